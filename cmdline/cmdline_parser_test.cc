@@ -38,7 +38,8 @@ namespace art {
         lhs.min_methods_to_save_ == rhs.min_methods_to_save_ &&
         lhs.min_classes_to_save_ == rhs.min_classes_to_save_ &&
         lhs.min_notification_before_wake_ == rhs.min_notification_before_wake_ &&
-        lhs.max_notification_before_wake_ == rhs.max_notification_before_wake_;
+        lhs.max_notification_before_wake_ == rhs.max_notification_before_wake_ &&
+        lhs.max_deltas_before_compaction_ == rhs.max_deltas_before_compaction_;
   }
 
   bool UsuallyEquals(double expected, double actual) {
@@ -483,7 +484,7 @@ TEST_F(CmdlineParserTest, TestJitOptions) {
 * -Xps-*
 */
 TEST_F(CmdlineParserTest, ProfileSaverOptions) {
-  ProfileSaverOptions opt = ProfileSaverOptions(true, 1, 2, 3, 4, 5, 6, 7, "abc");
+  ProfileSaverOptions opt = ProfileSaverOptions(true, 1, 2, 3, 4, 5, 6, 7, 8, "abc");
 
   EXPECT_SINGLE_PARSE_VALUE(opt,
                             "-Xjitsaveprofilinginfo "
@@ -494,6 +495,7 @@ TEST_F(CmdlineParserTest, ProfileSaverOptions) {
                             "-Xps-min-classes-to-save:5 "
                             "-Xps-min-notification-before-wake:6 "
                             "-Xps-max-notification-before-wake:7 "
+                            "-Xps-max-deltas-before-compaction:8 "
                             "-Xps-profile-path:abc",
                             M::ProfileSaverOpts);
 }  // TEST_F
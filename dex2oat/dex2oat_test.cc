@@ -31,6 +31,7 @@
 #include "dex_file-inl.h"
 #include "dex2oat_environment_test.h"
 #include "dex2oat_return_codes.h"
+#include "exec_utils.h"
 #include "jit/profile_compilation_info.h"
 #include "oat.h"
 #include "oat_file.h"
@@ -616,13 +617,32 @@ class Dex2oatLayoutTest : public Dex2oatTest {
     ASSERT_TRUE(result);
   }
 
+  // Rewrites the profile in the indexed format with profman.
+  void WriteIndexedProfile(const std::string& test_profile) {
+    std::string profman_cmd = GetTestAndroidRoot() + "/bin/profman";
+    if (kIsDebugBuild) {
+      profman_cmd += "d";
+    }
+    ASSERT_TRUE(OS::FileExists(profman_cmd.c_str())) << profman_cmd;
+    const std::string indexed_profile = test_profile + ".indexed";
+    std::vector<std::string> argv = {
+        profman_cmd,
+        "--write-indexed",
+        "--profile-file=" + test_profile,
+        "--reference-profile-file=" + indexed_profile };
+    std::string error_msg;
+    ASSERT_EQ(0, ExecAndReturnCode(argv, &error_msg)) << error_msg;
+    ASSERT_EQ(0, rename(indexed_profile.c_str(), test_profile.c_str()));
+  }
+
   void CompileProfileOdex(const std::string& dex_location,
                           const std::string& odex_location,
                           const std::string& app_image_file_name,
                           bool use_fd,
                           size_t num_profile_classes,
                           const std::vector<std::string>& extra_args = {},
-                          bool expect_success = true) {
+                          bool expect_success = true,
+                          bool indexed_profile = false) {
     const std::string profile_location = GetScratchDir() + "/primary.prof";
     const char* location = dex_location.c_str();
     std::string error_msg;
@@ -634,6 +654,9 @@ class Dex2oatLayoutTest : public Dex2oatTest {
                     dex_location,
                     num_profile_classes,
                     dex_file->GetLocationChecksum());
+    if (indexed_profile) {
+      WriteIndexedProfile(profile_location);
+    }
     std::vector<std::string> copy(extra_args);
     copy.push_back("--profile-file=" + profile_location);
     std::unique_ptr<File> app_image_file;
@@ -825,6 +848,26 @@ TEST_F(Dex2oatLayoutTest, TestVdexLayout) {
   RunTestVDex();
 }
 
+// dex2oat must lay out the dex file the same way from an indexed profile written by profman.
+TEST_F(Dex2oatLayoutTest, TestLayoutIndexedProfile) {
+  std::string dex_location = GetScratchDir() + "/DexNoOat.jar";
+  std::string odex_location = GetOdexDir() + "/DexOdexNoOat.odex";
+  std::string app_image_file = GetOdexDir() + "/DexOdexNoOat.art";
+  Copy(GetDexSrc2(), dex_location);
+
+  CompileProfileOdex(dex_location,
+                     odex_location,
+                     app_image_file,
+                     /* use_fd */ false,
+                     /* num_profile_classes */ 1,
+                     /* extra_args */ {},
+                     /* expect_success */ true,
+                     /* indexed_profile */ true);
+  CheckValidity();
+  ASSERT_TRUE(success_);
+  CheckResult(dex_location, odex_location, app_image_file);
+}
+
 class Dex2oatWatchdogTest : public Dex2oatTest {
  protected:
   void RunTest(bool expect_success, const std::vector<std::string>& extra_args = {}) {
@@ -347,16 +347,20 @@ void Collections::ReadEncodedValue(
 
 void Collections::CreateStringId(const DexFile& dex_file, uint32_t i) {
   const DexFile::StringId& disk_string_id = dex_file.GetStringId(dex::StringIndex(i));
-  StringData* string_data = new StringData(dex_file.GetStringData(disk_string_id));
+  const char* data = dex_file.GetStringData(disk_string_id);
+  const size_t data_size = strlen(data) + 1;
+  char* data_copy = allocator_.AllocArray<char>(data_size, kArenaAllocMisc);
+  memcpy(data_copy, data, data_size);
+  StringData* string_data = CreateItem<StringData>(data_copy);
   string_datas_.AddItem(string_data, disk_string_id.string_data_off_);
 
-  StringId* string_id = new StringId(string_data);
+  StringId* string_id = CreateItem<StringId>(string_data);
   string_ids_.AddIndexedItem(string_id, StringIdsOffset() + i * StringId::ItemSize(), i);
 }
 
 void Collections::CreateTypeId(const DexFile& dex_file, uint32_t i) {
   const DexFile::TypeId& disk_type_id = dex_file.GetTypeId(dex::TypeIndex(i));
-  TypeId* type_id = new TypeId(GetStringId(disk_type_id.descriptor_idx_.index_));
+  TypeId* type_id = CreateItem<TypeId>(GetStringId(disk_type_id.descriptor_idx_.index_));
   type_ids_.AddIndexedItem(type_id, TypeIdsOffset() + i * TypeId::ItemSize(), i);
 }
 
@@ -365,25 +369,25 @@ void Collections::CreateProtoId(const DexFile& dex_file, uint32_t i) {
   const DexFile::TypeList* type_list = dex_file.GetProtoParameters(disk_proto_id);
   TypeList* parameter_type_list = CreateTypeList(type_list, disk_proto_id.parameters_off_);
 
-  ProtoId* proto_id = new ProtoId(GetStringId(disk_proto_id.shorty_idx_.index_),
-                                  GetTypeId(disk_proto_id.return_type_idx_.index_),
-                                  parameter_type_list);
+  ProtoId* proto_id = CreateItem<ProtoId>(GetStringId(disk_proto_id.shorty_idx_.index_),
+                                          GetTypeId(disk_proto_id.return_type_idx_.index_),
+                                          parameter_type_list);
   proto_ids_.AddIndexedItem(proto_id, ProtoIdsOffset() + i * ProtoId::ItemSize(), i);
 }
 
 void Collections::CreateFieldId(const DexFile& dex_file, uint32_t i) {
   const DexFile::FieldId& disk_field_id = dex_file.GetFieldId(i);
-  FieldId* field_id = new FieldId(GetTypeId(disk_field_id.class_idx_.index_),
-                                  GetTypeId(disk_field_id.type_idx_.index_),
-                                  GetStringId(disk_field_id.name_idx_.index_));
+  FieldId* field_id = CreateItem<FieldId>(GetTypeId(disk_field_id.class_idx_.index_),
+                                          GetTypeId(disk_field_id.type_idx_.index_),
+                                          GetStringId(disk_field_id.name_idx_.index_));
   field_ids_.AddIndexedItem(field_id, FieldIdsOffset() + i * FieldId::ItemSize(), i);
 }
 
 void Collections::CreateMethodId(const DexFile& dex_file, uint32_t i) {
   const DexFile::MethodId& disk_method_id = dex_file.GetMethodId(i);
-  MethodId* method_id = new MethodId(GetTypeId(disk_method_id.class_idx_.index_),
-                                     GetProtoId(disk_method_id.proto_idx_),
-                                     GetStringId(disk_method_id.name_idx_.index_));
+  MethodId* method_id = CreateItem<MethodId>(GetTypeId(disk_method_id.class_idx_.index_),
+                                             GetProtoId(disk_method_id.proto_idx_),
+                                             GetStringId(disk_method_id.name_idx_.index_));
   method_ids_.AddIndexedItem(method_id, MethodIdsOffset() + i * MethodId::ItemSize(), i);
 }
 
@@ -411,8 +415,9 @@ void Collections::CreateClassDef(const DexFile& dex_file, uint32_t i) {
       CreateEncodedArrayItem(static_data, disk_class_def.static_values_off_);
   ClassData* class_data = CreateClassData(
       dex_file, dex_file.GetClassData(disk_class_def), disk_class_def.class_data_off_);
-  ClassDef* class_def = new ClassDef(class_type, access_flags, superclass, interfaces_type_list,
-                                     source_file, annotations, static_values, class_data);
+  ClassDef* class_def = CreateItem<ClassDef>(class_type, access_flags, superclass,
+                                             interfaces_type_list, source_file, annotations,
+                                             static_values, class_data);
   class_defs_.AddIndexedItem(class_def, ClassDefsOffset() + i * ClassDef::ItemSize(), i);
 }
 
@@ -429,7 +434,7 @@ TypeList* Collections::CreateTypeList(const DexFile::TypeList* dex_type_list, ui
   for (uint32_t index = 0; index < size; ++index) {
     type_vector->push_back(GetTypeId(dex_type_list->GetTypeItem(index).type_idx_.index_));
   }
-  TypeList* new_type_list = new TypeList(type_vector);
+  TypeList* new_type_list = CreateItem<TypeList>(type_vector);
   type_lists_.AddItem(new_type_list, offset);
   return new_type_list;
 }
@@ -448,7 +453,7 @@ EncodedArrayItem* Collections::CreateEncodedArrayItem(const uint8_t* static_data
     values->push_back(std::unique_ptr<EncodedValue>(ReadEncodedValue(&static_data)));
   }
   // TODO: Calculate the size of the encoded array.
-  EncodedArrayItem* encoded_array_item = new EncodedArrayItem(values);
+  EncodedArrayItem* encoded_array_item = CreateItem<EncodedArrayItem>(values);
   encoded_array_items_.AddItem(encoded_array_item, offset);
   return encoded_array_item;
 }
@@ -465,7 +470,7 @@ AnnotationItem* Collections::CreateAnnotationItem(const DexFile::AnnotationItem*
       ReadEncodedValue(&annotation_data, DexFile::kDexAnnotationAnnotation, 0);
   // TODO: Calculate the size of the annotation.
   AnnotationItem* annotation_item =
-      new AnnotationItem(visibility, encoded_value->ReleaseEncodedAnnotation());
+      CreateItem<AnnotationItem>(visibility, encoded_value->ReleaseEncodedAnnotation());
   annotation_items_.AddItem(annotation_item, offset);
   return annotation_item;
 }
@@ -491,7 +496,7 @@ AnnotationSetItem* Collections::CreateAnnotationSetItem(const DexFile& dex_file,
         CreateAnnotationItem(annotation, disk_annotations_item->entries_[i]);
     items->push_back(annotation_item);
   }
-  AnnotationSetItem* annotation_set_item = new AnnotationSetItem(items);
+  AnnotationSetItem* annotation_set_item = CreateItem<AnnotationSetItem>(items);
   annotation_set_items_.AddItem(annotation_set_item, offset);
   return annotation_set_item;
 }
@@ -555,7 +560,7 @@ AnnotationsDirectoryItem* Collections::CreateAnnotationsDirectoryItem(const DexF
     }
   }
   // TODO: Calculate the size of the annotations directory.
-  AnnotationsDirectoryItem* annotations_directory_item = new AnnotationsDirectoryItem(
+  AnnotationsDirectoryItem* annotations_directory_item = CreateItem<AnnotationsDirectoryItem>(
       class_annotation, field_annotations, method_annotations, parameter_annotations);
   annotations_directory_items_.AddItem(annotations_directory_item, offset);
   return annotations_directory_item;
@@ -577,7 +582,7 @@ ParameterAnnotation* Collections::GenerateParameterAnnotation(
       uint32_t set_offset = annotation_set_ref_list->list_[i].annotations_off_;
       annotations->push_back(CreateAnnotationSetItem(dex_file, annotation_set_item, set_offset));
     }
-    set_ref_list = new AnnotationSetRefList(annotations);
+    set_ref_list = CreateItem<AnnotationSetRefList>(annotations);
     annotation_set_ref_lists_.AddItem(set_ref_list, offset);
   }
   return new ParameterAnnotation(method_id, set_ref_list);
@@ -597,15 +602,16 @@ CodeItem* Collections::CreateCodeItem(const DexFile& dex_file,
     debug_info = debug_info_items_.GetExistingObject(disk_code_item.debug_info_off_);
     if (debug_info == nullptr) {
       uint32_t debug_info_size = GetDebugInfoStreamSize(debug_info_stream);
-      uint8_t* debug_info_buffer = new uint8_t[debug_info_size];
+      uint8_t* debug_info_buffer = allocator_.AllocArray<uint8_t>(debug_info_size,
+                                                                  kArenaAllocMisc);
       memcpy(debug_info_buffer, debug_info_stream, debug_info_size);
-      debug_info = new DebugInfoItem(debug_info_size, debug_info_buffer);
+      debug_info = CreateItem<DebugInfoItem>(debug_info_size, debug_info_buffer);
       debug_info_items_.AddItem(debug_info, disk_code_item.debug_info_off_);
     }
   }
 
   uint32_t insns_size = disk_code_item.insns_size_in_code_units_;
-  uint16_t* insns = new uint16_t[insns_size];
+  uint16_t* insns = allocator_.AllocArray<uint16_t>(insns_size, kArenaAllocMisc);
   memcpy(insns, disk_code_item.insns_, insns_size * sizeof(uint16_t));
 
   TryItemVector* tries = nullptr;
@@ -687,7 +693,7 @@ CodeItem* Collections::CreateCodeItem(const DexFile& dex_file,
   }
 
   uint32_t size = GetCodeItemSize(disk_code_item);
-  CodeItem* code_item = new CodeItem(
+  CodeItem* code_item = CreateItem<CodeItem>(
       registers_size, ins_size, outs_size, debug_info, insns_size, insns, tries, handler_list);
   code_item->SetSize(size);
   code_items_.AddItem(code_item, offset);
@@ -767,7 +773,8 @@ ClassData* Collections::CreateClassData(
     for (; cdii.HasNextVirtualMethod(); cdii.Next()) {
       virtual_methods->push_back(std::unique_ptr<MethodItem>(GenerateMethodItem(dex_file, cdii)));
     }
-    class_data = new ClassData(static_fields, instance_fields, direct_methods, virtual_methods);
+    class_data = CreateItem<ClassData>(
+        static_fields, instance_fields, direct_methods, virtual_methods);
     class_data->SetSize(cdii.EndDataPointer() - encoded_data);
     class_datas_.AddItem(class_data, offset);
   }
@@ -807,7 +814,7 @@ void Collections::CreateCallSiteId(const DexFile& dex_file, uint32_t i) {
   EncodedArrayItem* call_site_item =
       CreateEncodedArrayItem(disk_call_item_ptr, disk_call_site_id.data_off_);
 
-  CallSiteId* call_site_id = new CallSiteId(call_site_item);
+  CallSiteId* call_site_id = CreateItem<CallSiteId>(call_site_item);
   call_site_ids_.AddIndexedItem(call_site_id, CallSiteIdsOffset() + i * CallSiteId::ItemSize(), i);
 }
 
@@ -827,7 +834,7 @@ void Collections::CreateMethodHandleItem(const DexFile& dex_file, uint32_t i) {
   } else {
     field_or_method_id = GetFieldId(index);
   }
-  MethodHandleItem* method_handle = new MethodHandleItem(type, field_or_method_id);
+  MethodHandleItem* method_handle = CreateItem<MethodHandleItem>(type, field_or_method_id);
   method_handle_items_.AddIndexedItem(
       method_handle, MethodHandleItemsOffset() + i * MethodHandleItem::ItemSize(), i);
 }
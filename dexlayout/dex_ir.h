@@ -23,6 +23,7 @@
 #include <vector>
 #include <stdint.h>
 
+#include "base/arena_allocator.h"
 #include "dex_file-inl.h"
 #include "leb128.h"
 #include "utf.h"
@@ -104,7 +105,15 @@ class AbstractDispatcher {
   DISALLOW_COPY_AND_ASSIGN(AbstractDispatcher);
 };
 
-// Collections become owners of the objects added by moving them into unique pointers.
+// Items are allocated in the arena of the Collections that own them, and the arena memory is
+// released in bulk with the Collections. Owning pointers only run the destructors.
+template<class T> struct ItemDeleter {
+  void operator()(T* item) const { item->~T(); }
+};
+
+template<class T> using ItemPtr = std::unique_ptr<T, ItemDeleter<T>>;
+
+// Collections become owners of the objects added by moving them into item pointers.
 template<class T> class CollectionBase {
  public:
   CollectionBase() = default;
@@ -125,13 +134,13 @@ template<class T> class CollectionVector : public CollectionBase<T> {
   void AddIndexedItem(T* object, uint32_t offset, uint32_t index) {
     object->SetOffset(offset);
     object->SetIndex(index);
-    collection_.push_back(std::unique_ptr<T>(object));
+    collection_.push_back(ItemPtr<T>(object));
   }
   uint32_t Size() const { return collection_.size(); }
-  std::vector<std::unique_ptr<T>>& Collection() { return collection_; }
+  std::vector<ItemPtr<T>>& Collection() { return collection_; }
 
  private:
-  std::vector<std::unique_ptr<T>> collection_;
+  std::vector<ItemPtr<T>> collection_;
 
   DISALLOW_COPY_AND_ASSIGN(CollectionVector);
 };
@@ -148,49 +157,49 @@ template<class T> class CollectionMap : public CollectionBase<T> {
 
   void AddItem(T* object, uint32_t offset) {
     object->SetOffset(offset);
-    auto it = collection_.emplace(offset, std::unique_ptr<T>(object));
+    auto it = collection_.emplace(offset, ItemPtr<T>(object));
     CHECK(it.second) << "CollectionMap already has an object with offset " << offset << " "
                      << " and address " << it.first->second.get();
   }
   uint32_t Size() const { return collection_.size(); }
-  std::map<uint32_t, std::unique_ptr<T>>& Collection() { return collection_; }
+  std::map<uint32_t, ItemPtr<T>>& Collection() { return collection_; }
 
  private:
-  std::map<uint32_t, std::unique_ptr<T>> collection_;
+  std::map<uint32_t, ItemPtr<T>> collection_;
 
   DISALLOW_COPY_AND_ASSIGN(CollectionMap);
 };
 
 class Collections {
  public:
-  Collections() = default;
-
-  std::vector<std::unique_ptr<StringId>>& StringIds() { return string_ids_.Collection(); }
-  std::vector<std::unique_ptr<TypeId>>& TypeIds() { return type_ids_.Collection(); }
-  std::vector<std::unique_ptr<ProtoId>>& ProtoIds() { return proto_ids_.Collection(); }
-  std::vector<std::unique_ptr<FieldId>>& FieldIds() { return field_ids_.Collection(); }
-  std::vector<std::unique_ptr<MethodId>>& MethodIds() { return method_ids_.Collection(); }
-  std::vector<std::unique_ptr<ClassDef>>& ClassDefs() { return class_defs_.Collection(); }
-  std::vector<std::unique_ptr<CallSiteId>>& CallSiteIds() { return call_site_ids_.Collection(); }
-  std::vector<std::unique_ptr<MethodHandleItem>>& MethodHandleItems()
+  Collections() : allocator_(&pool_) { }
+
+  std::vector<ItemPtr<StringId>>& StringIds() { return string_ids_.Collection(); }
+  std::vector<ItemPtr<TypeId>>& TypeIds() { return type_ids_.Collection(); }
+  std::vector<ItemPtr<ProtoId>>& ProtoIds() { return proto_ids_.Collection(); }
+  std::vector<ItemPtr<FieldId>>& FieldIds() { return field_ids_.Collection(); }
+  std::vector<ItemPtr<MethodId>>& MethodIds() { return method_ids_.Collection(); }
+  std::vector<ItemPtr<ClassDef>>& ClassDefs() { return class_defs_.Collection(); }
+  std::vector<ItemPtr<CallSiteId>>& CallSiteIds() { return call_site_ids_.Collection(); }
+  std::vector<ItemPtr<MethodHandleItem>>& MethodHandleItems()
       { return method_handle_items_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<StringData>>& StringDatas()
+  std::map<uint32_t, ItemPtr<StringData>>& StringDatas()
       { return string_datas_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<TypeList>>& TypeLists() { return type_lists_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<EncodedArrayItem>>& EncodedArrayItems()
+  std::map<uint32_t, ItemPtr<TypeList>>& TypeLists() { return type_lists_.Collection(); }
+  std::map<uint32_t, ItemPtr<EncodedArrayItem>>& EncodedArrayItems()
       { return encoded_array_items_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<AnnotationItem>>& AnnotationItems()
+  std::map<uint32_t, ItemPtr<AnnotationItem>>& AnnotationItems()
       { return annotation_items_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<AnnotationSetItem>>& AnnotationSetItems()
+  std::map<uint32_t, ItemPtr<AnnotationSetItem>>& AnnotationSetItems()
       { return annotation_set_items_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<AnnotationSetRefList>>& AnnotationSetRefLists()
+  std::map<uint32_t, ItemPtr<AnnotationSetRefList>>& AnnotationSetRefLists()
       { return annotation_set_ref_lists_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<AnnotationsDirectoryItem>>& AnnotationsDirectoryItems()
+  std::map<uint32_t, ItemPtr<AnnotationsDirectoryItem>>& AnnotationsDirectoryItems()
       { return annotations_directory_items_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<DebugInfoItem>>& DebugInfoItems()
+  std::map<uint32_t, ItemPtr<DebugInfoItem>>& DebugInfoItems()
       { return debug_info_items_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<CodeItem>>& CodeItems() { return code_items_.Collection(); }
-  std::map<uint32_t, std::unique_ptr<ClassData>>& ClassDatas() { return class_datas_.Collection(); }
+  std::map<uint32_t, ItemPtr<CodeItem>>& CodeItems() { return code_items_.Collection(); }
+  std::map<uint32_t, ItemPtr<ClassData>>& ClassDatas() { return class_datas_.Collection(); }
 
   void CreateStringId(const DexFile& dex_file, uint32_t i);
   void CreateTypeId(const DexFile& dex_file, uint32_t i);
@@ -328,6 +337,15 @@ class Collections {
       const DexFile::AnnotationSetRefList* annotation_set_ref_list, uint32_t offset);
   MethodItem* GenerateMethodItem(const DexFile& dex_file, ClassDataItemIterator& cdii);
 
+  template <typename T, typename... Args>
+  T* CreateItem(Args&&... args) {
+    return new (allocator_.Alloc(sizeof(T), kArenaAllocMisc)) T(std::forward<Args>(args)...);
+  }
+
+  // Declared before the collections so that the items are destroyed before their memory.
+  ArenaPool pool_;
+  ArenaAllocator allocator_;
+
   CollectionVector<StringId> string_ids_;
   CollectionVector<TypeId> type_ids_;
   CollectionVector<ProtoId> proto_ids_;
@@ -458,16 +476,17 @@ class Header : public Item {
 
 class StringData : public Item {
  public:
-  explicit StringData(const char* data) : data_(strdup(data)) {
+  // `data` is owned by the arena of the Collections.
+  explicit StringData(const char* data) : data_(data) {
     size_ = UnsignedLeb128Size(CountModifiedUtf8Chars(data)) + strlen(data);
   }
 
-  const char* Data() const { return data_.get(); }
+  const char* Data() const { return data_; }
 
   void Accept(AbstractDispatcher* dispatch) const { dispatch->Dispatch(this); }
 
  private:
-  UniqueCPtr<const char> data_;
+  const char* data_;
 
   DISALLOW_COPY_AND_ASSIGN(StringData);
 };
@@ -935,7 +954,7 @@ class CodeItem : public Item {
   uint16_t TriesSize() const { return tries_ == nullptr ? 0 : tries_->size(); }
   DebugInfoItem* DebugInfo() const { return debug_info_; }
   uint32_t InsnsSize() const { return insns_size_; }
-  uint16_t* Insns() const { return insns_.get(); }
+  uint16_t* Insns() const { return insns_; }
   TryItemVector* Tries() const { return tries_.get(); }
   CatchHandlerVector* Handlers() const { return handlers_.get(); }
 
@@ -950,7 +969,7 @@ class CodeItem : public Item {
   uint16_t outs_size_;
   DebugInfoItem* debug_info_;  // This can be nullptr.
   uint32_t insns_size_;
-  std::unique_ptr<uint16_t[]> insns_;
+  uint16_t* insns_;  // Owned by the arena of the Collections.
   std::unique_ptr<TryItemVector> tries_;  // This can be nullptr.
   std::unique_ptr<CatchHandlerVector> handlers_;  // This can be nullptr.
   std::unique_ptr<CodeFixups> fixups_;  // This can be nullptr.
@@ -997,14 +1016,14 @@ class DebugInfoItem : public Item {
      : debug_info_size_(debug_info_size), debug_info_(debug_info) { }
 
   uint32_t GetDebugInfoSize() const { return debug_info_size_; }
-  uint8_t* GetDebugInfo() const { return debug_info_.get(); }
+  uint8_t* GetDebugInfo() const { return debug_info_; }
 
   PositionInfoVector& GetPositionInfo() { return positions_; }
   LocalInfoVector& GetLocalInfo() { return locals_; }
 
  private:
   uint32_t debug_info_size_;
-  std::unique_ptr<uint8_t[]> debug_info_;
+  uint8_t* debug_info_;  // Owned by the arena of the Collections.
 
   PositionInfoVector positions_;
   LocalInfoVector locals_;
@@ -49,8 +49,8 @@ bool VerifyOutputDexFile(dex_ir::Header* orig_header,
   return true;
 }
 
-template<class T> bool VerifyIds(std::vector<std::unique_ptr<T>>& orig,
-                                 std::vector<std::unique_ptr<T>>& output,
+template<class T> bool VerifyIds(std::vector<dex_ir::ItemPtr<T>>& orig,
+                                 std::vector<dex_ir::ItemPtr<T>>& output,
                                  const char* section_name,
                                  std::string* error_msg) {
   if (orig.size() != output.size()) {
@@ -181,8 +181,8 @@ struct ClassDefCompare {
 
 // The class defs may have a new order due to dexlayout. Use the class's class_idx to uniquely
 // identify them and sort them for comparison.
-bool VerifyClassDefs(std::vector<std::unique_ptr<dex_ir::ClassDef>>& orig,
-                     std::vector<std::unique_ptr<dex_ir::ClassDef>>& output,
+bool VerifyClassDefs(std::vector<dex_ir::ItemPtr<dex_ir::ClassDef>>& orig,
+                     std::vector<dex_ir::ItemPtr<dex_ir::ClassDef>>& output,
                      std::string* error_msg) {
   if (orig.size() != output.size()) {
     *error_msg = StringPrintf(
@@ -19,20 +19,26 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include "android-base/stringprintf.h"
 
 #include "base/stringpiece.h"
+#include "base/time_utils.h"
 
 #include "dex_file.h"
 #include "dex_ir.h"
 #include "dex_ir_builder.h"
 #include "pagemap/pagemap.h"
 #include "runtime.h"
+#include "utils.h"
 #include "vdex_file.h"
 
 namespace art {
@@ -260,11 +266,12 @@ static void DisplayDexStatistics(size_t start,
   printer->PrintSkipLine();
 }
 
-static void ProcessOneDexMapping(uint64_t* pagemap,
-                                 uint64_t map_start,
-                                 const DexFile* dex_file,
-                                 uint64_t vdex_start,
-                                 Printer* printer) {
+// Computes the pages of the vdex mapping that hold `dex_file`.
+static bool GetDexFilePages(uint64_t map_start,
+                            const DexFile* dex_file,
+                            uint64_t vdex_start,
+                            uint64_t* start_page,
+                            uint64_t* end_page) {
   uint64_t dex_file_start = reinterpret_cast<uint64_t>(dex_file->Begin());
   size_t dex_file_size = dex_file->Size();
   if (dex_file_start < vdex_start) {
@@ -273,24 +280,37 @@ static void ProcessOneDexMapping(uint64_t* pagemap,
               << " is incorrect: map start "
               << StringPrintf("%" PRIx64 " > dex start %" PRIx64 "\n", map_start, dex_file_start)
               << std::endl;
+    return false;
+  }
+  *start_page = (dex_file_start - vdex_start) / kPageSize;
+  uint64_t start_address = *start_page * kPageSize;
+  *end_page = RoundUp(start_address + dex_file_size, kPageSize) / kPageSize;
+  return true;
+}
+
+// Builds a list of the dex file section types, sorted from highest offset to lowest.
+static std::vector<dex_ir::DexFileSection> GetSortedSections(const DexFile* dex_file) {
+  std::unique_ptr<dex_ir::Header> header(dex_ir::DexIrBuilder(*dex_file));
+  return dex_ir::GetSortedDexFileSections(header.get(), dex_ir::SortDirection::kSortDescending);
+}
+
+static void ProcessOneDexMapping(uint64_t* pagemap,
+                                 uint64_t map_start,
+                                 const DexFile* dex_file,
+                                 uint64_t vdex_start,
+                                 Printer* printer) {
+  uint64_t start_page;
+  uint64_t end_page;
+  if (!GetDexFilePages(map_start, dex_file, vdex_start, &start_page, &end_page)) {
     return;
   }
-  uint64_t start_page = (dex_file_start - vdex_start) / kPageSize;
-  uint64_t start_address = start_page * kPageSize;
-  uint64_t end_page = RoundUp(start_address + dex_file_size, kPageSize) / kPageSize;
   std::cout << "DEX "
             << dex_file->GetLocation().c_str()
             << StringPrintf(": %" PRIx64 "-%" PRIx64,
                             map_start + start_page * kPageSize,
                             map_start + end_page * kPageSize)
             << std::endl;
-  // Build a list of the dex file section types, sorted from highest offset to lowest.
-  std::vector<dex_ir::DexFileSection> sections;
-  {
-    std::unique_ptr<dex_ir::Header> header(dex_ir::DexIrBuilder(*dex_file));
-    sections = dex_ir::GetSortedDexFileSections(header.get(),
-                                                dex_ir::SortDirection::kSortDescending);
-  }
+  std::vector<dex_ir::DexFileSection> sections = GetSortedSections(dex_file);
   PageCount section_resident_pages;
   ProcessPageMap(pagemap, start_page, end_page, sections, &section_resident_pages);
   DisplayDexStatistics(start_page, end_page, section_resident_pages, sections, printer);
@@ -431,11 +451,207 @@ static bool FilterByNameContains(const std::string& mapped_file_name,
   return false;
 }
 
+// Residency of the mapped dex files, sampled over time. Each sample writes one line per dex file
+// or oat mapping whose resident pages changed since the previous sample:
+//   <ms since first sample> <name> <section letter><resident pages><+/-delta> ...
+// where only the sections whose residency changed are listed.
+class ResidencyTimeline {
+ public:
+  explicit ResidencyTimeline(std::ostream* os) : os_(os) {}
+
+  void Record(uint64_t time_ms, const std::string& name, const std::map<char, size_t>& resident) {
+    std::map<char, size_t>& previous = previous_[name];
+    // A section missing from either sample has no resident pages in it, so walk both key sets to
+    // also report the sections that dropped to zero.
+    std::set<char> sections;
+    for (const auto& pair : previous) {
+      sections.insert(pair.first);
+    }
+    for (const auto& pair : resident) {
+      sections.insert(pair.first);
+    }
+    std::string line;
+    for (char section : sections) {
+      const size_t previous_count = GetCount(previous, section);
+      const size_t count = GetCount(resident, section);
+      if (count != previous_count) {
+        line += StringPrintf(" %c%zu%+" PRId64,
+                             section,
+                             count,
+                             static_cast<int64_t>(count) - static_cast<int64_t>(previous_count));
+      }
+    }
+    if (!line.empty()) {
+      *os_ << time_ms << " " << name << line << "\n";
+    }
+    previous = resident;
+  }
+
+  void Flush() {
+    *os_ << std::flush;
+  }
+
+ private:
+  static size_t GetCount(const std::map<char, size_t>& counts, char section) {
+    auto it = counts.find(section);
+    return (it != counts.end()) ? it->second : 0u;
+  }
+
+  std::ostream* const os_;
+  std::map<std::string, std::map<char, size_t>> previous_;
+};
+
+// The dex files of a vdex file and their sections, opened once for all samples.
+struct SampledVdexFile {
+  std::unique_ptr<VdexFile> vdex;
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  std::vector<std::vector<dex_ir::DexFileSection>> sections;
+};
+
+static bool SampleVdexMapping(pm_map_t* map,
+                              uint64_t time_ms,
+                              std::map<std::string, SampledVdexFile>* vdex_files,
+                              ResidencyTimeline* timeline) {
+  const std::string vdex_name = pm_map_name(map);
+  auto it = vdex_files->find(vdex_name);
+  if (it == vdex_files->end()) {
+    SampledVdexFile sampled;
+    std::string error_msg;
+    sampled.vdex = VdexFile::Open(vdex_name,
+                                  false /* writeable */,
+                                  false /* low_4gb */,
+                                  false /* unquicken */,
+                                  false /* decompile_return_instruction */,
+                                  &error_msg /* out */);
+    if (sampled.vdex == nullptr || !sampled.vdex->OpenAllDexFiles(&sampled.dex_files, &error_msg)) {
+      std::cerr << "Could not open vdex file " << vdex_name << ": error " << error_msg << std::endl;
+      return false;
+    }
+    for (const auto& dex_file : sampled.dex_files) {
+      sampled.sections.push_back(GetSortedSections(dex_file.get()));
+    }
+    it = vdex_files->emplace(vdex_name, std::move(sampled)).first;
+  }
+  const SampledVdexFile& sampled = it->second;
+
+  uint64_t* pagemap;
+  size_t len;
+  if (pm_map_pagemap(map, &pagemap, &len) != 0) {
+    std::cerr << "Error creating pagemap." << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < sampled.dex_files.size(); ++i) {
+    const DexFile* dex_file = sampled.dex_files[i].get();
+    uint64_t start_page;
+    uint64_t end_page;
+    if (!GetDexFilePages(pm_map_start(map),
+                         dex_file,
+                         reinterpret_cast<uint64_t>(sampled.vdex->Begin()),
+                         &start_page,
+                         &end_page)) {
+      continue;
+    }
+    end_page = std::min<uint64_t>(end_page, len);
+    std::map<char, size_t> resident;
+    for (uint64_t page = start_page; page < end_page; ++page) {
+      if (PM_PAGEMAP_PRESENT(pagemap[page])) {
+        ++resident[PageTypeChar(FindSectionTypeForPage(page - start_page, sampled.sections[i]))];
+      }
+    }
+    timeline->Record(time_ms, vdex_name + "!" + dex_file->GetLocation(), resident);
+  }
+  free(pagemap);
+  return true;
+}
+
+static bool SampleOatMapping(pm_map_t* map, uint64_t time_ms, ResidencyTimeline* timeline) {
+  uint64_t* pagemap;
+  size_t len;
+  if (pm_map_pagemap(map, &pagemap, &len) != 0) {
+    std::cerr << "Error creating pagemap." << std::endl;
+    return false;
+  }
+  std::map<char, size_t> resident;
+  for (size_t page = 0; page < len; ++page) {
+    if (PM_PAGEMAP_PRESENT(pagemap[page])) {
+      ++resident['*'];
+    }
+  }
+  free(pagemap);
+  // An oat file has several mappings, distinguish them by their start address.
+  timeline->Record(time_ms,
+                   StringPrintf("%s@%" PRIx64, pm_map_name(map), pm_map_start(map)),
+                   resident);
+  return true;
+}
+
+// Samples the residency of the dex and oat mappings of `pid` every `interval_ms`, `num_samples`
+// times or until the process exits. The maps are listed again for each sample, so that mappings
+// created during startup are picked up.
+static bool SampleResidency(pm_kernel_t* ker,
+                            pid_t pid,
+                            const std::vector<std::string>& name_filters,
+                            uint64_t interval_ms,
+                            size_t num_samples,
+                            ResidencyTimeline* timeline) {
+  std::map<std::string, SampledVdexFile> vdex_files;
+  const uint64_t start_ms = MilliTime();
+  for (size_t sample = 0; sample < num_samples; ++sample) {
+    // Sample at fixed times rather than fixed delays, so that slow samples do not skew the
+    // timeline.
+    const uint64_t sample_ms = start_ms + sample * interval_ms;
+    const uint64_t now_ms = MilliTime();
+    if (now_ms < sample_ms) {
+      usleep((sample_ms - now_ms) * 1000);
+    }
+    const uint64_t time_ms = MilliTime() - start_ms;
+
+    pm_process_t* proc;
+    if (pm_process_create(ker, pid, &proc) != 0) {
+      // The process exited, end the timeline.
+      break;
+    }
+    pm_map_t** maps;
+    size_t num_maps;
+    if (pm_process_maps(proc, &maps, &num_maps) != 0) {
+      pm_process_destroy(proc);
+      break;
+    }
+    bool success = true;
+    for (size_t i = 0; i < num_maps && success; ++i) {
+      std::string mapped_file_name = pm_map_name(maps[i]);
+      if (!FilterByNameContains(mapped_file_name, name_filters)) {
+        continue;
+      }
+      if (strstr(mapped_file_name.c_str(), ".vdex") != nullptr) {
+        success = SampleVdexMapping(maps[i], time_ms, &vdex_files, timeline);
+      } else if (strstr(mapped_file_name.c_str(), ".odex") != nullptr ||
+                 strstr(mapped_file_name.c_str(), ".oat") != nullptr) {
+        success = SampleOatMapping(maps[i], time_ms, timeline);
+      }
+    }
+    free(maps);
+    pm_process_destroy(proc);
+    timeline->Flush();
+    if (!success) {
+      return false;
+    }
+  }
+  return true;
+}
+
 static void Usage(const char* cmd) {
   std::cerr << "Usage: " << cmd << " [options] pid" << std::endl
             << "    --contains=<string>:  Display sections containing string." << std::endl
             << "    --help:               Shows this message." << std::endl
-            << "    --verbose:            Makes displays verbose." << std::endl;
+            << "    --verbose:            Makes displays verbose." << std::endl
+            << "    --samples=<n>:        Sample the residency n times and write a timeline of"
+            << std::endl
+            << "                          the resident pages of each section that changed."
+            << std::endl
+            << "    --interval-ms=<ms>:   Time between samples. Defaults to 100." << std::endl
+            << "    --timeline=<file>:    Write the timeline to file instead of stdout."
+            << std::endl;
   PrintLetterKey();
 }
 
@@ -446,6 +662,9 @@ static int DexDiagMain(int argc, char* argv[]) {
   }
 
   std::vector<std::string> name_filters;
+  size_t num_samples = 0;
+  uint64_t interval_ms = 100;
+  std::string timeline_filename;
   // TODO: add option to track usage by class name, etc.
   for (int i = 1; i < argc - 1; ++i) {
     const StringPiece option(argv[i]);
@@ -457,6 +676,19 @@ static int DexDiagMain(int argc, char* argv[]) {
     } else if (option.starts_with("--contains=")) {
       std::string contains(option.substr(strlen("--contains=")).data());
       name_filters.push_back(contains);
+    } else if (option.starts_with("--samples=")) {
+      if (!ParseUint(option.substr(strlen("--samples=")).data(), &num_samples) ||
+          num_samples == 0) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (option.starts_with("--interval-ms=")) {
+      if (!ParseUint(option.substr(strlen("--interval-ms=")).data(), &interval_ms)) {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (option.starts_with("--timeline=")) {
+      timeline_filename = option.substr(strlen("--timeline=")).ToString();
     } else {
       Usage(argv[0]);
       return EXIT_FAILURE;
@@ -482,6 +714,25 @@ static int DexDiagMain(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
+  if (num_samples != 0) {
+    std::ofstream timeline_file;
+    std::ostream* timeline_os = &std::cout;
+    if (!timeline_filename.empty()) {
+      timeline_file.open(timeline_filename);
+      if (!timeline_file.good()) {
+        std::cerr << "Could not open timeline file " << timeline_filename << std::endl;
+        return EXIT_FAILURE;
+      }
+      timeline_os = &timeline_file;
+    }
+    *timeline_os << "# dexdiag timeline: pid " << pid << ", " << interval_ms << " ms interval\n";
+    ResidencyTimeline timeline(timeline_os);
+    if (!SampleResidency(ker, pid, name_filters, interval_ms, num_samples, &timeline)) {
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
   // get libpagemap process information.
   pm_process_t* proc;
   if (pm_process_create(ker, pid, &proc) != 0) {
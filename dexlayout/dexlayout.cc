@@ -26,9 +26,12 @@
 #include <stdio.h>
 #include <sys/mman.h>  // For the PROT_* and MAP_* constants.
 
+#include <condition_variable>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #include "android-base/stringprintf.h"
@@ -50,6 +53,8 @@ namespace art {
 using android::base::StringPrintf;
 
 static constexpr uint32_t kDexCodeItemAlignment = 4;
+static constexpr uint32_t kDexTypeListAlignment = 4;
+static constexpr uint32_t kDexAnnotationSetItemAlignment = 4;
 
 /*
  * Flags for use with createAccessFlagStr().
@@ -1498,13 +1503,13 @@ void DexLayout::DumpDexFile() {
 
 std::vector<dex_ir::ClassData*> DexLayout::LayoutClassDefsAndClassData(const DexFile* dex_file) {
   std::vector<dex_ir::ClassDef*> new_class_def_order;
-  for (std::unique_ptr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
+  for (dex_ir::ItemPtr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
     dex::TypeIndex type_idx(class_def->ClassType()->GetIndex());
     if (info_->ContainsClass(*dex_file, type_idx)) {
       new_class_def_order.push_back(class_def.get());
     }
   }
-  for (std::unique_ptr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
+  for (dex_ir::ItemPtr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
     dex::TypeIndex type_idx(class_def->ClassType()->GetIndex());
     if (!info_->ContainsClass(*dex_file, type_idx)) {
       new_class_def_order.push_back(class_def.get());
@@ -1530,19 +1535,91 @@ std::vector<dex_ir::ClassData*> DexLayout::LayoutClassDefsAndClassData(const Dex
   return new_class_data_order;
 }
 
-void DexLayout::LayoutStringData(const DexFile* dex_file) {
+// The sections covered by the startup page report, in report order.
+enum StartupSection {
+  kStartupStringData,
+  kStartupTypeLists,
+  kStartupAnnotationSetItems,
+  kStartupClassData,
+  kStartupCodeItems,
+  kStartupDebugInfoItems,
+  kNumStartupSections
+};
+
+static const char* const kStartupSectionNames[kNumStartupSections] = {
+  "string_data",
+  "type_list",
+  "annotation_set",
+  "class_data",
+  "code_item",
+  "debug_info",
+};
+
+struct DexLayout::StartupItems {
+  void Add(StartupSection section, const dex_ir::Item* item, uint32_t size) {
+    if (item != nullptr && items.insert(item).second) {
+      sections[section].push_back(std::make_pair(item, size));
+    }
+  }
+
+  void AddAnnotationSet(const dex_ir::AnnotationSetItem* annotation_set_item) {
+    if (annotation_set_item != nullptr) {
+      Add(kStartupAnnotationSetItems, annotation_set_item, annotation_set_item->GetSize());
+    }
+  }
+
+  std::unordered_set<const dex_ir::Item*> items;
+  // The startup items of each section with their size in bytes.
+  std::vector<std::pair<const dex_ir::Item*, uint32_t>> sections[kNumStartupSections];
+  // String ids that are shorties of startup methods, and string ids used during startup.
+  std::vector<bool> is_shorty;
+  std::vector<bool> from_hot_method;
+};
+
+void DexLayout::CollectStartupItems(const DexFile* dex_file, StartupItems* startup_items) {
   const size_t num_strings = header_->GetCollections().StringIds().size();
-  std::vector<bool> is_shorty(num_strings, false);
-  std::vector<bool> from_hot_method(num_strings, false);
-  for (std::unique_ptr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
+  std::vector<bool>& is_shorty = startup_items->is_shorty;
+  std::vector<bool>& from_hot_method = startup_items->from_hot_method;
+  is_shorty.assign(num_strings, false);
+  from_hot_method.assign(num_strings, false);
+  for (dex_ir::ItemPtr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
     // A name of a profile class is probably going to get looked up by ClassTable::Lookup, mark it
     // as hot.
     const bool is_profile_class =
         info_->ContainsClass(*dex_file, dex::TypeIndex(class_def->ClassType()->GetIndex()));
+    dex_ir::ClassData* data = class_def->GetClassData();
     if (is_profile_class) {
       from_hot_method[class_def->ClassType()->GetStringId()->GetIndex()] = true;
+      // Class linking reads the interfaces, the class data, and the annotations.
+      const dex_ir::TypeList* interfaces = class_def->Interfaces();
+      if (interfaces != nullptr) {
+        startup_items->Add(kStartupTypeLists, interfaces, interfaces->GetSize());
+      }
+      if (data != nullptr) {
+        startup_items->Add(kStartupClassData, data, data->GetSize());
+      }
+      dex_ir::AnnotationsDirectoryItem* annotations = class_def->Annotations();
+      if (annotations != nullptr) {
+        startup_items->AddAnnotationSet(annotations->GetClassAnnotation());
+        if (annotations->GetFieldAnnotations() != nullptr) {
+          for (auto& field : *annotations->GetFieldAnnotations()) {
+            startup_items->AddAnnotationSet(field->GetAnnotationSetItem());
+          }
+        }
+        if (annotations->GetMethodAnnotations() != nullptr) {
+          for (auto& method : *annotations->GetMethodAnnotations()) {
+            startup_items->AddAnnotationSet(method->GetAnnotationSetItem());
+          }
+        }
+        if (annotations->GetParameterAnnotations() != nullptr) {
+          for (auto& parameter : *annotations->GetParameterAnnotations()) {
+            for (dex_ir::AnnotationSetItem* set : *parameter->GetAnnotations()->GetItems()) {
+              startup_items->AddAnnotationSet(set);
+            }
+          }
+        }
+      }
     }
-    dex_ir::ClassData* data = class_def->GetClassData();
     if (data == nullptr) {
       continue;
     }
@@ -1562,6 +1639,15 @@ void DexLayout::LayoutStringData(const DexFile* dex_file) {
           continue;
         }
         is_shorty[method_id->Proto()->Shorty()->GetIndex()] = true;
+        const dex_ir::TypeList* parameters = method_id->Proto()->Parameters();
+        if (parameters != nullptr) {
+          startup_items->Add(kStartupTypeLists, parameters, parameters->GetSize());
+        }
+        startup_items->Add(kStartupCodeItems, code_item, code_item->GetSize());
+        dex_ir::DebugInfoItem* debug_info = code_item->DebugInfo();
+        if (debug_info != nullptr) {
+          startup_items->Add(kStartupDebugInfoItems, debug_info, debug_info->GetDebugInfoSize());
+        }
         dex_ir::CodeFixups* fixups = code_item->GetCodeFixups();
         if (fixups == nullptr) {
           continue;
@@ -1572,6 +1658,10 @@ void DexLayout::LayoutStringData(const DexFile* dex_file) {
             from_hot_method[id->GetIndex()] = true;
           }
         }
+        // Add the descriptors of the types resolved by the method.
+        for (dex_ir::TypeId* id : *fixups->TypeIds()) {
+          from_hot_method[id->GetStringId()->GetIndex()] = true;
+        }
         // TODO: Only visit field ids from static getters and setters.
         for (dex_ir::FieldId* id : *fixups->FieldIds()) {
           // Add the field names and types from getters and setters.
@@ -1581,6 +1671,51 @@ void DexLayout::LayoutStringData(const DexFile* dex_file) {
       }
     }
   }
+  for (auto& string_id : header_->GetCollections().StringIds()) {
+    if (is_shorty[string_id->GetIndex()] || from_hot_method[string_id->GetIndex()]) {
+      dex_ir::StringData* data = string_id->DataItem();
+      startup_items->Add(kStartupStringData, data, data->GetSize() + 1);  // Add one for null.
+    }
+  }
+}
+
+// Returns the number of pages touched by the startup items of each section, followed by the
+// number of distinct pages touched by all of them.
+std::vector<size_t> DexLayout::CountStartupPages(const StartupItems& startup_items) {
+  std::vector<size_t> counts;
+  std::set<uint32_t> all_pages;
+  for (const auto& section : startup_items.sections) {
+    std::set<uint32_t> pages;
+    for (const auto& item_and_size : section) {
+      const uint32_t offset = item_and_size.first->GetOffset();
+      const uint32_t size = std::max(item_and_size.second, 1u);
+      for (uint32_t page = offset / kPageSize; page <= (offset + size - 1) / kPageSize; ++page) {
+        pages.insert(page);
+      }
+    }
+    counts.push_back(pages.size());
+    all_pages.insert(pages.begin(), pages.end());
+  }
+  counts.push_back(all_pages.size());
+  return counts;
+}
+
+void DexLayout::DumpStartupPages(const DexFile* dex_file,
+                                 const std::vector<size_t>& pages_before,
+                                 const std::vector<size_t>& pages_after) {
+  fprintf(out_file_, "Startup pages of '%s':\n", dex_file->GetLocation().c_str());
+  fprintf(out_file_, "%-16s %8s %8s\n", "section", "before", "after");
+  for (size_t i = 0; i < kNumStartupSections; ++i) {
+    fprintf(out_file_, "%-16s %8zu %8zu\n", kStartupSectionNames[i], pages_before[i],
+            pages_after[i]);
+  }
+  fprintf(out_file_, "%-16s %8zu %8zu\n\n", "total", pages_before[kNumStartupSections],
+          pages_after[kNumStartupSections]);
+}
+
+void DexLayout::LayoutStringData(const StartupItems& startup_items) {
+  const std::vector<bool>& is_shorty = startup_items.is_shorty;
+  const std::vector<bool>& from_hot_method = startup_items.from_hot_method;
   // Sort string data by specified order.
   std::vector<dex_ir::StringId*> string_ids;
   size_t min_offset = std::numeric_limits<size_t>::max();
@@ -1655,7 +1790,7 @@ int32_t DexLayout::LayoutCodeItems(const DexFile* dex_file,
   bool is_code_item_aligned = IsNextSectionCodeItemAligned(code_item_offset);
   if (!is_code_item_aligned) {
     for (auto& code_item_pair : header_->GetCollections().CodeItems()) {
-      std::unique_ptr<dex_ir::CodeItem>& code_item = code_item_pair.second;
+      dex_ir::ItemPtr<dex_ir::CodeItem>& code_item = code_item_pair.second;
       if (last_code_item == nullptr
           || last_code_item->GetOffset() < code_item->GetOffset()) {
         last_code_item = code_item.get();
@@ -1676,7 +1811,7 @@ int32_t DexLayout::LayoutCodeItems(const DexFile* dex_file,
 
   std::unordered_set<dex_ir::CodeItem*> code_items[CodeItemKind::kSize];
   for (InvokeType invoke_type : invoke_types) {
-    for (std::unique_ptr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
+    for (dex_ir::ItemPtr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
       const bool is_profile_class =
           info_->ContainsClass(*dex_file, dex::TypeIndex(class_def->ClassType()->GetIndex()));
 
@@ -1739,6 +1874,74 @@ int32_t DexLayout::LayoutCodeItems(const DexFile* dex_file,
   return RoundUp(total_diff, kDexCodeItemAlignment);
 }
 
+// Moves the startup items of a data section in front of the other items, keeping the original
+// order within each group. The item at the end of the section stays in place, so that the end of
+// the section and the offsets of the following sections do not change.
+template<class T, class SizeFn>
+static void MoveStartupItemsFirst(std::map<uint32_t, dex_ir::ItemPtr<T>>& items,
+                                  const std::unordered_set<const dex_ir::Item*>& startup_items,
+                                  SizeFn item_size,
+                                  uint32_t alignment,
+                                  const char* section_name) {
+  if (items.size() < 2) {
+    return;
+  }
+  std::vector<T*> order;
+  for (auto& pair : items) {
+    order.push_back(pair.second.get());
+  }
+  std::sort(order.begin(), order.end(), [](const T* a, const T* b) {
+    return a->GetOffset() < b->GetOffset();
+  });
+  const uint32_t section_start = order.front()->GetOffset();
+  const uint32_t last_offset = order.back()->GetOffset();
+  order.pop_back();
+  std::stable_partition(order.begin(), order.end(), [&startup_items](const T* item) {
+    return startup_items.find(item) != startup_items.end();
+  });
+  std::vector<uint32_t> new_offsets;
+  uint32_t offset = section_start;
+  for (const T* item : order) {
+    offset = RoundUp(offset, alignment);
+    new_offsets.push_back(offset);
+    offset += item_size(item);
+  }
+  if (RoundUp(offset, alignment) > last_offset) {
+    // The items do not fit with the new padding, keep the original order.
+    LOG(WARNING) << "Not reordering " << section_name << " items: the section would grow";
+    return;
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i]->SetOffset(new_offsets[i]);
+  }
+}
+
+void DexLayout::LayoutTypeLists(const StartupItems& startup_items) {
+  MoveStartupItemsFirst(header_->GetCollections().TypeLists(),
+                        startup_items.items,
+                        [](const dex_ir::TypeList* type_list) { return type_list->GetSize(); },
+                        kDexTypeListAlignment,
+                        "type list");
+}
+
+void DexLayout::LayoutAnnotationSetItems(const StartupItems& startup_items) {
+  MoveStartupItemsFirst(header_->GetCollections().AnnotationSetItems(),
+                        startup_items.items,
+                        [](const dex_ir::AnnotationSetItem* set) { return set->GetSize(); },
+                        kDexAnnotationSetItemAlignment,
+                        "annotation set");
+}
+
+void DexLayout::LayoutDebugInfoItems(const StartupItems& startup_items) {
+  MoveStartupItemsFirst(header_->GetCollections().DebugInfoItems(),
+                        startup_items.items,
+                        [](const dex_ir::DebugInfoItem* debug_info) {
+                          return debug_info->GetDebugInfoSize();
+                        },
+                        1u,
+                        "debug info");
+}
+
 bool DexLayout::IsNextSectionCodeItemAligned(uint32_t offset) {
   dex_ir::Collections& collections = header_->GetCollections();
   std::set<uint32_t> section_offsets;
@@ -1765,10 +1968,10 @@ bool DexLayout::IsNextSectionCodeItemAligned(uint32_t offset) {
 }
 
 // Adjust offsets of every item in the specified section by diff bytes.
-template<class T> void DexLayout::FixupSection(std::map<uint32_t, std::unique_ptr<T>>& map,
+template<class T> void DexLayout::FixupSection(std::map<uint32_t, dex_ir::ItemPtr<T>>& map,
                                                uint32_t diff) {
   for (auto& pair : map) {
-    std::unique_ptr<T>& item = pair.second;
+    dex_ir::ItemPtr<T>& item = pair.second;
     item->SetOffset(item->GetOffset() + diff);
   }
 }
@@ -1843,13 +2046,26 @@ void DexLayout::FixupSections(uint32_t offset, uint32_t diff) {
 }
 
 void DexLayout::LayoutOutputFile(const DexFile* dex_file) {
-  LayoutStringData(dex_file);
+  StartupItems startup_items;
+  CollectStartupItems(dex_file, &startup_items);
+  std::vector<size_t> pages_before;
+  if (options_.show_layout_report_) {
+    pages_before = CountStartupPages(startup_items);
+  }
+  LayoutStringData(startup_items);
+  // These sections only permute their items in place, so they do not move other sections.
+  LayoutTypeLists(startup_items);
+  LayoutAnnotationSetItems(startup_items);
+  LayoutDebugInfoItems(startup_items);
   std::vector<dex_ir::ClassData*> new_class_data_order = LayoutClassDefsAndClassData(dex_file);
   int32_t diff = LayoutCodeItems(dex_file, new_class_data_order);
   // Move sections after ClassData by diff bytes.
   FixupSections(header_->GetCollections().ClassDatasOffset(), diff);
   // Update file size.
   header_->SetFileSize(header_->FileSize() + diff);
+  if (options_.show_layout_report_) {
+    DumpStartupPages(dex_file, pages_before, CountStartupPages(startup_items));
+  }
 }
 
 void DexLayout::OutputDexFile(const DexFile* dex_file) {
@@ -1986,4 +2202,94 @@ int DexLayout::ProcessFile(const char* file_name) {
   return 0;
 }
 
+/*
+ * Copies the buffered output of one file to the shared output file and closes the buffer.
+ */
+static void FlushBufferedOutput(FILE* buffer, FILE* out_file) {
+  rewind(buffer);
+  char chunk[4096];
+  size_t count;
+  while ((count = fread(chunk, 1, sizeof(chunk), buffer)) != 0) {
+    fwrite(chunk, 1, count, out_file);
+  }
+  fclose(buffer);
+}
+
+int ProcessFiles(Options& options,
+                 ProfileCompilationInfo* info,
+                 FILE* out_file,
+                 const std::vector<const char*>& file_names) {
+  const size_t jobs = std::min<size_t>(std::max<size_t>(options.jobs_, 1u), file_names.size());
+  if (jobs <= 1) {
+    DexLayout dex_layout(options, info, out_file);
+    int result = 0;
+    for (const char* file_name : file_names) {
+      result |= dex_layout.ProcessFile(file_name);
+    }
+    return result;
+  }
+
+  // Each file is processed by its own DexLayout, which owns the IR and the output memmap of the
+  // dex file being laid out, so workers share nothing but the read-only options and profile.
+  // Their dump output is buffered and written to `out_file` in command line order as soon as
+  // all preceding files are done.
+  struct FileResult {
+    FILE* buffer = nullptr;
+    int result = 0;
+    bool done = false;
+  };
+  std::vector<FileResult> results(file_names.size());
+  std::mutex lock;
+  std::condition_variable done_condition;
+  size_t next_file = 0;
+
+  auto worker = [&]() {
+    while (true) {
+      size_t index;
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        if (next_file == file_names.size()) {
+          return;
+        }
+        index = next_file++;
+      }
+      FILE* buffer = tmpfile();
+      int result = -1;
+      if (buffer == nullptr) {
+        fprintf(stderr, "Can't create output buffer for %s\n", file_names[index]);
+      } else {
+        DexLayout dex_layout(options, info, buffer);
+        result = dex_layout.ProcessFile(file_names[index]);
+      }
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        results[index].buffer = buffer;
+        results[index].result = result;
+        results[index].done = true;
+      }
+      done_condition.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < jobs; ++i) {
+    threads.emplace_back(worker);
+  }
+  int result = 0;
+  for (FileResult& file_result : results) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      done_condition.wait(guard, [&file_result]() { return file_result.done; });
+    }
+    if (file_result.buffer != nullptr) {
+      FlushBufferedOutput(file_result.buffer, out_file);
+    }
+    result |= file_result.result;
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return result;
+}
+
 }  // namespace art
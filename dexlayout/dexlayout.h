@@ -26,6 +26,8 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <vector>
+
 #include "dex_ir.h"
 #include "mem_map.h"
 
@@ -55,12 +57,14 @@ class Options {
   bool output_to_memmap_ = false;
   bool show_annotations_ = false;
   bool show_file_headers_ = false;
+  bool show_layout_report_ = false;
   bool show_section_headers_ = false;
   bool show_section_statistics_ = false;
   bool verbose_ = false;
   bool verify_output_ = false;
   bool visualize_pattern_ = false;
   OutputFormat output_format_ = kOutputPlain;
+  size_t jobs_ = 1;
   const char* output_dex_directory_ = nullptr;
   const char* output_file_name_ = nullptr;
   const char* profile_file_name_ = nullptr;
@@ -107,16 +111,29 @@ class DexLayout {
   void DumpSField(uint32_t idx, uint32_t flags, int i, dex_ir::EncodedValue* init);
   void DumpDexFile();
 
+  // Data items that the profile says are accessed during startup.
+  struct StartupItems;
+
+  void CollectStartupItems(const DexFile* dex_file, StartupItems* startup_items);
+  std::vector<size_t> CountStartupPages(const StartupItems& startup_items);
+  void DumpStartupPages(const DexFile* dex_file,
+                        const std::vector<size_t>& pages_before,
+                        const std::vector<size_t>& pages_after);
+
   std::vector<dex_ir::ClassData*> LayoutClassDefsAndClassData(const DexFile* dex_file);
   int32_t LayoutCodeItems(const DexFile* dex_file,
                           std::vector<dex_ir::ClassData*> new_class_data_order);
-  void LayoutStringData(const DexFile* dex_file);
+  void LayoutStringData(const StartupItems& startup_items);
+  void LayoutTypeLists(const StartupItems& startup_items);
+  void LayoutAnnotationSetItems(const StartupItems& startup_items);
+  void LayoutDebugInfoItems(const StartupItems& startup_items);
   bool IsNextSectionCodeItemAligned(uint32_t offset);
-  template<class T> void FixupSection(std::map<uint32_t, std::unique_ptr<T>>& map, uint32_t diff);
+  template<class T> void FixupSection(std::map<uint32_t, dex_ir::ItemPtr<T>>& map, uint32_t diff);
   void FixupSections(uint32_t offset, uint32_t diff);
 
   // Creates a new layout for the dex file based on profile info.
-  // Currently reorders ClassDefs, ClassDataItems, and CodeItems.
+  // Currently reorders ClassDefs, ClassDataItems, CodeItems, StringDatas, TypeLists,
+  // AnnotationSetItems, and DebugInfoItems.
   void LayoutOutputFile(const DexFile* dex_file);
   void OutputDexFile(const DexFile* dex_file);
 
@@ -132,6 +149,13 @@ class DexLayout {
   DISALLOW_COPY_AND_ASSIGN(DexLayout);
 };
 
+// Processes the files with up to `options.jobs_` threads, each file being laid out by its own
+// DexLayout. The dump output goes to `out_file` in the order of `file_names`.
+int ProcessFiles(Options& options,
+                 ProfileCompilationInfo* info,
+                 FILE* out_file,
+                 const std::vector<const char*>& file_names);
+
 }  // namespace art
 
 #endif  // ART_DEXLAYOUT_DEXLAYOUT_H_
@@ -33,6 +33,7 @@
 #include "jit/profile_compilation_info.h"
 #include "runtime.h"
 #include "mem_map.h"
+#include "utils.h"
 
 namespace art {
 
@@ -43,8 +44,8 @@ static const char* kProgramName = "dexlayout";
  */
 static void Usage(void) {
   fprintf(stderr, "Copyright (C) 2016 The Android Open Source Project\n\n");
-  fprintf(stderr, "%s: [-a] [-c] [-d] [-e] [-f] [-h] [-i] [-l layout] [-o outfile] [-p profile]"
-                  " [-s] [-t] [-v] [-w directory] dexfile...\n\n", kProgramName);
+  fprintf(stderr, "%s: [-a] [-c] [-d] [-e] [-f] [-h] [-i] [-j jobs] [-l layout] [-o outfile]"
+                  " [-p profile] [-r] [-s] [-t] [-v] [-w directory] dexfile...\n\n", kProgramName);
   fprintf(stderr, " -a : display annotations\n");
   fprintf(stderr, " -b : build dex_ir\n");
   fprintf(stderr, " -c : verify checksum and exit\n");
@@ -53,9 +54,11 @@ static void Usage(void) {
   fprintf(stderr, " -f : display summary information from file header\n");
   fprintf(stderr, " -h : display file header details\n");
   fprintf(stderr, " -i : ignore checksum failures\n");
+  fprintf(stderr, " -j : number of files to process in parallel (defaults to 1)\n");
   fprintf(stderr, " -l : output layout, either 'plain' or 'xml'\n");
   fprintf(stderr, " -o : output file name (defaults to stdout)\n");
   fprintf(stderr, " -p : profile file name (defaults to no profile)\n");
+  fprintf(stderr, " -r : report startup pages before and after profile guided layout\n");
   fprintf(stderr, " -s : visualize reference pattern\n");
   fprintf(stderr, " -t : display file section sizes\n");
   fprintf(stderr, " -v : verify output file is canonical to input (IR level comparison)\n");
@@ -77,7 +80,7 @@ int DexlayoutDriver(int argc, char** argv) {
 
   // Parse all arguments.
   while (1) {
-    const int ic = getopt(argc, argv, "abcdefghil:mo:p:stvw:");
+    const int ic = getopt(argc, argv, "abcdefghij:l:mo:p:rstvw:");
     if (ic < 0) {
       break;  // done
     }
@@ -106,6 +109,11 @@ int DexlayoutDriver(int argc, char** argv) {
       case 'i':  // continue even if checksum is bad
         options.ignore_bad_checksum_ = true;
         break;
+      case 'j':  // parallel jobs
+        if (!ParseUint(optarg, &options.jobs_) || options.jobs_ == 0) {
+          want_usage = true;
+        }
+        break;
       case 'l':  // layout
         if (strcmp(optarg, "plain") == 0) {
           options.output_format_ = kOutputPlain;
@@ -125,6 +133,9 @@ int DexlayoutDriver(int argc, char** argv) {
       case 'p':  // profile file
         options.profile_file_name_ = optarg;
         break;
+      case 'r':  // report startup pages
+        options.show_layout_report_ = true;
+        break;
       case 's':  // visualize access pattern
         options.visualize_pattern_ = true;
         options.verbose_ = false;
@@ -154,6 +165,11 @@ int DexlayoutDriver(int argc, char** argv) {
     fprintf(stderr, "Can't specify both -c and -i\n");
     want_usage = true;
   }
+  if (options.jobs_ > 1 && (options.visualize_pattern_ || options.show_section_statistics_)) {
+    // These write straight to stdout and would interleave.
+    fprintf(stderr, "Can't specify -j with -s or -t\n");
+    want_usage = true;
+  }
   if (want_usage) {
     Usage();
     return 2;
@@ -184,14 +200,9 @@ int DexlayoutDriver(int argc, char** argv) {
     }
   }
 
-  // Create DexLayout instance.
-  DexLayout dex_layout(options, profile_info, out_file);
-
   // Process all files supplied on command line.
-  int result = 0;
-  while (optind < argc) {
-    result |= dex_layout.ProcessFile(argv[optind++]);
-  }  // while
+  std::vector<const char*> file_names(argv + optind, argv + argc);
+  int result = ProcessFiles(options, profile_info, out_file, file_names);
   return result != 0;
 }
 
@@ -18,9 +18,12 @@
 #include <vector>
 #include <sstream>
 
+#include <stdio.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "android-base/file.h"
+
 #include "base/unix_file/fd_file.h"
 #include "common_runtime_test.h"
 #include "exec_utils.h"
@@ -278,6 +281,81 @@ class DexLayoutTest : public CommonRuntimeTest {
     return true;
   }
 
+  // Runs ParallelPlainOutput test.
+  bool ParallelPlainOutputExec(std::string* error_msg) {
+    ScratchFile serial_output;
+    const std::string& serial_filename = serial_output.GetFilename();
+    ScratchFile parallel_output;
+    const std::string& parallel_filename = parallel_output.GetFilename();
+    std::string dexlayout = GetTestAndroidRoot() + "/bin/dexlayout";
+    EXPECT_TRUE(OS::FileExists(dexlayout.c_str())) << dexlayout << " should be a valid file path";
+
+    std::vector<std::string> serial_exec_argv =
+        { dexlayout, "-d", "-f", "-h", "-l", "plain", "-o", serial_filename };
+    std::vector<std::string> parallel_exec_argv =
+        { dexlayout, "-d", "-f", "-h", "-j", "4", "-l", "plain", "-o", parallel_filename };
+    for (const std::string &dex_file : GetLibCoreDexFileNames()) {
+      serial_exec_argv.push_back(dex_file);
+      parallel_exec_argv.push_back(dex_file);
+    }
+    if (!::art::Exec(serial_exec_argv, error_msg)) {
+      return false;
+    }
+    if (!::art::Exec(parallel_exec_argv, error_msg)) {
+      return false;
+    }
+    std::vector<std::string> diff_exec_argv =
+        { "/usr/bin/diff", serial_filename, parallel_filename };
+    if (!::art::Exec(diff_exec_argv, error_msg)) {
+      return false;
+    }
+    return true;
+  }
+
+  // Runs ParallelDexFileOutput test.
+  bool ParallelDexFileOutputExec(std::string* error_msg) {
+    ScratchFile tmp_file;
+    const std::string& tmp_name = tmp_file.GetFilename();
+    size_t tmp_last_slash = tmp_name.rfind('/');
+    std::string tmp_dir = tmp_name.substr(0, tmp_last_slash + 1);
+    std::string serial_dir = tmp_dir + "serial/";
+    std::string parallel_dir = tmp_dir + "parallel/";
+    std::string dexlayout = GetTestAndroidRoot() + "/bin/dexlayout";
+    EXPECT_TRUE(OS::FileExists(dexlayout.c_str())) << dexlayout << " should be a valid file path";
+
+    std::vector<std::string> mkdir_exec_argv = { "/bin/mkdir", serial_dir, parallel_dir };
+    if (!::art::Exec(mkdir_exec_argv, error_msg)) {
+      return false;
+    }
+    std::vector<std::string> serial_exec_argv =
+        { dexlayout, "-w", serial_dir, "-o", "/dev/null" };
+    std::vector<std::string> parallel_exec_argv =
+        { dexlayout, "-j", "4", "-w", parallel_dir, "-o", "/dev/null" };
+    for (const std::string &dex_file : GetLibCoreDexFileNames()) {
+      serial_exec_argv.push_back(dex_file);
+      parallel_exec_argv.push_back(dex_file);
+    }
+    bool result = ::art::Exec(serial_exec_argv, error_msg) &&
+        ::art::Exec(parallel_exec_argv, error_msg);
+    // Each input is written to a file of the same name, which must not depend on -j.
+    for (const std::string &dex_file : GetLibCoreDexFileNames()) {
+      if (!result) {
+        break;
+      }
+      std::string dex_file_name = dex_file.substr(dex_file.rfind('/') + 1);
+      std::vector<std::string> diff_exec_argv =
+          { "/usr/bin/diff", serial_dir + dex_file_name, parallel_dir + dex_file_name };
+      result = ::art::Exec(diff_exec_argv, error_msg);
+    }
+    std::string rm_error_msg;
+    std::vector<std::string> rm_exec_argv = { "/bin/rm", "-rf", serial_dir, parallel_dir };
+    if (!::art::Exec(rm_exec_argv, &rm_error_msg) && result) {
+      *error_msg = rm_error_msg;
+      return false;
+    }
+    return result;
+  }
+
   // Runs DexFileOutput test.
   bool DexFileOutputExec(std::string* error_msg) {
     ScratchFile tmp_file;
@@ -350,6 +428,57 @@ class DexLayoutTest : public CommonRuntimeTest {
     return true;
   }
 
+  // Runs DexFileLayoutReport test.
+  bool DexFileLayoutReportExec(std::string* error_msg) {
+    ScratchFile tmp_file;
+    std::string tmp_name = tmp_file.GetFilename();
+    size_t tmp_last_slash = tmp_name.rfind("/");
+    std::string tmp_dir = tmp_name.substr(0, tmp_last_slash + 1);
+
+    std::string dex_file = tmp_dir + "classes.dex";
+    WriteFileBase64(kDexFileLayoutInputDex, dex_file.c_str());
+    std::string profile_file = tmp_dir + "primary.prof";
+    WriteFileBase64(kDexFileLayoutInputProfile, profile_file.c_str());
+    std::string output_dex = tmp_dir + "classes.dex.new";
+
+    std::string dexlayout = GetTestAndroidRoot() + "/bin/dexlayout";
+    EXPECT_TRUE(OS::FileExists(dexlayout.c_str())) << dexlayout << " should be a valid file path";
+
+    // -v makes sure that the layout of the additional sections did not corrupt the dex file.
+    std::vector<std::string> dexlayout_exec_argv =
+        { dexlayout, "-v", "-r", "-w", tmp_dir, "-o", tmp_name, "-p", profile_file, dex_file };
+    if (!::art::Exec(dexlayout_exec_argv, error_msg)) {
+      return false;
+    }
+    std::string report;
+    if (!android::base::ReadFileToString(tmp_name, &report)) {
+      *error_msg = "Could not read the layout report";
+      return false;
+    }
+    size_t total = report.find("\ntotal ");
+    if (report.find("Startup pages of '" + dex_file + "':") == std::string::npos ||
+        total == std::string::npos) {
+      *error_msg = "Unexpected layout report: " + report;
+      return false;
+    }
+    // The profile has a startup class, whose pages the layout must not spread out.
+    size_t pages_before = 0u;
+    size_t pages_after = 0u;
+    if (sscanf(report.c_str() + total, "\ntotal %zu %zu", &pages_before, &pages_after) != 2 ||
+        pages_before == 0u ||
+        pages_after > pages_before) {
+      *error_msg = "Unexpected startup page totals in layout report: " + report;
+      return false;
+    }
+
+    std::vector<std::string> rm_exec_argv =
+        { "/bin/rm", dex_file, profile_file, output_dex };
+    if (!::art::Exec(rm_exec_argv, error_msg)) {
+      return false;
+    }
+    return true;
+  }
+
   // Runs UnreferencedCatchHandlerTest & Unreferenced0SizeCatchHandlerTest.
   bool UnreferencedCatchHandlerExec(std::string* error_msg, const char* filename) {
     ScratchFile tmp_file;
@@ -413,6 +542,20 @@ TEST_F(DexLayoutTest, FullPlainOutput) {
   ASSERT_TRUE(FullPlainOutputExec(&error_msg)) << error_msg;
 }
 
+TEST_F(DexLayoutTest, ParallelPlainOutput) {
+  // Disable test on target.
+  TEST_DISABLED_FOR_TARGET();
+  std::string error_msg;
+  ASSERT_TRUE(ParallelPlainOutputExec(&error_msg)) << error_msg;
+}
+
+TEST_F(DexLayoutTest, ParallelDexFileOutput) {
+  // Disable test on target.
+  TEST_DISABLED_FOR_TARGET();
+  std::string error_msg;
+  ASSERT_TRUE(ParallelDexFileOutputExec(&error_msg)) << error_msg;
+}
+
 TEST_F(DexLayoutTest, DexFileOutput) {
   // Disable test on target.
   TEST_DISABLED_FOR_TARGET();
@@ -427,6 +570,13 @@ TEST_F(DexLayoutTest, DexFileLayout) {
   ASSERT_TRUE(DexFileLayoutExec(&error_msg)) << error_msg;
 }
 
+TEST_F(DexLayoutTest, DexFileLayoutReport) {
+  // Disable test on target.
+  TEST_DISABLED_FOR_TARGET();
+  std::string error_msg;
+  ASSERT_TRUE(DexFileLayoutReportExec(&error_msg)) << error_msg;
+}
+
 TEST_F(DexLayoutTest, UnreferencedCatchHandler) {
   // Disable test on target.
   TEST_DISABLED_FOR_TARGET();
@@ -14,10 +14,20 @@
  * limitations under the License.
  */
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "android-base/stringprintf.h"
 #include "android-base/strings.h"
+#include "base/unix_file/fd_file.h"
 #include "compiler_filter.h"
 #include "dex_file.h"
 #include "noop_compiler_callbacks.h"
@@ -25,6 +35,7 @@
 #include "os.h"
 #include "runtime.h"
 #include "thread-inl.h"
+#include "thread_pool.h"
 #include "utils.h"
 
 namespace art {
@@ -97,6 +108,20 @@ NO_RETURN static void Usage(const char *fmt, ...) {
   UsageError("  --android-data=<directory>: optional, the directory which should be used as");
   UsageError("       android-data. By default ANDROID_DATA env variable is used.");
   UsageError("");
+  UsageError("  --batch-file=<filename>: analyzes all the queries in the given file with a single");
+  UsageError("       runtime instead of the single --dex-file. Each line is a query of the form");
+  UsageError("       '<dex-file> <isa> <compiler-filter> <profile-changed (true|false)>'.");
+  UsageError("       Empty lines and lines starting with '#' are ignored. For each query a line");
+  UsageError("       '<dex-file> <isa> <compiler-filter> <profile-changed> <return code>' is");
+  UsageError("       printed, in the order of the queries. In batch mode the exit code is 0 if");
+  UsageError("       all the queries were analyzed.");
+  UsageError("");
+  UsageError("  --batch-output-fd=<number>: optional, redirects the batch results to a file");
+  UsageError("       descriptor. By default the results are printed to standard output.");
+  UsageError("");
+  UsageError("  --jobs=<number>: optional, the number of threads used to analyze the batch");
+  UsageError("       queries. Defaults to the number of processors.");
+  UsageError("");
   UsageError("Return code:");
   UsageError("  To make it easier to integrate with the internal tools this command will make");
   UsageError("    available its result (dexoptNeeded) as the exit/return code. i.e. it will not");
@@ -119,9 +144,77 @@ NO_RETURN static void Usage(const char *fmt, ...) {
   exit(kErrorInvalidArguments);
 }
 
+// Converts the result of OatFileAssistant::GetDexOptNeeded to dexoptanalyzer codes.
+static int ToReturnCode(int dexoptNeeded) {
+  switch (dexoptNeeded) {
+    case OatFileAssistant::kNoDexOptNeeded: return kNoDexOptNeeded;
+    case OatFileAssistant::kDex2OatFromScratch: return kDex2OatFromScratch;
+    case OatFileAssistant::kDex2OatForBootImage: return kDex2OatForBootImageOat;
+    case OatFileAssistant::kDex2OatForFilter: return kDex2OatForFilterOat;
+    case OatFileAssistant::kDex2OatForRelocation: return kDex2OatForRelocationOat;
+
+    case -OatFileAssistant::kDex2OatForBootImage: return kDex2OatForBootImageOdex;
+    case -OatFileAssistant::kDex2OatForFilter: return kDex2OatForFilterOdex;
+    case -OatFileAssistant::kDex2OatForRelocation: return kDex2OatForRelocationOdex;
+    default:
+      LOG(ERROR) << "Unknown dexoptNeeded " << dexoptNeeded;
+      return kErrorUnknownDexOptNeeded;
+  }
+}
+
+// Analyzes the given dex file. The runtime must have been created.
+// If image_info is null, the boot image header for isa is read for this dex file.
+static int Analyze(const std::string& dex_file,
+                   InstructionSet isa,
+                   CompilerFilter::Filter compiler_filter,
+                   bool assume_profile_changed,
+                   const OatFileAssistant::ImageInfo* image_info) {
+  OatFileAssistant oat_file_assistant(dex_file.c_str(),
+                                      isa,
+                                      /*load_executable*/ false,
+                                      image_info);
+  // Always treat elements of the bootclasspath as up-to-date.
+  // TODO(calin): this check should be in OatFileAssistant.
+  if (oat_file_assistant.IsInBootClassPath()) {
+    return kNoDexOptNeeded;
+  }
+  return ToReturnCode(oat_file_assistant.GetDexOptNeeded(compiler_filter, assume_profile_changed));
+}
+
+// A line of the --batch-file.
+struct Query {
+  std::string dex_file;
+  InstructionSet isa;
+  CompilerFilter::Filter compiler_filter;
+  bool assume_profile_changed;
+  // The boot image info for isa, shared by all the queries with the same isa.
+  const OatFileAssistant::ImageInfo* image_info;
+  int result;
+};
+
+class AnalyzeTask FINAL : public SelfDeletingTask {
+ public:
+  explicit AnalyzeTask(Query* query) : query_(query) {}
+
+  void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE {
+    query_->result = Analyze(query_->dex_file,
+                             query_->isa,
+                             query_->compiler_filter,
+                             query_->assume_profile_changed,
+                             query_->image_info);
+  }
+
+ private:
+  Query* const query_;
+};
+
 class DexoptAnalyzer FINAL {
  public:
-  DexoptAnalyzer() : assume_profile_changed_(false) {}
+  DexoptAnalyzer()
+      : isa_(kNone),
+        assume_profile_changed_(false),
+        batch_output_fd_(-1),
+        jobs_(sysconf(_SC_NPROCESSORS_CONF)) {}
 
   void ParseArgs(int argc, char **argv) {
     original_argc = argc;
@@ -155,6 +248,15 @@ class DexoptAnalyzer FINAL {
         }
       } else if (option.starts_with("--image=")) {
         image_ = option.substr(strlen("--image=")).ToString();
+      } else if (option.starts_with("--batch-file=")) {
+        batch_file_ = option.substr(strlen("--batch-file=")).ToString();
+      } else if (option.starts_with("--batch-output-fd=")) {
+        ParseUintOption(option, "--batch-output-fd", &batch_output_fd_, Usage);
+      } else if (option.starts_with("--jobs=")) {
+        ParseUintOption(option, "--jobs", &jobs_, Usage);
+        if (jobs_ == 0) {
+          Usage("--jobs must be at least 1");
+        }
       } else if (option.starts_with("--android-data=")) {
         // Overwrite android-data if needed (oat file assistant relies on a valid directory to
         // compute dalvik-cache folder). This is mostly used in tests.
@@ -165,6 +267,13 @@ class DexoptAnalyzer FINAL {
       }
     }
 
+    if (!batch_file_.empty()) {
+      if (!dex_file_.empty()) {
+        Usage("--dex-file should not be specified with --batch-file");
+      }
+      ReadBatchFile();
+    }
+
     if (image_.empty()) {
       // If we don't receive the image, try to use the default one.
       // Tests may specify a different image (e.g. core image).
@@ -216,38 +325,140 @@ class DexoptAnalyzer FINAL {
     if (!CreateRuntime()) {
       return kErrorCannotCreateRuntime;
     }
-    OatFileAssistant oat_file_assistant(dex_file_.c_str(), isa_, /*load_executable*/ false);
-    // Always treat elements of the bootclasspath as up-to-date.
-    // TODO(calin): this check should be in OatFileAssistant.
-    if (oat_file_assistant.IsInBootClassPath()) {
-      return kNoDexOptNeeded;
+    return Analyze(dex_file_,
+                   isa_,
+                   compiler_filter_,
+                   assume_profile_changed_,
+                   /*image_info*/ nullptr);
+  }
+
+  // Analyzes all the queries of the batch file with the same runtime, so that the
+  // boot image is loaded once for the whole batch.
+  int GetDexOptNeededForBatch() {
+    // Non existing files don't need the runtime (see GetDexOptNeeded).
+    std::vector<Query*> queries_to_analyze;
+    for (Query& query : queries_) {
+      if (OS::FileExists(query.dex_file.c_str())) {
+        queries_to_analyze.push_back(&query);
+      } else {
+        query.result = kNoDexOptNeeded;
+      }
+    }
+    // The boot image info of each queried isa. It must outlive the analysis.
+    std::map<InstructionSet, std::unique_ptr<OatFileAssistant::ImageInfo>> image_infos;
+    if (!queries_to_analyze.empty()) {
+      // The image headers, and with them the boot image checksums, are read for each
+      // query isa. The runtime itself only needs a valid image for one of them.
+      if (isa_ == kNone) {
+        isa_ = queries_to_analyze[0]->isa;
+      }
+      if (!CreateRuntime()) {
+        return kErrorCannotCreateRuntime;
+      }
+      // Read the boot image header once per isa rather than once per query.
+      for (Query* query : queries_to_analyze) {
+        auto it = image_infos.find(query->isa);
+        if (it == image_infos.end()) {
+          std::string error_msg;
+          std::unique_ptr<OatFileAssistant::ImageInfo> image_info =
+              OatFileAssistant::ImageInfo::GetRuntimeImageInfo(query->isa, &error_msg);
+          // On failure, each query of the isa tries again and reports the error.
+          it = image_infos.emplace(query->isa, std::move(image_info)).first;
+        }
+        query->image_info = it->second.get();
+      }
+      Thread* self = Thread::Current();
+      size_t thread_count = std::min<size_t>(jobs_, queries_to_analyze.size());
+      if (thread_count <= 1) {
+        for (Query* query : queries_to_analyze) {
+          AnalyzeTask(query).Run(self);
+        }
+      } else {
+        // The main thread works too (see ThreadPool::Wait).
+        ThreadPool thread_pool("dexoptanalyzer thread pool", thread_count - 1);
+        for (Query* query : queries_to_analyze) {
+          thread_pool.AddTask(self, new AnalyzeTask(query));
+        }
+        thread_pool.StartWorkers(self);
+        thread_pool.Wait(self, /* do_work */ true, /* may_hold_locks */ false);
+      }
     }
-    int dexoptNeeded = oat_file_assistant.GetDexOptNeeded(
-        compiler_filter_, assume_profile_changed_);
-
-    // Convert OatFileAssitant codes to dexoptanalyzer codes.
-    switch (dexoptNeeded) {
-      case OatFileAssistant::kNoDexOptNeeded: return kNoDexOptNeeded;
-      case OatFileAssistant::kDex2OatFromScratch: return kDex2OatFromScratch;
-      case OatFileAssistant::kDex2OatForBootImage: return kDex2OatForBootImageOat;
-      case OatFileAssistant::kDex2OatForFilter: return kDex2OatForFilterOat;
-      case OatFileAssistant::kDex2OatForRelocation: return kDex2OatForRelocationOat;
-
-      case -OatFileAssistant::kDex2OatForBootImage: return kDex2OatForBootImageOdex;
-      case -OatFileAssistant::kDex2OatForFilter: return kDex2OatForFilterOdex;
-      case -OatFileAssistant::kDex2OatForRelocation: return kDex2OatForRelocationOdex;
-      default:
-        LOG(ERROR) << "Unknown dexoptNeeded " << dexoptNeeded;
-        return kErrorUnknownDexOptNeeded;
+
+    std::ostringstream output;
+    for (const Query& query : queries_) {
+      output << query.dex_file << " "
+             << GetInstructionSetString(query.isa) << " "
+             << CompilerFilter::NameOfFilter(query.compiler_filter) << " "
+             << (query.assume_profile_changed ? "true" : "false") << " "
+             << query.result << "\n";
+    }
+    std::string results = output.str();
+    if (batch_output_fd_ < 0) {
+      std::cout << results;
+    } else {
+      unix_file::FdFile out_fd(batch_output_fd_, /*check_usage*/ false);
+      if (!out_fd.WriteFully(results.c_str(), results.length())) {
+        PLOG(ERROR) << "Failed to write the batch results";
+        return kErrorInvalidArguments;
+      }
     }
+    return kNoDexOptNeeded;
+  }
+
+  bool IsBatch() const {
+    return !batch_file_.empty();
   }
 
  private:
+  void ReadBatchFile() {
+    std::ifstream input(batch_file_);
+    if (!input.good()) {
+      Usage("Failed to open batch file '%s'", batch_file_.c_str());
+    }
+    std::string line;
+    while (std::getline(input, line)) {
+      if (line.empty() || android::base::StartsWith(line, "#")) {
+        continue;
+      }
+      std::istringstream fields(line);
+      std::string isa_str;
+      std::string filter_str;
+      std::string profile_changed_str;
+      std::string extra;
+      Query query;
+      if (!(fields >> query.dex_file >> isa_str >> filter_str >> profile_changed_str) ||
+          (fields >> extra)) {
+        Usage("Invalid batch query '%s'", line.c_str());
+      }
+      query.isa = GetInstructionSetFromString(isa_str.c_str());
+      if (query.isa == kNone) {
+        Usage("Invalid isa in batch query '%s'", line.c_str());
+      }
+      if (!CompilerFilter::ParseCompilerFilter(filter_str.c_str(), &query.compiler_filter)) {
+        Usage("Invalid compiler filter in batch query '%s'", line.c_str());
+      }
+      if (profile_changed_str == "true") {
+        query.assume_profile_changed = true;
+      } else if (profile_changed_str == "false") {
+        query.assume_profile_changed = false;
+      } else {
+        Usage("Invalid profile-changed value in batch query '%s'", line.c_str());
+      }
+      query.image_info = nullptr;
+      query.result = kErrorUnknownDexOptNeeded;
+      queries_.push_back(query);
+    }
+  }
+
   std::string dex_file_;
   InstructionSet isa_;
   CompilerFilter::Filter compiler_filter_;
   bool assume_profile_changed_;
   std::string image_;
+  std::string batch_file_;
+  int batch_output_fd_;
+  uint32_t jobs_;
+  std::vector<Query> queries_;
 };
 
 static int dexoptAnalyze(int argc, char** argv) {
@@ -255,6 +466,9 @@ static int dexoptAnalyze(int argc, char** argv) {
 
   // Parse arguments. Argument mistakes will lead to exit(kErrorInvalidArguments) in UsageError.
   analyzer.ParseArgs(argc, argv);
+  if (analyzer.IsBatch()) {
+    return analyzer.GetDexOptNeededForBatch();
+  }
   return analyzer.GetDexOptNeeded();
 }
 
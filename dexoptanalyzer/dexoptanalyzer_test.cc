@@ -16,6 +16,7 @@
 
 #include <gtest/gtest.h>
 
+#include "android-base/strings.h"
 #include "arch/instruction_set.h"
 #include "compiler_filter.h"
 #include "dexopt_test.h"
@@ -79,6 +80,31 @@ class DexoptAnalyzerTest : public DexoptTest {
         compiler_filter, assume_profile_changed);
     EXPECT_EQ(assistantResult, dexoptanalyzerResult);
   }
+
+  // Runs dexoptanalyzer in batch mode and returns the printed results.
+  std::string AnalyzeBatch(const std::string& queries, size_t jobs) {
+    ScratchFile batch_file;
+    EXPECT_TRUE(batch_file.GetFile()->WriteFully(queries.c_str(), queries.length()));
+    EXPECT_EQ(0, batch_file.GetFile()->Flush());
+    ScratchFile output_file;
+
+    std::vector<std::string> argv_str;
+    argv_str.push_back(GetDexoptAnalyzerCmd());
+    argv_str.push_back("--batch-file=" + batch_file.GetFilename());
+    argv_str.push_back("--batch-output-fd=" + std::to_string(output_file.GetFd()));
+    argv_str.push_back("--jobs=" + std::to_string(jobs));
+    argv_str.push_back("--image=" + GetImageLocation());
+    argv_str.push_back("--android-data=" + android_data_);
+    std::string error;
+    EXPECT_EQ(0, ExecAndReturnCode(argv_str, &error)) << error;
+
+    File* file = output_file.GetFile();
+    EXPECT_EQ(0, file->Flush());
+    int64_t length = file->GetLength();
+    std::unique_ptr<char[]> buf(new char[length]);
+    EXPECT_EQ(length, file->Read(buf.get(), length, 0));
+    return std::string(buf.get(), length);
+  }
 };
 
 // The tests below exercise the same test case from oat_file_assistant_test.cc.
@@ -308,4 +334,54 @@ TEST_F(DexoptAnalyzerTest, ShortDexLocation) {
   Verify(dex_location, CompilerFilter::kSpeed);
 }
 
+// Case: Several queries answered by one dexoptanalyzer invocation.
+TEST_F(DexoptAnalyzerTest, Batch) {
+  std::string dex_no_oat = GetScratchDir() + "/BatchDexNoOat.jar";
+  Copy(GetDexSrc1(), dex_no_oat);
+  std::string dex_oat = GetScratchDir() + "/BatchOatUpToDate.jar";
+  Copy(GetDexSrc1(), dex_oat);
+  GenerateOatForTest(dex_oat.c_str(), CompilerFilter::kSpeedProfile);
+  std::string no_dex = GetScratchDir() + "/BatchNoDex.jar";
+
+  struct {
+    const std::string& dex_file;
+    CompilerFilter::Filter compiler_filter;
+    bool assume_profile_changed;
+  } cases[] = {
+    { dex_no_oat, CompilerFilter::kSpeed, false },
+    { dex_oat, CompilerFilter::kSpeedProfile, false },
+    { dex_oat, CompilerFilter::kSpeedProfile, true },
+    { dex_oat, CompilerFilter::kSpeed, false },
+    { no_dex, CompilerFilter::kSpeed, false },
+  };
+  std::string isa = GetInstructionSetString(kRuntimeISA);
+  std::string queries = "# dex-file isa compiler-filter profile-changed\n";
+  std::vector<std::string> expected_queries;
+  std::vector<int> expected_results;
+  for (const auto& c : cases) {
+    std::string query = c.dex_file + " " + isa + " " +
+        CompilerFilter::NameOfFilter(c.compiler_filter) + " " +
+        (c.assume_profile_changed ? "true" : "false");
+    queries += query + "\n\n";
+    expected_queries.push_back(query);
+    OatFileAssistant oat_file_assistant(c.dex_file.c_str(), kRuntimeISA, /*load_executable*/ false);
+    expected_results.push_back(
+        oat_file_assistant.GetDexOptNeeded(c.compiler_filter, c.assume_profile_changed));
+  }
+
+  for (size_t jobs : {1u, 3u}) {
+    std::vector<std::string> lines = android::base::Split(AnalyzeBatch(queries, jobs), "\n");
+    // The output ends with a new line.
+    ASSERT_EQ(expected_queries.size() + 1, lines.size());
+    ASSERT_TRUE(lines.back().empty());
+    for (size_t i = 0; i < expected_queries.size(); i++) {
+      size_t separator = lines[i].rfind(' ');
+      ASSERT_NE(std::string::npos, separator) << lines[i];
+      EXPECT_EQ(expected_queries[i], lines[i].substr(0, separator));
+      int result = DexoptanalyzerToOatFileAssistant(std::stoi(lines[i].substr(separator + 1)));
+      EXPECT_EQ(expected_results[i], result) << lines[i];
+    }
+  }
+}
+
 }  // namespace art
@@ -34,10 +34,11 @@ class DisassemblerOptions {
   ThreadOffsetNameFunction thread_offset_name_function_;
 
   // Base address for calculating relative code offsets when absolute_addresses_ is false.
-  const uint8_t* const base_address_;
+  // Changed only through Disassembler::SetCodeRange().
+  const uint8_t* base_address_;
 
   // End address (exclusive);
-  const uint8_t* const end_address_;
+  const uint8_t* end_address_;
 
   // Should the disassembler print absolute or relative addresses.
   const bool absolute_addresses_;
@@ -81,6 +82,13 @@ class Disassembler {
     return disassembler_options_;
   }
 
+  // Points the disassembler at another code range, so that one disassembler can be reused
+  // for several oat files of the same instruction set.
+  virtual void SetCodeRange(const uint8_t* base_address, const uint8_t* end_address) {
+    disassembler_options_->base_address_ = base_address;
+    disassembler_options_->end_address_ = end_address;
+  }
+
  protected:
   explicit Disassembler(DisassemblerOptions* disassembler_options);
 
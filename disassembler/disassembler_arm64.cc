@@ -69,7 +69,7 @@ void CustomDisassembler::VisitLoadLiteral(const Instruction* instr) {
   // avoid trying to fetch invalid literals (we can encounter this when
   // interpreting raw data as instructions).
   void* data_address = instr->GetLiteralAddress<void*>();
-  if (data_address < base_address_ || data_address >= end_address_) {
+  if (data_address < options_->base_address_ || data_address >= options_->end_address_) {
     AppendToOutput(" (?)");
     return;
   }
@@ -34,12 +34,15 @@ class CustomDisassembler FINAL : public vixl::aarch64::Disassembler {
   explicit CustomDisassembler(DisassemblerOptions* options)
       : vixl::aarch64::Disassembler(),
         read_literals_(options->can_read_literals_),
-        base_address_(options->base_address_),
-        end_address_(options->end_address_),
         options_(options) {
-    if (!options->absolute_addresses_) {
+    MapCodeRange();
+  }
+
+  // Maps relative code addresses onto the current code range of the options.
+  void MapCodeRange() {
+    if (!options_->absolute_addresses_) {
       MapCodeAddress(0,
-                     reinterpret_cast<const vixl::aarch64::Instruction*>(options->base_address_));
+                     reinterpret_cast<const vixl::aarch64::Instruction*>(options_->base_address_));
     }
   }
 
@@ -62,10 +65,7 @@ class CustomDisassembler FINAL : public vixl::aarch64::Disassembler {
   //          false | 0x72681558: 1c000acb  ldr s11, pc+344 (addr 0x726816b0) (3.40282e+38)
   const bool read_literals_;
 
-  // Valid address range: [base_address_, end_address_)
-  const void* const base_address_;
-  const void* const end_address_;
-
+  // Valid address range: [options_->base_address_, options_->end_address_)
   DisassemblerOptions* options_;
 };
 
@@ -79,6 +79,11 @@ class DisassemblerArm64 FINAL : public Disassembler {
   size_t Dump(std::ostream& os, const uint8_t* begin) OVERRIDE;
   void Dump(std::ostream& os, const uint8_t* begin, const uint8_t* end) OVERRIDE;
 
+  void SetCodeRange(const uint8_t* base_address, const uint8_t* end_address) OVERRIDE {
+    Disassembler::SetCodeRange(base_address, end_address);
+    disasm.MapCodeRange();
+  }
+
  private:
   vixl::aarch64::Decoder decoder;
   CustomDisassembler disasm;
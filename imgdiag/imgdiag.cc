@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -27,6 +28,7 @@
 #include <unordered_set>
 
 #include "android-base/stringprintf.h"
+#include "android-base/strings.h"
 
 #include "art_field-inl.h"
 #include "art_method-inl.h"
@@ -36,6 +38,7 @@
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
 #include "image.h"
+#include "imgdiag_aggregate.h"
 #include "scoped_thread_state_change-inl.h"
 #include "os.h"
 
@@ -55,12 +58,12 @@ class ImgDiagDumper {
   explicit ImgDiagDumper(std::ostream* os,
                          const ImageHeader& image_header,
                          const std::string& image_location,
-                         pid_t image_diff_pid,
+                         const std::vector<pid_t>& image_diff_pids,
                          pid_t zygote_diff_pid)
       : os_(os),
         image_header_(image_header),
         image_location_(image_location),
-        image_diff_pid_(image_diff_pid),
+        image_diff_pids_(image_diff_pids),
         zygote_diff_pid_(zygote_diff_pid) {}
 
   bool Dump() REQUIRES_SHARED(Locks::mutator_lock_) {
@@ -72,10 +75,19 @@ class ImgDiagDumper {
     os << "IMAGE BEGIN: " << reinterpret_cast<void*>(image_header_.GetImageBegin()) << "\n\n";
 
     bool ret = true;
-    if (image_diff_pid_ >= 0) {
-      os << "IMAGE DIFF PID (" << image_diff_pid_ << "): ";
-      ret = DumpImageDiff(image_diff_pid_, zygote_diff_pid_);
-      os << "\n\n";
+    if (!image_diff_pids_.empty()) {
+      // The runtime and the local image are shared by all the pids. A failure for one pid does
+      // not prevent diffing the others.
+      for (pid_t image_diff_pid : image_diff_pids_) {
+        os << "IMAGE DIFF PID (" << image_diff_pid << "): ";
+        if (!DumpImageDiff(image_diff_pid, zygote_diff_pid_)) {
+          ret = false;
+        }
+        os << "\n\n" << std::flush;
+      }
+      if (image_diff_pids_.size() > 1u) {
+        DumpAggregate();
+      }
     } else {
       os << "IMAGE DIFF PID: disabled\n\n";
     }
@@ -325,8 +337,6 @@ class ImgDiagDumper {
     const uint8_t* image_begin = AlignDown(image_begin_unaligned, kPageSize);
     const uint8_t* image_end = AlignUp(image_end_unaligned, kPageSize);
 
-    ptrdiff_t page_off_begin = boot_image_header.GetImageBegin() - image_begin;
-
     if (reinterpret_cast<uintptr_t>(image_begin) > boot_map.start ||
         reinterpret_cast<uintptr_t>(image_end) < boot_map.end) {
       // Sanity check that we aren't trying to read a completely different boot image
@@ -392,13 +402,12 @@ class ImgDiagDumper {
     std::set<size_t> dirty_page_set_remote;
     // Set of the local virtual page indices that are dirty
     std::set<size_t> dirty_page_set_local;
+    // Set of the local virtual page indices that are dirty and mapped by this process only
+    std::set<size_t> private_dirty_page_set_local;
 
     size_t different_int32s = 0;
     size_t different_bytes = 0;
     size_t different_pages = 0;
-    size_t virtual_page_idx = 0;   // Virtual page number (for an absolute memory address)
-    size_t page_idx = 0;           // Page index relative to 0
-    size_t previous_page_idx = 0;  // Previous page index relative to 0
     size_t dirty_pages = 0;
     size_t private_pages = 0;
     size_t private_dirty_pages = 0;
@@ -416,7 +425,7 @@ class ImgDiagDumper {
       if (memcmp(local_ptr, remote_ptr, kPageSize) != 0) {
         different_pages++;
 
-        // Count the number of 32-bit integers that are different.
+        // Count the number of 32-bit integers and bytes that are different.
         for (size_t i = 0; i < kPageSize / sizeof(uint32_t); ++i) {
           uint32_t* remote_ptr_int32 = reinterpret_cast<uint32_t*>(remote_ptr);
           const uint32_t* local_ptr_int32 = reinterpret_cast<const uint32_t*>(local_ptr);
@@ -425,61 +434,67 @@ class ImgDiagDumper {
             different_int32s++;
           }
         }
+        for (size_t i = 0; i < kPageSize; ++i) {
+          if (local_ptr[i] != remote_ptr[i]) {
+            different_bytes++;
+          }
+        }
       }
     }
 
-    // Iterate through one byte at a time.
-    for (uintptr_t begin = boot_map.start; begin != boot_map.end; ++begin) {
-      previous_page_idx = page_idx;
-      ptrdiff_t offset = begin - boot_map.start;
-
-      // We treat the image header as part of the memory map for now
-      // If we wanted to change this, we could pass base=start+sizeof(ImageHeader)
-      // But it might still be interesting to see if any of the ImageHeader data mutated
-      const uint8_t* local_ptr = reinterpret_cast<const uint8_t*>(&boot_image_header) + offset;
-      uint8_t* remote_ptr = &remote_contents[offset];
-
-      virtual_page_idx = reinterpret_cast<uintptr_t>(local_ptr) / kPageSize;
+    // Look up the page frames of the whole mapping, and their flags and mapping counts, with a
+    // few large reads instead of four reads per page.
+    const size_t num_pages = boot_map_size / kPageSize;
+    const size_t local_virtual_page_begin =
+        reinterpret_cast<uintptr_t>(&boot_image_header) / kPageSize;
+    std::vector<uint64_t> page_frame_numbers;
+    std::vector<uint64_t> clean_page_frame_numbers;
+    std::vector<uint64_t> page_flags;
+    std::vector<uint64_t> page_counts;
+    if (!GetPageFrameNumbers(page_map_file.get(),
+                             boot_map.start / kPageSize,
+                             num_pages,
+                             &page_frame_numbers,
+                             &error_msg) ||
+        !GetPageFrameNumbers(clean_page_map_file.get(),
+                             local_virtual_page_begin,
+                             num_pages,
+                             &clean_page_frame_numbers,
+                             &error_msg) ||
+        !ReadPageFrameEntries(kpage_flags_file.get(),
+                              page_frame_numbers,
+                              &page_flags,
+                              &error_msg) ||
+        !ReadPageFrameEntries(kpage_count_file.get(),
+                              page_frame_numbers,
+                              &page_counts,
+                              &error_msg)) {
+      os << error_msg;
+      return false;
+    }
 
-      // Calculate the page index, relative to the 0th page where the image begins
-      page_idx = (offset + page_off_begin) / kPageSize;
-      if (*local_ptr != *remote_ptr) {
-        // Track number of bytes that are different
-        different_bytes++;
+    // Independently count the # of dirty pages on the remote side
+    for (size_t i = 0; i != num_pages; ++i) {
+      // TODO: the clean page frame needs to be from the same process
+      bool is_dirty = IsPageDirty(page_frame_numbers[i],        // potentially "dirty" page
+                                  clean_page_frame_numbers[i],  // true "clean" page
+                                  page_flags[i]);
+      bool is_private = page_counts[i] == 1;
+
+      if (is_dirty) {
+        dirty_pages++;
+        dirty_page_set_remote.insert(dirty_page_set_remote.end(), boot_map.start / kPageSize + i);
+        dirty_page_set_local.insert(dirty_page_set_local.end(), local_virtual_page_begin + i);
       }
 
-      // Independently count the # of dirty pages on the remote side
-      size_t remote_virtual_page_idx = begin / kPageSize;
-      if (previous_page_idx != page_idx) {
-        uint64_t page_count = 0xC0FFEE;
-        // TODO: virtual_page_idx needs to be from the same process
-        int dirtiness = (IsPageDirty(page_map_file.get(),        // Image-diff-pid procmap
-                                     clean_page_map_file.get(),  // Self procmap
-                                     kpage_flags_file.get(),
-                                     kpage_count_file.get(),
-                                     remote_virtual_page_idx,    // potentially "dirty" page
-                                     virtual_page_idx,           // true "clean" page
-                                     &page_count,
-                                     &error_msg));
-        if (dirtiness < 0) {
-          os << error_msg;
-          return false;
-        } else if (dirtiness > 0) {
-          dirty_pages++;
-          dirty_page_set_remote.insert(dirty_page_set_remote.end(), remote_virtual_page_idx);
-          dirty_page_set_local.insert(dirty_page_set_local.end(), virtual_page_idx);
-        }
-
-        bool is_dirty = dirtiness > 0;
-        bool is_private = page_count == 1;
-
-        if (page_count == 1) {
-          private_pages++;
-        }
+      if (is_private) {
+        private_pages++;
+      }
 
-        if (is_dirty && is_private) {
-          private_dirty_pages++;
-        }
+      if (is_dirty && is_private) {
+        private_dirty_pages++;
+        private_dirty_page_set_local.insert(private_dirty_page_set_local.end(),
+                                            local_virtual_page_begin + i);
       }
     }
 
@@ -513,6 +528,9 @@ class ImgDiagDumper {
     const uint8_t* begin_image_ptr = image_begin_unaligned;
     const uint8_t* end_image_ptr = image_mirror_end_unaligned;
 
+    // Dirtiness in this process, merged into the aggregate over all processes at the end.
+    AggregateTables process_tables;
+
     const uint8_t* current = begin_image_ptr + RoundUp(sizeof(ImageHeader), kObjectAlignment);
     while (reinterpret_cast<uintptr_t>(current) < reinterpret_cast<uintptr_t>(end_image_ptr)) {
       CHECK_ALIGNED(current, kObjectAlignment);
@@ -568,6 +586,14 @@ class ImgDiagDumper {
         different_objects++;
         dirty_object_bytes += obj->SizeOf();
 
+        const bool is_private_dirty = private_dirty_page_set_local.find(
+            reinterpret_cast<uintptr_t>(current) / kPageSize) != private_dirty_page_set_local.end();
+        process_tables.classes[klass].Add(obj->SizeOf(), is_private_dirty);
+        for (ArtField* field : GetDirtyFields(obj, current_remote)) {
+          process_tables.fields[field].Add(
+              Primitive::ComponentSize(field->GetTypeAsPrimitiveType()), is_private_dirty);
+        }
+
         ++class_data[klass].dirty_object_count;
 
         // Go byte-by-byte and figure out what exactly got dirtied
@@ -831,9 +857,120 @@ class ImgDiagDumper {
       os << "    " << mirror::Class::PrettyClass(vk_pair.second) << " (" << vk_pair.first << ")\n";
     }
 
+    // ArtMethods are not objects. Compare the ArtMethods section method by method.
+    CollectDirtyArtMethods(remote_contents, private_dirty_page_set_local, &process_tables);
+    aggregate_tables_.MergeProcess(process_tables);
+    ++aggregate_process_count_;
+
     return true;
   }
 
+  struct AggregateTables {
+    std::map<mirror::Class*, AggregateData> classes;
+    std::map<ArtField*, AggregateData> fields;
+    std::map<ArtMethod*, AggregateData> art_methods;
+
+    void MergeProcess(const AggregateTables& process) {
+      MergeAggregateTable(process.classes, &classes);
+      MergeAggregateTable(process.fields, &fields);
+      MergeAggregateTable(process.art_methods, &art_methods);
+    }
+  };
+
+  // Returns the instance fields, and for classes the static fields, whose bytes differ.
+  static std::set<ArtField*> GetDirtyFields(mirror::Object* obj, const uint8_t* remote_bytes)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    std::set<ArtField*> dirty_fields;
+    mirror::Class* klass = obj->GetClass();
+    const uint8_t* obj_bytes = reinterpret_cast<const uint8_t*>(obj);
+    for (size_t i = 0, count = obj->SizeOf(); i < count; ++i) {
+      if (obj_bytes[i] != remote_bytes[i]) {
+        ArtField* field = ArtField::FindInstanceFieldWithOffset</*exact*/false>(klass, i);
+        if (field == nullptr && obj->IsClass()) {
+          field = ArtField::FindStaticFieldWithOffset</*exact*/false>(obj->AsClass(), i);
+        }
+        if (field != nullptr) {
+          dirty_fields.insert(field);
+        }
+      }
+    }
+    return dirty_fields;
+  }
+
+  void CollectDirtyArtMethods(const std::vector<uint8_t>& remote_contents,
+                              const std::set<size_t>& private_dirty_page_set_local,
+                              AggregateTables* tables) {
+    class DirtyArtMethodVisitor : public ArtMethodVisitor {
+     public:
+      DirtyArtMethodVisitor(const ImageHeader& image_header,
+                            const std::vector<uint8_t>& remote_contents,
+                            const std::set<size_t>& private_dirty_page_set_local,
+                            AggregateTables* tables)
+          : image_header_(image_header),
+            remote_contents_(remote_contents),
+            private_dirty_page_set_local_(private_dirty_page_set_local),
+            tables_(tables) {}
+
+      void Visit(ArtMethod* method) OVERRIDE {
+        const size_t size = ArtMethod::Size(image_header_.GetPointerSize());
+        const size_t offset = reinterpret_cast<const uint8_t*>(method) -
+            reinterpret_cast<const uint8_t*>(&image_header_);
+        if (offset + size > remote_contents_.size() ||
+            memcmp(method, &remote_contents_[offset], size) == 0) {
+          return;
+        }
+        const bool is_private_dirty = private_dirty_page_set_local_.find(
+            reinterpret_cast<uintptr_t>(method) / kPageSize) !=
+            private_dirty_page_set_local_.end();
+        tables_->art_methods[method].Add(size, is_private_dirty);
+      }
+
+     private:
+      const ImageHeader& image_header_;
+      const std::vector<uint8_t>& remote_contents_;
+      const std::set<size_t>& private_dirty_page_set_local_;
+      AggregateTables* const tables_;
+    };
+
+    DirtyArtMethodVisitor visitor(image_header_,
+                                  remote_contents,
+                                  private_dirty_page_set_local,
+                                  tables);
+    image_header_.VisitPackedArtMethods(&visitor,
+                                        image_header_.GetImageBegin(),
+                                        image_header_.GetPointerSize());
+  }
+
+  // Dumps which classes, fields and ArtMethods are dirty in how many of the diffed processes,
+  // ranked by their private dirty bytes summed over the processes.
+  void DumpAggregate() REQUIRES_SHARED(Locks::mutator_lock_) {
+    std::ostream& os = *os_;
+    os << "AGGREGATE DIRTINESS (" << aggregate_process_count_ << " of "
+       << image_diff_pids_.size() << " pids):\n";
+    DumpAggregateTable<mirror::Class*>(
+        os,
+        "Dirty objects by class",
+        aggregate_tables_.classes,
+        [](mirror::Class* klass) NO_THREAD_SAFETY_ANALYSIS {
+          return mirror::Class::PrettyClass(klass);
+        });
+    DumpAggregateTable<ArtField*>(
+        os,
+        "Dirty fields",
+        aggregate_tables_.fields,
+        [](ArtField* field) NO_THREAD_SAFETY_ANALYSIS {
+          return ArtField::PrettyField(field);
+        });
+    DumpAggregateTable<ArtMethod*>(
+        os,
+        "Dirty ArtMethods",
+        aggregate_tables_.art_methods,
+        [](ArtMethod* method) NO_THREAD_SAFETY_ANALYSIS {
+          return method->PrettyMethod();
+        });
+    os << "\n";
+  }
+
   // Fixup a remote pointer that we read from a foreign boot.art to point to our own memory.
   // Returned pointer will point to inside of remote_contents.
   template <typename T>
@@ -897,93 +1034,93 @@ class ImgDiagDumper {
     return value_key_vector;
   }
 
-  static bool GetPageFrameNumber(File* page_map_file,
-                                size_t virtual_page_index,
-                                uint64_t* page_frame_number,
-                                std::string* error_msg) {
+  // Maximum number of 64-bit entries of /proc/$pid/pagemap, /proc/kpageflags or /proc/kpagecount
+  // read at once.
+  static constexpr size_t kMaxPageEntriesPerRead = 4096;
+
+  // Reads the physical page frame numbers of `num_pages` virtual pages starting at
+  // `virtual_page_index`, in reads of up to kMaxPageEntriesPerRead pages.
+  static bool GetPageFrameNumbers(File* page_map_file,
+                                  size_t virtual_page_index,
+                                  size_t num_pages,
+                                  std::vector<uint64_t>* page_frame_numbers,
+                                  std::string* error_msg) {
     CHECK(page_map_file != nullptr);
-    CHECK(page_frame_number != nullptr);
+    CHECK(page_frame_numbers != nullptr);
     CHECK(error_msg != nullptr);
 
     constexpr size_t kPageMapEntrySize = sizeof(uint64_t);
     constexpr uint64_t kPageFrameNumberMask = (1ULL << 55) - 1;  // bits 0-54 [in /proc/$pid/pagemap]
-    constexpr uint64_t kPageSoftDirtyMask = (1ULL << 55);  // bit 55 [in /proc/$pid/pagemap]
-
-    uint64_t page_map_entry = 0;
 
-    // Read 64-bit entry from /proc/$pid/pagemap to get the physical page frame number
-    if (!page_map_file->PreadFully(&page_map_entry, kPageMapEntrySize,
-                                  virtual_page_index * kPageMapEntrySize)) {
-      *error_msg = StringPrintf("Failed to read the virtual page index entry from %s",
-                                page_map_file->GetPath().c_str());
-      return false;
+    // Read 64-bit entries from /proc/$pid/pagemap to get the physical page frame numbers
+    page_frame_numbers->resize(num_pages);
+    for (size_t i = 0; i < num_pages; i += kMaxPageEntriesPerRead) {
+      const size_t count = std::min(num_pages - i, kMaxPageEntriesPerRead);
+      if (!page_map_file->PreadFully(&(*page_frame_numbers)[i],
+                                     count * kPageMapEntrySize,
+                                     (virtual_page_index + i) * kPageMapEntrySize)) {
+        *error_msg = StringPrintf("Failed to read the virtual page index entries from %s",
+                                  page_map_file->GetPath().c_str());
+        return false;
+      }
     }
-
-    // TODO: seems useless, remove this.
-    bool soft_dirty = (page_map_entry & kPageSoftDirtyMask) != 0;
-    if ((false)) {
-      LOG(VERBOSE) << soft_dirty;  // Suppress unused warning
-      UNREACHABLE();
+    for (uint64_t& page_frame_number : *page_frame_numbers) {
+      page_frame_number &= kPageFrameNumberMask;
     }
 
-    *page_frame_number = page_map_entry & kPageFrameNumberMask;
-
     return true;
   }
 
-  static int IsPageDirty(File* page_map_file,
-                         File* clean_page_map_file,
-                         File* kpage_flags_file,
-                         File* kpage_count_file,
-                         size_t virtual_page_idx,
-                         size_t clean_virtual_page_idx,
-                         // Out parameters:
-                         uint64_t* page_count, std::string* error_msg) {
-    CHECK(page_map_file != nullptr);
-    CHECK(clean_page_map_file != nullptr);
-    CHECK_NE(page_map_file, clean_page_map_file);
-    CHECK(kpage_flags_file != nullptr);
-    CHECK(kpage_count_file != nullptr);
-    CHECK(page_count != nullptr);
+  // Reads the 64-bit entries of /proc/kpageflags or /proc/kpagecount for the given page frame
+  // numbers. The page frame numbers are sorted and deduplicated, and each run of consecutive
+  // ones is read at once.
+  static bool ReadPageFrameEntries(File* kpage_file,
+                                   const std::vector<uint64_t>& page_frame_numbers,
+                                   std::vector<uint64_t>* entries,
+                                   std::string* error_msg) {
+    CHECK(kpage_file != nullptr);
+    CHECK(entries != nullptr);
     CHECK(error_msg != nullptr);
 
-    // Constants are from https://www.kernel.org/doc/Documentation/vm/pagemap.txt
-
-    constexpr size_t kPageFlagsEntrySize = sizeof(uint64_t);
-    constexpr size_t kPageCountEntrySize = sizeof(uint64_t);
-    constexpr uint64_t kPageFlagsDirtyMask = (1ULL << 4);  // in /proc/kpageflags
-    constexpr uint64_t kPageFlagsNoPageMask = (1ULL << 20);  // in /proc/kpageflags
-    constexpr uint64_t kPageFlagsMmapMask = (1ULL << 11);  // in /proc/kpageflags
-
-    uint64_t page_frame_number = 0;
-    if (!GetPageFrameNumber(page_map_file, virtual_page_idx, &page_frame_number, error_msg)) {
-      return -1;
+    constexpr size_t kPageEntrySize = sizeof(uint64_t);
+
+    std::vector<uint64_t> sorted(page_frame_numbers);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    std::vector<uint64_t> sorted_entries(sorted.size());
+    for (size_t run_begin = 0; run_begin != sorted.size(); ) {
+      size_t run_end = run_begin + 1u;
+      while (run_end != sorted.size() &&
+             run_end - run_begin < kMaxPageEntriesPerRead &&
+             sorted[run_end] == sorted[run_end - 1u] + 1u) {
+        ++run_end;
+      }
+      if (!kpage_file->PreadFully(&sorted_entries[run_begin],
+                                  (run_end - run_begin) * kPageEntrySize,
+                                  sorted[run_begin] * kPageEntrySize)) {
+        *error_msg = StringPrintf("Failed to read the page frame entries from %s",
+                                  kpage_file->GetPath().c_str());
+        return false;
+      }
+      run_begin = run_end;
     }
 
-    uint64_t page_frame_number_clean = 0;
-    if (!GetPageFrameNumber(clean_page_map_file, clean_virtual_page_idx, &page_frame_number_clean,
-                            error_msg)) {
-      return -1;
+    entries->resize(page_frame_numbers.size());
+    for (size_t i = 0; i != page_frame_numbers.size(); ++i) {
+      auto it = std::lower_bound(sorted.begin(), sorted.end(), page_frame_numbers[i]);
+      (*entries)[i] = sorted_entries[it - sorted.begin()];
     }
+    return true;
+  }
 
-    // Read 64-bit entry from /proc/kpageflags to get the dirty bit for a page
-    uint64_t kpage_flags_entry = 0;
-    if (!kpage_flags_file->PreadFully(&kpage_flags_entry,
-                                     kPageFlagsEntrySize,
-                                     page_frame_number * kPageFlagsEntrySize)) {
-      *error_msg = StringPrintf("Failed to read the page flags from %s",
-                                kpage_flags_file->GetPath().c_str());
-      return -1;
-    }
+  static bool IsPageDirty(uint64_t page_frame_number,
+                          uint64_t page_frame_number_clean,
+                          uint64_t kpage_flags_entry) {
+    // Constants are from https://www.kernel.org/doc/Documentation/vm/pagemap.txt
 
-    // Read 64-bit entyry from /proc/kpagecount to get mapping counts for a page
-    if (!kpage_count_file->PreadFully(page_count /*out*/,
-                                     kPageCountEntrySize,
-                                     page_frame_number * kPageCountEntrySize)) {
-      *error_msg = StringPrintf("Failed to read the page count from %s",
-                                kpage_count_file->GetPath().c_str());
-      return -1;
-    }
+    constexpr uint64_t kPageFlagsDirtyMask = (1ULL << 4);  // in /proc/kpageflags
+    constexpr uint64_t kPageFlagsNoPageMask = (1ULL << 20);  // in /proc/kpageflags
+    constexpr uint64_t kPageFlagsMmapMask = (1ULL << 11);  // in /proc/kpageflags
 
     // There must be a page frame at the requested address.
     CHECK_EQ(kpage_flags_entry & kPageFlagsNoPageMask, 0u);
@@ -1011,7 +1148,9 @@ class ImgDiagDumper {
   std::ostream* os_;
   const ImageHeader& image_header_;
   const std::string image_location_;
-  pid_t image_diff_pid_;  // Dump image diff against boot.art if pid is non-negative
+  const std::vector<pid_t> image_diff_pids_;  // Dump image diff against boot.art for each pid
+  AggregateTables aggregate_tables_;
+  size_t aggregate_process_count_ = 0;
   pid_t zygote_diff_pid_;  // Dump image diff against zygote boot.art if pid is non-negative
 
   DISALLOW_COPY_AND_ASSIGN(ImgDiagDumper);
@@ -1019,7 +1158,7 @@ class ImgDiagDumper {
 
 static int DumpImage(Runtime* runtime,
                      std::ostream* os,
-                     pid_t image_diff_pid,
+                     const std::vector<pid_t>& image_diff_pids,
                      pid_t zygote_diff_pid) {
   ScopedObjectAccess soa(Thread::Current());
   gc::Heap* heap = runtime->GetHeap();
@@ -1035,7 +1174,7 @@ static int DumpImage(Runtime* runtime,
     ImgDiagDumper img_diag_dumper(os,
                                   image_header,
                                   image_space->GetImageLocation(),
-                                  image_diff_pid,
+                                  image_diff_pids,
                                   zygote_diff_pid);
     if (!img_diag_dumper.Dump()) {
       return EXIT_FAILURE;
@@ -1058,11 +1197,16 @@ struct ImgDiagArgs : public CmdlineArgs {
     }
 
     if (option.starts_with("--image-diff-pid=")) {
-      const char* image_diff_pid = option.substr(strlen("--image-diff-pid=")).data();
-
-      if (!ParseInt(image_diff_pid, &image_diff_pid_)) {
-        *error_msg = "Image diff pid out of range";
-        return kParseError;
+      const std::string image_diff_pids = option.substr(strlen("--image-diff-pid=")).ToString();
+
+      // Accept a comma separated list of pids, and repeated options.
+      for (const std::string& image_diff_pid : android::base::Split(image_diff_pids, ",")) {
+        pid_t pid;
+        if (!ParseInt(image_diff_pid.c_str(), &pid)) {
+          *error_msg = "Image diff pid out of range";
+          return kParseError;
+        }
+        image_diff_pids_.push_back(pid);
       }
     } else if (option.starts_with("--zygote-diff-pid=")) {
       const char* zygote_diff_pid = option.substr(strlen("--zygote-diff-pid=")).data();
@@ -1087,16 +1231,19 @@ struct ImgDiagArgs : public CmdlineArgs {
 
     // Perform our own checks.
 
-    if (kill(image_diff_pid_,
-             /*sig*/0) != 0) {  // No signal is sent, perform error-checking only.
-      // Check if the pid exists before proceeding.
-      if (errno == ESRCH) {
-        *error_msg = "Process specified does not exist";
-      } else {
-        *error_msg = StringPrintf("Failed to check process status: %s", strerror(errno));
+    for (pid_t image_diff_pid : image_diff_pids_) {
+      if (kill(image_diff_pid,
+               /*sig*/0) != 0) {  // No signal is sent, perform error-checking only.
+        // Check if the pid exists before proceeding.
+        if (errno == ESRCH) {
+          *error_msg = StringPrintf("Process specified does not exist: %d", image_diff_pid);
+        } else {
+          *error_msg = StringPrintf("Failed to check process status: %s", strerror(errno));
+        }
+        return kParseError;
       }
-      return kParseError;
-    } else if (instruction_set_ != kRuntimeISA) {
+    }
+    if (instruction_set_ != kRuntimeISA) {
       // Don't allow different ISAs since the images are ISA-specific.
       // Right now the code assumes both the runtime ISA and the remote ISA are identical.
       *error_msg = "Must use the default runtime ISA; changing ISA is not supported.";
@@ -1118,8 +1265,10 @@ struct ImgDiagArgs : public CmdlineArgs {
     usage += Base::GetUsage();
 
     usage +=  // Optional.
-        "  --image-diff-pid=<pid>: provide the PID of a process whose boot.art you want to diff.\n"
+        "  --image-diff-pid=<pid>[,<pid>...]: provide the PIDs of processes whose boot.art you\n"
+        "      want to diff. May be repeated. The runtime is only started once for all of them.\n"
         "      Example: --image-diff-pid=$(pid zygote)\n"
+        "      Example: --image-diff-pid=1234,1235 --image-diff-pid=1236\n"
         "  --zygote-diff-pid=<pid>: provide the PID of the zygote whose boot.art you want to diff "
         "against.\n"
         "      Example: --zygote-diff-pid=$(pid zygote)\n"
@@ -1129,7 +1278,7 @@ struct ImgDiagArgs : public CmdlineArgs {
   }
 
  public:
-  pid_t image_diff_pid_ = -1;
+  std::vector<pid_t> image_diff_pids_;
   pid_t zygote_diff_pid_ = -1;
 };
 
@@ -1139,7 +1288,7 @@ struct ImgDiagMain : public CmdlineMain<ImgDiagArgs> {
 
     return DumpImage(runtime,
                      args_->os_,
-                     args_->image_diff_pid_,
+                     args_->image_diff_pids_,
                      args_->zygote_diff_pid_) == EXIT_SUCCESS;
   }
 };
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Dirtiness aggregated by imgdiag over all the diffed processes. It only deals with counts, so
+ * it does not need a runtime and can be tested on its own.
+ */
+
+#ifndef ART_IMGDIAG_IMGDIAG_AGGREGATE_H_
+#define ART_IMGDIAG_IMGDIAG_AGGREGATE_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "android-base/stringprintf.h"
+
+namespace art {
+
+// Number of entries of each aggregate table that are dumped.
+static constexpr size_t kMaxAggregateEntriesToDump = 100;
+
+// Dirtiness of one class, field or ArtMethod, in one process or merged over several.
+struct AggregateData {
+  // Number of processes in which it is dirty.
+  size_t process_count = 0;
+  // Number of dirty instances, summed over the processes.
+  size_t dirty_count = 0;
+  size_t dirty_bytes = 0;
+  // The part of dirty_bytes that is on pages mapped by one process only.
+  size_t private_dirty_bytes = 0;
+
+  void Add(size_t bytes, bool is_private_dirty) {
+    process_count = 1u;
+    ++dirty_count;
+    dirty_bytes += bytes;
+    if (is_private_dirty) {
+      private_dirty_bytes += bytes;
+    }
+  }
+
+  void Merge(const AggregateData& other) {
+    process_count += other.process_count;
+    dirty_count += other.dirty_count;
+    dirty_bytes += other.dirty_bytes;
+    private_dirty_bytes += other.private_dirty_bytes;
+  }
+};
+
+// Merges the table of one process into the aggregate.
+template <typename K>
+void MergeAggregateTable(const std::map<K, AggregateData>& process,
+                         std::map<K, AggregateData>* aggregate) {
+  for (const auto& entry : process) {
+    (*aggregate)[entry.first].Merge(entry.second);
+  }
+}
+
+// Returns the entries of `table`, most private dirty bytes first, then most dirty bytes.
+template <typename K>
+std::vector<std::pair<K, AggregateData>> SortByPrivateDirtyBytes(
+    const std::map<K, AggregateData>& table) {
+  std::vector<std::pair<K, AggregateData>> entries(table.begin(), table.end());
+  std::stable_sort(entries.begin(),
+                   entries.end(),
+                   [](const std::pair<K, AggregateData>& lhs,
+                      const std::pair<K, AggregateData>& rhs) {
+    if (lhs.second.private_dirty_bytes != rhs.second.private_dirty_bytes) {
+      return lhs.second.private_dirty_bytes > rhs.second.private_dirty_bytes;
+    }
+    return lhs.second.dirty_bytes > rhs.second.dirty_bytes;
+  });
+  return entries;
+}
+
+// Dumps the first `max_entries` entries of `table` in SortByPrivateDirtyBytes order.
+template <typename K>
+void DumpAggregateTable(std::ostream& os,
+                        const char* title,
+                        const std::map<K, AggregateData>& table,
+                        const std::function<std::string(K)>& name,
+                        size_t max_entries = kMaxAggregateEntriesToDump) {
+  os << "  " << title << ": " << table.size() << "\n";
+  size_t num_dumped = 0u;
+  for (const auto& entry : SortByPrivateDirtyBytes(table)) {
+    if (num_dumped == max_entries) {
+      os << "    ... " << (table.size() - num_dumped) << " more\n";
+      break;
+    }
+    const AggregateData& data = entry.second;
+    os << android::base::StringPrintf(
+        "    %s: private_dirty_bytes=%zu dirty_bytes=%zu dirty=%zu processes=%zu\n",
+        name(entry.first).c_str(),
+        data.private_dirty_bytes,
+        data.dirty_bytes,
+        data.dirty_count,
+        data.process_count);
+    ++num_dumped;
+  }
+}
+
+}  // namespace art
+
+#endif  // ART_IMGDIAG_IMGDIAG_AGGREGATE_H_
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <map>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -22,6 +23,7 @@
 
 #include "android-base/stringprintf.h"
 
+#include "imgdiag_aggregate.h"
 #include "runtime/os.h"
 #include "runtime/arch/instruction_set.h"
 #include "runtime/exec_utils.h"
@@ -86,6 +88,14 @@ class ImgDiagTest : public CommonRuntimeTest {
 
   // Run imgdiag with a custom boot image location.
   bool Exec(pid_t image_diff_pid, const std::string& boot_image, std::string* error_msg) {
+    return Exec(std::to_string(image_diff_pid), image_diff_pid, boot_image, error_msg);
+  }
+
+  // Run imgdiag with a comma separated list of pids to diff.
+  bool Exec(const std::string& image_diff_pids,
+            pid_t zygote_diff_pid,
+            const std::string& boot_image,
+            std::string* error_msg) {
     // Invoke 'img_diag' against the current process.
     // This should succeed because we have a runtime and so it should
     // be able to map in the boot.art and do a diff for it.
@@ -97,12 +107,12 @@ class ImgDiagTest : public CommonRuntimeTest {
     std::string zygote_diff_pid_args;
     {
       std::stringstream diff_pid_args_ss;
-      diff_pid_args_ss << kImgDiagDiffPid << "=" << image_diff_pid;
+      diff_pid_args_ss << kImgDiagDiffPid << "=" << image_diff_pids;
       diff_pid_args = diff_pid_args_ss.str();
     }
     {
       std::stringstream zygote_pid_args_ss;
-      zygote_pid_args_ss << kImgDiagZygoteDiffPid << "=" << image_diff_pid;
+      zygote_pid_args_ss << kImgDiagZygoteDiffPid << "=" << zygote_diff_pid;
       zygote_diff_pid_args = zygote_pid_args_ss.str();
     }
     std::string boot_image_args = std::string(kImgDiagBootImage) + "=" + boot_image;
@@ -122,6 +132,12 @@ class ImgDiagTest : public CommonRuntimeTest {
     return Exec(image_diff_pid, boot_image_location_, error_msg);
   }
 
+  bool ExecDefaultBootImage(const std::string& image_diff_pids,
+                            pid_t zygote_diff_pid,
+                            std::string* error_msg) {
+    return Exec(image_diff_pids, zygote_diff_pid, boot_image_location_, error_msg);
+  }
+
  private:
   std::string runtime_args_image_;
   std::string boot_image_location_;
@@ -145,6 +161,19 @@ TEST_F(ImgDiagTest, DISABLED_ImageDiffPidSelf) {
                                                           << error_msg;
 }
 
+#if defined (ART_TARGET) && !defined(__mips__)
+TEST_F(ImgDiagTest, ImageDiffMultiplePidsSelf) {
+#else
+// Same as ImageDiffPidSelf.
+TEST_F(ImgDiagTest, DISABLED_ImageDiffMultiplePidsSelf) {
+#endif
+  // Diff the current process twice in one run.
+  std::string error_msg;
+  const std::string pids = std::to_string(getpid()) + "," + std::to_string(getpid());
+  ASSERT_TRUE(ExecDefaultBootImage(pids, getpid(), &error_msg))
+      << "Failed to execute -- because: " << error_msg;
+}
+
 TEST_F(ImgDiagTest, ImageDiffBadPid) {
   // Invoke 'img_diag' against a non-existing process. This should fail.
 
@@ -155,4 +184,97 @@ TEST_F(ImgDiagTest, ImageDiffBadPid) {
   UNUSED(error_msg);
 }
 
+TEST_F(ImgDiagTest, ImageDiffBadPidInList) {
+  // Invoke 'img_diag' against the current process and a non-existing one. This should fail
+  // before diffing anything.
+  std::string error_msg;
+  const std::string pids =
+      std::to_string(getpid()) + "," + std::to_string(kImgDiagGuaranteedBadPid);
+  ASSERT_FALSE(ExecDefaultBootImage(pids, getpid(), &error_msg)) << "Incorrectly executed";
+  UNUSED(error_msg);
+}
+
+// The aggregation over several pids only runs where ImageDiffMultiplePidsSelf is enabled, so
+// check it on synthetic per-process dirty sets.
+TEST(ImgDiagAggregateTest, Merge) {
+  std::map<int, AggregateData> process1;
+  process1[1].Add(/* bytes */ 16, /* is_private_dirty */ true);
+  process1[1].Add(/* bytes */ 8, /* is_private_dirty */ false);
+  process1[2].Add(/* bytes */ 32, /* is_private_dirty */ false);
+  std::map<int, AggregateData> process2;
+  process2[1].Add(/* bytes */ 16, /* is_private_dirty */ true);
+  process2[3].Add(/* bytes */ 4, /* is_private_dirty */ true);
+
+  std::map<int, AggregateData> aggregate;
+  MergeAggregateTable(process1, &aggregate);
+  MergeAggregateTable(process2, &aggregate);
+
+  ASSERT_EQ(3u, aggregate.size());
+  EXPECT_EQ(2u, aggregate[1].process_count);
+  EXPECT_EQ(3u, aggregate[1].dirty_count);
+  EXPECT_EQ(40u, aggregate[1].dirty_bytes);
+  EXPECT_EQ(32u, aggregate[1].private_dirty_bytes);
+  EXPECT_EQ(1u, aggregate[2].process_count);
+  EXPECT_EQ(1u, aggregate[2].dirty_count);
+  EXPECT_EQ(32u, aggregate[2].dirty_bytes);
+  EXPECT_EQ(0u, aggregate[2].private_dirty_bytes);
+  EXPECT_EQ(1u, aggregate[3].process_count);
+  EXPECT_EQ(4u, aggregate[3].private_dirty_bytes);
+
+  // Most private dirty bytes first, ties broken by dirty bytes.
+  std::vector<std::pair<int, AggregateData>> sorted = SortByPrivateDirtyBytes(aggregate);
+  ASSERT_EQ(3u, sorted.size());
+  EXPECT_EQ(1, sorted[0].first);
+  EXPECT_EQ(3, sorted[1].first);
+  EXPECT_EQ(2, sorted[2].first);
+}
+
+TEST(ImgDiagAggregateTest, DumpCap) {
+  const size_t kNumEntries = kMaxAggregateEntriesToDump + 20u;
+  std::map<int, AggregateData> aggregate;
+  for (size_t i = 0; i != kNumEntries; ++i) {
+    std::map<int, AggregateData> process;
+    process[static_cast<int>(i)].Add(/* bytes */ i + 1u, /* is_private_dirty */ true);
+    MergeAggregateTable(process, &aggregate);
+  }
+
+  std::ostringstream oss;
+  DumpAggregateTable<int>(oss,
+                          "Dirty things",
+                          aggregate,
+                          [](int key) { return std::to_string(key); });
+  std::vector<std::string> lines;
+  std::istringstream iss(oss.str());
+  for (std::string line; std::getline(iss, line); ) {
+    lines.push_back(line);
+  }
+
+  // The title, the capped entries and the line counting the rest.
+  ASSERT_EQ(kMaxAggregateEntriesToDump + 2u, lines.size());
+  EXPECT_EQ("  Dirty things: " + std::to_string(kNumEntries), lines.front());
+  EXPECT_EQ("    ... 20 more", lines.back());
+  // The entries with the most private dirty bytes are the ones dumped.
+  EXPECT_EQ(android::base::StringPrintf(
+                "    %zu: private_dirty_bytes=%zu dirty_bytes=%zu dirty=1 processes=1",
+                kNumEntries - 1u,
+                kNumEntries,
+                kNumEntries),
+            lines[1]);
+  EXPECT_EQ(android::base::StringPrintf(
+                "    %zu: private_dirty_bytes=%zu dirty_bytes=%zu dirty=1 processes=1",
+                kNumEntries - kMaxAggregateEntriesToDump,
+                kNumEntries - kMaxAggregateEntriesToDump + 1u,
+                kNumEntries - kMaxAggregateEntriesToDump + 1u),
+            lines[kMaxAggregateEntriesToDump]);
+
+  // No cap line when everything fits.
+  std::ostringstream small_oss;
+  DumpAggregateTable<int>(small_oss,
+                          "Dirty things",
+                          aggregate,
+                          [](int key) { return std::to_string(key); },
+                          /* max_entries */ kNumEntries);
+  EXPECT_EQ(std::string::npos, small_oss.str().find("more"));
+}
+
 }  // namespace art
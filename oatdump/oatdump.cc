@@ -14,14 +14,23 @@
  * limitations under the License.
  */
 
+#include <fnmatch.h>
+#include <regex.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -49,6 +58,9 @@
 #include "imtable-inl.h"
 #include "indenter.h"
 #include "interpreter/unstarted_runtime.h"
+#include "java_vm_ext.h"
+#include "jit/profile_compilation_info.h"
+#include "jni_env_ext.h"
 #include "linker/buffered_output_stream.h"
 #include "linker/file_output_stream.h"
 #include "mirror/array-inl.h"
@@ -66,6 +78,7 @@
 #include "stack_map.h"
 #include "string_reference.h"
 #include "thread_list.h"
+#include "thread_pool.h"
 #include "type_lookup_table.h"
 #include "vdex_file.h"
 #include "verifier/method_verifier.h"
@@ -95,21 +108,138 @@ const char* image_roots_descriptions_[] = {
   "kClassLoader",
 };
 
-// Map is so that we don't allocate multiple dex files for the same OatDexFile.
-static std::map<const OatFile::OatDexFile*,
-                std::unique_ptr<const DexFile>> opened_dex_files;
+// Map is so that we don't allocate multiple dex files for the same OatDexFile. Dex files are only
+// opened when first needed, and then shared by all the parts of a dump, including parallel ones.
+// They are grouped by oat file, so that they can be closed along with it (see CloseDexFiles).
+static std::map<const OatFile*,
+                std::map<const OatFile::OatDexFile*,
+                         std::unique_ptr<const DexFile>>> opened_dex_files;
+static std::mutex opened_dex_files_lock;
 
 const DexFile* OpenDexFile(const OatFile::OatDexFile* oat_dex_file, std::string* error_msg) {
   DCHECK(oat_dex_file != nullptr);
-  auto it = opened_dex_files.find(oat_dex_file);
-  if (it != opened_dex_files.end()) {
+  std::lock_guard<std::mutex> lock(opened_dex_files_lock);
+  auto& oat_file_dex_files = opened_dex_files[oat_dex_file->GetOatFile()];
+  auto it = oat_file_dex_files.find(oat_dex_file);
+  if (it != oat_file_dex_files.end()) {
     return it->second.get();
   }
   const DexFile* ret = oat_dex_file->OpenDexFile(error_msg).release();
-  opened_dex_files.emplace(oat_dex_file, std::unique_ptr<const DexFile>(ret));
+  oat_file_dex_files.emplace(oat_dex_file, std::unique_ptr<const DexFile>(ret));
   return ret;
 }
 
+// Closes the dex files opened from `oat_file`. Must be called before the oat file is destroyed,
+// as the dex files point into it and a later oat file may reuse its OatDexFile addresses.
+static void CloseDexFiles(const OatFile* oat_file) {
+  std::lock_guard<std::mutex> lock(opened_dex_files_lock);
+  opened_dex_files.erase(oat_file);
+}
+
+// One record of the machine-readable output: a flat JSON object, tagged with the kind of record,
+// written on a single line. Records are written as soon as they are complete, so consumers can
+// stream the output of arbitrarily large files. Records describing a class or method follow the
+// record of the dex file or class containing them.
+class JsonRecord {
+ public:
+  explicit JsonRecord(const char* kind) {
+    AddString("record", kind);
+  }
+
+  JsonRecord& AddString(const char* key, const std::string& value) {
+    AddKey(key);
+    AppendQuoted(value);
+    return *this;
+  }
+
+  JsonRecord& AddUint(const char* key, uint64_t value) {
+    AddKey(key);
+    buffer_ += std::to_string(value);
+    return *this;
+  }
+
+  JsonRecord& AddInt(const char* key, int64_t value) {
+    AddKey(key);
+    buffer_ += std::to_string(value);
+    return *this;
+  }
+
+  JsonRecord& AddBool(const char* key, bool value) {
+    AddKey(key);
+    buffer_ += value ? "true" : "false";
+    return *this;
+  }
+
+  JsonRecord& AddUintArray(const char* key, const std::vector<uint32_t>& values) {
+    AddKey(key);
+    buffer_ += '[';
+    for (size_t i = 0; i != values.size(); ++i) {
+      if (i != 0) {
+        buffer_ += ',';
+      }
+      buffer_ += std::to_string(values[i]);
+    }
+    buffer_ += ']';
+    return *this;
+  }
+
+  JsonRecord& AddStringArray(const char* key, const std::vector<std::string>& values) {
+    AddKey(key);
+    buffer_ += '[';
+    for (size_t i = 0; i != values.size(); ++i) {
+      if (i != 0) {
+        buffer_ += ',';
+      }
+      AppendQuoted(values[i]);
+    }
+    buffer_ += ']';
+    return *this;
+  }
+
+  void Write(std::ostream& os) const {
+    os << '{' << buffer_ << "}\n";
+  }
+
+ private:
+  void AddKey(const char* key) {
+    if (!buffer_.empty()) {
+      buffer_ += ',';
+    }
+    AppendQuoted(key);
+    buffer_ += ':';
+  }
+
+  void AppendQuoted(const std::string& value) {
+    buffer_ += '"';
+    for (char c : value) {
+      switch (c) {
+        case '"':
+          buffer_ += "\\\"";
+          break;
+        case '\\':
+          buffer_ += "\\\\";
+          break;
+        case '\n':
+          buffer_ += "\\n";
+          break;
+        case '\t':
+          buffer_ += "\\t";
+          break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            buffer_ += StringPrintf("\\u%04x", static_cast<unsigned char>(c));
+          } else {
+            buffer_ += c;
+          }
+          break;
+      }
+    }
+    buffer_ += '"';
+  }
+
+  std::string buffer_;
+};
+
 template <typename ElfTypes>
 class OatSymbolizer FINAL {
  public:
@@ -294,6 +424,249 @@ class OatSymbolizer FINAL {
   bool no_bits_;
 };
 
+// Code ranges of the compiled methods of an oat file, sorted by code offset, so that addresses
+// such as PCs from crash dumps can be resolved to methods with a binary search. The index can be
+// saved to a file and reused by later runs on the same oat file.
+class OatCodeIndex {
+ public:
+  struct Entry {
+    uint32_t code_begin;  // Relative to the oat data begin, without the Thumb bit.
+    uint32_t code_end;
+    uint32_t oat_dex_file_index;
+    uint32_t class_def_index;
+    uint32_t class_method_index;
+    uint32_t dex_method_idx;
+  };
+  static_assert(sizeof(Entry) == 6u * sizeof(uint32_t), "Entry is saved as is");
+
+  void Add(const Entry& entry) {
+    entries_.push_back(entry);
+  }
+
+  // Must be called after the last Add() and before any Lookup().
+  void Sort() {
+    // Keep the order of methods sharing deduplicated code, the first one is reported.
+    std::stable_sort(entries_.begin(),
+                     entries_.end(),
+                     [](const Entry& lhs, const Entry& rhs) {
+                       return lhs.code_begin < rhs.code_begin;
+                     });
+  }
+
+  // Returns the entry whose code contains `offset`, or null if there is none.
+  const Entry* Lookup(uint32_t offset) const {
+    auto it = std::upper_bound(entries_.begin(),
+                               entries_.end(),
+                               offset,
+                               [](uint32_t value, const Entry& entry) {
+                                 return value < entry.code_begin;
+                               });
+    if (it == entries_.begin()) {
+      return nullptr;
+    }
+    // Go to the first of the methods sharing this code.
+    it = std::lower_bound(entries_.begin(),
+                          it,
+                          std::prev(it)->code_begin,
+                          [](const Entry& entry, uint32_t value) {
+                            return entry.code_begin < value;
+                          });
+    return (offset < it->code_end) ? &*it : nullptr;
+  }
+
+  size_t Size() const {
+    return entries_.size();
+  }
+
+  bool Save(const std::string& filename,
+            const OatFile& oat_file,
+            std::string* error_msg) const {
+    std::unique_ptr<File> file(OS::CreateEmptyFile(filename.c_str()));
+    if (file == nullptr) {
+      *error_msg = "Failed to create " + filename;
+      return false;
+    }
+    Header header = MakeHeader(oat_file, entries_.size());
+    if (!file->WriteFully(&header, sizeof(header)) ||
+        !file->WriteFully(entries_.data(), entries_.size() * sizeof(Entry))) {
+      *error_msg = "Failed to write " + filename;
+      file->Erase(/* unlink */ true);
+      return false;
+    }
+    if (file->FlushCloseOrErase() != 0) {
+      *error_msg = "Failed to flush and close " + filename;
+      return false;
+    }
+    return true;
+  }
+
+  // Loads an index saved for `oat_file`. Fails if the file was written for another oat file.
+  bool Load(const std::string& filename, const OatFile& oat_file, std::string* error_msg) {
+    std::unique_ptr<File> file(OS::OpenFileForReading(filename.c_str()));
+    if (file == nullptr) {
+      *error_msg = "Failed to open " + filename;
+      return false;
+    }
+    Header header;
+    if (!file->ReadFully(&header, sizeof(header))) {
+      *error_msg = "Failed to read the header of " + filename;
+      return false;
+    }
+    const Header expected = MakeHeader(oat_file, header.num_entries);
+    if (memcmp(&header, &expected, sizeof(header)) != 0) {
+      *error_msg = filename + " is not an index of " + oat_file.GetLocation();
+      return false;
+    }
+    if (file->GetLength() !=
+        static_cast<int64_t>(sizeof(header) + header.num_entries * sizeof(Entry))) {
+      *error_msg = filename + " has an unexpected size";
+      return false;
+    }
+    entries_.resize(header.num_entries);
+    if (!file->ReadFully(entries_.data(), entries_.size() * sizeof(Entry))) {
+      *error_msg = "Failed to read the entries of " + filename;
+      entries_.clear();
+      return false;
+    }
+    for (const Entry& entry : entries_) {
+      if (entry.oat_dex_file_index >= oat_file.GetOatDexFiles().size()) {
+        *error_msg = filename + " refers to a missing dex file";
+        entries_.clear();
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  struct Header {
+    uint8_t magic[4];
+    uint32_t version;
+    uint32_t oat_checksum;
+    uint32_t num_entries;
+    uint64_t oat_size;
+  };
+
+  static constexpr uint8_t kMagic[] = { 'o', 'c', 'i', '\n' };
+  static constexpr uint32_t kVersion = 1u;
+
+  static Header MakeHeader(const OatFile& oat_file, size_t num_entries) {
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.oat_checksum = oat_file.GetOatHeader().GetChecksum();
+    header.num_entries = dchecked_integral_cast<uint32_t>(num_entries);
+    header.oat_size = oat_file.Size();
+    return header;
+  }
+
+  std::vector<Entry> entries_;
+};
+
+constexpr uint8_t OatCodeIndex::kMagic[];
+
+// A --class-filter or --method-filter. By default the pattern matches any name containing it.
+// With --filter-syntax it can instead be a glob, which must match the whole name, or a POSIX
+// extended regular expression, which may match any part of the name. The pattern is compiled once
+// and matched against the names in the dex file string tables, before anything is decoded.
+class NameFilter {
+ public:
+  enum Syntax {
+    kSyntaxSubstring,
+    kSyntaxGlob,
+    kSyntaxRegex,
+  };
+
+  NameFilter() : syntax_(kSyntaxSubstring), regex_compiled_(false) {}
+
+  ~NameFilter() {
+    if (regex_compiled_) {
+      regfree(&regex_);
+    }
+  }
+
+  bool Init(const char* pattern, Syntax syntax, std::string* error_msg) {
+    CHECK(!regex_compiled_);
+    pattern_ = pattern;
+    syntax_ = syntax;
+    // Class names are matched in their descriptor form, where packages are separated by '/'.
+    // This is exact for substrings and globs, in which '.' only ever matches itself.
+    descriptor_pattern_ = pattern_;
+    std::replace(descriptor_pattern_.begin(), descriptor_pattern_.end(), '.', '/');
+    if (syntax_ == kSyntaxGlob) {
+      descriptor_pattern_ = "L" + descriptor_pattern_ + ";";
+    } else if (syntax_ == kSyntaxRegex && !pattern_.empty()) {
+      int result = regcomp(&regex_, pattern, REG_EXTENDED | REG_NOSUB);
+      if (result != 0) {
+        char buffer[256];
+        regerror(result, &regex_, buffer, sizeof(buffer));
+        *error_msg = StringPrintf("Invalid regular expression '%s': %s", pattern, buffer);
+        return false;
+      }
+      regex_compiled_ = true;
+    }
+    return true;
+  }
+
+  bool MatchesAll() const {
+    return pattern_.empty();
+  }
+
+  bool Matches(const char* name) const {
+    if (MatchesAll()) {
+      return true;
+    }
+    switch (syntax_) {
+      case kSyntaxSubstring:
+        return strstr(name, pattern_.c_str()) != nullptr;
+      case kSyntaxGlob:
+        return fnmatch(pattern_.c_str(), name, 0) == 0;
+      case kSyntaxRegex:
+        return regexec(&regex_, name, 0, nullptr, 0) == 0;
+    }
+    LOG(FATAL) << "Unexpected syntax " << static_cast<int>(syntax_);
+    UNREACHABLE();
+  }
+
+  // Matches the class named by `descriptor`, with a pattern written for dotted class names.
+  bool MatchesClass(const char* descriptor) const {
+    if (MatchesAll()) {
+      return true;
+    }
+    switch (syntax_) {
+      case kSyntaxSubstring: {
+        // Search between the leading 'L' and the trailing ';'.
+        const size_t length = strlen(descriptor);
+        DCHECK(length >= 2u && descriptor[0] == 'L' && descriptor[length - 1] == ';');
+        return StringPiece(descriptor + 1, length - 2u).find(descriptor_pattern_) !=
+            StringPiece::npos;
+      }
+      case kSyntaxGlob:
+        return fnmatch(descriptor_pattern_.c_str(), descriptor, 0) == 0;
+      case kSyntaxRegex:
+        // A regular expression may use '.' as a wildcard, so it needs the dotted name.
+        return Matches(DescriptorToDot(descriptor).c_str());
+    }
+    LOG(FATAL) << "Unexpected syntax " << static_cast<int>(syntax_);
+    UNREACHABLE();
+  }
+
+ private:
+  std::string pattern_;
+  std::string descriptor_pattern_;
+  Syntax syntax_;
+  regex_t regex_;
+  bool regex_compiled_;
+
+  DISALLOW_COPY_AND_ASSIGN(NameFilter);
+};
+
+enum class OatDumpOutputFormat {
+  kText,       // Human readable text.
+  kJsonLines,  // One JsonRecord per line.
+};
+
 class OatDumperOptions {
  public:
   OatDumperOptions(bool dump_vmap,
@@ -302,19 +675,26 @@ class OatDumperOptions {
                    bool absolute_addresses,
                    const char* class_filter,
                    const char* method_filter,
+                   NameFilter::Syntax filter_syntax,
                    bool list_classes,
                    bool list_methods,
                    bool dump_header_only,
                    const char* export_dex_location,
                    const char* app_image,
                    const char* app_oat,
-                   uint32_t addr2instr)
+                   const std::vector<uint32_t>& addr2instr,
+                   const char* addr2instr_index,
+                   size_t jobs,
+                   OatDumpOutputFormat output_format,
+                   bool image_stats_only,
+                   const ProfileCompilationInfo* profile)
     : dump_vmap_(dump_vmap),
       dump_code_info_stack_maps_(dump_code_info_stack_maps),
       disassemble_code_(disassemble_code),
       absolute_addresses_(absolute_addresses),
       class_filter_(class_filter),
       method_filter_(method_filter),
+      filter_syntax_(filter_syntax),
       list_classes_(list_classes),
       list_methods_(list_methods),
       dump_header_only_(dump_header_only),
@@ -322,6 +702,11 @@ class OatDumperOptions {
       app_image_(app_image),
       app_oat_(app_oat),
       addr2instr_(addr2instr),
+      addr2instr_index_(addr2instr_index),
+      jobs_(jobs),
+      output_format_(output_format),
+      image_stats_only_(image_stats_only),
+      profile_(profile),
       class_loader_(nullptr) {}
 
   const bool dump_vmap_;
@@ -330,49 +715,400 @@ class OatDumperOptions {
   const bool absolute_addresses_;
   const char* const class_filter_;
   const char* const method_filter_;
+  const NameFilter::Syntax filter_syntax_;
   const bool list_classes_;
   const bool list_methods_;
   const bool dump_header_only_;
   const char* const export_dex_location_;
   const char* const app_image_;
   const char* const app_oat_;
-  uint32_t addr2instr_;
+  const std::vector<uint32_t> addr2instr_;
+  const char* const addr2instr_index_;
+  const size_t jobs_;
+  const OatDumpOutputFormat output_format_;
+  const bool image_stats_only_;
+  // If not null, only the methods in the profile are dumped and analyzed.
+  const ProfileCompilationInfo* const profile_;
   Handle<mirror::ClassLoader>* class_loader_;
 };
 
+// Runs `fn` for every index in [0, num_tasks) on `jobs` threads, including the calling
+// one. With a runtime the work goes through a ThreadPool so that workers are attached, and
+// each task holds the mutator lock so that it can run the verifier and create handles; without
+// one the dumper only reads mapped data and plain threads suffice. The mutator lock is held by
+// the caller exactly when a runtime is present, which the static analysis cannot express.
+static void RunParallel(size_t jobs, size_t num_tasks, const std::function<void(size_t)>& fn)
+    NO_THREAD_SAFETY_ANALYSIS {
+  if (Runtime::Current() != nullptr) {
+    class FunctionTask FINAL : public Task {
+     public:
+      FunctionTask(const std::function<void(size_t)>* fn, size_t index)
+          : fn_(fn), index_(index) {}
+
+      void Run(Thread* self) OVERRIDE {
+        ScopedObjectAccess soa(self);
+        (*fn_)(index_);
+      }
+
+     private:
+      const std::function<void(size_t)>* const fn_;
+      const size_t index_;
+    };
+
+    Thread* self = Thread::Current();
+    // Workers need the mutator lock for verification, so do not hold it while waiting.
+    ScopedThreadSuspension sts(self, kNative);
+    ThreadPool thread_pool("oatdump thread pool", jobs - 1u);
+    std::vector<std::unique_ptr<FunctionTask>> tasks;
+    for (size_t i = 0; i != num_tasks; ++i) {
+      tasks.emplace_back(new FunctionTask(&fn, i));
+      thread_pool.AddTask(self, tasks.back().get());
+    }
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, /* do_work */ true, /* may_hold_locks */ false);
+  } else {
+    std::atomic<size_t> next_task(0u);
+    auto worker = [&]() {
+      for (size_t i = next_task++; i < num_tasks; i = next_task++) {
+        fn(i);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < jobs; ++i) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+}
+
 class OatDumper {
  public:
-  OatDumper(const OatFile& oat_file, const OatDumperOptions& options)
+  // Uses `disassembler`, if not null, instead of creating one. It must be for the instruction set
+  // of `oat_file` and is pointed at its code.
+  OatDumper(const OatFile& oat_file,
+            const OatDumperOptions& options,
+            Disassembler* disassembler = nullptr)
     : oat_file_(oat_file),
       oat_dex_files_(oat_file.GetOatDexFiles()),
       options_(options),
-      resolved_addr2instr_(0),
       instruction_set_(oat_file_.GetOatHeader().GetInstructionSet()),
-      disassembler_(Disassembler::Create(instruction_set_,
-                                         new DisassemblerOptions(
-                                             options_.absolute_addresses_,
-                                             oat_file.Begin(),
-                                             oat_file.End(),
-                                             true /* can_read_literals_ */,
-                                             Is64BitInstructionSet(instruction_set_)
-                                                 ? &Thread::DumpThreadOffset<PointerSize::k64>
-                                                 : &Thread::DumpThreadOffset<PointerSize::k32>))) {
+      owned_disassembler_((disassembler == nullptr) ? CreateDisassembler() : nullptr),
+      disassembler_((disassembler == nullptr) ? owned_disassembler_.get() : disassembler) {
+    if (disassembler != nullptr) {
+      disassembler->SetCodeRange(oat_file_.Begin(), oat_file_.End());
+    }
     CHECK(options_.class_loader_ != nullptr);
     CHECK(options_.class_filter_ != nullptr);
     CHECK(options_.method_filter_ != nullptr);
-    AddAllOffsets();
-  }
-
-  ~OatDumper() {
-    delete disassembler_;
+    std::string error_msg;
+    CHECK(class_filter_.Init(options_.class_filter_, options_.filter_syntax_, &error_msg))
+        << error_msg;
+    CHECK(method_filter_.Init(options_.method_filter_, options_.filter_syntax_, &error_msg))
+        << error_msg;
+    CHECK_GE(options_.jobs_, 1u);
   }
 
   InstructionSet GetInstructionSet() {
     return instruction_set_;
   }
 
+  // Hands over the disassembler created by this dumper so that it can be reused for other oat
+  // files. The dumper must not be used afterwards.
+  std::unique_ptr<Disassembler> ReleaseDisassembler() {
+    return std::move(owned_disassembler_);
+  }
+
   bool Dump(std::ostream& os) {
     bool success = true;
+
+    if (IsJsonOutput()) {
+      DumpOatHeaderRecord(os);
+    } else {
+      DumpOatHeader(os);
+    }
+
+    if (!options_.dump_header_only_) {
+      DumpDexFileData(os);
+      // The verifier dependencies are only available as text.
+      if (!IsJsonOutput() && !DumpVerifierDeps(os)) {
+        return false;
+      }
+      if (!options_.addr2instr_.empty()) {
+        if (!DumpAddresses(os)) {
+          success = false;
+        }
+      } else {
+        for (size_t i = 0; i < oat_dex_files_.size(); i++) {
+          const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
+          CHECK(oat_dex_file != nullptr);
+          if (!DumpOatDexFile(os, *oat_dex_file)) {
+            success = false;
+          }
+        }
+        if (options_.profile_ != nullptr) {
+          DumpProfileCoverage(os);
+        }
+      }
+    }
+
+    if (options_.export_dex_location_) {
+      if (!ExportDexFiles(os)) {
+        success = false;
+      }
+    }
+
+    const bool dump_code_layout = !options_.dump_header_only_ && options_.addr2instr_.empty();
+    if (IsJsonOutput()) {
+      stats_.DumpRecords(os);
+      if (dump_code_layout) {
+        DumpCodeLayout(os, nullptr);
+      }
+    } else {
+      os << "OAT FILE STATS:\n";
+      VariableIndentationOutputStream vios(&os);
+      stats_.Dump(vios);
+      if (dump_code_layout) {
+        DumpCodeLayout(os, &vios);
+      }
+    }
+
+    os << std::flush;
+    return success;
+  }
+
+  // Dumps the dex file overview. This reads all of the dex files, so it is skipped for header-only
+  // dumps.
+  void DumpDexFileData(std::ostream& os) {
+    DexFileData cumulative;
+    for (size_t i = 0; i < oat_dex_files_.size(); i++) {
+      const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
+      CHECK(oat_dex_file != nullptr);
+      std::string error_msg;
+      const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
+      if (dex_file == nullptr) {
+        if (IsJsonOutput()) {
+          JsonRecord("error")
+              .AddString("location", oat_dex_file->GetDexFileLocation())
+              .AddString("message", "Failed to open dex file: " + error_msg)
+              .Write(os);
+        } else {
+          os << "Failed to open dex file '" << oat_dex_file->GetDexFileLocation() << "': "
+             << error_msg;
+        }
+        continue;
+      }
+      DexFileData data(*dex_file);
+      if (IsJsonOutput()) {
+        JsonRecord record("dex_file_data");
+        record.AddString("location", dex_file->GetLocation());
+        data.AddTo(&record);
+        record.Write(os);
+      } else {
+        os << "Dex file data for " << dex_file->GetLocation() << "\n";
+        data.Dump(os);
+        os << "\n";
+      }
+      cumulative.Add(data);
+    }
+    if (IsJsonOutput()) {
+      JsonRecord record("cumulative_dex_file_data");
+      cumulative.AddTo(&record);
+      record.Write(os);
+    } else {
+      os << "Cumulative dex file data\n";
+      cumulative.Dump(os);
+      os << "\n";
+    }
+  }
+
+  // Compares the profile with the compiled code: hot methods left to the interpreter cost run
+  // time, compiled methods that are not hot cost space. The methods of startup classes are
+  // reported apart, as they run once during startup rather than often. Only methods with a code
+  // item that pass the class and method filters are counted.
+  void DumpProfileCoverage(std::ostream& os) {
+    if (!IsJsonOutput()) {
+      os << "PROFILE COVERAGE:\n";
+    }
+    for (const OatFile::OatDexFile* oat_dex_file : oat_dex_files_) {
+      std::string error_msg;
+      const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
+      if (dex_file == nullptr) {
+        continue;
+      }
+      size_t profiled_compiled = 0u;
+      size_t compiled_not_profiled = 0u;
+      size_t compiled_not_profiled_code_bytes = 0u;
+      std::vector<uint32_t> profiled_interpreted;
+      size_t startup_classes = 0u;
+      size_t startup_methods = 0u;
+      size_t startup_compiled = 0u;
+      for (uint32_t class_def_index : GetFilteredClassDefs(*dex_file)) {
+        const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(class_def_index);
+        const DexFile::ClassDef& class_def = dex_file->GetClassDef(class_def_index);
+        const bool startup = IsStartupClass(*dex_file, class_def.class_idx_);
+        if (startup) {
+          ++startup_classes;
+        }
+        ForEachMethod(*dex_file,
+                      class_def,
+                      [&](uint32_t class_method_index, const ClassDataItemIterator& it) {
+          const uint32_t dex_method_idx = it.GetMemberIndex();
+          if (it.GetMethodCodeItem() == nullptr ||
+              !method_filter_.Matches(
+                  dex_file->GetMethodName(dex_file->GetMethodId(dex_method_idx)))) {
+            return;
+          }
+          const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_method_index);
+          const bool compiled = oat_method.GetQuickCode() != nullptr;
+          const bool profiled = IsHotMethod(*dex_file, dex_method_idx);
+          if (startup) {
+            ++startup_methods;
+            if (compiled) {
+              ++startup_compiled;
+            }
+          }
+          if (profiled && compiled) {
+            ++profiled_compiled;
+          } else if (profiled) {
+            profiled_interpreted.push_back(dex_method_idx);
+          } else if (compiled) {
+            ++compiled_not_profiled;
+            compiled_not_profiled_code_bytes += oat_method.GetQuickCodeSize();
+          }
+        });
+      }
+      if (IsJsonOutput()) {
+        JsonRecord("profile_coverage")
+            .AddString("location", dex_file->GetLocation())
+            .AddUint("profiled_compiled", profiled_compiled)
+            .AddUint("profiled_interpreted", profiled_interpreted.size())
+            .AddUint("compiled_not_profiled", compiled_not_profiled)
+            .AddUint("compiled_not_profiled_code_bytes", compiled_not_profiled_code_bytes)
+            .AddUint("startup_classes", startup_classes)
+            .AddUint("startup_methods", startup_methods)
+            .AddUint("startup_compiled", startup_compiled)
+            .Write(os);
+        for (uint32_t dex_method_idx : profiled_interpreted) {
+          JsonRecord("profiled_interpreted_method")
+              .AddString("location", dex_file->GetLocation())
+              .AddString("method", dex_file->PrettyMethod(dex_method_idx, true))
+              .Write(os);
+        }
+      } else {
+        os << StringPrintf("  %s: profiled %zu (compiled %zu, interpreted %zu), "
+                           "compiled but not profiled %zu (%zu code bytes)\n",
+                           dex_file->GetLocation().c_str(),
+                           profiled_compiled + profiled_interpreted.size(),
+                           profiled_compiled,
+                           profiled_interpreted.size(),
+                           compiled_not_profiled,
+                           compiled_not_profiled_code_bytes);
+        os << StringPrintf("    startup classes %zu with %zu methods (compiled %zu)\n",
+                           startup_classes,
+                           startup_methods,
+                           startup_compiled);
+        for (uint32_t dex_method_idx : profiled_interpreted) {
+          os << "    interpreted: " << dex_file->PrettyMethod(dex_method_idx, true) << "\n";
+        }
+      }
+    }
+    if (!IsJsonOutput()) {
+      os << "\n";
+    }
+    os << std::flush;
+  }
+
+  // Reports how many pages the code of the methods accepted by the filters and the profile
+  // touches, compared to the minimum if that code was laid out contiguously. With a profile of the
+  // startup methods, this measures the i-TLB and page fault cost that method ordering can save.
+  // Deduplicated code is counted once. Writes a code_layout record if `vios` is null.
+  void DumpCodeLayout(std::ostream& os, VariableIndentationOutputStream* vios) {
+    std::unordered_set<uint32_t> seen_code_offsets;
+    std::set<size_t> pages;
+    size_t num_methods = 0u;
+    size_t code_bytes = 0u;
+    for (const OatFile::OatDexFile* oat_dex_file : oat_dex_files_) {
+      std::string error_msg;
+      const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
+      if (dex_file == nullptr) {
+        continue;
+      }
+      for (uint32_t class_def_index : GetFilteredClassDefs(*dex_file)) {
+        const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(class_def_index);
+        ForEachMethod(*dex_file,
+                      dex_file->GetClassDef(class_def_index),
+                      [&](uint32_t class_method_index, const ClassDataItemIterator& it) {
+          if (!MatchesMethod(*dex_file, it.GetMemberIndex())) {
+            return;
+          }
+          const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_method_index);
+          if (oat_method.GetQuickCode() == nullptr ||
+              oat_method.GetOatQuickMethodHeaderOffset() > oat_file_.Size() ||
+              !seen_code_offsets.insert(oat_method.GetCodeOffset()).second) {
+            return;
+          }
+          // The method header is read on entry, so it counts as code.
+          const size_t begin = oat_method.GetOatQuickMethodHeaderOffset();
+          const size_t size = sizeof(OatQuickMethodHeader) + oat_method.GetQuickCodeSize();
+          for (size_t page = begin / kPageSize; page <= (begin + size - 1u) / kPageSize; ++page) {
+            pages.insert(page);
+          }
+          ++num_methods;
+          code_bytes += size;
+        });
+      }
+    }
+
+    // Runs of consecutive pages, i.e. the number of separate page ranges that are touched.
+    size_t num_runs = 0u;
+    size_t previous_page = 0u;
+    for (size_t page : pages) {
+      if (num_runs == 0u || page != previous_page + 1u) {
+        ++num_runs;
+      }
+      previous_page = page;
+    }
+    const size_t ideal_pages = RoundUp(code_bytes, kPageSize) / kPageSize;
+    const size_t executable_offset = oat_file_.GetOatHeader().GetExecutableOffset();
+    const size_t executable_pages =
+        RoundUp(oat_file_.Size() - std::min(executable_offset, oat_file_.Size()), kPageSize) /
+        kPageSize;
+    if (vios == nullptr) {
+      JsonRecord("code_layout")
+          .AddBool("profiled_only", options_.profile_ != nullptr)
+          .AddUint("page_size", kPageSize)
+          .AddUint("methods", num_methods)
+          .AddUint("code_bytes", code_bytes)
+          .AddUint("pages", pages.size())
+          .AddUint("page_runs", num_runs)
+          .AddUint("ideal_pages", ideal_pages)
+          .AddUint("executable_pages", executable_pages)
+          .Write(os);
+      return;
+    }
+    vios->Stream() << StringPrintf("Code layout of the %s methods, %zu-byte pages:\n",
+                                   options_.profile_ != nullptr ? "profiled" : "compiled",
+                                   kPageSize);
+    ScopedIndentation indent1(vios);
+    vios->Stream() << StringPrintf("methods = %zu with %zu bytes of code\n",
+                                   num_methods,
+                                   code_bytes);
+    vios->Stream() << StringPrintf("pages   = %zu of %zu executable pages, in %zu runs\n",
+                                   pages.size(),
+                                   executable_pages,
+                                   num_runs);
+    if (ideal_pages != 0u) {
+      vios->Stream() << StringPrintf("ideal   = %zu pages (%.2fx), %.0f%% of touched bytes used\n",
+                                     ideal_pages,
+                                     static_cast<double>(pages.size()) / ideal_pages,
+                                     100.0 * code_bytes / (pages.size() * kPageSize));
+    }
+  }
+
+  void DumpOatHeader(std::ostream& os) {
     const OatHeader& oat_header = oat_file_.GetOatHeader();
 
     os << "MAGIC:\n";
@@ -459,128 +1195,80 @@ class OatDumper {
     os << oat_file_.Size() << "\n\n";
 
     os << std::flush;
+  }
 
-    // If set, adjust relative address to be searched
-    if (options_.addr2instr_ != 0) {
-      resolved_addr2instr_ = options_.addr2instr_ + oat_header.GetExecutableOffset();
-      os << "SEARCH ADDRESS (executable offset + input):\n";
-      os << StringPrintf("0x%08x\n\n", resolved_addr2instr_);
+  void DumpOatHeaderRecord(std::ostream& os) {
+    const OatHeader& oat_header = oat_file_.GetOatHeader();
+    std::unique_ptr<const InstructionSetFeatures> features(
+        InstructionSetFeatures::FromBitmap(oat_header.GetInstructionSet(),
+                                           oat_header.GetInstructionSetFeaturesBitmap()));
+    JsonRecord record("oat_header");
+    record.AddString("magic", oat_header.GetMagic())
+        .AddString("location", oat_file_.GetLocation())
+        .AddUint("checksum", oat_header.GetChecksum())
+        .AddString("instruction_set", GetInstructionSetString(oat_header.GetInstructionSet()))
+        .AddString("instruction_set_features", features->GetFeatureString())
+        .AddUint("dex_file_count", oat_header.GetDexFileCount())
+        .AddUint("executable_offset", oat_header.GetExecutableOffset())
+        .AddUint("interpreter_to_interpreter_bridge_offset",
+                 oat_header.GetInterpreterToInterpreterBridgeOffset())
+        .AddUint("interpreter_to_compiled_code_bridge_offset",
+                 oat_header.GetInterpreterToCompiledCodeBridgeOffset())
+        .AddUint("jni_dlsym_lookup_offset", oat_header.GetJniDlsymLookupOffset())
+        .AddUint("quick_generic_jni_trampoline_offset",
+                 oat_header.GetQuickGenericJniTrampolineOffset())
+        .AddUint("quick_imt_conflict_trampoline_offset",
+                 oat_header.GetQuickImtConflictTrampolineOffset())
+        .AddUint("quick_resolution_trampoline_offset",
+                 oat_header.GetQuickResolutionTrampolineOffset())
+        .AddUint("quick_to_interpreter_bridge_offset",
+                 oat_header.GetQuickToInterpreterBridgeOffset())
+        .AddInt("image_patch_delta", oat_header.GetImagePatchDelta())
+        .AddUint("image_file_location_oat_checksum",
+                 oat_header.GetImageFileLocationOatChecksum())
+        .AddUint("image_file_location_oat_begin",
+                 oat_header.GetImageFileLocationOatDataBegin())
+        .AddUint("size", oat_file_.Size());
+    record.Write(os);
+
+    size_t index = 0;
+    const char* key;
+    const char* value;
+    while (oat_header.GetStoreKeyValuePairByIndex(index, &key, &value)) {
+      JsonRecord("oat_header_key_value").AddString("key", key).AddString("value", value).Write(os);
+      index++;
     }
+    os << std::flush;
+  }
 
-    // Dumping the dex file overview is compact enough to do even if header only.
-    DexFileData cumulative;
-    for (size_t i = 0; i < oat_dex_files_.size(); i++) {
-      const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
-      CHECK(oat_dex_file != nullptr);
+  bool DumpVerifierDeps(std::ostream& os) {
+    VariableIndentationOutputStream vios(&os);
+    VdexFile::Header vdex_header = oat_file_.GetVdexFile()->GetHeader();
+    if (vdex_header.IsValid()) {
       std::string error_msg;
-      const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
-      if (dex_file == nullptr) {
-        os << "Failed to open dex file '" << oat_dex_file->GetDexFileLocation() << "': "
-           << error_msg;
-        continue;
-      }
-      DexFileData data(*dex_file);
-      os << "Dex file data for " << dex_file->GetLocation() << "\n";
-      data.Dump(os);
-      os << "\n";
-      cumulative.Add(data);
-    }
-    os << "Cumulative dex file data\n";
-    cumulative.Dump(os);
-    os << "\n";
-
-    if (!options_.dump_header_only_) {
-      VariableIndentationOutputStream vios(&os);
-      VdexFile::Header vdex_header = oat_file_.GetVdexFile()->GetHeader();
-      if (vdex_header.IsValid()) {
-        std::string error_msg;
-        std::vector<const DexFile*> dex_files;
-        for (size_t i = 0; i < oat_dex_files_.size(); i++) {
-          const DexFile* dex_file = OpenDexFile(oat_dex_files_[i], &error_msg);
-          if (dex_file == nullptr) {
-            os << "Error opening dex file: " << error_msg << std::endl;
-            return false;
-          }
-          dex_files.push_back(dex_file);
-        }
-        verifier::VerifierDeps deps(dex_files, oat_file_.GetVdexFile()->GetVerifierDepsData());
-        deps.Dump(&vios);
-      } else {
-        os << "UNRECOGNIZED vdex file, magic "
-           << vdex_header.GetMagic()
-           << ", version "
-           << vdex_header.GetVersion()
-           << "\n";
-      }
+      std::vector<const DexFile*> dex_files;
       for (size_t i = 0; i < oat_dex_files_.size(); i++) {
-        const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
-        CHECK(oat_dex_file != nullptr);
-        if (!DumpOatDexFile(os, *oat_dex_file)) {
-          success = false;
-        }
-      }
-    }
-
-    if (options_.export_dex_location_) {
-      if (kIsVdexEnabled) {
-        std::string error_msg;
-        std::string vdex_filename = GetVdexFilename(oat_file_.GetLocation());
-        if (!OS::FileExists(vdex_filename.c_str())) {
-          os << "File " << vdex_filename.c_str() << " does not exist\n";
-          return false;
-        }
-
-        std::unique_ptr<VdexFile> vdex = VdexFile::Open(vdex_filename,
-                                                        /* writable */ false,
-                                                        /* low_4gb */ false,
-                                                        /* unquicken */ true,
-                                                        /* decompile_return_instruction */ true,
-                                                        &error_msg);
-        if (vdex.get() == nullptr) {
-          os << "Failed to load vdex file '" << vdex_filename.c_str() << "': "
-             << error_msg << "\n";
+        const DexFile* dex_file = OpenDexFile(oat_dex_files_[i], &error_msg);
+        if (dex_file == nullptr) {
+          os << "Error opening dex file: " << error_msg << std::endl;
           return false;
         }
-
-        std::vector<std::unique_ptr<const DexFile>> unique_ptr_dex_files;
-        if (!vdex->OpenAllDexFiles(&unique_ptr_dex_files, &error_msg)) {
-          os << "Failed to open dex files from vdex:  " << error_msg << "\n";
-          return false;
-        }
-        if (oat_dex_files_.size() != unique_ptr_dex_files.size()) {
-          os << "Unexpected number of dex files\n";
-          return false;
-        }
-
-        size_t i = 0;
-        for (const auto& dex_file : unique_ptr_dex_files) {
-          const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
-          CHECK(oat_dex_file != nullptr);
-          CHECK(dex_file != nullptr);
-          if (!ExportDexFile(os, *oat_dex_file, dex_file.get())) {
-            success = false;
-          }
-          i++;
-        }
-      } else {
-        for (size_t i = 0; i < oat_dex_files_.size(); i++) {
-          const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
-          CHECK(oat_dex_file != nullptr);
-          if (!ExportDexFile(os, *oat_dex_file, nullptr)) {
-            success = false;
-          }
-        }
+        dex_files.push_back(dex_file);
       }
+      verifier::VerifierDeps deps(dex_files, oat_file_.GetVdexFile()->GetVerifierDepsData());
+      deps.Dump(&vios);
+    } else {
+      os << "UNRECOGNIZED vdex file, magic "
+         << vdex_header.GetMagic()
+         << ", version "
+         << vdex_header.GetVersion()
+         << "\n";
     }
+    return true;
+  }
 
-    {
-      os << "OAT FILE STATS:\n";
-      VariableIndentationOutputStream vios(&os);
-      stats_.Dump(vios);
-    }
-
-    os << std::flush;
-    return success;
+  bool IsJsonOutput() const {
+    return options_.output_format_ == OatDumpOutputFormat::kJsonLines;
   }
 
   size_t ComputeSize(const void* oat_data) {
@@ -588,6 +1276,10 @@ class OatDumper {
         reinterpret_cast<const uint8_t*>(oat_data) > oat_file_.End()) {
       return 0;  // Address not in oat file
     }
+    if (offsets_.empty()) {
+      // Only image dumps need the offsets, and they need those of all methods.
+      AddAllOffsets();
+    }
     uintptr_t begin_offset = reinterpret_cast<uintptr_t>(oat_data) -
                              reinterpret_cast<uintptr_t>(oat_file_.Begin());
     auto it = offsets_.upper_bound(begin_offset);
@@ -624,6 +1316,108 @@ class OatDumper {
     return nullptr;
   }
 
+  // Resolves `pc`, relative to the executable offset like --addr2instr, to the method containing
+  // it. For optimized code, also resolves the dex pc of the closest stack map at or before `pc` and
+  // the chain of methods inlined there, innermost first. Nothing is disassembled.
+  bool SymbolizePc(std::ostream& os, uint32_t pc) {
+    const uint32_t address = pc + oat_file_.GetOatHeader().GetExecutableOffset();
+    const OatCodeIndex::Entry* entry = GetCodeIndex().Lookup(address);
+    JsonRecord record("pc");
+    record.AddString("oat", oat_file_.GetLocation()).AddUint("pc", pc);
+    if (entry == nullptr) {
+      if (IsJsonOutput()) {
+        record.AddBool("found", false).Write(os);
+      } else {
+        os << StringPrintf("0x%08x: NOT FOUND\n", pc);
+      }
+      return true;
+    }
+    const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[entry->oat_dex_file_index];
+    std::string error_msg;
+    const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
+    if (dex_file == nullptr) {
+      if (IsJsonOutput()) {
+        record.AddBool("found", false).AddString("error", error_msg).Write(os);
+      } else {
+        os << StringPrintf("0x%08x: NOT FOUND: %s\n", pc, error_msg.c_str());
+      }
+      return false;
+    }
+    const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(entry->class_def_index);
+    const OatFile::OatMethod oat_method = oat_class.GetOatMethod(entry->class_method_index);
+    const uint32_t native_pc_offset = address - entry->code_begin;
+
+    // Frames, innermost first, as (dex method index, dex pc) pairs.
+    std::vector<std::pair<uint32_t, uint32_t>> frames;
+    frames.emplace_back(entry->dex_method_idx, DexFile::kDexNoIndex);
+    // Only the optimizing compiler emits a vmap table along with the code.
+    if (oat_method.GetVmapTable() != nullptr) {
+      CodeInfo code_info(oat_method.GetVmapTable());
+      CodeInfoEncoding encoding = code_info.ExtractEncoding();
+      const StackMapEncoding& stack_map_encoding = encoding.stack_map.encoding;
+      StackMap closest;
+      uint32_t closest_native_pc = 0u;
+      for (size_t i = 0, e = code_info.GetNumberOfStackMaps(encoding); i != e; ++i) {
+        StackMap stack_map = code_info.GetStackMapAt(i, encoding);
+        uint32_t native_pc = stack_map.GetNativePcOffset(stack_map_encoding, instruction_set_);
+        if (native_pc <= native_pc_offset &&
+            (!closest.IsValid() || native_pc > closest_native_pc)) {
+          closest = stack_map;
+          closest_native_pc = native_pc;
+        }
+      }
+      if (closest.IsValid()) {
+        frames.back().second = closest.GetDexPc(stack_map_encoding);
+        if (closest.HasInlineInfo(stack_map_encoding)) {
+          MethodInfo method_info(oat_method.GetOatQuickMethodHeader()->GetOptimizedMethodInfo());
+          InlineInfo inline_info = code_info.GetInlineInfoOf(closest, encoding);
+          const InlineInfoEncoding& inline_encoding = encoding.inline_info.encoding;
+          for (uint32_t depth = 0; depth != inline_info.GetDepth(inline_encoding); ++depth) {
+            frames.emplace_back(
+                inline_info.EncodesArtMethodAtDepth(inline_encoding, depth)
+                    ? DexFile::kDexNoIndex
+                    : inline_info.GetMethodIndexAtDepth(inline_encoding, method_info, depth),
+                inline_info.GetDexPcAtDepth(inline_encoding, depth));
+          }
+          std::reverse(frames.begin(), frames.end());
+        }
+      }
+    }
+
+    if (IsJsonOutput()) {
+      std::vector<uint32_t> method_indexes;
+      std::vector<std::string> methods;
+      std::vector<uint32_t> dex_pcs;
+      for (const std::pair<uint32_t, uint32_t>& frame : frames) {
+        method_indexes.push_back(frame.first);
+        methods.push_back(GetFrameMethodName(*dex_file, frame.first));
+        dex_pcs.push_back(frame.second);
+      }
+      record.AddBool("found", true)
+          .AddString("location", oat_dex_file->GetDexFileLocation())
+          .AddUint("code_offset", entry->code_begin)
+          .AddUint("native_pc_offset", native_pc_offset)
+          .AddStringArray("frame_methods", methods)
+          .AddUintArray("frame_method_idx", method_indexes)
+          .AddUintArray("frame_dex_pcs", dex_pcs)
+          .Write(os);
+    } else {
+      os << StringPrintf("0x%08x: %s (code_offset=0x%08x native_pc_offset=0x%x)\n",
+                         pc,
+                         oat_dex_file->GetDexFileLocation().c_str(),
+                         entry->code_begin,
+                         native_pc_offset);
+      for (size_t i = 0; i != frames.size(); ++i) {
+        os << StringPrintf("  #%zu %s", i, GetFrameMethodName(*dex_file, frames[i].first).c_str());
+        if (frames[i].second != DexFile::kDexNoIndex) {
+          os << StringPrintf(" dex_pc=0x%x", frames[i].second);
+        }
+        os << (i + 1u != frames.size() ? " (inlined)\n" : "\n");
+      }
+    }
+    return true;
+  }
+
   struct Stats {
     enum ByteKind {
       kByteKindCode,
@@ -657,9 +1451,15 @@ class OatDumper {
     // deduplicated code and tables.
     std::unordered_set<const void*> seen;
 
+    Stats() : parent_(nullptr) {}
+
+    // Stats for one shard of a parallel dump. Deduplication goes through the parent's seen set so
+    // that code shared between shards is only accounted once when the shards are merged.
+    explicit Stats(Stats* parent) : parent_(parent) {}
+
     // Returns true if it was newly added.
     bool AddBitsIfUnique(ByteKind kind, int64_t count, const void* address) {
-      if (seen.insert(address).second == true) {
+      if (MarkSeen(address)) {
         // True means the address was not already in the set.
         AddBits(kind, count);
         return true;
@@ -671,6 +1471,12 @@ class OatDumper {
       bits[kind] += count;
     }
 
+    void Merge(const Stats& other) {
+      for (size_t i = 0; i < kByteKindCount; ++i) {
+        bits[i] += other.bits[i];
+      }
+    }
+
     void Dump(VariableIndentationOutputStream& os) {
       const int64_t sum = std::accumulate(bits, bits + kByteKindCount, 0u);
       os.Stream() << "Dumping cumulative use of " << sum / kBitsPerByte << " accounted bytes\n";
@@ -758,7 +1564,51 @@ class OatDumper {
       os.Stream() << "\n" << std::flush;
     }
 
+    void DumpRecords(std::ostream& os) const {
+      for (size_t i = 0; i < kByteKindCount; ++i) {
+        JsonRecord("stats")
+            .AddString("kind", GetByteKindName(static_cast<ByteKind>(i)))
+            .AddInt("bytes", bits[i] / kBitsPerByte)
+            .Write(os);
+      }
+    }
+
+    static const char* GetByteKindName(ByteKind kind) {
+      switch (kind) {
+        case kByteKindCode: return "Code";
+        case kByteKindQuickMethodHeader: return "QuickMethodHeader";
+        case kByteKindCodeInfoLocationCatalog: return "CodeInfoLocationCatalog";
+        case kByteKindCodeInfoDexRegisterMap: return "CodeInfoDexRegisterMap";
+        case kByteKindCodeInfoEncoding: return "CodeInfoEncoding";
+        case kByteKindCodeInfoInvokeInfo: return "CodeInfoInvokeInfo";
+        case kByteKindCodeInfoStackMasks: return "CodeInfoStackMasks";
+        case kByteKindCodeInfoRegisterMasks: return "CodeInfoRegisterMasks";
+        case kByteKindStackMapNativePc: return "StackMapNativePc";
+        case kByteKindStackMapDexPc: return "StackMapDexPc";
+        case kByteKindStackMapDexRegisterMap: return "StackMapDexRegisterMap";
+        case kByteKindStackMapInlineInfoIndex: return "StackMapInlineInfoIndex";
+        case kByteKindStackMapRegisterMaskIndex: return "StackMapRegisterMaskIndex";
+        case kByteKindStackMapStackMaskIndex: return "StackMapStackMaskIndex";
+        case kByteKindInlineInfoMethodIndexIdx: return "InlineInfoMethodIndexIdx";
+        case kByteKindInlineInfoDexPc: return "InlineInfoDexPc";
+        case kByteKindInlineInfoExtraData: return "InlineInfoExtraData";
+        case kByteKindInlineInfoDexRegisterMap: return "InlineInfoDexRegisterMap";
+        case kByteKindInlineInfoIsLast: return "InlineInfoIsLast";
+        case kByteKindCount: break;
+      }
+      LOG(FATAL) << "Unexpected byte kind " << static_cast<int>(kind);
+      UNREACHABLE();
+    }
+
    private:
+    bool MarkSeen(const void* address) {
+      if (parent_ != nullptr) {
+        return parent_->MarkSeen(address);
+      }
+      std::lock_guard<std::mutex> lock(seen_lock_);
+      return seen.insert(address).second;
+    }
+
     void Dump(VariableIndentationOutputStream& os,
               const char* name,
               int64_t size,
@@ -771,8 +1621,80 @@ class OatDumper {
                                   percent,
                                   sum_of);
     }
+
+    Stats* const parent_;
+    std::mutex seen_lock_;
+
+    DISALLOW_COPY_AND_ASSIGN(Stats);
   };
 
+  // Sizes of the compiled code and metadata of one method, compared by --diff.
+  struct MethodSizes {
+    // Pretty method with signature.
+    std::string name;
+    int64_t bits[Stats::kByteKindCount] = {};
+    size_t num_stack_maps = 0u;
+    size_t num_inline_infos = 0u;
+    // Whether the code is shared with a method collected before this one.
+    bool deduped = false;
+  };
+
+  // A method of the dex files of an oat file: its dex location and dex method index. A class
+  // may be defined in several dex files of a multidex oat file, so the name is not enough.
+  typedef std::pair<std::string, uint32_t> MethodKey;
+
+  // Collects the sizes of the compiled methods accepted by the class and method filters, keyed
+  // so that methods can be matched across oat files compiled from the same dex files. Nothing is
+  // disassembled.
+  void CollectMethodSizes(std::map<MethodKey, MethodSizes>* sizes) {
+    std::unordered_set<uint32_t> seen_code_offsets;
+    for (const OatFile::OatDexFile* oat_dex_file : oat_dex_files_) {
+      CHECK(oat_dex_file != nullptr);
+      std::string error_msg;
+      const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
+      if (dex_file == nullptr) {
+        LOG(WARNING) << "Failed to open dex file '" << oat_dex_file->GetDexFileLocation()
+            << "': " << error_msg;
+        continue;
+      }
+      for (uint32_t class_def_index : GetFilteredClassDefs(*dex_file)) {
+        const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(class_def_index);
+        ForEachMethod(*dex_file,
+                      dex_file->GetClassDef(class_def_index),
+                      [&](uint32_t class_method_index, const ClassDataItemIterator& it) {
+          const uint32_t dex_method_idx = it.GetMemberIndex();
+          if (!MatchesMethod(*dex_file, dex_method_idx)) {
+            return;
+          }
+          const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_method_index);
+          const OatQuickMethodHeader* method_header = oat_method.GetOatQuickMethodHeader();
+          if (oat_method.GetQuickCode() == nullptr ||
+              method_header == nullptr ||
+              oat_method.GetOatQuickMethodHeaderOffset() > oat_file_.Size()) {
+            return;
+          }
+          MethodSizes method_sizes;
+          method_sizes.name = dex_file->PrettyMethod(dex_method_idx, true);
+          method_sizes.deduped = !seen_code_offsets.insert(oat_method.GetCodeOffset()).second;
+          Stats stats;
+          stats.AddBits(Stats::kByteKindQuickMethodHeader, sizeof(*method_header) * kBitsPerByte);
+          stats.AddBits(Stats::kByteKindCode, oat_method.GetQuickCodeSize() * kBitsPerByte);
+          const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
+          if (IsMethodGeneratedByOptimizingCompiler(oat_method, code_item)) {
+            CodeInfo code_info(oat_method.GetVmapTable());
+            CodeInfoEncoding encoding = code_info.ExtractEncoding();
+            AddCodeInfoStats(&stats, oat_method, code_item, code_info, encoding);
+            method_sizes.num_stack_maps = encoding.stack_map.num_entries;
+            method_sizes.num_inline_infos = encoding.inline_info.num_entries;
+          }
+          std::copy(stats.bits, stats.bits + Stats::kByteKindCount, method_sizes.bits);
+          sizes->emplace(MethodKey(oat_dex_file->GetDexFileLocation(), dex_method_idx),
+                         std::move(method_sizes));
+        });
+      }
+    }
+  }
+
  private:
   void AddAllOffsets() {
     // We don't know the length of the code for each method, but we need to know where to stop
@@ -795,20 +1717,12 @@ class OatDumper {
            class_def_index++) {
         const DexFile::ClassDef& class_def = dex_file->GetClassDef(class_def_index);
         const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(class_def_index);
-        const uint8_t* class_data = dex_file->GetClassData(class_def);
-        if (class_data != nullptr) {
-          ClassDataItemIterator it(*dex_file, class_data);
-          SkipAllFields(it);
-          uint32_t class_method_index = 0;
-          while (it.HasNextDirectMethod()) {
-            AddOffsets(oat_class.GetOatMethod(class_method_index++));
-            it.Next();
-          }
-          while (it.HasNextVirtualMethod()) {
-            AddOffsets(oat_class.GetOatMethod(class_method_index++));
-            it.Next();
-          }
-        }
+        ForEachMethod(*dex_file,
+                      class_def,
+                      [&](uint32_t class_method_index,
+                          const ClassDataItemIterator& it ATTRIBUTE_UNUSED) {
+          AddOffsets(oat_class.GetOatMethod(class_method_index));
+        });
       }
     }
 
@@ -872,6 +1786,18 @@ class OatDumper {
       os << "Total number of dex code bytes: " << dex_code_bytes_ << "\n";
     }
 
+    void AddTo(JsonRecord* record) const {
+      record->AddUint("num_string_ids", num_string_ids_)
+          .AddUint("num_method_ids", num_method_ids_)
+          .AddUint("num_field_ids", num_field_ids_)
+          .AddUint("num_type_ids", num_type_ids_)
+          .AddUint("num_class_defs", num_class_defs_)
+          .AddUint("unique_strings_from_code", unique_string_ids_from_code_.size())
+          .AddUint("total_strings_from_code", num_string_ids_from_code_)
+          .AddUint("unique_dex_code_items", dex_code_item_ptrs_.size())
+          .AddUint("dex_code_bytes", dex_code_bytes_);
+    }
+
   private:
     // All of the elements from one container to another.
     template <typename Dest, typename Src>
@@ -880,21 +1806,12 @@ class OatDumper {
     }
 
     void WalkClass(const DexFile& dex_file, const DexFile::ClassDef& class_def) {
-      const uint8_t* class_data = dex_file.GetClassData(class_def);
-      if (class_data == nullptr) {  // empty class such as a marker interface?
-        return;
-      }
-      ClassDataItemIterator it(dex_file, class_data);
-      SkipAllFields(it);
-      while (it.HasNextDirectMethod()) {
+      ForEachMethod(dex_file,
+                    class_def,
+                    [&](uint32_t class_method_index ATTRIBUTE_UNUSED,
+                        const ClassDataItemIterator& it) {
         WalkCodeItem(dex_file, it.GetMethodCodeItem());
-        it.Next();
-      }
-      while (it.HasNextVirtualMethod()) {
-        WalkCodeItem(dex_file, it.GetMethodCodeItem());
-        it.Next();
-      }
-      DCHECK(!it.HasNext());
+      });
     }
 
     void WalkCodeItem(const DexFile& dex_file, const DexFile::CodeItem* code_item) {
@@ -953,12 +1870,181 @@ class OatDumper {
     size_t num_class_defs_ = 0;
   };
 
+  // Dumps the methods containing the addresses given with --addr2instr. The addresses are relative
+  // to the executable offset.
+  bool DumpAddresses(std::ostream& os) {
+    const OatCodeIndex& code_index = GetCodeIndex();
+    const uint32_t executable_offset = oat_file_.GetOatHeader().GetExecutableOffset();
+    VariableIndentationOutputStream vios(&os);
+    ClassDumpState state(&os, &stats_, disassembler_);
+    bool success = true;
+    for (uint32_t addr2instr : options_.addr2instr_) {
+      const uint32_t address = addr2instr + executable_offset;
+      const OatCodeIndex::Entry* entry = code_index.Lookup(address);
+      if (IsJsonOutput()) {
+        JsonRecord("search_address")
+            .AddUint("address", address)
+            .AddBool("found", entry != nullptr)
+            .Write(os);
+      } else {
+        os << "SEARCH ADDRESS (executable offset + input):\n";
+        os << StringPrintf("0x%08x\n", address);
+        if (entry == nullptr) {
+          os << "NOT FOUND\n";
+        }
+      }
+      if (entry != nullptr && !DumpIndexedMethod(&vios, &state, *entry)) {
+        success = false;
+      }
+      if (!IsJsonOutput()) {
+        os << "\n";
+      }
+    }
+    os << std::flush;
+    return success;
+  }
+
+  bool DumpIndexedMethod(VariableIndentationOutputStream* vios,
+                         ClassDumpState* state,
+                         const OatCodeIndex::Entry& entry) {
+    std::ostream& os = vios->Stream();
+    const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[entry.oat_dex_file_index];
+    std::string error_msg;
+    const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
+    if (dex_file == nullptr) {
+      os << "NOT FOUND: " << error_msg << "\n";
+      return false;
+    }
+    const DexFile::ClassDef& class_def = dex_file->GetClassDef(entry.class_def_index);
+    const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(entry.class_def_index);
+    if (!IsJsonOutput()) {
+      os << StringPrintf("location: %s\n", oat_dex_file->GetDexFileLocation().c_str());
+      os << StringPrintf("%u: %s\n",
+                         entry.class_def_index,
+                         dex_file->GetClassDescriptor(class_def));
+    }
+    ScopedIndentation indent1(vios);
+    bool found = false;
+    bool success = true;
+    ForEachMethod(*dex_file,
+                  class_def,
+                  [&](uint32_t class_method_index, const ClassDataItemIterator& it) {
+      if (class_method_index != entry.class_method_index) {
+        return;
+      }
+      CHECK_EQ(it.GetMemberIndex(), entry.dex_method_idx);
+      found = true;
+      success = DumpOatMethod(vios, state, class_def, class_method_index, oat_class, *dex_file,
+                              it.GetMemberIndex(), it.GetMethodCodeItem(),
+                              it.GetRawMemberAccessFlags());
+    });
+    CHECK(found) << "No method " << entry.class_method_index << " in class "
+                 << dex_file->GetClassDescriptor(class_def);
+    return success;
+  }
+
+  // Methods inlined from other dex files are encoded as ArtMethod* and cannot be named without
+  // the runtime.
+  static std::string GetFrameMethodName(const DexFile& dex_file, uint32_t dex_method_idx) {
+    return (dex_method_idx != DexFile::kDexNoIndex)
+        ? dex_file.PrettyMethod(dex_method_idx, true)
+        : "<unknown>";
+  }
+
+  // Returns the code index, loaded from --addr2instr-index if that holds the index of this oat
+  // file, or built otherwise. A newly built index is saved to --addr2instr-index for later runs.
+  const OatCodeIndex& GetCodeIndex() {
+    if (code_index_ != nullptr) {
+      return *code_index_;
+    }
+    code_index_.reset(new OatCodeIndex());
+    const char* index_filename = options_.addr2instr_index_;
+    std::string error_msg;
+    if (index_filename != nullptr && OS::FileExists(index_filename)) {
+      if (code_index_->Load(index_filename, oat_file_, &error_msg)) {
+        return *code_index_;
+      }
+      LOG(WARNING) << "Rebuilding code index: " << error_msg;
+    }
+    BuildCodeIndex(code_index_.get());
+    if (index_filename != nullptr && !code_index_->Save(index_filename, oat_file_, &error_msg)) {
+      LOG(WARNING) << "Failed to save code index: " << error_msg;
+    }
+    return *code_index_;
+  }
+
+  void BuildCodeIndex(OatCodeIndex* code_index) {
+    for (size_t i = 0; i < oat_dex_files_.size(); i++) {
+      const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
+      std::string error_msg;
+      const DexFile* const dex_file = OpenDexFile(oat_dex_file, &error_msg);
+      if (dex_file == nullptr) {
+        continue;  // Already reported with the dex file data.
+      }
+      for (size_t class_def_index = 0;
+           class_def_index < dex_file->NumClassDefs();
+           class_def_index++) {
+        const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(class_def_index);
+        ForEachMethod(*dex_file,
+                      dex_file->GetClassDef(class_def_index),
+                      [&](uint32_t class_method_index, const ClassDataItemIterator& it) {
+          const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_method_index);
+          const uint32_t code_begin = AlignCodeOffset(oat_method.GetCodeOffset());
+          // Skip methods without code and, in broken files, code past the end of the file.
+          if (code_begin == 0u || code_begin > oat_file_.Size()) {
+            return;
+          }
+          code_index->Add({code_begin,
+                           code_begin + oat_method.GetQuickCodeSize(),
+                           dchecked_integral_cast<uint32_t>(i),
+                           dchecked_integral_cast<uint32_t>(class_def_index),
+                           class_method_index,
+                           it.GetMemberIndex()});
+        });
+      }
+    }
+    code_index->Sort();
+  }
+
+  // The first dumped method using a piece of compiled code. Later methods sharing that code
+  // refer back to it instead of disassembling it again.
+  struct CodeOwner {
+    const DexFile* dex_file;
+    uint32_t dex_method_idx;
+  };
+
+  // Deduplication of the compiled code of the dumped methods of one dex file.
+  struct CodeDedupInfo {
+    size_t compiled_methods = 0u;
+    // Methods whose code is shared with a method dumped before them, possibly from an earlier
+    // dex file.
+    size_t deduped_methods = 0u;
+    uint64_t deduped_code_bytes = 0u;
+  };
+
   bool DumpOatDexFile(std::ostream& os, const OatFile::OatDexFile& oat_dex_file) {
     bool success = true;
-    bool stop_analysis = false;
-    os << "OatDexFile:\n";
-    os << StringPrintf("location: %s\n", oat_dex_file.GetDexFileLocation().c_str());
-    os << StringPrintf("checksum: 0x%08x\n", oat_dex_file.GetDexFileLocationChecksum());
+    // Create the dex file early. A lot of print-out things depend on it.
+    std::string error_msg;
+    const DexFile* const dex_file = OpenDexFile(&oat_dex_file, &error_msg);
+    std::vector<uint32_t> class_def_indexes;
+    CodeDedupInfo dedup_info;
+    if (dex_file != nullptr) {
+      class_def_indexes = GetDumpedClassDefs(*dex_file);
+      if (!options_.list_classes_ && !options_.list_methods_) {
+        dedup_info = CollectCodeOwners(oat_dex_file, *dex_file, class_def_indexes);
+      }
+    }
+
+    if (IsJsonOutput()) {
+      if (!DumpOatDexFileRecord(os, oat_dex_file, dex_file, error_msg, dedup_info)) {
+        return false;
+      }
+    } else {
+      os << "OatDexFile:\n";
+      os << StringPrintf("location: %s\n", oat_dex_file.GetDexFileLocation().c_str());
+      os << StringPrintf("checksum: 0x%08x\n", oat_dex_file.GetDexFileLocationChecksum());
+    }
 
     const uint8_t* const oat_file_begin = oat_dex_file.GetOatFile()->Begin();
     const uint8_t* const vdex_file_begin = oat_dex_file.GetOatFile()->DexBegin();
@@ -966,13 +2052,13 @@ class OatDumper {
     // Print data range of the dex file embedded inside the corresponding vdex file.
     const uint8_t* const dex_file_pointer = oat_dex_file.GetDexFilePointer();
     uint32_t dex_offset = dchecked_integral_cast<uint32_t>(dex_file_pointer - vdex_file_begin);
-    os << StringPrintf("dex-file: 0x%08x..0x%08x\n",
-                       dex_offset,
-                       dchecked_integral_cast<uint32_t>(dex_offset + oat_dex_file.FileSize() - 1));
+    if (!IsJsonOutput()) {
+      os << StringPrintf(
+          "dex-file: 0x%08x..0x%08x\n",
+          dex_offset,
+          dchecked_integral_cast<uint32_t>(dex_offset + oat_dex_file.FileSize() - 1));
+    }
 
-    // Create the dex file early. A lot of print-out things depend on it.
-    std::string error_msg;
-    const DexFile* const dex_file = OpenDexFile(&oat_dex_file, &error_msg);
     if (dex_file == nullptr) {
       os << "NOT FOUND: " << error_msg << "\n\n";
       os << std::flush;
@@ -980,7 +2066,7 @@ class OatDumper {
     }
 
     // Print lookup table, if it exists.
-    if (oat_dex_file.GetLookupTableData() != nullptr) {
+    if (oat_dex_file.GetLookupTableData() != nullptr && !IsJsonOutput()) {
       uint32_t table_offset = dchecked_integral_cast<uint32_t>(
           oat_dex_file.GetLookupTableData() - oat_file_begin);
       uint32_t table_size = TypeLookupTable::RawDataLength(dex_file->NumClassDefs());
@@ -989,38 +2075,401 @@ class OatDumper {
                          table_offset + table_size - 1);
     }
 
-    VariableIndentationOutputStream vios(&os);
-    ScopedIndentation indent1(&vios);
-    for (size_t class_def_index = 0;
-         class_def_index < dex_file->NumClassDefs();
-         class_def_index++) {
-      const DexFile::ClassDef& class_def = dex_file->GetClassDef(class_def_index);
-      const char* descriptor = dex_file->GetClassDescriptor(class_def);
+    if (!options_.list_classes_ && !options_.list_methods_ && !IsJsonOutput()) {
+      const size_t compiled_methods = std::max<size_t>(dedup_info.compiled_methods, 1u);
+      os << StringPrintf("code dedup: %zu of %zu compiled methods share code (%.0f%%), "
+                         "%" PRIu64 " bytes not duplicated\n",
+                         dedup_info.deduped_methods,
+                         dedup_info.compiled_methods,
+                         dedup_info.deduped_methods * 100.0 / compiled_methods,
+                         dedup_info.deduped_code_bytes);
+    }
 
-      // TODO: Support regex
-      if (DescriptorToDot(descriptor).find(options_.class_filter_) == std::string::npos) {
-        continue;
+    if (options_.jobs_ > 1u) {
+      if (!DumpOatClassDefsParallel(os, oat_dex_file, *dex_file, class_def_indexes)) {
+        success = false;
+      }
+    } else {
+      VariableIndentationOutputStream vios(&os);
+      ScopedIndentation indent1(&vios);
+      ClassDumpState state(&os, &stats_, disassembler_);
+      for (uint32_t class_def_index : class_def_indexes) {
+        if (!DumpOatClassDef(os, &vios, &state, oat_dex_file, *dex_file, class_def_index)) {
+          success = false;
+        }
       }
+    }
+    if (!IsJsonOutput()) {
+      os << "\n";
+    }
+    os << std::flush;
+    return success;
+  }
+
+  // Writes the record describing `oat_dex_file`. Returns false if the dex file could not be
+  // opened, in which case the record carries the error.
+  bool DumpOatDexFileRecord(std::ostream& os,
+                            const OatFile::OatDexFile& oat_dex_file,
+                            const DexFile* dex_file,
+                            const std::string& error_msg,
+                            const CodeDedupInfo& dedup_info) {
+    const uint8_t* const dex_file_pointer = oat_dex_file.GetDexFilePointer();
+    JsonRecord record("dex_file");
+    record.AddString("location", oat_dex_file.GetDexFileLocation())
+        .AddUint("checksum", oat_dex_file.GetDexFileLocationChecksum())
+        .AddUint("dex_file_offset", dex_file_pointer - oat_dex_file.GetOatFile()->DexBegin())
+        .AddUint("dex_file_size", oat_dex_file.FileSize());
+    if (dex_file == nullptr) {
+      record.AddString("error", error_msg).Write(os);
+      os << std::flush;
+      return false;
+    }
+    if (oat_dex_file.GetLookupTableData() != nullptr) {
+      record.AddUint("type_table_offset",
+                     oat_dex_file.GetLookupTableData() - oat_dex_file.GetOatFile()->Begin());
+      record.AddUint("type_table_size", TypeLookupTable::RawDataLength(dex_file->NumClassDefs()));
+    }
+    record.AddUint("class_def_count", dex_file->NumClassDefs());
+    if (dedup_info.compiled_methods != 0u) {
+      record.AddUint("compiled_methods", dedup_info.compiled_methods)
+          .AddUint("deduped_methods", dedup_info.deduped_methods)
+          .AddUint("deduped_code_bytes", dedup_info.deduped_code_bytes);
+    }
+    record.Write(os);
+    return true;
+  }
 
-      uint32_t oat_class_offset = oat_dex_file.GetOatClassOffset(class_def_index);
+  // Records the owner of the code of every method of `class_def_indexes` that passes the method
+  // filter, in dump order, so that the owners are the same for serial and parallel dumps. Only
+  // the method headers are read; nothing is disassembled.
+  CodeDedupInfo CollectCodeOwners(const OatFile::OatDexFile& oat_dex_file,
+                                  const DexFile& dex_file,
+                                  const std::vector<uint32_t>& class_def_indexes) {
+    CodeDedupInfo info;
+    for (uint32_t class_def_index : class_def_indexes) {
       const OatFile::OatClass oat_class = oat_dex_file.GetOatClass(class_def_index);
+      ForEachMethod(dex_file,
+                    dex_file.GetClassDef(class_def_index),
+                    [&](uint32_t class_method_index, const ClassDataItemIterator& it) {
+        const uint32_t dex_method_idx = it.GetMemberIndex();
+        if (!MatchesMethod(dex_file, dex_method_idx)) {
+          return;
+        }
+        const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_method_index);
+        if (oat_method.GetQuickCode() == nullptr ||
+            oat_method.GetOatQuickMethodHeaderOffset() > oat_file_.Size()) {
+          return;
+        }
+        ++info.compiled_methods;
+        auto inserted = code_owners_.emplace(oat_method.GetCodeOffset(),
+                                             CodeOwner { &dex_file, dex_method_idx });
+        if (!inserted.second) {
+          ++info.deduped_methods;
+          info.deduped_code_bytes += oat_method.GetQuickCodeSize();
+        }
+      });
+    }
+    return info;
+  }
+
+  // Returns the name of the method the code of `oat_method` was first dumped for, or an empty
+  // string if that is the given method itself or the code was not seen by CollectCodeOwners().
+  std::string GetCodeOwnerName(const OatFile::OatMethod& oat_method,
+                               const DexFile& dex_file,
+                               uint32_t dex_method_idx) const {
+    auto it = code_owners_.find(oat_method.GetCodeOffset());
+    if (it == code_owners_.end() ||
+        (it->second.dex_file == &dex_file && it->second.dex_method_idx == dex_method_idx)) {
+      return std::string();
+    }
+    return it->second.dex_file->PrettyMethod(it->second.dex_method_idx, true);
+  }
+
+  // State needed to dump the classes of a dex file. Neither the disassembler nor the stats are
+  // thread-safe, so each shard of a parallel dump gets its own.
+  struct ClassDumpState {
+    ClassDumpState(std::ostream* os_in, Stats* stats_in, Disassembler* disassembler_in)
+        : os(os_in), stats(stats_in), disassembler(disassembler_in) {}
+
+    // Unindented output, used for records.
+    std::ostream* const os;
+    Stats* const stats;
+    Disassembler* const disassembler;
+  };
+
+  // Returns whether the method passes the method filter and, with --profile, is a hot method or
+  // a method of a startup class.
+  bool MatchesMethod(const DexFile& dex_file, uint32_t dex_method_idx) const {
+    return method_filter_.Matches(dex_file.GetMethodName(dex_file.GetMethodId(dex_method_idx))) &&
+           (options_.profile_ == nullptr ||
+            IsHotMethod(dex_file, dex_method_idx) ||
+            IsStartupClass(dex_file, dex_file.GetMethodId(dex_method_idx).class_idx_));
+  }
+
+  // Returns whether --profile lists the method, i.e. it ran often enough to be recorded. The
+  // profile has no finer hotness than that.
+  bool IsHotMethod(const DexFile& dex_file, uint32_t dex_method_idx) const {
+    return options_.profile_ != nullptr &&
+           options_.profile_->ContainsMethod(MethodReference(&dex_file, dex_method_idx));
+  }
+
+  // Returns whether --profile lists the class, i.e. it was resolved during startup.
+  bool IsStartupClass(const DexFile& dex_file, dex::TypeIndex type_idx) const {
+    return options_.profile_ != nullptr && options_.profile_->ContainsClass(dex_file, type_idx);
+  }
+
+  // Returns whether the class has a method that IsHotMethod().
+  bool HasHotMethod(const DexFile& dex_file, const DexFile::ClassDef& class_def) const {
+    bool has_hot_method = false;
+    ForEachMethod(dex_file,
+                  class_def,
+                  [&](uint32_t class_method_index ATTRIBUTE_UNUSED,
+                      const ClassDataItemIterator& it) {
+      has_hot_method = has_hot_method || IsHotMethod(dex_file, it.GetMemberIndex());
+    });
+    return has_hot_method;
+  }
+
+  // Returns the indexes of the class defs accepted by the class filter. Only the type descriptors
+  // are looked at, so the classes filtered out cost next to nothing.
+  std::vector<uint32_t> GetFilteredClassDefs(const DexFile& dex_file) const {
+    std::vector<uint32_t> class_def_indexes;
+    class_def_indexes.reserve(class_filter_.MatchesAll() ? dex_file.NumClassDefs() : 0u);
+    for (uint32_t class_def_index = 0;
+         class_def_index != dex_file.NumClassDefs();
+         ++class_def_index) {
+      const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_index);
+      if (class_filter_.MatchesClass(dex_file.GetClassDescriptor(class_def))) {
+        class_def_indexes.push_back(class_def_index);
+      }
+    }
+    return class_def_indexes;
+  }
+
+  // Returns the indexes of the class defs to dump, in dump order: the GetFilteredClassDefs() or,
+  // with --profile, those that are startup classes followed by those with hot methods, so that the
+  // dump starts with what runs first.
+  std::vector<uint32_t> GetDumpedClassDefs(const DexFile& dex_file) const {
+    std::vector<uint32_t> class_def_indexes = GetFilteredClassDefs(dex_file);
+    if (options_.profile_ == nullptr) {
+      return class_def_indexes;
+    }
+    std::vector<uint32_t> startup_class_def_indexes;
+    std::vector<uint32_t> hot_class_def_indexes;
+    for (uint32_t class_def_index : class_def_indexes) {
+      const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_index);
+      if (IsStartupClass(dex_file, class_def.class_idx_)) {
+        startup_class_def_indexes.push_back(class_def_index);
+      } else if (HasHotMethod(dex_file, class_def)) {
+        hot_class_def_indexes.push_back(class_def_index);
+      }
+    }
+    startup_class_def_indexes.insert(startup_class_def_indexes.end(),
+                                     hot_class_def_indexes.begin(),
+                                     hot_class_def_indexes.end());
+    return startup_class_def_indexes;
+  }
+
+  bool DumpOatClassDef(std::ostream& os,
+                       VariableIndentationOutputStream* vios,
+                       ClassDumpState* state,
+                       const OatFile::OatDexFile& oat_dex_file,
+                       const DexFile& dex_file,
+                       size_t class_def_index) {
+    const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_index);
+    const char* descriptor = dex_file.GetClassDescriptor(class_def);
+    uint32_t oat_class_offset = oat_dex_file.GetOatClassOffset(class_def_index);
+    const OatFile::OatClass oat_class = oat_dex_file.GetOatClass(class_def_index);
+    if (IsJsonOutput()) {
+      std::ostringstream status;
+      status << oat_class.GetStatus();
+      std::ostringstream type;
+      type << oat_class.GetType();
+      JsonRecord("class")
+          .AddUint("class_def_index", class_def_index)
+          .AddString("descriptor", descriptor)
+          .AddUint("offset", oat_class_offset)
+          .AddUint("type_idx", class_def.class_idx_.index_)
+          .AddString("status", status.str())
+          .AddString("type", type.str())
+          .AddBool("startup", IsStartupClass(dex_file, class_def.class_idx_))
+          .Write(os);
+    } else {
       os << StringPrintf("%zd: %s (offset=0x%08x) (type_idx=%d)",
                          class_def_index, descriptor, oat_class_offset, class_def.class_idx_.index_)
          << " (" << oat_class.GetStatus() << ")"
-         << " (" << oat_class.GetType() << ")\n";
-      // TODO: include bitmap here if type is kOatClassSomeCompiled?
-      if (options_.list_classes_) {
-        continue;
+         << " (" << oat_class.GetType() << ")"
+         << (IsStartupClass(dex_file, class_def.class_idx_) ? " (startup)" : "") << "\n";
+    }
+    // TODO: include bitmap here if type is kOatClassSomeCompiled?
+    if (options_.list_classes_) {
+      return true;
+    }
+    return DumpOatClass(vios, state, oat_class, dex_file, class_def);
+  }
+
+  // Number of consecutive class defs rendered by one task of a parallel dump.
+  static constexpr size_t kClassDefsPerShard = 16;
+
+  // Number of shards buffered per job before the output is flushed. Bounds the memory used for
+  // rendered but not yet written output.
+  static constexpr size_t kShardsPerJob = 8;
+
+  // Dumps the given classes of `dex_file` on options_.jobs_ threads. Each shard of class defs is
+  // rendered into its own buffer and the buffers are written out in class def order, so the
+  // output is identical to the serial dump.
+  bool DumpOatClassDefsParallel(std::ostream& os,
+                                const OatFile::OatDexFile& oat_dex_file,
+                                const DexFile& dex_file,
+                                const std::vector<uint32_t>& class_def_indexes) {
+    struct Shard {
+      explicit Shard(Stats* parent_stats) : stats(parent_stats), success(true) {}
+
+      std::ostringstream output;
+      Stats stats;
+      bool success;
+    };
+
+    const size_t num_class_defs = class_def_indexes.size();
+    const size_t num_shards = RoundUp(num_class_defs, kClassDefsPerShard) / kClassDefsPerShard;
+    const size_t window_size = options_.jobs_ * kShardsPerJob;
+    bool success = true;
+    for (size_t window_begin = 0; window_begin < num_shards; window_begin += window_size) {
+      const size_t window_end = std::min(num_shards, window_begin + window_size);
+      std::vector<std::unique_ptr<Shard>> shards;
+      for (size_t i = window_begin; i != window_end; ++i) {
+        shards.emplace_back(new Shard(&stats_));
       }
-      if (!DumpOatClass(&vios, oat_class, *dex_file, class_def, &stop_analysis)) {
-        success = false;
+      RunParallel(options_.jobs_, shards.size(), [&](size_t i) {
+        Shard* shard = shards[i].get();
+        std::unique_ptr<Disassembler> disassembler(CreateDisassembler());
+        ClassDumpState state(&shard->output, &shard->stats, disassembler.get());
+        VariableIndentationOutputStream vios(&shard->output);
+        ScopedIndentation indent1(&vios);
+        const size_t begin = (window_begin + i) * kClassDefsPerShard;
+        const size_t end = std::min(num_class_defs, begin + kClassDefsPerShard);
+        for (size_t j = begin; j != end; ++j) {
+          if (!DumpOatClassDef(shard->output, &vios, &state, oat_dex_file, dex_file,
+                               class_def_indexes[j])) {
+            shard->success = false;
+          }
+        }
+      });
+      for (const std::unique_ptr<Shard>& shard : shards) {
+        os << shard->output.str();
+        stats_.Merge(shard->stats);
+        success = success && shard->success;
       }
-      if (stop_analysis) {
-        os << std::flush;
-        return success;
+      os << std::flush;
+    }
+    return success;
+  }
+
+  Disassembler* CreateDisassembler() const {
+    return Disassembler::Create(instruction_set_,
+                                new DisassemblerOptions(
+                                    options_.absolute_addresses_,
+                                    oat_file_.Begin(),
+                                    oat_file_.End(),
+                                    true /* can_read_literals_ */,
+                                    Is64BitInstructionSet(instruction_set_)
+                                        ? &Thread::DumpThreadOffset<PointerSize::k64>
+                                        : &Thread::DumpThreadOffset<PointerSize::k32>));
+  }
+
+  // Exports the dex files that contain classes accepted by the class filter, on options_.jobs_
+  // threads. With a vdex file, each dex file is copied out of the read-only vdex mapping and only
+  // that copy is unquickened, so that at most one unquickened dex file per thread is alive.
+  bool ExportDexFiles(std::ostream& os) {
+    std::vector<size_t> exported;
+    for (size_t i = 0; i < oat_dex_files_.size(); i++) {
+      // Also fills the dex file cache before it is read concurrently.
+      std::string error_msg;
+      const DexFile* const dex_file = OpenDexFile(oat_dex_files_[i], &error_msg);
+      if (dex_file == nullptr ||
+          class_filter_.MatchesAll() ||
+          !GetFilteredClassDefs(*dex_file).empty()) {
+        exported.push_back(i);
       }
     }
-    os << "\n";
+
+    std::unique_ptr<VdexFile> vdex;
+    std::vector<std::unique_ptr<const DexFile>> vdex_dex_files;
+    std::vector<ArrayRef<const uint8_t>> quickening_infos;
+    if (kIsVdexEnabled) {
+      std::string error_msg;
+      std::string vdex_filename = GetVdexFilename(oat_file_.GetLocation());
+      if (!OS::FileExists(vdex_filename.c_str())) {
+        os << "File " << vdex_filename.c_str() << " does not exist\n";
+        return false;
+      }
+
+      vdex = VdexFile::Open(vdex_filename,
+                            /* writable */ false,
+                            /* low_4gb */ false,
+                            /* unquicken */ false,
+                            /* decompile_return_instruction */ true,
+                            &error_msg);
+      if (vdex.get() == nullptr) {
+        os << "Failed to load vdex file '" << vdex_filename.c_str() << "': "
+           << error_msg << "\n";
+        return false;
+      }
+
+      if (!vdex->OpenAllDexFiles(&vdex_dex_files, &error_msg)) {
+        os << "Failed to open dex files from vdex:  " << error_msg << "\n";
+        return false;
+      }
+      if (oat_dex_files_.size() != vdex_dex_files.size()) {
+        os << "Unexpected number of dex files\n";
+        return false;
+      }
+
+      // The quickening info of the dex files is laid out in dex file order.
+      const ArrayRef<const uint8_t> quickening_info = vdex->GetQuickeningInfo();
+      size_t offset = 0u;
+      for (const std::unique_ptr<const DexFile>& dex_file : vdex_dex_files) {
+        quickening_infos.push_back(
+            VdexFile::GetQuickeningInfoOf(*dex_file, quickening_info.SubArray(offset)));
+        offset += quickening_infos.back().size();
+      }
+    }
+
+    std::vector<std::ostringstream> outputs(exported.size());
+    std::unique_ptr<bool[]> results(new bool[exported.size()]);
+    RunParallel(options_.jobs_, exported.size(), [&](size_t j) {
+      const size_t i = exported[j];
+      if (!kIsVdexEnabled) {
+        results[j] = ExportDexFile(outputs[j], *oat_dex_files_[i], nullptr);
+        return;
+      }
+      const DexFile& quickened = *vdex_dex_files[i];
+      std::vector<uint8_t> data(quickened.Begin(), quickened.Begin() + quickened.Size());
+      std::string error_msg;
+      std::unique_ptr<const DexFile> dex_file = DexFile::Open(data.data(),
+                                                              data.size(),
+                                                              quickened.GetLocation(),
+                                                              quickened.GetLocationChecksum(),
+                                                              /* oat_dex_file */ nullptr,
+                                                              /* verify */ false,
+                                                              /* verify_checksum */ false,
+                                                              &error_msg);
+      if (dex_file == nullptr) {
+        outputs[j] << "Failed to open dex file from vdex: " << error_msg << "\n";
+        results[j] = false;
+        return;
+      }
+      VdexFile::UnquickenDexFile(*dex_file,
+                                 quickening_infos[i],
+                                 /* decompile_return_instruction */ true);
+      results[j] = ExportDexFile(outputs[j], *oat_dex_files_[i], dex_file.get());
+    });
+
+    bool success = true;
+    for (size_t j = 0; j != exported.size(); ++j) {
+      os << outputs[j].str();
+      success = success && results[j];
+    }
     os << std::flush;
     return success;
   }
@@ -1128,46 +2577,35 @@ class OatDumper {
     }
   }
 
-  bool DumpOatClass(VariableIndentationOutputStream* vios,
-                    const OatFile::OatClass& oat_class, const DexFile& dex_file,
-                    const DexFile::ClassDef& class_def, bool* stop_analysis) {
-    bool success = true;
-    bool addr_found = false;
+  // Calls `fn(class_method_index, it)` for each direct and virtual method of `class_def`, where
+  // `it` is positioned on the method and `class_method_index` is its index in the OatClass.
+  template <typename Fn>
+  static void ForEachMethod(const DexFile& dex_file, const DexFile::ClassDef& class_def, Fn fn) {
     const uint8_t* class_data = dex_file.GetClassData(class_def);
     if (class_data == nullptr) {  // empty class such as a marker interface?
-      vios->Stream() << std::flush;
-      return success;
+      return;
     }
     ClassDataItemIterator it(dex_file, class_data);
     SkipAllFields(it);
-    uint32_t class_method_index = 0;
-    while (it.HasNextDirectMethod()) {
-      if (!DumpOatMethod(vios, class_def, class_method_index, oat_class, dex_file,
-                         it.GetMemberIndex(), it.GetMethodCodeItem(),
-                         it.GetRawMemberAccessFlags(), &addr_found)) {
-        success = false;
-      }
-      if (addr_found) {
-        *stop_analysis = true;
-        return success;
-      }
-      class_method_index++;
-      it.Next();
+    for (uint32_t class_method_index = 0; it.HasNext(); ++class_method_index, it.Next()) {
+      fn(class_method_index, it);
     }
-    while (it.HasNextVirtualMethod()) {
-      if (!DumpOatMethod(vios, class_def, class_method_index, oat_class, dex_file,
+  }
+
+  bool DumpOatClass(VariableIndentationOutputStream* vios,
+                    ClassDumpState* state,
+                    const OatFile::OatClass& oat_class, const DexFile& dex_file,
+                    const DexFile::ClassDef& class_def) {
+    bool success = true;
+    ForEachMethod(dex_file,
+                  class_def,
+                  [&](uint32_t class_method_index, const ClassDataItemIterator& it) {
+      if (!DumpOatMethod(vios, state, class_def, class_method_index, oat_class, dex_file,
                          it.GetMemberIndex(), it.GetMethodCodeItem(),
-                         it.GetRawMemberAccessFlags(), &addr_found)) {
+                         it.GetRawMemberAccessFlags())) {
         success = false;
       }
-      if (addr_found) {
-        *stop_analysis = true;
-        return success;
-      }
-      class_method_index++;
-      it.Next();
-    }
-    DCHECK(!it.HasNext());
+    });
     vios->Stream() << std::flush;
     return success;
   }
@@ -1177,24 +2615,147 @@ class OatDumper {
   // When this was picked, the largest arm method was 55,256 bytes and arm64 was 50,412 bytes.
   static constexpr uint32_t kMaxCodeSize = 100 * 1000;
 
+  // Emits a "method" record, followed by its "stack_map" records when vmap dumping is enabled.
+  bool DumpOatMethodRecords(ClassDumpState* state,
+                            uint32_t class_method_index,
+                            const OatFile::OatClass& oat_class,
+                            const DexFile& dex_file,
+                            uint32_t dex_method_idx,
+                            const std::string& pretty_method,
+                            const DexFile::CodeItem* code_item,
+                            uint32_t method_access_flags) {
+    JsonRecord record("method");
+    record.AddUint("class_method_index", class_method_index)
+        .AddUint("dex_method_idx", dex_method_idx)
+        .AddString("name", pretty_method)
+        .AddUint("access_flags", method_access_flags)
+        .AddBool("hot", IsHotMethod(dex_file, dex_method_idx));
+    if (options_.list_methods_) {
+      record.Write(*state->os);
+      return true;
+    }
+
+    const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_method_index);
+    uint32_t code_offset = oat_method.GetCodeOffset();
+    uint32_t code_size = oat_method.GetQuickCodeSize();
+
+    const char* compiler = "none";
+    if (IsMethodGeneratedByOptimizingCompiler(oat_method, code_item)) {
+      compiler = "optimizing";
+    } else if (IsMethodGeneratedByDexToDexCompiler(oat_method, code_item)) {
+      compiler = "dex2dex";
+    }
+    uint32_t method_header_offset = oat_method.GetOatQuickMethodHeaderOffset();
+    const OatQuickMethodHeader* method_header = oat_method.GetOatQuickMethodHeader();
+    record.AddUint("dex_code_bytes",
+                   code_item != nullptr ? code_item->insns_size_in_code_units_ * 2u : 0u)
+        .AddUint("code_offset", code_offset)
+        .AddUint("code_size", code_size)
+        .AddUint("method_header_offset", method_header_offset)
+        .AddUint("vmap_table_offset",
+                 method_header != nullptr ? method_header->GetVmapTableOffset() : 0u)
+        .AddUint("frame_size", oat_method.GetFrameSizeInBytes())
+        .AddUint("core_spill_mask", oat_method.GetCoreSpillMask())
+        .AddUint("fp_spill_mask", oat_method.GetFpSpillMask())
+        .AddString("compiler", compiler);
+    std::string code_owner = GetCodeOwnerName(oat_method, dex_file, dex_method_idx);
+    if (!code_owner.empty()) {
+      record.AddString("same_code_as", code_owner);
+    }
+
+    bool success = true;
+    if (method_header_offset > oat_file_.Size() ||
+        AlignCodeOffset(code_offset) + static_cast<uint64_t>(code_size) > oat_file_.Size()) {
+      record.AddString("error", "method data past end of file");
+      success = false;
+    }
+    record.Write(*state->os);
+    if (!success || method_header == nullptr) {
+      return success;
+    }
+
+    state->stats->AddBitsIfUnique(Stats::kByteKindQuickMethodHeader,
+                                  sizeof(*method_header) * kBitsPerByte,
+                                  method_header);
+    const void* code = oat_method.GetQuickCode();
+    if (code != nullptr) {
+      state->stats->AddBitsIfUnique(Stats::kByteKindCode, code_size * kBitsPerByte, code);
+    }
+    if (code != nullptr && IsMethodGeneratedByOptimizingCompiler(oat_method, code_item)) {
+      CodeInfo code_info(oat_method.GetVmapTable());
+      CodeInfoEncoding encoding = code_info.ExtractEncoding();
+      AddCodeInfoStats(state->stats, oat_method, code_item, code_info, encoding);
+      if (options_.dump_vmap_) {
+        DumpStackMapRecords(state->os, oat_method, dex_method_idx, code_info, encoding);
+      }
+    }
+    return success;
+  }
+
+  void DumpStackMapRecords(std::ostream* os,
+                           const OatFile::OatMethod& oat_method,
+                           uint32_t dex_method_idx,
+                           const CodeInfo& code_info,
+                           const CodeInfoEncoding& encoding) {
+    MethodInfo method_info(oat_method.GetOatQuickMethodHeader()->GetOptimizedMethodInfo());
+    const size_t num_stack_maps = code_info.GetNumberOfStackMaps(encoding);
+    for (size_t i = 0; i != num_stack_maps; ++i) {
+      StackMap stack_map = code_info.GetStackMapAt(i, encoding);
+      JsonRecord record("stack_map");
+      record.AddUint("dex_method_idx", dex_method_idx)
+          .AddUint("native_pc",
+                   stack_map.GetNativePcOffset(encoding.stack_map.encoding, instruction_set_))
+          .AddUint("dex_pc", stack_map.GetDexPc(encoding.stack_map.encoding))
+          .AddUint("register_mask", code_info.GetRegisterMaskOf(encoding, stack_map))
+          .AddBool("has_dex_register_map",
+                   stack_map.HasDexRegisterMap(encoding.stack_map.encoding));
+      if (stack_map.HasInlineInfo(encoding.stack_map.encoding)) {
+        InlineInfo inline_info = code_info.GetInlineInfoOf(stack_map, encoding);
+        const InlineInfoEncoding& inline_encoding = encoding.inline_info.encoding;
+        std::vector<uint32_t> dex_pcs;
+        std::vector<uint32_t> method_indexes;
+        for (uint32_t depth = 0; depth != inline_info.GetDepth(inline_encoding); ++depth) {
+          dex_pcs.push_back(inline_info.GetDexPcAtDepth(inline_encoding, depth));
+          method_indexes.push_back(
+              inline_info.EncodesArtMethodAtDepth(inline_encoding, depth)
+                  ? DexFile::kDexNoIndex
+                  : inline_info.GetMethodIndexAtDepth(inline_encoding, method_info, depth));
+        }
+        record.AddUintArray("inline_dex_pcs", dex_pcs)
+            .AddUintArray("inline_method_idx", method_indexes);
+      }
+      record.Write(*os);
+    }
+  }
+
   bool DumpOatMethod(VariableIndentationOutputStream* vios,
+                     ClassDumpState* state,
                      const DexFile::ClassDef& class_def,
                      uint32_t class_method_index,
                      const OatFile::OatClass& oat_class, const DexFile& dex_file,
                      uint32_t dex_method_idx, const DexFile::CodeItem* code_item,
-                     uint32_t method_access_flags, bool* addr_found) {
+                     uint32_t method_access_flags) {
     bool success = true;
 
-    // TODO: Support regex
-    std::string method_name = dex_file.GetMethodName(dex_file.GetMethodId(dex_method_idx));
-    if (method_name.find(options_.method_filter_) == std::string::npos) {
+    if (!MatchesMethod(dex_file, dex_method_idx)) {
       return success;
     }
 
     std::string pretty_method = dex_file.PrettyMethod(dex_method_idx, true);
-    vios->Stream() << StringPrintf("%d: %s (dex_method_idx=%d)\n",
+    if (IsJsonOutput()) {
+      return DumpOatMethodRecords(state,
+                                  class_method_index,
+                                  oat_class,
+                                  dex_file,
+                                  dex_method_idx,
+                                  pretty_method,
+                                  code_item,
+                                  method_access_flags);
+    }
+    vios->Stream() << StringPrintf("%d: %s (dex_method_idx=%d)%s\n",
                                    class_method_index, pretty_method.c_str(),
-                                   dex_method_idx);
+                                   dex_method_idx,
+                                   IsHotMethod(dex_file, dex_method_idx) ? " (hot)" : "");
     if (options_.list_methods_) return success;
 
     uint32_t oat_method_offsets_offset = oat_class.GetOatMethodOffsetsOffset(class_method_index);
@@ -1202,13 +2763,6 @@ class OatDumper {
     const OatFile::OatMethod oat_method = oat_class.GetOatMethod(class_method_index);
     uint32_t code_offset = oat_method.GetCodeOffset();
     uint32_t code_size = oat_method.GetQuickCodeSize();
-    if (resolved_addr2instr_ != 0) {
-      if (resolved_addr2instr_ > code_offset + code_size) {
-        return success;
-      } else {
-        *addr_found = true;  // stop analyzing file at next iteration
-      }
-    }
 
     // Everything below is indented at least once.
     ScopedIndentation indent1(vios);
@@ -1261,9 +2815,9 @@ class OatDumper {
       vios->Stream() << "OatQuickMethodHeader ";
       uint32_t method_header_offset = oat_method.GetOatQuickMethodHeaderOffset();
       const OatQuickMethodHeader* method_header = oat_method.GetOatQuickMethodHeader();
-      stats_.AddBitsIfUnique(Stats::kByteKindQuickMethodHeader,
-                             sizeof(*method_header) * kBitsPerByte,
-                             method_header);
+      state->stats->AddBitsIfUnique(Stats::kByteKindQuickMethodHeader,
+                                    sizeof(*method_header) * kBitsPerByte,
+                                    method_header);
       if (options_.absolute_addresses_) {
         vios->Stream() << StringPrintf("%p ", method_header);
       }
@@ -1335,7 +2889,7 @@ class OatDumper {
         const void* code = oat_method.GetQuickCode();
         uint32_t aligned_code_begin = AlignCodeOffset(code_offset);
         uint64_t aligned_code_end = aligned_code_begin + code_size;
-        stats_.AddBitsIfUnique(Stats::kByteKindCode, code_size * kBitsPerByte, code);
+        state->stats->AddBitsIfUnique(Stats::kByteKindCode, code_size * kBitsPerByte, code);
 
         if (options_.absolute_addresses_) {
           vios->Stream() << StringPrintf("%p ", code);
@@ -1362,7 +2916,7 @@ class OatDumper {
           success = false;
           if (options_.disassemble_code_) {
             if (code_size_offset + kPrologueBytes <= oat_file_.Size()) {
-              DumpCode(vios, oat_method, code_item, true, kPrologueBytes);
+              DumpCode(vios, state, oat_method, code_item, true, kPrologueBytes);
             }
           }
         } else if (code_size > kMaxCodeSize) {
@@ -1375,11 +2929,17 @@ class OatDumper {
           success = false;
           if (options_.disassemble_code_) {
             if (code_size_offset + kPrologueBytes <= oat_file_.Size()) {
-              DumpCode(vios, oat_method, code_item, true, kPrologueBytes);
+              DumpCode(vios, state, oat_method, code_item, true, kPrologueBytes);
             }
           }
         } else if (options_.disassemble_code_) {
-          DumpCode(vios, oat_method, code_item, !success, 0);
+          std::string code_owner = GetCodeOwnerName(oat_method, dex_file, dex_method_idx);
+          if (!code_owner.empty()) {
+            // Deduplicated code, already disassembled for its first method.
+            vios->Stream() << "same code as " << code_owner << "\n";
+          } else {
+            DumpCode(vios, state, oat_method, code_item, !success, 0);
+          }
         }
       }
     }
@@ -1537,7 +3097,8 @@ class OatDumper {
       ScopedObjectAccess soa(Thread::Current());
       Runtime* const runtime = Runtime::Current();
       Handle<mirror::DexCache> dex_cache(
-          hs->NewHandle(runtime->GetClassLinker()->RegisterDexFile(*dex_file, nullptr)));
+          hs->NewHandle(runtime->GetClassLinker()->RegisterDexFile(
+              *dex_file, options_.class_loader_->Get())));
       CHECK(dex_cache != nullptr);
       DCHECK(options_.class_loader_ != nullptr);
       return verifier::MethodVerifier::VerifyMethodAndDump(
@@ -1639,7 +3200,90 @@ class OatDumper {
     const InstructionSet instruction_set_;
   };
 
+  // Accounts the CodeInfo of an optimized method, unless it was already seen for deduplicated code.
+  void AddCodeInfoStats(Stats* stats,
+                        const OatFile::OatMethod& oat_method,
+                        const DexFile::CodeItem* code_item,
+                        const CodeInfo& code_info,
+                        const CodeInfoEncoding& encoding) {
+    StackMapEncoding stack_map_encoding(encoding.stack_map.encoding);
+    const size_t num_stack_maps = encoding.stack_map.num_entries;
+    if (stats->AddBitsIfUnique(Stats::kByteKindCodeInfoEncoding,
+                               encoding.HeaderSize() * kBitsPerByte,
+                               oat_method.GetVmapTable())) {
+      // Stack maps
+      stats->AddBits(
+          Stats::kByteKindStackMapNativePc,
+          stack_map_encoding.GetNativePcEncoding().BitSize() * num_stack_maps);
+      stats->AddBits(
+          Stats::kByteKindStackMapDexPc,
+          stack_map_encoding.GetDexPcEncoding().BitSize() * num_stack_maps);
+      stats->AddBits(
+          Stats::kByteKindStackMapDexRegisterMap,
+          stack_map_encoding.GetDexRegisterMapEncoding().BitSize() * num_stack_maps);
+      stats->AddBits(
+          Stats::kByteKindStackMapInlineInfoIndex,
+          stack_map_encoding.GetInlineInfoEncoding().BitSize() * num_stack_maps);
+      stats->AddBits(
+          Stats::kByteKindStackMapRegisterMaskIndex,
+          stack_map_encoding.GetRegisterMaskIndexEncoding().BitSize() * num_stack_maps);
+      stats->AddBits(
+          Stats::kByteKindStackMapStackMaskIndex,
+          stack_map_encoding.GetStackMaskIndexEncoding().BitSize() * num_stack_maps);
+
+      // Stack masks
+      stats->AddBits(
+          Stats::kByteKindCodeInfoStackMasks,
+          encoding.stack_mask.encoding.BitSize() * encoding.stack_mask.num_entries);
+
+      // Register masks
+      stats->AddBits(
+          Stats::kByteKindCodeInfoRegisterMasks,
+          encoding.register_mask.encoding.BitSize() * encoding.register_mask.num_entries);
+
+      // Invoke infos
+      if (encoding.invoke_info.num_entries > 0u) {
+        stats->AddBits(
+            Stats::kByteKindCodeInfoInvokeInfo,
+            encoding.invoke_info.encoding.BitSize() * encoding.invoke_info.num_entries);
+      }
+
+      // Location catalog
+      const size_t location_catalog_bytes =
+          code_info.GetDexRegisterLocationCatalogSize(encoding);
+      stats->AddBits(Stats::kByteKindCodeInfoLocationCatalog,
+                     kBitsPerByte * location_catalog_bytes);
+      // Dex register bytes.
+      const size_t dex_register_bytes =
+          code_info.GetDexRegisterMapsSize(encoding, code_item->registers_size_);
+      stats->AddBits(
+          Stats::kByteKindCodeInfoDexRegisterMap,
+          kBitsPerByte * dex_register_bytes);
+
+      // Inline infos.
+      const size_t num_inline_infos = encoding.inline_info.num_entries;
+      if (num_inline_infos > 0u) {
+        stats->AddBits(
+            Stats::kByteKindInlineInfoMethodIndexIdx,
+            encoding.inline_info.encoding.GetMethodIndexIdxEncoding().BitSize() *
+                num_inline_infos);
+        stats->AddBits(
+            Stats::kByteKindInlineInfoDexPc,
+            encoding.inline_info.encoding.GetDexPcEncoding().BitSize() * num_inline_infos);
+        stats->AddBits(
+            Stats::kByteKindInlineInfoExtraData,
+            encoding.inline_info.encoding.GetExtraDataEncoding().BitSize() * num_inline_infos);
+        stats->AddBits(
+            Stats::kByteKindInlineInfoDexRegisterMap,
+            encoding.inline_info.encoding.GetDexRegisterMapEncoding().BitSize() *
+                num_inline_infos);
+        stats->AddBits(Stats::kByteKindInlineInfoIsLast, num_inline_infos);
+      }
+    }
+  }
+
   void DumpCode(VariableIndentationOutputStream* vios,
+                ClassDumpState* state,
                 const OatFile::OatMethod& oat_method, const DexFile::CodeItem* code_item,
                 bool bad_input, size_t code_size) {
     const void* quick_code = oat_method.GetQuickCode();
@@ -1654,87 +3298,15 @@ class OatDumper {
       // The optimizing compiler outputs its CodeInfo data in the vmap table.
       StackMapsHelper helper(oat_method.GetVmapTable(), instruction_set_);
       MethodInfo method_info(oat_method.GetOatQuickMethodHeader()->GetOptimizedMethodInfo());
-      {
-        CodeInfoEncoding encoding(helper.GetEncoding());
-        StackMapEncoding stack_map_encoding(encoding.stack_map.encoding);
-        const size_t num_stack_maps = encoding.stack_map.num_entries;
-        if (stats_.AddBitsIfUnique(Stats::kByteKindCodeInfoEncoding,
-                                   encoding.HeaderSize() * kBitsPerByte,
-                                   oat_method.GetVmapTable())) {
-          // Stack maps
-          stats_.AddBits(
-              Stats::kByteKindStackMapNativePc,
-              stack_map_encoding.GetNativePcEncoding().BitSize() * num_stack_maps);
-          stats_.AddBits(
-              Stats::kByteKindStackMapDexPc,
-              stack_map_encoding.GetDexPcEncoding().BitSize() * num_stack_maps);
-          stats_.AddBits(
-              Stats::kByteKindStackMapDexRegisterMap,
-              stack_map_encoding.GetDexRegisterMapEncoding().BitSize() * num_stack_maps);
-          stats_.AddBits(
-              Stats::kByteKindStackMapInlineInfoIndex,
-              stack_map_encoding.GetInlineInfoEncoding().BitSize() * num_stack_maps);
-          stats_.AddBits(
-              Stats::kByteKindStackMapRegisterMaskIndex,
-              stack_map_encoding.GetRegisterMaskIndexEncoding().BitSize() * num_stack_maps);
-          stats_.AddBits(
-              Stats::kByteKindStackMapStackMaskIndex,
-              stack_map_encoding.GetStackMaskIndexEncoding().BitSize() * num_stack_maps);
-
-          // Stack masks
-          stats_.AddBits(
-              Stats::kByteKindCodeInfoStackMasks,
-              encoding.stack_mask.encoding.BitSize() * encoding.stack_mask.num_entries);
-
-          // Register masks
-          stats_.AddBits(
-              Stats::kByteKindCodeInfoRegisterMasks,
-              encoding.register_mask.encoding.BitSize() * encoding.register_mask.num_entries);
-
-          // Invoke infos
-          if (encoding.invoke_info.num_entries > 0u) {
-            stats_.AddBits(
-                Stats::kByteKindCodeInfoInvokeInfo,
-                encoding.invoke_info.encoding.BitSize() * encoding.invoke_info.num_entries);
-          }
-
-          // Location catalog
-          const size_t location_catalog_bytes =
-              helper.GetCodeInfo().GetDexRegisterLocationCatalogSize(encoding);
-          stats_.AddBits(Stats::kByteKindCodeInfoLocationCatalog,
-                         kBitsPerByte * location_catalog_bytes);
-          // Dex register bytes.
-          const size_t dex_register_bytes =
-              helper.GetCodeInfo().GetDexRegisterMapsSize(encoding, code_item->registers_size_);
-          stats_.AddBits(
-              Stats::kByteKindCodeInfoDexRegisterMap,
-              kBitsPerByte * dex_register_bytes);
-
-          // Inline infos.
-          const size_t num_inline_infos = encoding.inline_info.num_entries;
-          if (num_inline_infos > 0u) {
-            stats_.AddBits(
-                Stats::kByteKindInlineInfoMethodIndexIdx,
-                encoding.inline_info.encoding.GetMethodIndexIdxEncoding().BitSize() *
-                    num_inline_infos);
-            stats_.AddBits(
-                Stats::kByteKindInlineInfoDexPc,
-                encoding.inline_info.encoding.GetDexPcEncoding().BitSize() * num_inline_infos);
-            stats_.AddBits(
-                Stats::kByteKindInlineInfoExtraData,
-                encoding.inline_info.encoding.GetExtraDataEncoding().BitSize() * num_inline_infos);
-            stats_.AddBits(
-                Stats::kByteKindInlineInfoDexRegisterMap,
-                encoding.inline_info.encoding.GetDexRegisterMapEncoding().BitSize() *
-                    num_inline_infos);
-            stats_.AddBits(Stats::kByteKindInlineInfoIsLast, num_inline_infos);
-          }
-        }
-      }
+      AddCodeInfoStats(state->stats,
+                       oat_method,
+                       code_item,
+                       helper.GetCodeInfo(),
+                       helper.GetEncoding());
       const uint8_t* quick_native_pc = reinterpret_cast<const uint8_t*>(quick_code);
       size_t offset = 0;
       while (offset < code_size) {
-        offset += disassembler_->Dump(vios->Stream(), quick_native_pc + offset);
+        offset += state->disassembler->Dump(vios->Stream(), quick_native_pc + offset);
         if (offset == helper.GetOffset()) {
           ScopedIndentation indent1(vios);
           StackMap stack_map = helper.GetStackMap();
@@ -1757,7 +3329,7 @@ class OatDumper {
       const uint8_t* quick_native_pc = reinterpret_cast<const uint8_t*>(quick_code);
       size_t offset = 0;
       while (offset < code_size) {
-        offset += disassembler_->Dump(vios->Stream(), quick_native_pc + offset);
+        offset += state->disassembler->Dump(vios->Stream(), quick_native_pc + offset);
       }
     }
   }
@@ -1765,11 +3337,17 @@ class OatDumper {
   const OatFile& oat_file_;
   const std::vector<const OatFile::OatDexFile*> oat_dex_files_;
   const OatDumperOptions& options_;
-  uint32_t resolved_addr2instr_;
   const InstructionSet instruction_set_;
   std::set<uintptr_t> offsets_;
-  Disassembler* disassembler_;
+  std::unique_ptr<Disassembler> owned_disassembler_;
+  Disassembler* const disassembler_;
   Stats stats_;
+  std::unique_ptr<OatCodeIndex> code_index_;
+  // Code offset to the first dumped method using that code. Filled in serially before each dex
+  // file is dumped and only read while dumping.
+  std::unordered_map<uint32_t, CodeOwner> code_owners_;
+  NameFilter class_filter_;
+  NameFilter method_filter_;
 };
 
 class ImageDumper {
@@ -1906,7 +3484,9 @@ class ImageDumper {
                                                          oat_dex_file->FileSize()));
     }
 
-    os << "OBJECTS:\n" << std::flush;
+    if (!oat_dumper_options_->image_stats_only_) {
+      os << "OBJECTS:\n" << std::flush;
+    }
 
     // Loop through the image space and dump its objects.
     gc::Heap* heap = runtime->GetHeap();
@@ -2034,9 +3614,13 @@ class ImageDumper {
     explicit DumpArtMethodVisitor(ImageDumper* image_dumper) : image_dumper_(image_dumper) {}
 
     virtual void Visit(ArtMethod* method) OVERRIDE REQUIRES_SHARED(Locks::mutator_lock_) {
+      if (image_dumper_->oat_dumper_options_->image_stats_only_) {
+        image_dumper_->DumpMethod(method, nullptr);
+        return;
+      }
       std::ostream& indent_os = image_dumper_->vios_.Stream();
       indent_os << method << " " << " ArtMethod: " << ArtMethod::PrettyMethod(method) << "\n";
-      image_dumper_->DumpMethod(method, indent_os);
+      image_dumper_->DumpMethod(method, &indent_os);
       indent_os << "\n";
     }
 
@@ -2174,10 +3758,14 @@ class ImageDumper {
     size_t alignment_bytes = RoundUp(object_bytes, kObjectAlignment) - object_bytes;
     state->stats_.object_bytes += object_bytes;
     state->stats_.alignment_bytes += alignment_bytes;
+    mirror::Class* obj_class = obj->GetClass();
+    state->stats_.Update(obj_class, object_bytes);
+    if (state->oat_dumper_options_->image_stats_only_) {
+      return;
+    }
 
     std::ostream& os = state->vios_.Stream();
 
-    mirror::Class* obj_class = obj->GetClass();
     if (obj_class->IsArrayClass()) {
       os << StringPrintf("%p: %s length:%d\n", obj, obj_class->PrettyDescriptor().c_str(),
                          obj->AsArray()->GetLength());
@@ -2336,11 +3924,10 @@ class ImageDumper {
         }
       }
     }
-    std::string temp;
-    state->stats_.Update(obj_class->GetDescriptor(&temp), object_bytes);
   }
 
-  void DumpMethod(ArtMethod* method, std::ostream& indent_os)
+  // Accounts `method` in the stats and, unless `indent_os` is null, dumps it.
+  void DumpMethod(ArtMethod* method, std::ostream* indent_os)
       REQUIRES_SHARED(Locks::mutator_lock_) {
     DCHECK(method != nullptr);
     const void* quick_oat_code_begin = GetQuickOatCodeBegin(method);
@@ -2355,19 +3942,20 @@ class ImageDumper {
       if (first_occurrence) {
         stats_.native_to_managed_code_bytes += quick_oat_code_size;
       }
-      if (quick_oat_code_begin != method->GetEntryPointFromQuickCompiledCodePtrSize(
-          image_header_.GetPointerSize())) {
-        indent_os << StringPrintf("OAT CODE: %p\n", quick_oat_code_begin);
+      if (indent_os != nullptr &&
+          quick_oat_code_begin != method->GetEntryPointFromQuickCompiledCodePtrSize(
+              image_header_.GetPointerSize())) {
+        *indent_os << StringPrintf("OAT CODE: %p\n", quick_oat_code_begin);
       }
     } else if (method->IsAbstract() || method->IsClassInitializer()) {
       // Don't print information for these.
     } else if (method->IsRuntimeMethod()) {
       ImtConflictTable* table = method->GetImtConflictTable(image_header_.GetPointerSize());
-      if (table != nullptr) {
-        indent_os << "IMT conflict table " << table << " method: ";
+      if (table != nullptr && indent_os != nullptr) {
+        *indent_os << "IMT conflict table " << table << " method: ";
         for (size_t i = 0, count = table->NumEntries(pointer_size); i < count; ++i) {
-          indent_os << ArtMethod::PrettyMethod(table->GetImplementationMethod(i, pointer_size))
-                    << " ";
+          *indent_os << ArtMethod::PrettyMethod(table->GetImplementationMethod(i, pointer_size))
+                     << " ";
         }
       }
     } else {
@@ -2403,22 +3991,31 @@ class ImageDumper {
 
       uint32_t method_access_flags = method->GetAccessFlags();
 
-      indent_os << StringPrintf("OAT CODE: %p-%p\n", quick_oat_code_begin, quick_oat_code_end);
-      indent_os << StringPrintf("SIZE: Dex Instructions=%zd StackMaps=%zd AccessFlags=0x%x\n",
-                                dex_instruction_bytes,
-                                vmap_table_bytes,
-                                method_access_flags);
+      if (indent_os != nullptr) {
+        *indent_os << StringPrintf("OAT CODE: %p-%p\n", quick_oat_code_begin, quick_oat_code_end);
+        *indent_os << StringPrintf("SIZE: Dex Instructions=%zd StackMaps=%zd AccessFlags=0x%x\n",
+                                   dex_instruction_bytes,
+                                   vmap_table_bytes,
+                                   method_access_flags);
+      }
 
       size_t total_size = dex_instruction_bytes +
           vmap_table_bytes + quick_oat_code_size + ArtMethod::Size(image_header_.GetPointerSize());
 
       double expansion =
       static_cast<double>(quick_oat_code_size) / static_cast<double>(dex_instruction_bytes);
-      stats_.ComputeOutliers(total_size, expansion, method);
+      const ProfileCompilationInfo* profile = oat_dumper_options_->profile_;
+      if (profile == nullptr ||
+          profile->ContainsMethod(
+              MethodReference(method->GetDexFile(), method->GetDexMethodIndex())) ||
+          profile->ContainsClass(*method->GetDexFile(),
+                                 method->GetDeclaringClass()->GetDexTypeIndex())) {
+        stats_.ComputeOutliers(total_size, expansion, method);
+      }
     }
   }
 
-  std::set<const void*> already_seen_;
+  std::unordered_set<const void*> already_seen_;
   // Compute the size of the given data within the oat file and whether this is the first time
   // this data has been requested
   size_t ComputeOatSize(const void* oat_data, bool* first_occurrence) {
@@ -2457,9 +4054,129 @@ class ImageDumper {
 
     size_t dex_instruction_bytes;
 
-    std::vector<ArtMethod*> method_outlier;
-    std::vector<size_t> method_outlier_size;
-    std::vector<double> method_outlier_expansion;
+    // Streaming summary of a per-method value, so that the outlier analysis does not keep every
+    // method of the image. The mean and variance are exact, and the methods with the largest
+    // values are kept up to kMaxOutliers. All values are also counted in a log-linear histogram,
+    // which gives counts and percentiles within 1/kSubBuckets of the value.
+    class OutlierSketch {
+     public:
+      typedef std::pair<double, ArtMethod*> Entry;
+
+      static constexpr size_t kMaxOutliers = 64;
+
+      OutlierSketch() : count_(0u), sum_(0.0), sum_of_squares_(0.0), histogram_() {}
+
+      void Add(double value, ArtMethod* method) {
+        if (!(value > 0.0)) {
+          value = 0.0;  // Also for NaN.
+        } else if (value > kMaxValue) {
+          value = kMaxValue;
+        }
+        ++count_;
+        sum_ += value;
+        sum_of_squares_ += value * value;
+        ++histogram_[BucketOf(value)];
+        if (largest_.size() < kMaxOutliers) {
+          largest_.emplace_back(value, method);
+          std::push_heap(largest_.begin(), largest_.end(), std::greater<Entry>());
+        } else if (value > largest_.front().first) {
+          std::pop_heap(largest_.begin(), largest_.end(), std::greater<Entry>());
+          largest_.back() = Entry(value, method);
+          std::push_heap(largest_.begin(), largest_.end(), std::greater<Entry>());
+        }
+      }
+
+      size_t Count() const {
+        return count_;
+      }
+
+      double Mean() const {
+        return sum_ / count_;
+      }
+
+      double StandardDeviation() const {
+        if (count_ <= 1u) {
+          return 0.0;
+        }
+        double variance = (sum_of_squares_ - sum_ * Mean()) / (count_ - 1u);
+        return std::sqrt(std::max(variance, 0.0));
+      }
+
+      // Returns the number of values above `threshold`. Exact if all of them are kept as
+      // outliers, otherwise within the histogram resolution.
+      size_t CountAbove(double threshold) const {
+        if (largest_.size() < kMaxOutliers || largest_.front().first <= threshold) {
+          return static_cast<size_t>(std::count_if(
+              largest_.begin(),
+              largest_.end(),
+              [threshold](const Entry& entry) { return entry.first > threshold; }));
+        }
+        size_t count = 0u;
+        for (size_t bucket = 0; bucket != kNumBuckets; ++bucket) {
+          if (BucketLowerBound(bucket) > threshold) {
+            count += histogram_[bucket];
+          }
+        }
+        return count;
+      }
+
+      // Returns the lower bound of the histogram bucket holding the given percentile.
+      double Percentile(double percentile) const {
+        const size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * count_));
+        size_t count = 0u;
+        for (size_t bucket = 0; bucket != kNumBuckets; ++bucket) {
+          count += histogram_[bucket];
+          if (count != 0u && count >= rank) {
+            return BucketLowerBound(bucket);
+          }
+        }
+        return 0.0;
+      }
+
+      // Returns the kept outliers, largest value first.
+      std::vector<Entry> GetLargest() const {
+        std::vector<Entry> largest(largest_);
+        std::sort(largest.begin(), largest.end(), std::greater<Entry>());
+        return largest;
+      }
+
+     private:
+      // Values are bucketed in units of 1/kValueScale, with kSubBuckets buckets per power of two.
+      static constexpr double kValueScale = 16.0;
+      static constexpr double kMaxValue = static_cast<double>(UINT64_C(1) << 48);
+      static constexpr size_t kSubBucketBits = 3u;
+      static constexpr size_t kSubBuckets = 1u << kSubBucketBits;
+      static constexpr size_t kNumBuckets = (64u - kSubBucketBits + 1u) * kSubBuckets;
+
+      static size_t BucketOf(double value) {
+        const uint64_t scaled = static_cast<uint64_t>(value * kValueScale);
+        if (scaled < kSubBuckets) {
+          return scaled;
+        }
+        const size_t exponent = 63u - CLZ(scaled);
+        const size_t sub_bucket = (scaled >> (exponent - kSubBucketBits)) & (kSubBuckets - 1u);
+        return (exponent - kSubBucketBits + 1u) * kSubBuckets + sub_bucket;
+      }
+
+      static double BucketLowerBound(size_t bucket) {
+        if (bucket < kSubBuckets) {
+          return bucket / kValueScale;
+        }
+        const size_t exponent = bucket / kSubBuckets + kSubBucketBits - 1u;
+        const uint64_t mantissa = kSubBuckets + bucket % kSubBuckets;
+        return (mantissa << (exponent - kSubBucketBits)) / kValueScale;
+      }
+
+      size_t count_;
+      double sum_;
+      double sum_of_squares_;
+      // Min-heap of the largest values.
+      std::vector<Entry> largest_;
+      size_t histogram_[kNumBuckets];
+    };
+
+    OutlierSketch method_sizes;
+    OutlierSketch method_expansions;
     std::vector<std::pair<std::string, size_t>> oat_dex_file_sizes;
 
     Stats()
@@ -2484,21 +4201,37 @@ class ImageDumper {
           dex_instruction_bytes(0) {}
 
     struct SizeAndCount {
+      SizeAndCount() : bytes(0), count(0) {}  // For sizes_and_counts[].
       SizeAndCount(size_t bytes_in, size_t count_in) : bytes(bytes_in), count(count_in) {}
       size_t bytes;
       size_t count;
     };
     typedef SafeMap<std::string, SizeAndCount> SizeAndCountTable;
-    SizeAndCountTable sizes_and_counts;
-
-    void Update(const char* descriptor, size_t object_bytes_in) {
-      SizeAndCountTable::iterator it = sizes_and_counts.find(descriptor);
-      if (it != sizes_and_counts.end()) {
-        it->second.bytes += object_bytes_in;
-        it->second.count += 1;
-      } else {
-        sizes_and_counts.Put(descriptor, SizeAndCount(object_bytes_in, 1));
+    // Keyed by class rather than descriptor, so that descriptors are only built once per class,
+    // when the stats are dumped.
+    std::unordered_map<mirror::Class*, SizeAndCount> sizes_and_counts;
+
+    void Update(mirror::Class* klass, size_t object_bytes_in) {
+      SizeAndCount& size_and_count = sizes_and_counts[klass];
+      size_and_count.bytes += object_bytes_in;
+      size_and_count.count += 1;
+    }
+
+    // Returns the sizes and counts by descriptor.
+    SizeAndCountTable GetSizesAndCountsByDescriptor() REQUIRES_SHARED(Locks::mutator_lock_) {
+      SizeAndCountTable table;
+      for (const auto& entry : sizes_and_counts) {
+        std::string temp;
+        const char* descriptor = entry.first->GetDescriptor(&temp);
+        SizeAndCountTable::iterator it = table.find(descriptor);
+        if (it != table.end()) {
+          it->second.bytes += entry.second.bytes;
+          it->second.count += entry.second.count;
+        } else {
+          table.Put(descriptor, entry.second);
+        }
       }
+      return table;
     }
 
     double PercentOfOatBytes(size_t size) {
@@ -2514,113 +4247,79 @@ class ImageDumper {
     }
 
     void ComputeOutliers(size_t total_size, double expansion, ArtMethod* method) {
-      method_outlier_size.push_back(total_size);
-      method_outlier_expansion.push_back(expansion);
-      method_outlier.push_back(method);
+      method_sizes.Add(total_size, method);
+      method_expansions.Add(expansion, method);
     }
 
     void DumpOutliers(std::ostream& os)
         REQUIRES_SHARED(Locks::mutator_lock_) {
-      size_t sum_of_sizes = 0;
-      size_t sum_of_sizes_squared = 0;
-      size_t sum_of_expansion = 0;
-      size_t sum_of_expansion_squared = 0;
-      size_t n = method_outlier_size.size();
-      if (n <= 1) {
+      if (method_sizes.Count() <= 1) {
         return;
       }
-      for (size_t i = 0; i < n; i++) {
-        size_t cur_size = method_outlier_size[i];
-        sum_of_sizes += cur_size;
-        sum_of_sizes_squared += cur_size * cur_size;
-        double cur_expansion = method_outlier_expansion[i];
-        sum_of_expansion += cur_expansion;
-        sum_of_expansion_squared += cur_expansion * cur_expansion;
-      }
-      size_t size_mean = sum_of_sizes / n;
-      size_t size_variance = (sum_of_sizes_squared - sum_of_sizes * size_mean) / (n - 1);
-      double expansion_mean = sum_of_expansion / n;
-      double expansion_variance =
-          (sum_of_expansion_squared - sum_of_expansion * expansion_mean) / (n - 1);
-
       // Dump methods whose size is a certain number of standard deviations from the mean
-      size_t dumped_values = 0;
-      size_t skipped_values = 0;
-      for (size_t i = 100; i > 0; i--) {  // i is the current number of standard deviations
-        size_t cur_size_variance = i * i * size_variance;
-        bool first = true;
-        for (size_t j = 0; j < n; j++) {
-          size_t cur_size = method_outlier_size[j];
-          if (cur_size > size_mean) {
-            size_t cur_var = cur_size - size_mean;
-            cur_var = cur_var * cur_var;
-            if (cur_var > cur_size_variance) {
-              if (dumped_values > 20) {
-                if (i == 1) {
-                  skipped_values++;
-                } else {
-                  i = 2;  // jump to counting for 1 standard deviation
-                  break;
-                }
-              } else {
-                if (first) {
-                  os << "\nBig methods (size > " << i << " standard deviations the norm):\n";
-                  first = false;
-                }
-                os << ArtMethod::PrettyMethod(method_outlier[j]) << " requires storage of "
-                    << PrettySize(cur_size) << "\n";
-                method_outlier_size[j] = 0;  // don't consider this method again
-                dumped_values++;
-              }
-            }
-          }
-        }
-      }
-      if (skipped_values > 0) {
-        os << "... skipped " << skipped_values
-           << " methods with size > 1 standard deviation from the norm\n";
-      }
+      DumpOutliers(os, method_sizes, 100, "Big methods", "size", " requires storage of ", true);
+      os << StringPrintf("Method size percentiles: p50=%s p90=%s p99=%s\n",
+                         PrettySize(method_sizes.Percentile(50)).c_str(),
+                         PrettySize(method_sizes.Percentile(90)).c_str(),
+                         PrettySize(method_sizes.Percentile(99)).c_str());
       os << std::flush;
 
       // Dump methods whose expansion is a certain number of standard deviations from the mean
-      dumped_values = 0;
-      skipped_values = 0;
-      for (size_t i = 10; i > 0; i--) {  // i is the current number of standard deviations
-        double cur_expansion_variance = i * i * expansion_variance;
-        bool first = true;
-        for (size_t j = 0; j < n; j++) {
-          double cur_expansion = method_outlier_expansion[j];
-          if (cur_expansion > expansion_mean) {
-            size_t cur_var = cur_expansion - expansion_mean;
-            cur_var = cur_var * cur_var;
-            if (cur_var > cur_expansion_variance) {
-              if (dumped_values > 20) {
-                if (i == 1) {
-                  skipped_values++;
-                } else {
-                  i = 2;  // jump to counting for 1 standard deviation
-                  break;
-                }
-              } else {
-                if (first) {
-                  os << "\nLarge expansion methods (size > " << i
-                      << " standard deviations the norm):\n";
-                  first = false;
-                }
-                os << ArtMethod::PrettyMethod(method_outlier[j]) << " expanded code by "
-                   << cur_expansion << "\n";
-                method_outlier_expansion[j] = 0.0;  // don't consider this method again
-                dumped_values++;
-              }
-            }
-          }
+      DumpOutliers(os, method_expansions, 10, "Large expansion methods", "expansion",
+                   " expanded code by ", false);
+      os << StringPrintf("Method expansion percentiles: p50=%.2f p90=%.2f p99=%.2f\n",
+                         method_expansions.Percentile(50),
+                         method_expansions.Percentile(90),
+                         method_expansions.Percentile(99));
+      os << "\n" << std::flush;
+    }
+
+    // Dumps the largest values that are more than one standard deviation above the mean, grouped
+    // by the number of standard deviations, up to `max_deviations`. At most kMaxDumpedOutliers
+    // methods are named and the others are only counted.
+    static void DumpOutliers(std::ostream& os,
+                             const OutlierSketch& sketch,
+                             size_t max_deviations,
+                             const char* title,
+                             const char* value_name,
+                             const char* value_description,
+                             bool value_is_size)
+        REQUIRES_SHARED(Locks::mutator_lock_) {
+      static constexpr size_t kMaxDumpedOutliers = 21;
+      static_assert(kMaxDumpedOutliers < OutlierSketch::kMaxOutliers, "Too few outliers kept");
+      const double mean = sketch.Mean();
+      const double standard_deviation = sketch.StandardDeviation();
+      size_t dumped_values = 0;
+      size_t current_deviations = 0;
+      for (const OutlierSketch::Entry& entry : sketch.GetLargest()) {
+        const double deviation = entry.first - mean;
+        if (dumped_values == kMaxDumpedOutliers || deviation <= standard_deviation) {
+          break;
+        }
+        // The largest number of standard deviations the value is strictly above.
+        size_t deviations = max_deviations;
+        if (standard_deviation > 0.0 && deviation / standard_deviation <= max_deviations) {
+          deviations = static_cast<size_t>(std::ceil(deviation / standard_deviation)) - 1u;
+        }
+        if (deviations != current_deviations) {
+          os << "\n" << title << " (" << value_name << " > " << deviations
+             << " standard deviations the norm):\n";
+          current_deviations = deviations;
         }
+        os << ArtMethod::PrettyMethod(entry.second) << value_description;
+        if (value_is_size) {
+          os << PrettySize(static_cast<size_t>(entry.first)) << "\n";
+        } else {
+          os << entry.first << "\n";
+        }
+        dumped_values++;
       }
-      if (skipped_values > 0) {
+      const size_t values_above = sketch.CountAbove(mean + standard_deviation);
+      if (values_above > dumped_values) {
+        const size_t skipped_values = values_above - dumped_values;
         os << "... skipped " << skipped_values
-           << " methods with expansion > 1 standard deviation from the norm\n";
+           << " methods with " << value_name << " > 1 standard deviation from the norm\n";
       }
-      os << "\n" << std::flush;
     }
 
     void Dump(std::ostream& os, std::ostream& indent_os)
@@ -2657,7 +4356,7 @@ class ImageDumper {
 
       os << "object_bytes breakdown:\n";
       size_t object_bytes_total = 0;
-      for (const auto& sizes_and_count : sizes_and_counts) {
+      for (const auto& sizes_and_count : GetSizesAndCountsByDescriptor()) {
         const std::string& descriptor(sizes_and_count.first);
         double average = static_cast<double>(sizes_and_count.second.bytes) /
             static_cast<double>(sizes_and_count.second.count);
@@ -2809,16 +4508,23 @@ static int DumpImages(Runtime* runtime, OatDumperOptions* options, std::ostream*
   return EXIT_SUCCESS;
 }
 
+// Prepares the runtime for InstallOatFile. Must be called once, before the first oat file is
+// installed.
+static void PrepareRuntimeForOatFiles(Thread* self) REQUIRES_SHARED(Locks::mutator_lock_) {
+  CHECK(self != nullptr);
+  // Need well-known-classes.
+  WellKnownClasses::Init(self->GetJniEnv());
+  // Creating a class loader runs initializers through the unstarted runtime, so make sure it's
+  // initialized.
+  interpreter::UnstartedRuntime::Initialize();
+}
+
 static jobject InstallOatFile(Runtime* runtime,
                               std::unique_ptr<OatFile> oat_file,
                               std::vector<const DexFile*>* class_path)
     REQUIRES_SHARED(Locks::mutator_lock_) {
   Thread* self = Thread::Current();
   CHECK(self != nullptr);
-  // Need well-known-classes.
-  WellKnownClasses::Init(self->GetJniEnv());
-
-  // Need to register dex files to get a working dex cache.
   OatFile* oat_file_ptr = oat_file.get();
   ClassLinker* class_linker = runtime->GetClassLinker();
   runtime->GetOatFileManager().RegisterOatFile(std::move(oat_file));
@@ -2826,22 +4532,53 @@ static jobject InstallOatFile(Runtime* runtime,
     std::string error_msg;
     const DexFile* const dex_file = OpenDexFile(odf, &error_msg);
     CHECK(dex_file != nullptr) << error_msg;
-    ObjPtr<mirror::DexCache> dex_cache =
-        class_linker->RegisterDexFile(*dex_file, nullptr);
-    CHECK(dex_cache != nullptr);
     class_path->push_back(dex_file);
   }
 
   // Need a class loader. Fake that we're a compiler.
-  // Note: this will run initializers through the unstarted runtime, so make sure it's
-  //       initialized.
-  interpreter::UnstartedRuntime::Initialize();
-
   jobject class_loader = class_linker->CreatePathClassLoader(self, *class_path);
 
+  // Need to register dex files to get a working dex cache. They are registered with the class
+  // loader, so that their dex caches can be freed along with it (see ReleaseOatFiles).
+  StackHandleScope<1> hs(self);
+  Handle<mirror::ClassLoader> loader_handle = hs.NewHandle(
+      ObjPtr<mirror::ClassLoader>::DownCast(self->DecodeJObject(class_loader)));
+  for (const DexFile* dex_file : *class_path) {
+    ObjPtr<mirror::DexCache> dex_cache =
+        class_linker->RegisterDexFile(*dex_file, loader_handle.Get());
+    CHECK(dex_cache != nullptr);
+  }
+
   return class_loader;
 }
 
+// Deletes the oat files installed with InstallOatFile, given with their class loaders, once the
+// class loaders are collected along with their classes and dex caches. The global references to
+// the class loaders are deleted. An oat file whose class loader is still reachable stays mapped.
+static void ReleaseOatFiles(Runtime* runtime,
+                            const std::vector<std::pair<jobject, const OatFile*>>& oat_files)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  Thread* self = Thread::Current();
+  JavaVMExt* vm = self->GetJniEnv()->vm;
+  std::vector<jweak> weak_class_loaders;
+  for (const std::pair<jobject, const OatFile*>& oat_file : oat_files) {
+    weak_class_loaders.push_back(vm->AddWeakGlobalRef(self, self->DecodeJObject(oat_file.first)));
+    vm->DeleteGlobalRef(self, oat_file.first);
+  }
+  runtime->GetHeap()->CollectGarbage(/* clear_soft_references */ true);
+  for (size_t i = 0; i != oat_files.size(); ++i) {
+    const OatFile* oat_file = oat_files[i].second;
+    if (self->IsJWeakCleared(weak_class_loaders[i])) {
+      CloseDexFiles(oat_file);
+      runtime->GetOatFileManager().UnRegisterAndDeleteOatFile(oat_file);
+    } else {
+      LOG(WARNING) << "Class loader of " << oat_file->GetLocation()
+                   << " is still reachable, keeping the oat file";
+    }
+    vm->DeleteWeakGlobalRef(self, weak_class_loaders[i]);
+  }
+}
+
 static int DumpOatWithRuntime(Runtime* runtime,
                               std::unique_ptr<OatFile> oat_file,
                               OatDumperOptions* options,
@@ -2851,6 +4588,7 @@ static int DumpOatWithRuntime(Runtime* runtime,
 
   OatFile* oat_file_ptr = oat_file.get();
   std::vector<const DexFile*> class_path;
+  PrepareRuntimeForOatFiles(soa.Self());
   jobject class_loader = InstallOatFile(runtime, std::move(oat_file), &class_path);
 
   // Use the class loader while dumping.
@@ -2898,6 +4636,242 @@ static int DumpOat(Runtime* runtime, const char* oat_filename, OatDumperOptions*
   }
 }
 
+// Summarizes an image file from its mapped bytes, without a runtime, so that images of any
+// instruction set can be processed at disk speed. Only the data with a layout independent of the
+// runtime is read: the header and the image roots are printed, while the ArtMethods, the object
+// bitmap and the serialized intern and class tables are only counted. References and native
+// pointers in the image are addresses in the space the image was compiled for and are translated
+// to offsets into the mapping.
+class ImageSummaryDumper {
+ public:
+  ImageSummaryDumper(std::ostream* os, const std::string& image_filename)
+      : os_(os), image_filename_(image_filename), header_(nullptr) {}
+
+  bool Dump(std::string* error_msg) {
+    std::unique_ptr<File> file(OS::OpenFileForReading(image_filename_.c_str()));
+    if (file == nullptr) {
+      *error_msg = "Failed to open image file " + image_filename_;
+      return false;
+    }
+    const int64_t file_length = file->GetLength();
+    if (file_length < static_cast<int64_t>(sizeof(ImageHeader))) {
+      *error_msg = "Image file " + image_filename_ + " is too short";
+      return false;
+    }
+    map_.reset(MemMap::MapFile(static_cast<size_t>(file_length),
+                               PROT_READ,
+                               MAP_PRIVATE,
+                               file->Fd(),
+                               /* start */ 0,
+                               /* low_4gb */ false,
+                               image_filename_.c_str(),
+                               error_msg));
+    if (map_ == nullptr) {
+      return false;
+    }
+    header_ = reinterpret_cast<const ImageHeader*>(map_->Begin());
+    if (!header_->IsValid()) {
+      *error_msg = "Invalid image header in " + image_filename_;
+      return false;
+    }
+    if (header_->GetStorageMode() != ImageHeader::kStorageModeUncompressed) {
+      *error_msg = StringPrintf("Compressed image %s (storage mode %d) cannot be dumped offline",
+                                image_filename_.c_str(),
+                                static_cast<int>(header_->GetStorageMode()));
+      return false;
+    }
+    if (header_->GetImageSize() > map_->Size()) {
+      *error_msg = "Image file " + image_filename_ + " is truncated";
+      return false;
+    }
+
+    DumpHeader();
+    DumpRoots();
+    DumpStats();
+    *os_ << std::flush;
+    return true;
+  }
+
+ private:
+  void DumpHeader() {
+    std::ostream& os = *os_;
+    os << "MAGIC: " << header_->GetMagic() << "\n\n";
+    os << "IMAGE LOCATION: " << image_filename_ << "\n\n";
+    os << "IMAGE BEGIN: " << reinterpret_cast<void*>(header_->GetImageBegin()) << "\n\n";
+    os << "IMAGE SIZE: " << header_->GetImageSize() << "\n\n";
+    for (size_t i = 0; i < ImageHeader::kSectionCount; ++i) {
+      auto section = static_cast<ImageHeader::ImageSections>(i);
+      os << "IMAGE SECTION " << section << ": " << header_->GetImageSection(section) << "\n\n";
+    }
+    os << "OAT CHECKSUM: " << StringPrintf("0x%08x\n\n", header_->GetOatChecksum());
+    os << "OAT FILE BEGIN:" << reinterpret_cast<void*>(header_->GetOatFileBegin()) << "\n\n";
+    os << "OAT DATA BEGIN:" << reinterpret_cast<void*>(header_->GetOatDataBegin()) << "\n\n";
+    os << "OAT DATA END:" << reinterpret_cast<void*>(header_->GetOatDataEnd()) << "\n\n";
+    os << "OAT FILE END:" << reinterpret_cast<void*>(header_->GetOatFileEnd()) << "\n\n";
+    os << "PATCH DELTA:" << header_->GetPatchDelta() << "\n\n";
+    os << "COMPILE PIC: " << (header_->CompilePic() ? "yes" : "no") << "\n\n";
+    os << "POINTER SIZE: " << static_cast<size_t>(header_->GetPointerSize()) << "\n\n";
+  }
+
+  // Only the address of the roots is used, which needs no mutator lock.
+  void DumpRoots() NO_THREAD_SAFETY_ANALYSIS {
+    std::ostream& os = *os_;
+    const uint32_t roots_address = dchecked_integral_cast<uint32_t>(
+        reinterpret_cast<uintptr_t>(header_->GetImageRoots<kWithoutReadBarrier>()));
+    os << "ROOTS: " << StringPrintf("0x%08x", roots_address) << "\n";
+    uint32_t roots_offset;
+    int32_t length;
+    if (!ToOffset(roots_address, &roots_offset) ||
+        !Read(roots_offset + mirror::Array::LengthOffset().Uint32Value(), &length) ||
+        length < 0) {
+      os << "  INVALID ROOTS\n\n";
+      return;
+    }
+    const uint32_t data_offset = roots_offset +
+        mirror::Array::DataOffset(sizeof(mirror::HeapReference<mirror::Object>)).Uint32Value();
+    for (int32_t i = 0; i < std::min<int32_t>(length, ImageHeader::kImageRootsMax); ++i) {
+      uint32_t value = 0u;
+      Read(data_offset + i * sizeof(mirror::HeapReference<mirror::Object>), &value);
+      os << StringPrintf("  %s: 0x%08x\n", image_roots_descriptions_[i], value);
+    }
+    os << "\n";
+  }
+
+  class CountArtMethodsVisitor : public ArtMethodVisitor {
+   public:
+    explicit CountArtMethodsVisitor(const ImageHeader* header)
+        : header_(header),
+          num_methods(0u),
+          num_native_methods(0u),
+          num_abstract_methods(0u),
+          num_compiled_methods(0u) {}
+
+    void Visit(ArtMethod* method) OVERRIDE {
+      // Read the fields directly, the accessors may look at the declaring class.
+      const uint8_t* raw = reinterpret_cast<const uint8_t*>(method);
+      uint32_t access_flags;
+      memcpy(&access_flags,
+             raw + ArtMethod::DeclaringClassOffset().Uint32Value() +
+                 sizeof(GcRoot<mirror::Class>),
+             sizeof(access_flags));
+      const PointerSize pointer_size = header_->GetPointerSize();
+      uint64_t entry_point = 0u;
+      memcpy(&entry_point,
+             raw + ArtMethod::EntryPointFromQuickCompiledCodeOffset(pointer_size).Uint32Value(),
+             static_cast<size_t>(pointer_size));
+      ++num_methods;
+      if ((access_flags & kAccNative) != 0u) {
+        ++num_native_methods;
+      } else if ((access_flags & kAccAbstract) != 0u) {
+        ++num_abstract_methods;
+      }
+      if (entry_point >= reinterpret_cast<uintptr_t>(header_->GetOatDataBegin()) &&
+          entry_point < reinterpret_cast<uintptr_t>(header_->GetOatFileEnd())) {
+        ++num_compiled_methods;
+      }
+    }
+
+   private:
+    const ImageHeader* const header_;
+
+   public:
+    size_t num_methods;
+    size_t num_native_methods;
+    size_t num_abstract_methods;
+    // Methods whose entry point is in the oat file, possibly a trampoline.
+    size_t num_compiled_methods;
+  };
+
+  void DumpStats() {
+    std::ostream& os = *os_;
+    os << "STATS:\n";
+
+    // The bitmap has one bit per kObjectAlignment bytes of the objects section.
+    const ImageSection& bitmap_section = header_->GetImageSection(ImageHeader::kSectionImageBitmap);
+    size_t num_objects = 0u;
+    if (bitmap_section.End() <= map_->Size()) {
+      for (uint32_t i = bitmap_section.Offset(); i != bitmap_section.End(); ++i) {
+        num_objects += POPCOUNT(static_cast<uint32_t>(map_->Begin()[i]));
+      }
+    }
+    os << StringPrintf("objects          = %8zu (%u bytes)\n",
+                       num_objects,
+                       header_->GetImageSection(ImageHeader::kSectionObjects).Size());
+
+    CountArtMethodsVisitor visitor(header_);
+    header_->VisitPackedArtMethods(&visitor, map_->Begin(), header_->GetPointerSize());
+    os << StringPrintf("art_methods      = %8zu (native %zu, abstract %zu, oat entry point %zu)\n",
+                       visitor.num_methods,
+                       visitor.num_native_methods,
+                       visitor.num_abstract_methods,
+                       visitor.num_compiled_methods);
+    os << StringPrintf("interned_strings = %8" PRIu64 "\n",
+                       GetSerializedSetSize(ImageHeader::kSectionInternedStrings));
+    os << StringPrintf("classes          = %8" PRIu64 "\n",
+                       GetSerializedSetSize(ImageHeader::kSectionClassTable));
+    os << "\n";
+  }
+
+  // Returns the number of elements of the HashSet serialized in `section`, as written by the
+  // intern and class tables. The element count comes first.
+  uint64_t GetSerializedSetSize(ImageHeader::ImageSections section) {
+    const ImageSection& image_section = header_->GetImageSection(section);
+    uint64_t num_elements = 0u;
+    if (image_section.Size() >= sizeof(num_elements)) {
+      Read(image_section.Offset(), &num_elements);
+    }
+    return num_elements;
+  }
+
+  // Converts an address in the image space to an offset into the image file.
+  bool ToOffset(uint32_t address, uint32_t* offset) const {
+    const uint32_t image_begin =
+        dchecked_integral_cast<uint32_t>(reinterpret_cast<uintptr_t>(header_->GetImageBegin()));
+    if (address < image_begin || address - image_begin >= header_->GetImageSize()) {
+      return false;
+    }
+    *offset = address - image_begin;
+    return true;
+  }
+
+  template <typename T>
+  bool Read(size_t offset, T* value) const {
+    if (offset > map_->Size() || map_->Size() - offset < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, map_->Begin() + offset, sizeof(T));
+    return true;
+  }
+
+  std::ostream* const os_;
+  const std::string image_filename_;
+  std::unique_ptr<MemMap> map_;
+  const ImageHeader* header_;
+
+  DISALLOW_COPY_AND_ASSIGN(ImageSummaryDumper);
+};
+
+// Summarizes the image and then dumps its oat file, both without a runtime.
+static int DumpImageSummary(const char* image_location,
+                            InstructionSet isa,
+                            OatDumperOptions* options,
+                            std::ostream* os) {
+  std::string image_filename;
+  if (!LocationToFilename(image_location, isa, &image_filename)) {
+    fprintf(stderr, "No image file for location '%s'\n", image_location);
+    return EXIT_FAILURE;
+  }
+  ImageSummaryDumper image_dumper(os, image_filename);
+  std::string error_msg;
+  if (!image_dumper.Dump(&error_msg)) {
+    fprintf(stderr, "%s\n", error_msg.c_str());
+    return EXIT_FAILURE;
+  }
+  const std::string oat_filename = ImageHeader::GetOatLocationFromImageLocation(image_filename);
+  *os << "OAT LOCATION: " << oat_filename << "\n\n";
+  return DumpOat(nullptr, oat_filename.c_str(), options, os);
+}
+
 static int SymbolizeOat(const char* oat_filename, std::string& output_name, bool no_bits) {
   std::string error_msg;
   OatFile* oat_file = OatFile::Open(oat_filename,
@@ -2931,6 +4905,535 @@ static int SymbolizeOat(const char* oat_filename, std::string& output_name, bool
   return EXIT_SUCCESS;
 }
 
+// Read lines from the given stream, dropping comments and empty lines
+static std::vector<std::string> ReadCommentedInputStream(std::istream& in_stream) {
+  std::vector<std::string> output;
+  while (in_stream.good()) {
+    std::string dot;
+    std::getline(in_stream, dot);
+    if (android::base::StartsWith(dot, "#") || dot.empty()) {
+      continue;
+    }
+    output.push_back(dot);
+  }
+  return output;
+}
+
+// Read lines from the given file, dropping comments and empty lines.
+static std::vector<std::string> ReadCommentedInputFromFile(const std::string& input_filename) {
+  std::unique_ptr<std::ifstream> input_file(new std::ifstream(input_filename, std::ifstream::in));
+  if (input_file.get() == nullptr) {
+    LOG(ERROR) << "Failed to open input file " << input_filename;
+    return std::vector<std::string>();
+  }
+  std::vector<std::string> result = ReadCommentedInputStream(*input_file);
+  input_file->close();
+  return result;
+}
+
+// Symbolizes the PCs listed in `pcs_filename`, one per line. A PC is relative to the executable
+// offset, as for --addr2instr, and may be preceded by the oat file containing it, which defaults
+// to `oat_filename`. Each oat file is opened and indexed once for all of its PCs.
+static int SymbolizePcs(const char* pcs_filename,
+                        const char* oat_filename,
+                        OatDumperOptions* options,
+                        std::ostream* os) {
+  CHECK(options != nullptr);
+  if (!OS::FileExists(pcs_filename)) {
+    fprintf(stderr, "Failed to open PC list '%s'\n", pcs_filename);
+    return EXIT_FAILURE;
+  }
+  // No image = no class loader.
+  ScopedNullHandle<mirror::ClassLoader> null_class_loader;
+  options->class_loader_ = &null_class_loader;
+
+  // Oat files that failed to open are kept with a null dumper, so that they are reported once.
+  std::map<std::string, std::pair<std::unique_ptr<OatFile>, std::unique_ptr<OatDumper>>> dumpers;
+  bool success = true;
+  for (const std::string& line : ReadCommentedInputFromFile(pcs_filename)) {
+    std::istringstream fields(line);
+    std::string first;
+    std::string second;
+    fields >> first >> second;
+    const bool has_oat_location = !second.empty();
+    const std::string oat_location =
+        has_oat_location ? first : (oat_filename != nullptr ? oat_filename : "");
+    uint32_t pc;
+    if (oat_location.empty() || !ParseUint((has_oat_location ? second : first).c_str(), &pc)) {
+      fprintf(stderr, "Malformed PC line '%s'\n", line.c_str());
+      success = false;
+      continue;
+    }
+    auto it = dumpers.find(oat_location);
+    if (it == dumpers.end()) {
+      std::string error_msg;
+      std::unique_ptr<OatFile> oat_file(OatFile::Open(oat_location,
+                                                      oat_location,
+                                                      nullptr,
+                                                      nullptr,
+                                                      false,
+                                                      /*low_4gb*/false,
+                                                      nullptr,
+                                                      &error_msg));
+      std::unique_ptr<OatDumper> dumper;
+      if (oat_file == nullptr) {
+        fprintf(stderr, "Failed to open oat file from '%s': %s\n",
+                oat_location.c_str(), error_msg.c_str());
+      } else {
+        dumper.reset(new OatDumper(*oat_file, *options));
+      }
+      it = dumpers.emplace(oat_location, std::make_pair(std::move(oat_file), std::move(dumper)))
+          .first;
+    }
+    OatDumper* dumper = it->second.second.get();
+    if (dumper == nullptr || !dumper->SymbolizePc(*os, pc)) {
+      success = false;
+    }
+  }
+  *os << std::flush;
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Prints the header and the dex files of a vdex file, which has no compiled code to dump.
+static bool DumpVdex(const std::string& vdex_filename,
+                     OatDumperOptions* options,
+                     std::ostream* os,
+                     std::string* error_msg) {
+  std::unique_ptr<VdexFile> vdex_file(VdexFile::Open(vdex_filename,
+                                                     /* writable */ false,
+                                                     /* low_4gb */ false,
+                                                     /* unquicken */ false,
+                                                     /* decompile_return_instruction */ false,
+                                                     error_msg));
+  if (vdex_file == nullptr) {
+    return false;
+  }
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  if (!vdex_file->OpenAllDexFiles(&dex_files, error_msg)) {
+    return false;
+  }
+  const VdexFile::Header& header = vdex_file->GetHeader();
+  if (options->output_format_ == OatDumpOutputFormat::kJsonLines) {
+    JsonRecord("vdex_header")
+        .AddString("location", vdex_filename)
+        .AddString("version", header.GetVersion())
+        .AddUint("dex_file_count", header.GetNumberOfDexFiles())
+        .AddUint("dex_size", header.GetDexSize())
+        .AddUint("verifier_deps_size", header.GetVerifierDepsSize())
+        .AddUint("quickening_info_size", header.GetQuickeningInfoSize())
+        .Write(*os);
+    for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+      JsonRecord("dex_file")
+          .AddString("location", dex_file->GetLocation())
+          .AddUint("checksum", dex_file->GetLocationChecksum())
+          .AddUint("class_defs", dex_file->NumClassDefs())
+          .Write(*os);
+    }
+    return true;
+  }
+  *os << "VDEX LOCATION: " << vdex_filename << "\n\n";
+  *os << "VDEX VERSION: " << header.GetVersion() << "\n\n";
+  *os << "DEX FILE COUNT: " << header.GetNumberOfDexFiles() << "\n\n";
+  *os << "DEX SIZE: " << header.GetDexSize() << "\n\n";
+  *os << "VERIFIER DEPS SIZE: " << header.GetVerifierDepsSize() << "\n\n";
+  *os << "QUICKENING INFO SIZE: " << header.GetQuickeningInfoSize() << "\n\n";
+  for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+    *os << StringPrintf("%s: checksum 0x%08x, %u class defs\n",
+                        dex_file->GetLocation().c_str(),
+                        dex_file->GetLocationChecksum(),
+                        dex_file->NumClassDefs());
+  }
+  *os << "\n";
+  return true;
+}
+
+// Number of manifest entries opened per job before their output is written. Bounds the number of
+// oat files mapped and the memory used for buffered output.
+static constexpr size_t kBatchEntriesPerJob = 4;
+
+// Dumps every oat, odex or vdex file listed in `manifest_filename` with a single runtime, boot
+// image and process. Each line of the manifest holds a file, optionally followed by the file the
+// dump of that file is written to. Dumps without their own output file are written to `os` in
+// manifest order, each followed by a BATCH RESULT line. The files are dumped on options->jobs_
+// threads, each file serially. After each window of files is written out, its oat files are
+// unmapped; with a runtime, once the garbage collector has freed their class loaders.
+static int DumpBatch(Runtime* runtime,
+                     const char* manifest_filename,
+                     OatDumperOptions* options,
+                     std::ostream* os) NO_THREAD_SAFETY_ANALYSIS {
+  CHECK(options != nullptr);
+  if (!OS::FileExists(manifest_filename)) {
+    fprintf(stderr, "Failed to open batch manifest '%s'\n", manifest_filename);
+    return EXIT_FAILURE;
+  }
+
+  struct Entry {
+    std::string input;
+    std::string output;
+    std::unique_ptr<OatFile> oat_file;
+    OatFile* installed_oat_file = nullptr;
+    jobject class_loader_ref = nullptr;
+    Handle<mirror::ClassLoader> class_loader;
+    std::ostringstream buffer;
+    std::string error_msg;
+    bool success = false;
+  };
+
+  std::vector<std::unique_ptr<Entry>> entries;
+  for (const std::string& line : ReadCommentedInputFromFile(manifest_filename)) {
+    std::istringstream fields(line);
+    std::unique_ptr<Entry> entry(new Entry());
+    fields >> entry->input >> entry->output;
+    if (!entry->input.empty()) {
+      entries.push_back(std::move(entry));
+    }
+  }
+
+  // The pool is over files, so each file is dumped serially.
+  const size_t jobs = options->jobs_;
+  const OatDumperOptions file_options(options->dump_vmap_,
+                                      options->dump_code_info_stack_maps_,
+                                      options->disassemble_code_,
+                                      options->absolute_addresses_,
+                                      options->class_filter_,
+                                      options->method_filter_,
+                                      options->filter_syntax_,
+                                      options->list_classes_,
+                                      options->list_methods_,
+                                      options->dump_header_only_,
+                                      options->export_dex_location_,
+                                      options->app_image_,
+                                      options->app_oat_,
+                                      options->addr2instr_,
+                                      options->addr2instr_index_,
+                                      /* jobs */ 1u,
+                                      options->output_format_,
+                                      options->image_stats_only_,
+                                      options->profile_);
+  ScopedNullHandle<mirror::ClassLoader> null_class_loader;
+  std::unique_ptr<ScopedObjectAccess> soa;
+  if (runtime != nullptr) {
+    soa.reset(new ScopedObjectAccess(Thread::Current()));
+    PrepareRuntimeForOatFiles(soa->Self());
+  }
+
+  // Disassemblers are not thread safe, so each job takes one out of the pool of the instruction
+  // set of its file and puts it back when done. Creating them is expensive, e.g. for ARM.
+  std::mutex disassemblers_lock;
+  std::map<InstructionSet, std::vector<std::unique_ptr<Disassembler>>> disassemblers;
+  auto acquire_disassembler = [&](InstructionSet isa) -> std::unique_ptr<Disassembler> {
+    std::lock_guard<std::mutex> lock(disassemblers_lock);
+    std::vector<std::unique_ptr<Disassembler>>& pool = disassemblers[isa];
+    if (pool.empty()) {
+      return nullptr;
+    }
+    std::unique_ptr<Disassembler> disassembler = std::move(pool.back());
+    pool.pop_back();
+    return disassembler;
+  };
+  auto release_disassembler = [&](InstructionSet isa, std::unique_ptr<Disassembler> disassembler) {
+    std::lock_guard<std::mutex> lock(disassemblers_lock);
+    disassemblers[isa].push_back(std::move(disassembler));
+  };
+
+  size_t num_failures = 0u;
+  const size_t window_size = jobs * kBatchEntriesPerJob;
+  for (size_t window_begin = 0; window_begin < entries.size(); window_begin += window_size) {
+    const size_t window_end = std::min(entries.size(), window_begin + window_size);
+    // Open the oat files up front. Installing them in the runtime is not thread safe.
+    std::unique_ptr<VariableSizedHandleScope> handles;
+    if (runtime != nullptr) {
+      handles.reset(new VariableSizedHandleScope(soa->Self()));
+    }
+    for (size_t i = window_begin; i != window_end; ++i) {
+      Entry* entry = entries[i].get();
+      if (android::base::EndsWith(entry->input, ".vdex")) {
+        continue;
+      }
+      entry->oat_file.reset(OatFile::Open(entry->input,
+                                          entry->input,
+                                          nullptr,
+                                          nullptr,
+                                          false,
+                                          /*low_4gb*/false,
+                                          nullptr,
+                                          &entry->error_msg));
+      if (entry->oat_file != nullptr && runtime != nullptr) {
+        entry->installed_oat_file = entry->oat_file.get();
+        std::vector<const DexFile*> class_path;
+        entry->class_loader_ref = InstallOatFile(runtime, std::move(entry->oat_file), &class_path);
+        entry->class_loader =
+            handles->NewHandle(soa->Decode<mirror::ClassLoader>(entry->class_loader_ref));
+      } else if (entry->oat_file != nullptr) {
+        entry->installed_oat_file = entry->oat_file.get();
+      }
+    }
+
+    RunParallel(jobs, window_end - window_begin, [&](size_t i) {
+      Entry* entry = entries[window_begin + i].get();
+      std::unique_ptr<std::ofstream> output_file;
+      std::ostream* entry_os = &entry->buffer;
+      if (!entry->output.empty()) {
+        output_file.reset(new std::ofstream(entry->output));
+        if (!output_file->good()) {
+          entry->error_msg = "Failed to open output file " + entry->output;
+          return;
+        }
+        entry_os = output_file.get();
+      }
+      if (android::base::EndsWith(entry->input, ".vdex")) {
+        entry->success = DumpVdex(entry->input, options, entry_os, &entry->error_msg);
+      } else if (entry->installed_oat_file != nullptr) {
+        OatDumperOptions entry_options(file_options);
+        entry_options.class_loader_ =
+            (runtime != nullptr) ? &entry->class_loader : &null_class_loader;
+        const InstructionSet isa = entry->installed_oat_file->GetOatHeader().GetInstructionSet();
+        std::unique_ptr<Disassembler> disassembler = acquire_disassembler(isa);
+        {
+          OatDumper oat_dumper(*entry->installed_oat_file, entry_options, disassembler.get());
+          entry->success = oat_dumper.Dump(*entry_os);
+          if (disassembler == nullptr) {
+            disassembler = oat_dumper.ReleaseDisassembler();
+          }
+        }
+        release_disassembler(isa, std::move(disassembler));
+      }
+      if (output_file != nullptr) {
+        output_file->flush();
+        entry->success = entry->success && output_file->good();
+      }
+    });
+
+    std::vector<std::pair<jobject, const OatFile*>> installed_oat_files;
+    for (size_t i = window_begin; i != window_end; ++i) {
+      Entry* entry = entries[i].get();
+      if (options->output_format_ == OatDumpOutputFormat::kJsonLines) {
+        *os << entry->buffer.str();
+        JsonRecord("batch_result")
+            .AddString("file", entry->input)
+            .AddString("output", entry->output)
+            .AddBool("success", entry->success)
+            .AddString("error", entry->error_msg)
+            .Write(*os);
+      } else {
+        if (entry->output.empty()) {
+          *os << "BATCH FILE: " << entry->input << "\n\n" << entry->buffer.str();
+        }
+        *os << "BATCH RESULT: " << entry->input << ": "
+            << (entry->success ? "ok" : "failed");
+        if (!entry->output.empty()) {
+          *os << " -> " << entry->output;
+        }
+        if (!entry->error_msg.empty()) {
+          *os << " (" << entry->error_msg << ")";
+        }
+        *os << "\n\n";
+      }
+      *os << std::flush;
+      if (!entry->success) {
+        ++num_failures;
+      }
+      // Release the output and, without a runtime, the oat file along with its dex files.
+      if (entry->oat_file != nullptr) {
+        CloseDexFiles(entry->oat_file.get());
+      }
+      if (entry->class_loader_ref != nullptr) {
+        installed_oat_files.emplace_back(entry->class_loader_ref, entry->installed_oat_file);
+      }
+      entries[i].reset();
+    }
+    // With a runtime, the oat files of the window are released along with their class loaders.
+    if (runtime != nullptr) {
+      handles.reset();
+      ReleaseOatFiles(runtime, installed_oat_files);
+    }
+  }
+
+  if (options->output_format_ == OatDumpOutputFormat::kText) {
+    *os << "BATCH SUMMARY: " << (entries.size() - num_failures) << " of " << entries.size()
+        << " files dumped\n";
+  }
+  return (num_failures == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Compares the compiled methods of two oat files, e.g. built by two compiler versions. Methods
+// are matched by dex location and method index, so both must be compiled from the same dex
+// files. Reports the size deltas per Stats byte kind, then the methods that changed, largest size
+// delta first.
+static int DiffOat(const char* old_oat_filename,
+                   const char* new_oat_filename,
+                   OatDumperOptions* options,
+                   std::ostream* os) {
+  CHECK(options != nullptr);
+  // No image = no class loader.
+  ScopedNullHandle<mirror::ClassLoader> null_class_loader;
+  options->class_loader_ = &null_class_loader;
+
+  // Both oat files stay open until the end, as the dex file cache is keyed by OatDexFile.
+  const char* const oat_filenames[] = { old_oat_filename, new_oat_filename };
+  std::unique_ptr<OatFile> oat_files[arraysize(oat_filenames)];
+  std::map<OatDumper::MethodKey, OatDumper::MethodSizes> sizes[arraysize(oat_filenames)];
+  int64_t total_bits[arraysize(oat_filenames)][OatDumper::Stats::kByteKindCount] = {};
+  for (size_t i = 0; i != arraysize(oat_filenames); ++i) {
+    std::string error_msg;
+    oat_files[i].reset(OatFile::Open(oat_filenames[i],
+                                     oat_filenames[i],
+                                     nullptr,
+                                     nullptr,
+                                     false,
+                                     /*low_4gb*/false,
+                                     nullptr,
+                                     &error_msg));
+    if (oat_files[i] == nullptr) {
+      fprintf(stderr, "Failed to open oat file from '%s': %s\n",
+              oat_filenames[i], error_msg.c_str());
+      return EXIT_FAILURE;
+    }
+    OatDumper oat_dumper(*oat_files[i], *options);
+    oat_dumper.CollectMethodSizes(&sizes[i]);
+    for (const auto& entry : sizes[i]) {
+      // Deduplicated code and metadata are only stored once.
+      if (!entry.second.deduped) {
+        for (size_t kind = 0; kind != OatDumper::Stats::kByteKindCount; ++kind) {
+          total_bits[i][kind] += entry.second.bits[kind];
+        }
+      }
+    }
+  }
+
+  struct MethodDiff {
+    const std::string* name;  // Owned by old_sizes or new_sizes.
+    const OatDumper::MethodSizes* old_sizes;  // Null for an added method.
+    const OatDumper::MethodSizes* new_sizes;  // Null for a removed method.
+    int64_t bits[OatDumper::Stats::kByteKindCount];
+    int64_t delta_bits;
+    int64_t stack_maps_delta;
+    int64_t inline_infos_delta;
+  };
+  std::vector<MethodDiff> diffs;
+  size_t num_matched = 0u;
+  size_t num_added = 0u;
+  size_t num_removed = 0u;
+  auto add_diff = [&](const OatDumper::MethodSizes* old_sizes,
+                      const OatDumper::MethodSizes* new_sizes) {
+    static const OatDumper::MethodSizes kNoSizes = OatDumper::MethodSizes();
+    const OatDumper::MethodSizes& old_or_none = (old_sizes != nullptr) ? *old_sizes : kNoSizes;
+    const OatDumper::MethodSizes& new_or_none = (new_sizes != nullptr) ? *new_sizes : kNoSizes;
+    MethodDiff diff;
+    diff.name = (new_sizes != nullptr) ? &new_sizes->name : &old_sizes->name;
+    diff.old_sizes = old_sizes;
+    diff.new_sizes = new_sizes;
+    diff.delta_bits = 0;
+    bool changed = (old_sizes == nullptr) || (new_sizes == nullptr);
+    for (size_t kind = 0; kind != OatDumper::Stats::kByteKindCount; ++kind) {
+      diff.bits[kind] = new_or_none.bits[kind] - old_or_none.bits[kind];
+      diff.delta_bits += diff.bits[kind];
+      changed = changed || (diff.bits[kind] != 0);
+    }
+    diff.stack_maps_delta = static_cast<int64_t>(new_or_none.num_stack_maps) -
+                            static_cast<int64_t>(old_or_none.num_stack_maps);
+    diff.inline_infos_delta = static_cast<int64_t>(new_or_none.num_inline_infos) -
+                              static_cast<int64_t>(old_or_none.num_inline_infos);
+    if (changed || diff.stack_maps_delta != 0 || diff.inline_infos_delta != 0) {
+      diffs.push_back(diff);
+    }
+  };
+  for (const auto& entry : sizes[0]) {
+    auto it = sizes[1].find(entry.first);
+    if (it == sizes[1].end()) {
+      ++num_removed;
+      add_diff(&entry.second, nullptr);
+    } else {
+      ++num_matched;
+      add_diff(&entry.second, &it->second);
+    }
+  }
+  for (const auto& entry : sizes[1]) {
+    if (sizes[0].find(entry.first) == sizes[0].end()) {
+      ++num_added;
+      add_diff(nullptr, &entry.second);
+    }
+  }
+  std::stable_sort(diffs.begin(), diffs.end(), [](const MethodDiff& lhs, const MethodDiff& rhs) {
+    auto magnitude = [](int64_t value) { return value < 0 ? -value : value; };
+    return magnitude(lhs.delta_bits) > magnitude(rhs.delta_bits);
+  });
+
+  const bool json = options->output_format_ == OatDumpOutputFormat::kJsonLines;
+  const size_t num_changed = diffs.size() - num_added - num_removed;
+  if (json) {
+    JsonRecord("diff")
+        .AddString("old", old_oat_filename)
+        .AddString("new", new_oat_filename)
+        .AddUint("matched_methods", num_matched)
+        .AddUint("changed_methods", num_changed)
+        .AddUint("added_methods", num_added)
+        .AddUint("removed_methods", num_removed)
+        .Write(*os);
+  } else {
+    *os << "OAT DIFF:\n"
+        << "old: " << old_oat_filename << "\n"
+        << "new: " << new_oat_filename << "\n"
+        << StringPrintf("methods: %zu matched, %zu changed, %zu added, %zu removed\n\n",
+                        num_matched, num_changed, num_added, num_removed);
+    *os << StringPrintf("%-32s %12s %12s %12s\n", "BYTES", "old", "new", "delta");
+  }
+  for (size_t kind = 0; kind != OatDumper::Stats::kByteKindCount; ++kind) {
+    const char* name =
+        OatDumper::Stats::GetByteKindName(static_cast<OatDumper::Stats::ByteKind>(kind));
+    const int64_t old_bytes = total_bits[0][kind] / kBitsPerByte;
+    const int64_t new_bytes = total_bits[1][kind] / kBitsPerByte;
+    if (json) {
+      JsonRecord("diff_stats")
+          .AddString("kind", name)
+          .AddInt("old_bytes", old_bytes)
+          .AddInt("new_bytes", new_bytes)
+          .AddInt("delta_bytes", new_bytes - old_bytes)
+          .Write(*os);
+    } else {
+      *os << StringPrintf("%-32s %12" PRId64 " %12" PRId64 " %+12" PRId64 "\n",
+                          name, old_bytes, new_bytes, new_bytes - old_bytes);
+    }
+  }
+
+  if (!json) {
+    *os << "\nMETHOD DELTAS (bytes, largest first):\n";
+  }
+  for (const MethodDiff& diff : diffs) {
+    const char* status = (diff.old_sizes == nullptr) ? "added"
+        : (diff.new_sizes == nullptr) ? "removed" : "changed";
+    const int64_t code_delta = diff.bits[OatDumper::Stats::kByteKindCode];
+    const int64_t header_delta = diff.bits[OatDumper::Stats::kByteKindQuickMethodHeader];
+    const int64_t code_info_delta = diff.delta_bits - code_delta - header_delta;
+    if (json) {
+      JsonRecord("method_diff")
+          .AddString("name", *diff.name)
+          .AddString("status", status)
+          .AddInt("delta_bytes", diff.delta_bits / kBitsPerByte)
+          .AddInt("code_delta_bytes", code_delta / kBitsPerByte)
+          .AddInt("method_header_delta_bytes", header_delta / kBitsPerByte)
+          .AddInt("code_info_delta_bytes", code_info_delta / kBitsPerByte)
+          .AddInt("stack_maps_delta", diff.stack_maps_delta)
+          .AddInt("inline_infos_delta", diff.inline_infos_delta)
+          .Write(*os);
+    } else {
+      *os << StringPrintf("  %+8" PRId64 " %-7s code=%+" PRId64 " header=%+" PRId64
+                          " code_info=%+" PRId64 " stack_maps=%+" PRId64
+                          " inline_infos=%+" PRId64 " %s\n",
+                          diff.delta_bits / kBitsPerByte,
+                          status,
+                          code_delta / kBitsPerByte,
+                          header_delta / kBitsPerByte,
+                          code_info_delta / kBitsPerByte,
+                          diff.stack_maps_delta,
+                          diff.inline_infos_delta,
+                          diff.name->c_str());
+    }
+  }
+  *os << std::flush;
+  return EXIT_SUCCESS;
+}
+
 class IMTDumper {
  public:
   static bool Dump(Runtime* runtime,
@@ -2959,6 +5462,7 @@ class IMTDumper {
         return false;
       }
 
+      PrepareRuntimeForOatFiles(self);
       class_loader.Assign(soa.Decode<mirror::ClassLoader>(
           InstallOatFile(runtime, std::move(oat_file), &class_path)));
     } else {
@@ -3317,32 +5821,6 @@ class IMTDumper {
     }
   }
 
-  // Read lines from the given stream, dropping comments and empty lines
-  static std::vector<std::string> ReadCommentedInputStream(std::istream& in_stream) {
-    std::vector<std::string> output;
-    while (in_stream.good()) {
-      std::string dot;
-      std::getline(in_stream, dot);
-      if (android::base::StartsWith(dot, "#") || dot.empty()) {
-        continue;
-      }
-      output.push_back(dot);
-    }
-    return output;
-  }
-
-  // Read lines from the given file, dropping comments and empty lines.
-  static std::vector<std::string> ReadCommentedInputFromFile(const std::string& input_filename) {
-    std::unique_ptr<std::ifstream> input_file(new std::ifstream(input_filename, std::ifstream::in));
-    if (input_file.get() == nullptr) {
-      LOG(ERROR) << "Failed to open input file " << input_filename;
-      return std::vector<std::string>();
-    }
-    std::vector<std::string> result = ReadCommentedInputStream(*input_file);
-    input_file->close();
-    return result;
-  }
-
   // Prepare a class, i.e., ensure it has a filled IMT. Will do so recursively for superclasses,
   // and note in the given set that the work was done.
   static void PrepareClass(Runtime* runtime,
@@ -3406,6 +5884,18 @@ struct OatdumpArgs : public CmdlineArgs {
       class_filter_ = option.substr(strlen("--class-filter=")).data();
     } else if (option.starts_with("--method-filter=")) {
       method_filter_ = option.substr(strlen("--method-filter=")).data();
+    } else if (option.starts_with("--filter-syntax=")) {
+      const StringPiece syntax = option.substr(strlen("--filter-syntax="));
+      if (syntax == "substring") {
+        filter_syntax_ = NameFilter::kSyntaxSubstring;
+      } else if (syntax == "glob") {
+        filter_syntax_ = NameFilter::kSyntaxGlob;
+      } else if (syntax == "regex") {
+        filter_syntax_ = NameFilter::kSyntaxRegex;
+      } else {
+        *error_msg = "--filter-syntax must be one of substring, glob or regex";
+        return kParseError;
+      }
     } else if (option.starts_with("--list-classes")) {
       list_classes_ = true;
     } else if (option.starts_with("--list-methods")) {
@@ -3413,16 +5903,47 @@ struct OatdumpArgs : public CmdlineArgs {
     } else if (option.starts_with("--export-dex-to=")) {
       export_dex_location_ = option.substr(strlen("--export-dex-to=")).data();
     } else if (option.starts_with("--addr2instr=")) {
-      if (!ParseUint(option.substr(strlen("--addr2instr=")).data(), &addr2instr_)) {
+      uint32_t addr2instr;
+      if (!ParseUint(option.substr(strlen("--addr2instr=")).data(), &addr2instr)) {
         *error_msg = "Address conversion failed";
         return kParseError;
       }
+      addr2instr_.push_back(addr2instr);
+    } else if (option.starts_with("--symbolize-pcs=")) {
+      symbolize_pcs_ = option.substr(strlen("--symbolize-pcs=")).data();
+    } else if (option.starts_with("--profile=")) {
+      profile_filename_ = option.substr(strlen("--profile=")).data();
+    } else if (option.starts_with("--batch=")) {
+      batch_manifest_ = option.substr(strlen("--batch=")).data();
+    } else if (option.starts_with("--diff=")) {
+      diff_oat_filename_ = option.substr(strlen("--diff=")).data();
+    } else if (option.starts_with("--addr2instr-index=")) {
+      addr2instr_index_ = option.substr(strlen("--addr2instr-index=")).data();
+    } else if (option.starts_with("--jobs=")) {
+      if (!ParseUint(option.substr(strlen("--jobs=")).data(), &jobs_) || jobs_ == 0u) {
+        *error_msg = "--jobs must be a positive number";
+        return kParseError;
+      }
+    } else if (option.starts_with("--output-format=")) {
+      const StringPiece format = option.substr(strlen("--output-format="));
+      if (format == "text") {
+        output_format_ = OatDumpOutputFormat::kText;
+      } else if (format == "jsonl") {
+        output_format_ = OatDumpOutputFormat::kJsonLines;
+      } else {
+        *error_msg = "--output-format must be either text or jsonl";
+        return kParseError;
+      }
     } else if (option.starts_with("--app-image=")) {
       app_image_ = option.substr(strlen("--app-image=")).data();
     } else if (option.starts_with("--app-oat=")) {
       app_oat_ = option.substr(strlen("--app-oat=")).data();
     } else if (option.starts_with("--dump-imt=")) {
       imt_dump_ = option.substr(strlen("--dump-imt=")).data();
+    } else if (option == "--image-stats-only") {
+      image_stats_only_ = true;
+    } else if (option == "--image-summary") {
+      image_summary_ = true;
     } else if (option == "--dump-imt-stats") {
       imt_stat_dump_ = true;
     } else {
@@ -3445,7 +5966,46 @@ struct OatdumpArgs : public CmdlineArgs {
     }
 
     // Perform our own checks.
-    if (image_location_ == nullptr && oat_filename_ == nullptr) {
+    for (const char* pattern : { class_filter_, method_filter_ }) {
+      NameFilter filter;
+      if (!filter.Init(pattern, filter_syntax_, error_msg)) {
+        return kParseError;
+      }
+    }
+    if (diff_oat_filename_ != nullptr && oat_filename_ == nullptr) {
+      *error_msg = "--diff requires --oat-file";
+      return kParseError;
+    }
+    if (image_summary_ && image_location_ == nullptr) {
+      *error_msg = "--image-summary requires --image";
+      return kParseError;
+    }
+    if (image_summary_ && (app_image_ != nullptr || !imt_dump_.empty() || imt_stat_dump_)) {
+      *error_msg = "--image-summary cannot be used with --app-image or --dump-imt";
+      return kParseError;
+    }
+    if (profile_filename_ != nullptr) {
+      // Indexed profiles are mapped, which needs MemMap. The runtime calls Init() again later,
+      // which does nothing.
+      MemMap::Init();
+      std::unique_ptr<File> profile_file(OS::OpenFileForReading(profile_filename_));
+      profile_.reset(new ProfileCompilationInfo());
+      if (profile_file == nullptr || !profile_->Load(profile_file->Fd())) {
+        *error_msg = StringPrintf("Failed to load profile '%s'", profile_filename_);
+        return kParseError;
+      }
+    }
+    if (batch_manifest_ != nullptr) {
+      if (image_location_ != nullptr || oat_filename_ != nullptr) {
+        *error_msg = "--batch cannot be used with --image or --oat-file";
+        return kParseError;
+      }
+    } else if (symbolize_pcs_ != nullptr) {
+      if (image_location_ != nullptr) {
+        *error_msg = "--symbolize-pcs cannot be used with --image";
+        return kParseError;
+      }
+    } else if (image_location_ == nullptr && oat_filename_ == nullptr) {
       *error_msg = "Either --image or --oat-file must be specified";
       return kParseError;
     } else if (image_location_ != nullptr && oat_filename_ != nullptr) {
@@ -3515,12 +6075,73 @@ struct OatdumpArgs : public CmdlineArgs {
         "  --method-filter=<method name>: only dumps methods that contain the filter.\n"
         "      Example: --method-filter=foo\n"
         "\n"
+        "  --filter-syntax=(substring|glob|regex): how --class-filter and --method-filter\n"
+        "      are matched. A glob must match the whole name, a POSIX extended regular\n"
+        "      expression any part of it. Defaults to substring.\n"
+        "      Example: --filter-syntax=glob --class-filter='com.example.*'\n"
+        "\n"
         "  --export-dex-to=<directory>: may be used to export oat embedded dex files.\n"
+        "      With --class-filter, only dex files defining a matching class are exported.\n"
+        "      Dex files are exported on --jobs threads.\n"
         "      Example: --export-dex-to=/data/local/tmp\n"
         "\n"
         "  --addr2instr=<address>: output matching method disassembled code from relative\n"
         "                          address (e.g. PC from crash dump)\n"
         "      Example: --addr2instr=0x00001a3b\n"
+        "      May be repeated to look up several addresses in one run.\n"
+        "\n"
+        "  --addr2instr-index=<file>: cache for the code ranges used by --addr2instr and\n"
+        "      --symbolize-pcs. The file is created if it does not hold the index of the\n"
+        "      dumped oat file yet.\n"
+        "      Example: --addr2instr-index=/data/local/tmp/boot.oat.idx\n"
+        "\n"
+        "  --symbolize-pcs=<file>: output the method, dex pc and inlined frames of each PC\n"
+        "      listed in the file, without disassembling. Each line holds a PC relative to\n"
+        "      the executable offset, optionally preceded by an oat file. The oat file\n"
+        "      defaults to --oat-file.\n"
+        "      Example: --symbolize-pcs=pcs.txt\n"
+        "\n"
+        "  --diff=<old.oat>: compare the compiled methods of --oat-file with those of\n"
+        "      old.oat, which must be compiled from the same dex files; methods are matched\n"
+        "      by dex location and method index. Outputs the size delta of the code and of\n"
+        "      each kind of metadata, then the changed methods, largest delta first.\n"
+        "      Example: --oat-file=new/boot.oat --diff=old/boot.oat\n"
+        "\n"
+        "  --profile=<file.prof>: only dump the hot methods of the profile and the methods\n"
+        "      of its startup classes, also in the oat file stats and the image outlier\n"
+        "      analysis. Oat dumps list the startup classes first, then the classes with hot\n"
+        "      methods, and end with the PROFILE COVERAGE of each dex file: hot methods that\n"
+        "      are compiled or left to the interpreter, compiled methods that are not hot,\n"
+        "      and the methods of startup classes.\n"
+        "      Example: --oat-file=base.odex --profile=primary.prof\n"
+        "\n"
+        "  --batch=<file>: dump every oat, odex or vdex file listed in the file in one\n"
+        "      process, sharing the runtime and the boot image given by --boot-image. Each\n"
+        "      line holds a file, optionally followed by the file its dump is written to.\n"
+        "      Other dumps are written to the output in manifest order. A BATCH RESULT line\n"
+        "      reports the outcome for each file. Files are dumped on --jobs threads.\n"
+        "      Example: --boot-image=/system/framework/boot.art --batch=odex.txt --jobs=16\n"
+        "\n"
+        "  --jobs=<N>: dump the classes of each dex file on N threads. The output is the\n"
+        "      same as for a serial dump.\n"
+        "      Example: --jobs=8\n"
+        "\n"
+        "  --output-format=(text|jsonl): select the oat file dump format. jsonl writes one\n"
+        "      JSON object per line, each with a \"record\" field naming its kind (oat_header,\n"
+        "      dex_file, class, method, stack_map, stats, ...). Image dumps are always text.\n"
+        "      Example: --output-format=jsonl\n"
+        "\n"
+        "  --image-stats-only: skip the per-object and per-method output of image dumps\n"
+        "      and only print the header, the roots and the STATS summary.\n"
+        "      Example: --image=/system/framework/boot.art --image-stats-only\n"
+        "\n"
+        "  --image-summary: summarize --image without starting a runtime, so that images\n"
+        "      of any instruction set can be processed quickly. The image is mapped\n"
+        "      read-only; only its header and roots are printed, and its objects,\n"
+        "      ArtMethods, interned strings and classes are counted but not decoded. Its\n"
+        "      oat file is then dumped without the verifier type analysis. Compressed\n"
+        "      images are not supported.\n"
+        "      Example: --image=boot.art --instruction-set=arm64 --image-summary\n"
         "\n"
         "  --dump-imt=<file.txt>: output IMT collisions (if any) for the given receiver\n"
         "                         types and interface methods in the given file. The file\n"
@@ -3540,6 +6161,7 @@ struct OatdumpArgs : public CmdlineArgs {
   const char* oat_filename_ = nullptr;
   const char* class_filter_ = "";
   const char* method_filter_ = "";
+  NameFilter::Syntax filter_syntax_ = NameFilter::kSyntaxSubstring;
   const char* image_location_ = nullptr;
   std::string elf_filename_prefix_;
   std::string imt_dump_;
@@ -3552,7 +6174,17 @@ struct OatdumpArgs : public CmdlineArgs {
   bool list_methods_ = false;
   bool dump_header_only_ = false;
   bool imt_stat_dump_ = false;
-  uint32_t addr2instr_ = 0;
+  bool image_stats_only_ = false;
+  bool image_summary_ = false;
+  std::vector<uint32_t> addr2instr_;
+  const char* addr2instr_index_ = nullptr;
+  const char* symbolize_pcs_ = nullptr;
+  const char* diff_oat_filename_ = nullptr;
+  const char* batch_manifest_ = nullptr;
+  const char* profile_filename_ = nullptr;
+  std::unique_ptr<ProfileCompilationInfo> profile_;
+  size_t jobs_ = 1;
+  OatDumpOutputFormat output_format_ = OatDumpOutputFormat::kText;
   const char* export_dex_location_ = nullptr;
   const char* app_image_ = nullptr;
   const char* app_oat_ = nullptr;
@@ -3562,8 +6194,9 @@ struct OatdumpMain : public CmdlineMain<OatdumpArgs> {
   virtual bool NeedsRuntime() OVERRIDE {
     CHECK(args_ != nullptr);
 
-    // If we are only doing the oat file, disable absolute_addresses. Keep them for image dumping.
-    bool absolute_addresses = (args_->oat_filename_ == nullptr);
+    // If we are only doing oat files, disable absolute_addresses. Keep them for image dumping.
+    bool absolute_addresses =
+        (args_->oat_filename_ == nullptr && args_->batch_manifest_ == nullptr);
 
     oat_dumper_options_.reset(new OatDumperOptions(
         args_->dump_vmap_,
@@ -3572,33 +6205,65 @@ struct OatdumpMain : public CmdlineMain<OatdumpArgs> {
         absolute_addresses,
         args_->class_filter_,
         args_->method_filter_,
+        args_->filter_syntax_,
         args_->list_classes_,
         args_->list_methods_,
         args_->dump_header_only_,
         args_->export_dex_location_,
         args_->app_image_,
         args_->app_oat_,
-        args_->addr2instr_));
+        args_->addr2instr_,
+        args_->addr2instr_index_,
+        args_->jobs_,
+        args_->output_format_,
+        args_->image_stats_only_,
+        args_->profile_.get()));
 
     return (args_->boot_image_location_ != nullptr ||
             args_->image_location_ != nullptr ||
             !args_->imt_dump_.empty()) &&
-          !args_->symbolize_;
+          !args_->symbolize_ &&
+          !args_->image_summary_ &&
+          args_->symbolize_pcs_ == nullptr &&
+          args_->diff_oat_filename_ == nullptr;
   }
 
   virtual bool ExecuteWithoutRuntime() OVERRIDE {
     CHECK(args_ != nullptr);
-    CHECK(args_->oat_filename_ != nullptr);
+    CHECK(args_->oat_filename_ != nullptr ||
+          args_->symbolize_pcs_ != nullptr ||
+          args_->batch_manifest_ != nullptr ||
+          args_->image_summary_);
 
     MemMap::Init();
 
-    if (args_->symbolize_) {
+    if (args_->batch_manifest_ != nullptr) {
+      return DumpBatch(nullptr,
+                       args_->batch_manifest_,
+                       oat_dumper_options_.get(),
+                       args_->os_) == EXIT_SUCCESS;
+    } else if (args_->diff_oat_filename_ != nullptr) {
+      return DiffOat(args_->diff_oat_filename_,
+                     args_->oat_filename_,
+                     oat_dumper_options_.get(),
+                     args_->os_) == EXIT_SUCCESS;
+    } else if (args_->symbolize_pcs_ != nullptr) {
+      return SymbolizePcs(args_->symbolize_pcs_,
+                          args_->oat_filename_,
+                          oat_dumper_options_.get(),
+                          args_->os_) == EXIT_SUCCESS;
+    } else if (args_->symbolize_) {
       // ELF has special kind of section called SHT_NOBITS which allows us to create
       // sections which exist but their data is omitted from the ELF file to save space.
       // This is what "strip --only-keep-debug" does when it creates separate ELF file
       // with only debug data. We use it in similar way to exclude .rodata and .text.
       bool no_bits = args_->only_keep_debug_;
       return SymbolizeOat(args_->oat_filename_, args_->output_name_, no_bits) == EXIT_SUCCESS;
+    } else if (args_->oat_filename_ == nullptr) {
+      return DumpImageSummary(args_->image_location_,
+                              args_->instruction_set_,
+                              oat_dumper_options_.get(),
+                              args_->os_) == EXIT_SUCCESS;
     } else {
       return DumpOat(nullptr,
                      args_->oat_filename_,
@@ -3617,6 +6282,13 @@ struct OatdumpMain : public CmdlineMain<OatdumpArgs> {
                              args_->oat_filename_);
     }
 
+    if (args_->batch_manifest_ != nullptr) {
+      return DumpBatch(runtime,
+                       args_->batch_manifest_,
+                       oat_dumper_options_.get(),
+                       args_->os_) == EXIT_SUCCESS;
+    }
+
     if (args_->oat_filename_ != nullptr) {
       return DumpOat(runtime,
                      args_->oat_filename_,
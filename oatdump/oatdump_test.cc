@@ -14,23 +14,29 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "android-base/stringprintf.h"
 #include "android-base/strings.h"
 
 #include "common_runtime_test.h"
 
+#include "base/bit_utils.h"
 #include "base/unix_file/fd_file.h"
 #include "runtime/arch/instruction_set.h"
+#include "runtime/dex_file.h"
 #include "runtime/exec_utils.h"
 #include "runtime/gc/heap.h"
 #include "runtime/gc/space/image_space.h"
+#include "runtime/jit/profile_compilation_info.h"
 #include "runtime/os.h"
 #include "runtime/utils.h"
 #include "utils.h"
 
+#include <inttypes.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -63,10 +69,46 @@ class OatDumpTest : public CommonRuntimeTest {
     return root;
   }
 
+  // Returns path to the dex2oat binary.
+  std::string GetDex2OatFilePath() {
+    std::string root = GetTestAndroidRoot();
+    root += "/bin/dex2oat";
+    if (kIsDebugBuild) {
+      root += "d";
+    }
+    return root;
+  }
+
+  // Compiles the test dex file `dex_name` against the core image into a PIC oat file at
+  // `oat_location`, so that it can be dumped with a runtime.
+  bool GenerateAppOat(const char* dex_name,
+                      const std::string& compiler_filter,
+                      const std::string& oat_location,
+                      std::string* error_msg) {
+    std::vector<std::string> argv = {
+        GetDex2OatFilePath(),
+        "--runtime-arg",
+        "-Xnorelocate",
+        "--boot-image=" + core_art_location_,
+        "--instruction-set=" + std::string(GetInstructionSetString(kRuntimeISA)),
+        "--dex-file=" + GetTestDexFileName(dex_name),
+        "--oat-file=" + oat_location,
+        "--compiler-filter=" + compiler_filter,
+        "--compile-pic",
+        "--android-root=" + GetTestAndroidRoot()
+    };
+    if (!kIsTargetBuild) {
+      argv.push_back("--host");
+    }
+    return ::art::Exec(argv, error_msg);
+  }
+
   enum Mode {
     kModeOat,
     kModeArt,
     kModeSymbolize,
+    kModeSymbolizePcs,
+    kModeBatch,
   };
 
   // Display style.
@@ -88,7 +130,30 @@ class OatDumpTest : public CommonRuntimeTest {
     // ScratchFile scratch;
     std::vector<std::string> exec_argv = { file_path };
     std::vector<std::string> expected_prefixes;
-    if (mode == kModeSymbolize) {
+    std::unique_ptr<ScratchFile> pcs_file;
+    std::unique_ptr<ScratchFile> manifest_file;
+    if (mode == kModeSymbolizePcs) {
+      pcs_file.reset(new ScratchFile());
+      const std::string pcs = "# Offsets from the executable offset.\n0x100\n0x1000\n";
+      EXPECT_TRUE(pcs_file->GetFile()->WriteFully(pcs.data(), pcs.size()));
+      exec_argv.push_back("--oat-file=" + core_oat_location_);
+      exec_argv.push_back("--symbolize-pcs=" + pcs_file->GetFilename());
+      expected_prefixes.push_back("0x00000100:");
+      expected_prefixes.push_back("0x00001000:");
+    } else if (mode == kModeBatch) {
+      // The same oat file twice, dumped on two threads.
+      manifest_file.reset(new ScratchFile());
+      const std::string manifest = "# Oat files.\n" + core_oat_location_ + "\n" +
+          core_oat_location_ + "\n";
+      EXPECT_TRUE(manifest_file->GetFile()->WriteFully(manifest.data(), manifest.size()));
+      exec_argv.push_back("--batch=" + manifest_file->GetFilename());
+      exec_argv.push_back("--jobs=2");
+      expected_prefixes.push_back("BATCH FILE:");
+      expected_prefixes.push_back("LOCATION:");
+      expected_prefixes.push_back("DEX FILE COUNT:");
+      expected_prefixes.push_back("BATCH RESULT:");
+      expected_prefixes.push_back("BATCH SUMMARY: 2 of 2");
+    } else if (mode == kModeSymbolize) {
       exec_argv.push_back("--symbolize=" + core_oat_location_);
       exec_argv.push_back("--output=" + core_oat_location_ + ".symbolize");
     } else {
@@ -103,6 +168,8 @@ class OatDumpTest : public CommonRuntimeTest {
         // Code and dex code do not show up if list only.
         expected_prefixes.push_back("DEX CODE:");
         expected_prefixes.push_back("CODE:");
+        expected_prefixes.push_back("code dedup:");
+        expected_prefixes.push_back("Code layout of the compiled methods");
         expected_prefixes.push_back("CodeInfoEncoding");
         expected_prefixes.push_back("CodeInfoInlineInfo");
       }
@@ -113,6 +180,10 @@ class OatDumpTest : public CommonRuntimeTest {
         expected_prefixes.push_back("IMAGE LOCATION:");
         expected_prefixes.push_back("IMAGE BEGIN:");
         expected_prefixes.push_back("kDexCaches:");
+        if (display == kListAndCode) {
+          // Only the objects of full image dumps are checked, see TestImageStatsOnly.
+          expected_prefixes.push_back("OBJECTS:");
+        }
       } else {
         CHECK_EQ(static_cast<size_t>(mode), static_cast<size_t>(kModeOat));
         exec_argv.push_back("--oat-file=" + core_oat_location_);
@@ -216,7 +287,656 @@ class OatDumpTest : public CommonRuntimeTest {
     return result;
   }
 
- private:
+  // Checks that --export-dex-to wrote every dex file of the core oat file to `export_dir`, and
+  // that the exported dex files are valid and identical to the input dex files, i.e. that the
+  // vdex contents were unquickened back to the original bytecode.
+  void CheckExportedDexFiles(const std::string& export_dir) {
+    for (const std::string& dex_file_name : GetLibCoreDexFileNames()) {
+      std::string error_msg;
+      std::vector<std::unique_ptr<const DexFile>> input_dex_files;
+      ASSERT_TRUE(DexFile::Open(dex_file_name.c_str(),
+                                dex_file_name,
+                                /* verify_checksum */ true,
+                                &error_msg,
+                                &input_dex_files)) << error_msg;
+      for (const std::unique_ptr<const DexFile>& input : input_dex_files) {
+        const std::string& location = input->GetLocation();
+        std::string exported_name =
+            export_dir + "/" + location.substr(location.rfind('/') + 1) + "_export.dex";
+        ASSERT_TRUE(OS::FileExists(exported_name.c_str())) << exported_name;
+        std::vector<std::unique_ptr<const DexFile>> exported_dex_files;
+        ASSERT_TRUE(DexFile::Open(exported_name.c_str(),
+                                  exported_name,
+                                  /* verify_checksum */ true,
+                                  &error_msg,
+                                  &exported_dex_files)) << error_msg;
+        ASSERT_EQ(1u, exported_dex_files.size()) << exported_name;
+        const DexFile& exported = *exported_dex_files[0];
+        ASSERT_EQ(input->Size(), exported.Size()) << exported_name;
+        if (kIsVdexEnabled) {
+          // Without a vdex the bytecode is exported quickened, with a recomputed checksum.
+          EXPECT_EQ(input->GetHeader().checksum_, exported.GetHeader().checksum_) << exported_name;
+          EXPECT_EQ(0, memcmp(input->Begin(), exported.Begin(), input->Size())) << exported_name;
+        }
+      }
+    }
+  }
+
+  // Runs oatdump with `args` and returns what it wrote to --output in `output`.
+  bool ExecAndReadOutput(Flavor flavor,
+                         const std::vector<std::string>& args,
+                         std::string* output,
+                         std::string* error_msg) {
+    std::string file_path = GetOatDumpFilePath(flavor);
+    EXPECT_TRUE(OS::FileExists(file_path.c_str())) << file_path << " should be a valid file path";
+
+    ScratchFile output_file;
+    std::vector<std::string> exec_argv = { file_path };
+    exec_argv.insert(exec_argv.end(), args.begin(), args.end());
+    exec_argv.push_back("--output=" + output_file.GetFilename());
+    if (!::art::Exec(exec_argv, error_msg)) {
+      return false;
+    }
+    std::unique_ptr<File> file(OS::OpenFileForReading(output_file.GetFilename().c_str()));
+    if (file == nullptr) {
+      *error_msg = "Cannot open " + output_file.GetFilename();
+      return false;
+    }
+    int64_t length = file->GetLength();
+    output->resize(length);
+    if (length <= 0 || !file->ReadFully(&(*output)[0], length)) {
+      *error_msg = "Cannot read " + output_file.GetFilename();
+      return false;
+    }
+    return true;
+  }
+
+  // Returns the lines of `output` that start with `prefix`, ignoring indentation.
+  static std::vector<std::string> GetLinesStartingWith(const std::string& output,
+                                                       const std::string& prefix) {
+    std::vector<std::string> lines;
+    for (const std::string& line : android::base::Split(output, "\n")) {
+      std::string trimmed = android::base::Trim(line);
+      if (android::base::StartsWith(trimmed, prefix.c_str())) {
+        lines.push_back(trimmed);
+      }
+    }
+    return lines;
+  }
+
+  // Compiles ProfileTestMultiDex, whose two dex files define Main.getA/getB/getC and
+  // Second.getX/getY/getZ, and returns the location of the oat file in `oat_location`.
+  void GenerateMultiDexOat(const std::string& compiler_filter, std::string* oat_location) {
+    *oat_location = dalvik_cache_ + "/ProfileTestMultiDex_" + compiler_filter + ".odex";
+    std::string error_msg;
+    ASSERT_TRUE(GenerateAppOat("ProfileTestMultiDex", compiler_filter, *oat_location, &error_msg))
+        << error_msg;
+  }
+
+  // Every line of a --output-format=jsonl dump is one record, and none of the text dump is
+  // mixed in.
+  void CheckJsonLines(Flavor flavor) {
+    std::string oat_location;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + oat_location, "--output-format=jsonl"},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    size_t num_records = 0u;
+    for (const std::string& line : android::base::Split(output, "\n")) {
+      if (line.empty()) {
+        continue;
+      }
+      EXPECT_TRUE(android::base::StartsWith(line, "{\"record\":\"")) << line;
+      EXPECT_TRUE(android::base::EndsWith(line, "}")) << line;
+      ++num_records;
+    }
+    EXPECT_GT(num_records, 0u);
+    EXPECT_EQ(1u, GetLinesStartingWith(output, "{\"record\":\"oat_header\"").size());
+    EXPECT_EQ(2u, GetLinesStartingWith(output, "{\"record\":\"dex_file\"").size());
+    EXPECT_NE(std::string::npos, output.find("\"descriptor\":\"LMain;\""));
+    EXPECT_NE(std::string::npos, output.find("\"descriptor\":\"LSecond;\""));
+    EXPECT_NE(std::string::npos, output.find("\"name\":\"java.lang.String Main.getA()\""));
+    EXPECT_NE(std::string::npos, output.find("\"name\":\"java.lang.String Second.getX()\""));
+    EXPECT_TRUE(GetLinesStartingWith(output, "LOCATION:").empty());
+    EXPECT_TRUE(GetLinesStartingWith(output, "OatDexFile:").empty());
+    EXPECT_TRUE(GetLinesStartingWith(output, "CODE:").empty());
+  }
+
+  // Returns the value of the unsigned field `key` of the JSON record `line`.
+  static uint64_t GetJsonUint(const std::string& line, const std::string& key) {
+    const std::string quoted_key = "\"" + key + "\":";
+    size_t pos = line.find(quoted_key);
+    EXPECT_NE(std::string::npos, pos) << key << " not in " << line;
+    return (pos != std::string::npos)
+        ? strtoull(line.c_str() + pos + quoted_key.size(), nullptr, 10)
+        : 0u;
+  }
+
+  // Looks up an address inside Main.getA() and one past the code, first building the code index
+  // and then loading it, and checks that only the matching method is dumped.
+  void CheckAddr2Instr(Flavor flavor) {
+    std::string oat_location;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+    std::string json;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + oat_location, "--output-format=jsonl"},
+                                  &json,
+                                  &error_msg)) << error_msg;
+    std::vector<std::string> headers = GetLinesStartingWith(json, "{\"record\":\"oat_header\"");
+    ASSERT_EQ(1u, headers.size());
+    const uint64_t executable_offset = GetJsonUint(headers[0], "executable_offset");
+    const uint64_t oat_size = GetJsonUint(headers[0], "size");
+    uint64_t code_offset = 0u;
+    for (const std::string& line : GetLinesStartingWith(json, "{\"record\":\"method\"")) {
+      if (line.find("\"name\":\"java.lang.String Main.getA()\"") != std::string::npos) {
+        code_offset = GetJsonUint(line, "code_offset");
+      }
+    }
+    ASSERT_GT(code_offset, executable_offset);
+    // Skip the instruction set's code alignment, e.g. the Thumb bit.
+    const uint64_t address = RoundDown(code_offset, 2u) - executable_offset + 1u;
+    const uint64_t missing_address = oat_size - executable_offset + 0x1000u;
+
+    ScratchFile index;
+    const std::vector<std::string> args = {
+        "--oat-file=" + oat_location,
+        android::base::StringPrintf("--addr2instr=0x%" PRIx64, address),
+        android::base::StringPrintf("--addr2instr=0x%" PRIx64, missing_address),
+        "--addr2instr-index=" + index.GetFilename()
+    };
+    std::string outputs[2];
+    // The first run writes the index, the second one reads it.
+    for (std::string& output : outputs) {
+      ASSERT_TRUE(ExecAndReadOutput(flavor, args, &output, &error_msg)) << error_msg;
+    }
+    EXPECT_GT(index.GetFile()->GetLength(), 0);
+    EXPECT_EQ(outputs[0], outputs[1]);
+
+    const std::string& output = outputs[0];
+    EXPECT_EQ(2u, GetLinesStartingWith(output, "SEARCH ADDRESS").size());
+    EXPECT_EQ(1u, GetLinesStartingWith(output, "NOT FOUND").size());
+    EXPECT_NE(std::string::npos, output.find("Main.getA() (dex_method_idx="));
+    EXPECT_EQ(std::string::npos, output.find("Main.getB()"));
+    EXPECT_EQ(std::string::npos, output.find("Second.getX()"));
+    // Only the looked up method is dumped, not the whole oat file.
+    EXPECT_TRUE(GetLinesStartingWith(output, "OatDexFile:").empty());
+  }
+
+  // Returns whether the text dump `output` has the class line of `descriptor`.
+  static bool HasClassLine(const std::string& output, const std::string& descriptor) {
+    return output.find(": " + descriptor + " (offset=") != std::string::npos;
+  }
+
+  // Returns whether the text dump `output` has the method line of `pretty_method`.
+  static bool HasMethodLine(const std::string& output, const std::string& pretty_method) {
+    return output.find(": " + pretty_method + " (dex_method_idx=") != std::string::npos;
+  }
+
+  // Dumps the multidex app oat file with the class and method filters in `args`, and checks that
+  // exactly the expected classes and methods are dumped.
+  void CheckFilter(Flavor flavor,
+                   const std::vector<std::string>& args,
+                   const std::vector<std::string>& included_classes,
+                   const std::vector<std::string>& excluded_classes,
+                   const std::vector<std::string>& included_methods,
+                   const std::vector<std::string>& excluded_methods) {
+    std::string oat_location;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+    std::vector<std::string> filter_args = { "--oat-file=" + oat_location };
+    filter_args.insert(filter_args.end(), args.begin(), args.end());
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor, filter_args, &output, &error_msg)) << error_msg;
+    for (const std::string& descriptor : included_classes) {
+      EXPECT_TRUE(HasClassLine(output, descriptor)) << descriptor;
+    }
+    for (const std::string& descriptor : excluded_classes) {
+      EXPECT_FALSE(HasClassLine(output, descriptor)) << descriptor;
+    }
+    for (const std::string& method : included_methods) {
+      EXPECT_TRUE(HasMethodLine(output, method)) << method;
+    }
+    for (const std::string& method : excluded_methods) {
+      EXPECT_FALSE(HasMethodLine(output, method)) << method;
+    }
+  }
+
+  void CheckGlobFilter(Flavor flavor) {
+    CheckFilter(flavor,
+                {"--filter-syntax=glob", "--class-filter=Sub?", "--method-filter=get*"},
+                {"LSubA;", "LSubB;", "LSubC;"},
+                {"LMain;", "LSecond;", "LSuper;", "LTestInline;"},
+                {"int SubA.getValue()", "int SubC.getValue()"},
+                {"void SubA.<init>()", "java.lang.String Main.getA()", "int Super.getValue()"});
+  }
+
+  void CheckRegexFilter(Flavor flavor) {
+    CheckFilter(flavor,
+                {"--filter-syntax=regex",
+                 "--class-filter=^(Main|Second)$",
+                 "--method-filter=^get[AX]$"},
+                {"LMain;", "LSecond;"},
+                {"LSubA;", "LSubC;", "LSuper;", "LTestInline;"},
+                {"java.lang.String Main.getA()", "java.lang.String Second.getX()"},
+                {"java.lang.String Main.getB()",
+                 "java.lang.String Second.getY()",
+                 "void Main.<init>()"});
+  }
+
+  // A header-only dump prints the oat header and stats, but nothing that needs the dex files,
+  // which the full dump of the same file does print.
+  void CheckHeaderOnly(Flavor flavor) {
+    std::string oat_location;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+    std::string error_msg;
+    std::string full_output;
+    ASSERT_TRUE(ExecAndReadOutput(flavor, {"--oat-file=" + oat_location}, &full_output, &error_msg))
+        << error_msg;
+    std::string output;
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + oat_location, "--header-only"},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    for (const char* prefix : { "MAGIC:", "LOCATION:", "CHECKSUM:", "DEX FILE COUNT:",
+                                "OAT FILE STATS:" }) {
+      EXPECT_EQ(1u, GetLinesStartingWith(output, prefix).size()) << prefix;
+    }
+    for (const char* prefix : { "Dex file data for", "OatDexFile:", "Code layout of" }) {
+      EXPECT_FALSE(GetLinesStartingWith(full_output, prefix).empty()) << prefix;
+      EXPECT_TRUE(GetLinesStartingWith(output, prefix).empty()) << prefix;
+    }
+    EXPECT_TRUE(HasClassLine(full_output, "LMain;"));
+    EXPECT_FALSE(HasClassLine(output, "LMain;"));
+    EXPECT_LT(output.size(), full_output.size());
+  }
+
+  // Returns the code_layout record of a --output-format=jsonl dump with `args`.
+  void GetCodeLayoutRecord(Flavor flavor, const std::vector<std::string>& args, std::string* line) {
+    std::vector<std::string> json_args(args);
+    json_args.push_back("--output-format=jsonl");
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor, json_args, &output, &error_msg)) << error_msg;
+    std::vector<std::string> records = GetLinesStartingWith(output, "{\"record\":\"code_layout\"");
+    ASSERT_EQ(1u, records.size());
+    *line = records[0];
+  }
+
+  // The code layout report counts the pages touched by the code of the dumped methods, against
+  // the pages that code would need if it was contiguous.
+  void CheckCodeLayout(Flavor flavor) {
+    std::string oat_location;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+    std::string all;
+    ASSERT_NO_FATAL_FAILURE(GetCodeLayoutRecord(flavor, {"--oat-file=" + oat_location}, &all));
+    EXPECT_NE(std::string::npos, all.find("\"profiled_only\":false")) << all;
+    EXPECT_EQ(kPageSize, GetJsonUint(all, "page_size")) << all;
+    EXPECT_GT(GetJsonUint(all, "methods"), 1u) << all;
+    EXPECT_GT(GetJsonUint(all, "code_bytes"), 0u) << all;
+    EXPECT_GE(GetJsonUint(all, "pages"), GetJsonUint(all, "ideal_pages")) << all;
+    EXPECT_GE(GetJsonUint(all, "ideal_pages"), 1u) << all;
+    EXPECT_GE(GetJsonUint(all, "page_runs"), 1u) << all;
+    EXPECT_LE(GetJsonUint(all, "page_runs"), GetJsonUint(all, "pages")) << all;
+    EXPECT_LE(GetJsonUint(all, "pages"), GetJsonUint(all, "executable_pages")) << all;
+
+    // Only the filtered methods are counted.
+    std::string one;
+    ASSERT_NO_FATAL_FAILURE(GetCodeLayoutRecord(
+        flavor,
+        {"--oat-file=" + oat_location, "--class-filter=Main", "--method-filter=getA"},
+        &one));
+    EXPECT_EQ(1u, GetJsonUint(one, "methods")) << one;
+    EXPECT_LT(GetJsonUint(one, "code_bytes"), GetJsonUint(all, "code_bytes")) << one;
+    EXPECT_EQ(1u, GetJsonUint(one, "ideal_pages")) << one;
+    EXPECT_EQ(1u, GetJsonUint(one, "page_runs")) << one;
+
+    // The four TestInline.inline* methods share their code, which is counted once.
+    std::string deduped;
+    ASSERT_NO_FATAL_FAILURE(GetCodeLayoutRecord(
+        flavor,
+        {"--oat-file=" + oat_location, "--class-filter=TestInline", "--method-filter=inline"},
+        &deduped));
+    EXPECT_EQ(1u, GetJsonUint(deduped, "methods")) << deduped;
+
+    // Without compiled code nothing is touched, and there is no ideal layout to compare with.
+    std::string quicken_location;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("quicken", &quicken_location));
+    std::string none;
+    ASSERT_NO_FATAL_FAILURE(GetCodeLayoutRecord(flavor, {"--oat-file=" + quicken_location}, &none));
+    EXPECT_EQ(0u, GetJsonUint(none, "methods")) << none;
+    EXPECT_EQ(0u, GetJsonUint(none, "pages")) << none;
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor, {"--oat-file=" + quicken_location}, &output, &error_msg))
+        << error_msg;
+    EXPECT_EQ(1u, GetLinesStartingWith(output, "Code layout of the compiled methods").size());
+    EXPECT_EQ(1u, GetLinesStartingWith(output, "methods = 0 with 0 bytes of code").size());
+    EXPECT_TRUE(GetLinesStartingWith(output, "ideal   =").empty());
+
+    // Looking up addresses does not report the layout.
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + oat_location, "--addr2instr=0x0"},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    EXPECT_TRUE(GetLinesStartingWith(output, "Code layout of").empty());
+  }
+
+  // The five TestInline methods other than the constructor all compile to `return s.getValue()`,
+  // so dex2oat stores their code once. Only the first of them in dump order is disassembled.
+  void CheckCodeDedup(Flavor flavor) {
+    std::string oat_location;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor, {"--oat-file=" + oat_location}, &output, &error_msg))
+        << error_msg;
+    const std::string owner = "int TestInline.inlineMegamorphic(Super)";
+    EXPECT_TRUE(HasMethodLine(output, owner));
+    EXPECT_EQ(4u, GetLinesStartingWith(output, "same code as " + owner).size());
+    // Methods whose code is their own are never referred to.
+    EXPECT_TRUE(GetLinesStartingWith(output, "same code as java.lang.String Main.").empty());
+    EXPECT_TRUE(GetLinesStartingWith(output, "same code as java.lang.String Second.").empty());
+    std::vector<std::string> dedup_lines = GetLinesStartingWith(output, "code dedup: ");
+    ASSERT_EQ(2u, dedup_lines.size());
+    EXPECT_FALSE(android::base::StartsWith(dedup_lines[0], "code dedup: 0 of")) << dedup_lines[0];
+  }
+
+  // Returns the METHOD DELTAS lines of a --diff dump, which end with the method name.
+  static std::vector<std::string> GetMethodDeltaLines(const std::string& output,
+                                                      const std::string& status) {
+    std::vector<std::string> lines;
+    for (const std::string& line : android::base::Split(output, "\n")) {
+      if (line.find(" " + status + " code=") != std::string::npos) {
+        lines.push_back(line);
+      }
+    }
+    return lines;
+  }
+
+  // Diffs the multidex app oat file compiled with `quicken`, which has no compiled code, and with
+  // `speed`, in both directions and against itself.
+  void CheckDiff(Flavor flavor) {
+    std::string quicken_oat;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("quicken", &quicken_oat));
+    std::string speed_oat;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &speed_oat));
+    std::string error_msg;
+
+    std::string output;
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + speed_oat, "--diff=" + quicken_oat},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    std::vector<std::string> added = GetMethodDeltaLines(output, "added");
+    // Methods of both dex files are reported.
+    EXPECT_EQ(1, std::count_if(added.begin(), added.end(), [](const std::string& line) {
+      return android::base::EndsWith(line, " java.lang.String Main.getA()");
+    }));
+    EXPECT_EQ(1, std::count_if(added.begin(), added.end(), [](const std::string& line) {
+      return android::base::EndsWith(line, " java.lang.String Second.getX()");
+    }));
+    EXPECT_TRUE(GetMethodDeltaLines(output, "removed").empty());
+    EXPECT_TRUE(GetMethodDeltaLines(output, "changed").empty());
+    std::vector<std::string> summary = GetLinesStartingWith(output, "methods: ");
+    ASSERT_EQ(1u, summary.size());
+    EXPECT_EQ(android::base::StringPrintf("methods: 0 matched, 0 changed, %zu added, 0 removed",
+                                          added.size()),
+              summary[0]);
+
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + quicken_oat, "--diff=" + speed_oat},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    EXPECT_EQ(added.size(), GetMethodDeltaLines(output, "removed").size());
+    EXPECT_TRUE(GetMethodDeltaLines(output, "added").empty());
+
+    // Diffing an oat file with itself matches every method and changes none.
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + speed_oat, "--diff=" + speed_oat},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    summary = GetLinesStartingWith(output, "methods: ");
+    ASSERT_EQ(1u, summary.size());
+    EXPECT_EQ(android::base::StringPrintf("methods: %zu matched, 0 changed, 0 added, 0 removed",
+                                          added.size()),
+              summary[0]);
+    EXPECT_TRUE(GetMethodDeltaLines(output, "changed").empty());
+  }
+
+  // --image-stats-only walks the core image for the STATS summary, which the full dump also
+  // prints, without writing out the objects and methods.
+  void CheckImageStatsOnly(Flavor flavor) {
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(
+        flavor,
+        {"--image=" + core_art_location_,
+         "--instruction-set=" + std::string(GetInstructionSetString(kRuntimeISA)),
+         "--image-stats-only"},
+        &output,
+        &error_msg)) << error_msg;
+    for (const char* prefix : { "IMAGE LOCATION:", "STATS:", "art_file_bytes = ",
+                                "Method size percentiles:" }) {
+      EXPECT_FALSE(GetLinesStartingWith(output, prefix).empty()) << prefix;
+    }
+    EXPECT_TRUE(GetLinesStartingWith(output, "OBJECTS:").empty());
+    EXPECT_EQ(std::string::npos, output.find(" ArtMethod: "));
+    EXPECT_EQ(std::string::npos, output.find(": java.lang.Class \""));
+  }
+
+  // --image-summary prints the header, roots and counts of the core image without a runtime,
+  // then dumps its oat file, also without a runtime.
+  void CheckImageSummary(Flavor flavor) {
+    const std::string isa_arg =
+        "--instruction-set=" + std::string(GetInstructionSetString(kRuntimeISA));
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--image=" + core_art_location_, isa_arg, "--image-summary"},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    for (const char* prefix : { "IMAGE LOCATION:", "ROOTS:", "kDexCaches:", "STATS:",
+                                "OAT LOCATION:", "OatDexFile:" }) {
+      EXPECT_FALSE(GetLinesStartingWith(output, prefix).empty()) << prefix;
+    }
+    for (const char* prefix : { "objects ", "art_methods ", "interned_strings ", "classes " }) {
+      std::vector<std::string> lines = GetLinesStartingWith(output, prefix);
+      ASSERT_EQ(1u, lines.size()) << prefix;
+      const size_t equals = lines[0].find('=');
+      ASSERT_NE(std::string::npos, equals) << lines[0];
+      EXPECT_GT(strtoull(lines[0].c_str() + equals + 1, nullptr, 10), 0u) << lines[0];
+    }
+    // Nothing that needs a runtime is printed.
+    EXPECT_TRUE(GetLinesStartingWith(output, "OBJECTS:").empty());
+    EXPECT_EQ(std::string::npos, output.find(" ArtMethod: "));
+    EXPECT_TRUE(GetLinesStartingWith(output, "VERIFIER TYPE ANALYSIS:").empty());
+
+    // The summary is only for images.
+    EXPECT_FALSE(ExecAndReadOutput(flavor,
+                                   {"--oat-file=" + core_oat_location_, "--image-summary"},
+                                   &output,
+                                   &error_msg));
+  }
+
+  // Dumps the multidex app oat file with a profile in which Main.getA() and Second.getX() are hot
+  // and SubA is a startup class, then with an empty profile.
+  void CheckProfile(Flavor flavor) {
+    std::string oat_location;
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+    std::vector<std::unique_ptr<const DexFile>> dex_files = OpenTestDexFiles("ProfileTestMultiDex");
+    std::vector<ProfileMethodInfo> methods;
+    std::set<DexCacheResolvedClasses> classes;
+    for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+      for (uint32_t i = 0; i != dex_file->NumMethodIds(); ++i) {
+        const std::string pretty_method = dex_file->PrettyMethod(i, true);
+        if (pretty_method == "java.lang.String Main.getA()" ||
+            pretty_method == "java.lang.String Second.getX()") {
+          methods.emplace_back(dex_file.get(), i);
+        }
+      }
+      const DexFile::TypeId* startup_type = dex_file->FindTypeId("LSubA;");
+      if (startup_type != nullptr && dex_file->FindClassDef(dex_file->GetIndexForTypeId(
+              *startup_type)) != nullptr) {
+        DexCacheResolvedClasses resolved_classes(dex_file->GetLocation(),
+                                                 dex_file->GetBaseLocation(),
+                                                 dex_file->GetLocationChecksum());
+        resolved_classes.AddClass(dex_file->GetIndexForTypeId(*startup_type));
+        classes.insert(resolved_classes);
+      }
+    }
+    ASSERT_EQ(2u, methods.size());
+    ASSERT_EQ(1u, classes.size());
+    ProfileCompilationInfo info;
+    ASSERT_TRUE(info.AddMethodsAndClasses(methods, classes));
+    ScratchFile profile;
+    ASSERT_TRUE(info.Save(profile.GetFd()));
+
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + oat_location,
+                                   "--profile=" + profile.GetFilename()},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    // Startup classes come first, then the classes with hot methods. Only startup classes are
+    // marked.
+    const size_t sub_a = output.find(": LSubA; (offset=");
+    const size_t main = output.find(": LMain; (offset=");
+    ASSERT_NE(std::string::npos, sub_a);
+    ASSERT_NE(std::string::npos, main);
+    EXPECT_LT(sub_a, main);
+    EXPECT_TRUE(android::base::EndsWith(output.substr(sub_a, output.find('\n', sub_a) - sub_a),
+                                        " (startup)"));
+    EXPECT_FALSE(android::base::EndsWith(output.substr(main, output.find('\n', main) - main),
+                                         " (startup)"));
+    EXPECT_TRUE(HasClassLine(output, "LSecond;"));
+    for (const char* descriptor : { "LSubB;", "LSubC;", "LTestInline;", "LSuper;" }) {
+      EXPECT_FALSE(HasClassLine(output, descriptor)) << descriptor;
+    }
+    // Hot methods are marked, the other methods of startup classes are dumped unmarked.
+    std::vector<std::string> hot_lines;
+    for (const std::string& line : GetLinesStartingWith(output, "")) {
+      if (android::base::EndsWith(line, " (hot)")) {
+        hot_lines.push_back(line);
+      }
+    }
+    ASSERT_EQ(2u, hot_lines.size());
+    EXPECT_TRUE(HasMethodLine(hot_lines[0], "java.lang.String Main.getA()")) << hot_lines[0];
+    EXPECT_TRUE(HasMethodLine(hot_lines[1], "java.lang.String Second.getX()")) << hot_lines[1];
+    EXPECT_TRUE(HasMethodLine(output, "int SubA.getValue()"));
+    for (const char* method : { "java.lang.String Main.getB()", "java.lang.String Second.getY()",
+                                "int SubB.getValue()" }) {
+      EXPECT_FALSE(HasMethodLine(output, method)) << method;
+    }
+    // Each dex file has one compiled hot method, and the startup class has two methods.
+    size_t num_coverage_lines = 0u;
+    for (size_t pos = output.find(": profiled 1 (compiled 1, interpreted 0)");
+         pos != std::string::npos;
+         pos = output.find(": profiled 1 (compiled 1, interpreted 0)", pos + 1u)) {
+      ++num_coverage_lines;
+    }
+    EXPECT_EQ(2u, num_coverage_lines);
+    EXPECT_EQ(1u, GetLinesStartingWith(output, "startup classes 1 with 2 methods").size());
+    EXPECT_EQ(1u, GetLinesStartingWith(output, "startup classes 0 with 0 methods").size());
+
+    // Nothing is in an empty profile.
+    ScratchFile empty_profile;
+    ASSERT_TRUE(ProfileCompilationInfo().Save(empty_profile.GetFd()));
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--oat-file=" + oat_location,
+                                   "--profile=" + empty_profile.GetFilename()},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    EXPECT_FALSE(GetLinesStartingWith(output, "PROFILE COVERAGE:").empty());
+    EXPECT_FALSE(GetLinesStartingWith(output, "Code layout of the profiled methods").empty());
+    EXPECT_FALSE(HasClassLine(output, "LMain;"));
+    EXPECT_FALSE(HasClassLine(output, "LSubA;"));
+    EXPECT_EQ(2u, GetLinesStartingWith(output, "startup classes 0 with 0 methods").size());
+  }
+
+  // Dumps app oat files with a runtime in a batch that takes more than one window of files, so
+  // that the runtime is set up once for all of them, the oat files of the first window are
+  // released and disassemblers are reused across files. Each file must be dumped the same way
+  // every time it is listed.
+  void CheckBatchWithRuntime(Flavor flavor) {
+    std::string oat_locations[2];
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_locations[0]));
+    ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("quicken", &oat_locations[1]));
+    // Two jobs open eight files per window.
+    static constexpr size_t kNumEntries = 9u;
+    std::string manifest;
+    for (size_t i = 0; i != kNumEntries; ++i) {
+      manifest += oat_locations[i % 2u] + "\n";
+    }
+    ScratchFile manifest_file;
+    ASSERT_TRUE(manifest_file.GetFile()->WriteFully(manifest.data(), manifest.size()));
+    std::string output;
+    std::string error_msg;
+    ASSERT_TRUE(ExecAndReadOutput(flavor,
+                                  {"--batch=" + manifest_file.GetFilename(),
+                                   "--boot-image=" + core_art_location_,
+                                   "--jobs=2"},
+                                  &output,
+                                  &error_msg)) << error_msg;
+    EXPECT_EQ(1u, GetLinesStartingWith(output, "BATCH SUMMARY: 9 of 9 files dumped").size());
+    std::vector<std::string> results = GetLinesStartingWith(output, "BATCH RESULT: ");
+    ASSERT_EQ(kNumEntries, results.size());
+    for (size_t i = 0; i != kNumEntries; ++i) {
+      EXPECT_EQ("BATCH RESULT: " + oat_locations[i % 2u] + ": ok", results[i]);
+    }
+
+    // The dump of each file runs from its BATCH FILE line to its BATCH RESULT line.
+    std::vector<std::string> dumps;
+    for (size_t begin = output.find("BATCH FILE: "); begin != std::string::npos; ) {
+      size_t end = output.find("BATCH RESULT: ", begin);
+      ASSERT_NE(std::string::npos, end);
+      dumps.push_back(output.substr(begin, end - begin));
+      begin = output.find("BATCH FILE: ", end);
+    }
+    ASSERT_EQ(kNumEntries, dumps.size());
+    for (size_t i = 0; i != kNumEntries; ++i) {
+      EXPECT_TRUE(HasMethodLine(dumps[i], "java.lang.String Main.getA()")) << i;
+      EXPECT_TRUE(HasMethodLine(dumps[i], "java.lang.String Second.getX()")) << i;
+      EXPECT_EQ(dumps[i % 2u], dumps[i]) << i;
+    }
+    EXPECT_NE(dumps[0], dumps[1]);
+  }
+
+  // Dumps with `args` serially and with --jobs=4, and checks that the outputs are the same byte
+  // for byte.
+  bool ExecParallelAndCompare(Flavor flavor,
+                              const std::vector<std::string>& args,
+                              std::string* error_msg) {
+    std::string outputs[2];
+    const char* jobs[] = { "--jobs=1", "--jobs=4" };
+    for (size_t i = 0; i != arraysize(jobs); ++i) {
+      std::vector<std::string> jobs_args(args);
+      jobs_args.push_back(jobs[i]);
+      if (!ExecAndReadOutput(flavor, jobs_args, &outputs[i], error_msg)) {
+        return false;
+      }
+    }
+    if (outputs[0].size() != outputs[1].size()) {
+      *error_msg = android::base::StringPrintf(
+          "--jobs=4 output has %zu bytes, --jobs=1 output has %zu bytes",
+          outputs[1].size(),
+          outputs[0].size());
+      return false;
+    }
+    if (outputs[0] != outputs[1]) {
+      auto mismatch = std::mismatch(outputs[0].begin(), outputs[0].end(), outputs[1].begin());
+      *error_msg = android::base::StringPrintf(
+          "--jobs=4 output differs from --jobs=1 output at byte %zu",
+          static_cast<size_t>(mismatch.first - outputs[0].begin()));
+      return false;
+    }
+    return true;
+  }
+
   std::string core_art_location_;
   std::string core_oat_location_;
 };
@@ -284,6 +1004,177 @@ TEST_F(OatDumpTest, TestListMethodsStatic) {
   ASSERT_TRUE(Exec(kStatic, kModeArt, {"--list-methods"}, kListOnly, &error_msg)) << error_msg;
 }
 
+TEST_F(OatDumpTest, TestParallel) {
+  std::string error_msg;
+  ASSERT_TRUE(ExecParallelAndCompare(kDynamic, {"--oat-file=" + core_oat_location_}, &error_msg))
+      << error_msg;
+}
+TEST_F(OatDumpTest, TestParallelStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  std::string error_msg;
+  ASSERT_TRUE(ExecParallelAndCompare(kStatic, {"--oat-file=" + core_oat_location_}, &error_msg))
+      << error_msg;
+}
+
+// With a runtime the workers also run the verifier, which needs them attached and holding the
+// mutator lock.
+TEST_F(OatDumpTest, TestParallelWithRuntime) {
+  std::string oat_location;
+  ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+  std::string error_msg;
+  ASSERT_TRUE(ExecParallelAndCompare(
+      kDynamic,
+      {"--oat-file=" + oat_location, "--boot-image=" + core_art_location_},
+      &error_msg)) << error_msg;
+}
+TEST_F(OatDumpTest, TestParallelWithRuntimeStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  std::string oat_location;
+  ASSERT_NO_FATAL_FAILURE(GenerateMultiDexOat("speed", &oat_location));
+  std::string error_msg;
+  ASSERT_TRUE(ExecParallelAndCompare(
+      kStatic,
+      {"--oat-file=" + oat_location, "--boot-image=" + core_art_location_},
+      &error_msg)) << error_msg;
+}
+
+TEST_F(OatDumpTest, TestJsonLines) {
+  CheckJsonLines(kDynamic);
+}
+TEST_F(OatDumpTest, TestJsonLinesStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckJsonLines(kStatic);
+}
+
+TEST_F(OatDumpTest, TestAddr2Instr) {
+  CheckAddr2Instr(kDynamic);
+}
+TEST_F(OatDumpTest, TestAddr2InstrStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckAddr2Instr(kStatic);
+}
+
+TEST_F(OatDumpTest, TestCodeDedup) {
+  CheckCodeDedup(kDynamic);
+}
+TEST_F(OatDumpTest, TestCodeDedupStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckCodeDedup(kStatic);
+}
+
+TEST_F(OatDumpTest, TestGlobFilter) {
+  CheckGlobFilter(kDynamic);
+}
+TEST_F(OatDumpTest, TestGlobFilterStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckGlobFilter(kStatic);
+}
+
+TEST_F(OatDumpTest, TestRegexFilter) {
+  CheckRegexFilter(kDynamic);
+}
+TEST_F(OatDumpTest, TestRegexFilterStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckRegexFilter(kStatic);
+}
+
+TEST_F(OatDumpTest, TestExportDex) {
+  std::string error_msg;
+  // The exported dex files are removed along with the dalvik cache.
+  ASSERT_TRUE(Exec(kDynamic,
+                   kModeOat,
+                   {"--export-dex-to=" + dalvik_cache_, "--jobs=4"},
+                   kListOnly,
+                   &error_msg)) << error_msg;
+  CheckExportedDexFiles(dalvik_cache_);
+}
+TEST_F(OatDumpTest, TestExportDexStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  std::string error_msg;
+  ASSERT_TRUE(Exec(kStatic,
+                   kModeOat,
+                   {"--export-dex-to=" + dalvik_cache_, "--jobs=4"},
+                   kListOnly,
+                   &error_msg)) << error_msg;
+  CheckExportedDexFiles(dalvik_cache_);
+}
+
+TEST_F(OatDumpTest, TestImageStatsOnly) {
+  CheckImageStatsOnly(kDynamic);
+}
+TEST_F(OatDumpTest, TestImageStatsOnlyStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckImageStatsOnly(kStatic);
+}
+
+TEST_F(OatDumpTest, TestImageSummary) {
+  CheckImageSummary(kDynamic);
+}
+TEST_F(OatDumpTest, TestImageSummaryStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckImageSummary(kStatic);
+}
+
+TEST_F(OatDumpTest, TestHeaderOnly) {
+  CheckHeaderOnly(kDynamic);
+}
+TEST_F(OatDumpTest, TestHeaderOnlyStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckHeaderOnly(kStatic);
+}
+
+TEST_F(OatDumpTest, TestCodeLayout) {
+  CheckCodeLayout(kDynamic);
+}
+TEST_F(OatDumpTest, TestCodeLayoutStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckCodeLayout(kStatic);
+}
+
+TEST_F(OatDumpTest, TestDiff) {
+  CheckDiff(kDynamic);
+}
+TEST_F(OatDumpTest, TestDiffStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckDiff(kStatic);
+}
+
+TEST_F(OatDumpTest, TestBatch) {
+  std::string error_msg;
+  ASSERT_TRUE(Exec(kDynamic, kModeBatch, {}, kListOnly, &error_msg)) << error_msg;
+}
+TEST_F(OatDumpTest, TestBatchStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  std::string error_msg;
+  ASSERT_TRUE(Exec(kStatic, kModeBatch, {}, kListOnly, &error_msg)) << error_msg;
+}
+
+TEST_F(OatDumpTest, TestBatchWithRuntime) {
+  CheckBatchWithRuntime(kDynamic);
+}
+TEST_F(OatDumpTest, TestBatchWithRuntimeStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckBatchWithRuntime(kStatic);
+}
+
+TEST_F(OatDumpTest, TestProfile) {
+  CheckProfile(kDynamic);
+}
+TEST_F(OatDumpTest, TestProfileStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  CheckProfile(kStatic);
+}
+
+TEST_F(OatDumpTest, TestSymbolizePcs) {
+  std::string error_msg;
+  ASSERT_TRUE(Exec(kDynamic, kModeSymbolizePcs, {}, kListOnly, &error_msg)) << error_msg;
+}
+TEST_F(OatDumpTest, TestSymbolizePcsStatic) {
+  TEST_DISABLED_FOR_NON_STATIC_HOST_BUILDS();
+  std::string error_msg;
+  ASSERT_TRUE(Exec(kStatic, kModeSymbolizePcs, {}, kListOnly, &error_msg)) << error_msg;
+}
+
 TEST_F(OatDumpTest, TestSymbolize) {
   std::string error_msg;
   ASSERT_TRUE(Exec(kDynamic, kModeSymbolize, {}, kListOnly, &error_msg)) << error_msg;
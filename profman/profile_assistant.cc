@@ -16,6 +16,10 @@
 
 #include "profile_assistant.h"
 
+#include <atomic>
+#include <functional>
+#include <thread>
+
 #include "base/unix_file/fd_file.h"
 #include "os.h"
 
@@ -26,9 +30,74 @@ namespace art {
 static constexpr const uint32_t kMinNewMethodsForCompilation = 10;
 static constexpr const uint32_t kMinNewClassesForCompilation = 10;
 
+// Runs task(0) ... task(num_tasks - 1) concurrently, one thread per task.
+static void RunTasks(size_t num_tasks, const std::function<void(size_t)>& task) {
+  if (num_tasks == 1) {
+    task(0);
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < num_tasks; ++i) {
+    threads.emplace_back(task, i);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+// The profile files are split into `jobs` contiguous ranges. Each range is loaded and merged
+// into its own partial profile concurrently, holding at most one decoded input at a time. The
+// partial profiles are then merged pairwise, in log2(jobs) rounds. Every merge keeps the dex files
+// of the left profile first, so the result is the same as merging the files one after the other.
+bool ProfileAssistant::MergeProfiles(const std::vector<ScopedFlock>& profile_files,
+                                     size_t jobs,
+                                     ProfileCompilationInfo* info) {
+  const size_t num_partials = std::max<size_t>(1u, std::min(jobs, profile_files.size()));
+  std::vector<std::unique_ptr<ProfileCompilationInfo>> owned_partials(num_partials);
+  std::vector<ProfileCompilationInfo*> partials(num_partials, info);
+  for (size_t i = 1; i < num_partials; ++i) {
+    owned_partials[i].reset(new ProfileCompilationInfo());
+    partials[i] = owned_partials[i].get();
+  }
+
+  std::atomic<bool> success(true);
+  RunTasks(num_partials, [&](size_t partial_index) {
+    const size_t begin = profile_files.size() * partial_index / num_partials;
+    const size_t end = profile_files.size() * (partial_index + 1) / num_partials;
+    for (size_t i = begin; i < end && success.load(std::memory_order_relaxed); ++i) {
+      ProfileCompilationInfo cur_info;
+      if (!cur_info.Load(profile_files[i].GetFile()->Fd())) {
+        LOG(WARNING) << "Could not load profile file at index " << i;
+        success = false;
+        return;
+      }
+      if (!partials[partial_index]->MergeWith(cur_info)) {
+        LOG(WARNING) << "Could not merge profile file at index " << i;
+        success = false;
+        return;
+      }
+    }
+  });
+
+  for (size_t stride = 1; stride < num_partials && success; stride *= 2) {
+    const size_t num_merges = (num_partials - stride + 2 * stride - 1) / (2 * stride);
+    RunTasks(num_merges, [&](size_t merge_index) {
+      const size_t left = merge_index * 2 * stride;
+      const size_t right = left + stride;
+      if (!partials[left]->MergeWith(*partials[right])) {
+        LOG(WARNING) << "Could not merge partial profiles " << left << " and " << right;
+        success = false;
+      }
+      owned_partials[right].reset();
+    });
+  }
+  return success;
+}
+
 ProfileAssistant::ProcessingResult ProfileAssistant::ProcessProfilesInternal(
         const std::vector<ScopedFlock>& profile_files,
-        const ScopedFlock& reference_profile_file) {
+        const ScopedFlock& reference_profile_file,
+        size_t jobs) {
   DCHECK(!profile_files.empty());
 
   ProfileCompilationInfo info;
@@ -43,16 +112,8 @@ ProfileAssistant::ProcessingResult ProfileAssistant::ProcessProfilesInternal(
   uint32_t number_of_classes = info.GetNumberOfResolvedClasses();
 
   // Merge all current profiles.
-  for (size_t i = 0; i < profile_files.size(); i++) {
-    ProfileCompilationInfo cur_info;
-    if (!cur_info.Load(profile_files[i].GetFile()->Fd())) {
-      LOG(WARNING) << "Could not load profile file at index " << i;
-      return kErrorBadProfiles;
-    }
-    if (!info.MergeWith(cur_info)) {
-      LOG(WARNING) << "Could not merge profile file at index " << i;
-      return kErrorBadProfiles;
-    }
+  if (!MergeProfiles(profile_files, jobs, &info)) {
+    return kErrorBadProfiles;
   }
 
   // Check if there is enough new information added by the current profiles.
@@ -121,7 +182,8 @@ class ScopedCollectionFlock {
 
 ProfileAssistant::ProcessingResult ProfileAssistant::ProcessProfiles(
         const std::vector<int>& profile_files_fd,
-        int reference_profile_file_fd) {
+        int reference_profile_file_fd,
+        size_t jobs) {
   DCHECK_GE(reference_profile_file_fd, 0);
   std::string error;
   ScopedCollectionFlock profile_files_flocks(profile_files_fd.size());
@@ -136,12 +198,14 @@ ProfileAssistant::ProcessingResult ProfileAssistant::ProcessProfiles(
   }
 
   return ProcessProfilesInternal(profile_files_flocks.Get(),
-                                 reference_profile_file_flock);
+                                 reference_profile_file_flock,
+                                 jobs);
 }
 
 ProfileAssistant::ProcessingResult ProfileAssistant::ProcessProfiles(
         const std::vector<std::string>& profile_files,
-        const std::string& reference_profile_file) {
+        const std::string& reference_profile_file,
+        size_t jobs) {
   std::string error;
   ScopedCollectionFlock profile_files_flocks(profile_files.size());
   if (!profile_files_flocks.Init(profile_files, &error)) {
@@ -155,7 +219,8 @@ ProfileAssistant::ProcessingResult ProfileAssistant::ProcessProfiles(
   }
 
   return ProcessProfilesInternal(profile_files_flocks.Get(),
-                                 reference_profile_file_flock);
+                                 reference_profile_file_flock,
+                                 jobs);
 }
 
 }  // namespace art
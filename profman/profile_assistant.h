@@ -51,18 +51,29 @@ class ProfileAssistant {
   // merge of the current profiles and the reference one is insignificant. In
   // this case no file will be updated.
   //
+  // Up to `jobs` threads are used to load and merge the profile files. The
+  // result does not depend on the number of jobs.
+  //
   static ProcessingResult ProcessProfiles(
       const std::vector<std::string>& profile_files,
-      const std::string& reference_profile_file);
+      const std::string& reference_profile_file,
+      size_t jobs = 1);
 
   static ProcessingResult ProcessProfiles(
       const std::vector<int>& profile_files_fd_,
-      int reference_profile_file_fd);
+      int reference_profile_file_fd,
+      size_t jobs = 1);
 
  private:
   static ProcessingResult ProcessProfilesInternal(
       const std::vector<ScopedFlock>& profile_files,
-      const ScopedFlock& reference_profile_file);
+      const ScopedFlock& reference_profile_file,
+      size_t jobs);
+
+  // Merge the profile files into `info`, which already holds the reference profile.
+  static bool MergeProfiles(const std::vector<ScopedFlock>& profile_files,
+                            size_t jobs,
+                            ProfileCompilationInfo* info);
 
   DISALLOW_COPY_AND_ASSIGN(ProfileAssistant);
 };
@@ -139,7 +139,9 @@ class ProfileAssistantTest : public CommonRuntimeTest {
     return file_path;
   }
   // Runs test with given arguments.
-  int ProcessProfiles(const std::vector<int>& profiles_fd, int reference_profile_fd) {
+  int ProcessProfiles(const std::vector<int>& profiles_fd,
+                      int reference_profile_fd,
+                      size_t jobs = 1) {
     std::string profman_cmd = GetProfmanCmd();
     std::vector<std::string> argv_str;
     argv_str.push_back(profman_cmd);
@@ -147,6 +149,9 @@ class ProfileAssistantTest : public CommonRuntimeTest {
       argv_str.push_back("--profile-file-fd=" + std::to_string(profiles_fd[k]));
     }
     argv_str.push_back("--reference-profile-file-fd=" + std::to_string(reference_profile_fd));
+    if (jobs != 1) {
+      argv_str.push_back("--jobs=" + std::to_string(jobs));
+    }
 
     std::string error;
     return ExecAndReturnCode(argv_str, &error);
@@ -215,6 +220,23 @@ class ProfileAssistantTest : public CommonRuntimeTest {
     return true;
   }
 
+  // Runs profman with the given arguments and returns what it printed.
+  std::string GetProfmanOutput(const std::vector<std::string>& args) {
+    ScratchFile output_file;
+    std::vector<std::string> argv_str;
+    argv_str.push_back(GetProfmanCmd());
+    argv_str.insert(argv_str.end(), args.begin(), args.end());
+    argv_str.push_back("--dump-output-to-fd=" + std::to_string(GetFd(output_file)));
+    std::string error;
+    EXPECT_EQ(ExecAndReturnCode(argv_str, &error), 0);
+    File* file = output_file.GetFile();
+    EXPECT_EQ(0, file->Flush());
+    int64_t length = file->GetLength();
+    std::unique_ptr<char[]> buf(new char[length]);
+    EXPECT_EQ(file->Read(buf.get(), length, 0), length);
+    return std::string(buf.get(), length);
+  }
+
   bool CreateAndDump(const std::string& input_file_contents,
                      std::string* output_file_contents) {
     ScratchFile profile_file;
@@ -759,6 +781,117 @@ TEST_F(ProfileAssistantTest, MergeProfilesWithDifferentDexOrder) {
   CheckProfileInfo(profile1, info1);
 }
 
+TEST_F(ProfileAssistantTest, MergeProfilesInParallel) {
+  const size_t kNumberOfProfiles = 5;
+  std::vector<std::unique_ptr<ScratchFile>> profiles;
+  std::vector<std::unique_ptr<ProfileCompilationInfo>> infos;
+  std::vector<int> profile_fds;
+  ScratchFile reference_profile;
+  int reference_profile_fd = GetFd(reference_profile);
+
+  // The reference profile and every other input share dex files, so that the merge has to
+  // remap the dex profile indices of the inline caches.
+  const uint16_t kNumberOfMethodsToEnableCompilation = 100;
+  ProfileCompilationInfo reference_info;
+  SetupProfile("p0", 1, kNumberOfMethodsToEnableCompilation, 0, reference_profile,
+      &reference_info);
+  for (size_t i = 0; i < kNumberOfProfiles; ++i) {
+    profiles.emplace_back(new ScratchFile());
+    infos.emplace_back(new ProfileCompilationInfo());
+    const std::string id = "p" + std::to_string(i % 2 == 0 ? 0 : i);
+    SetupProfile(id, 1, kNumberOfMethodsToEnableCompilation, 10, *profiles.back(),
+        infos.back().get(), /*start_method_index*/ i * 10, /*reverse_dex_write_order*/ i % 3 == 0);
+    profile_fds.push_back(GetFd(*profiles.back()));
+  }
+
+  // We should advise compilation.
+  ASSERT_EQ(ProfileAssistant::kCompile,
+            ProcessProfiles(profile_fds, reference_profile_fd, /*jobs*/ 3));
+
+  // The result must be the same as merging the inputs one after the other.
+  ProfileCompilationInfo result;
+  ASSERT_TRUE(reference_profile.GetFile()->ResetOffset());
+  ASSERT_TRUE(result.Load(reference_profile_fd));
+
+  ProfileCompilationInfo expected;
+  ASSERT_TRUE(expected.MergeWith(reference_info));
+  for (const std::unique_ptr<ProfileCompilationInfo>& info : infos) {
+    ASSERT_TRUE(expected.MergeWith(*info));
+  }
+  ASSERT_TRUE(expected.Equals(result));
+
+  // The information from profiles must remain the same.
+  for (size_t i = 0; i < kNumberOfProfiles; ++i) {
+    CheckProfileInfo(*profiles[i], *infos[i]);
+  }
+}
+
+TEST_F(ProfileAssistantTest, WriteIndexedProfile) {
+  ScratchFile profile1;
+  ScratchFile profile2;
+  ScratchFile indexed_profile;
+  ProfileCompilationInfo info1;
+  SetupProfile("p1", 1, /*number_of_methods*/ 10, /*number_of_classes*/ 5, profile1, &info1);
+  ProfileCompilationInfo info2;
+  SetupProfile("p2", 2, /*number_of_methods*/ 10, /*number_of_classes*/ 3, profile2, &info2,
+      /*start_method_index*/ 5);
+
+  std::vector<std::string> argv_str;
+  argv_str.push_back(GetProfmanCmd());
+  argv_str.push_back("--write-indexed");
+  argv_str.push_back("--profile-file=" + profile1.GetFilename());
+  argv_str.push_back("--profile-file-fd=" + std::to_string(GetFd(profile2)));
+  argv_str.push_back("--reference-profile-file=" + indexed_profile.GetFilename());
+  std::string error;
+  ASSERT_EQ(0, ExecAndReturnCode(argv_str, &error)) << error;
+
+  // The indexed profile holds the merge of the inputs, inline caches included.
+  ProfileCompilationInfo expected;
+  ASSERT_TRUE(expected.MergeWith(info1));
+  ASSERT_TRUE(expected.MergeWith(info2));
+  ProfileCompilationInfo result;
+  ASSERT_TRUE(indexed_profile.GetFile()->ResetOffset());
+  ASSERT_TRUE(result.Load(GetFd(indexed_profile)));
+  ASSERT_TRUE(expected.Equals(result));
+
+  // The inputs must remain the same.
+  CheckProfileInfo(profile1, info1);
+  CheckProfileInfo(profile2, info2);
+}
+
+TEST_F(ProfileAssistantTest, PrintStatsAndDiff) {
+  ScratchFile profile;
+  ScratchFile reference_profile;
+  ProfileCompilationInfo info;
+  SetupProfile("p1", 1, /*number_of_methods*/ 10, /*number_of_classes*/ 5, profile, &info);
+  ProfileCompilationInfo reference_info;
+  SetupProfile("p1", 1, /*number_of_methods*/ 10, /*number_of_classes*/ 3, reference_profile,
+      &reference_info, /*start_method_index*/ 5);
+
+  std::string stats = GetProfmanOutput({"--stats", "--profile-file=" + profile.GetFilename()});
+  ASSERT_NE(std::string::npos, stats.find("location1p1 [checksum=1]\n"
+                                          "\tmethods: 10\n"
+                                          "\tclasses: 5\n"
+                                          "\tinline caches: types[1]=110 types[2]=110 "
+                                          "megamorphic=110 missing_types=110\n")) << stats;
+
+  std::string diff = GetProfmanOutput({"--diff",
+                                       "--profile-file=" + profile.GetFilename(),
+                                       "--reference-profile-file=" +
+                                           reference_profile.GetFilename()});
+  ASSERT_NE(std::string::npos, diff.find("location1p1\n"
+                                         "\tadded methods (5): 0,1,2,3,4,\n"
+                                         "\tremoved methods (5): 10,11,12,13,14,\n"
+                                         "\tadded classes (2): 3,4,\n")) << diff;
+  ASSERT_NE(std::string::npos, diff.find("total: added_methods=10 removed_methods=10 "
+                                         "changed_methods=0 added_classes=2 removed_classes=0 "
+                                         "checksum_mismatches=0\n")) << diff;
+
+  // The profiles must remain the same.
+  CheckProfileInfo(profile, info);
+  CheckProfileInfo(reference_profile, reference_info);
+}
+
 TEST_F(ProfileAssistantTest, TestProfileCreateWithInvalidData) {
   // Create the profile content.
   std::vector<std::string> profile_methods = {
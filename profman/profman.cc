@@ -24,6 +24,7 @@
 #include <fstream>
 #include <iostream>
 #include <set>
+#include <sstream>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -90,6 +91,18 @@ NO_RETURN static void Usage(const char *fmt, ...) {
   UsageError("");
   UsageError("  --dump-output-to-fd=<number>: redirects --dump-only output to a file descriptor.");
   UsageError("");
+  UsageError("  --stats: prints, for each dex file in the specified profile files, the number of");
+  UsageError("      methods and classes and a histogram of the inline caches by number of");
+  UsageError("      receiver types.");
+  UsageError("");
+  UsageError("  --diff: prints the methods and classes which a profile file adds to or removes");
+  UsageError("      from the reference profile, and the methods whose inline caches changed.");
+  UsageError("      Requires exactly one --profile-file(-fd) and a reference profile.");
+  UsageError("");
+  UsageError("  --write-indexed: merges the --profile-file(-fd) profiles and writes them to the");
+  UsageError("      reference profile in the indexed format, which dex2oat maps instead of");
+  UsageError("      decoding. The reference profile is overwritten.");
+  UsageError("");
   UsageError("  --dump-classes-and-methods: dumps a sorted list of classes and methods that are");
   UsageError("      in the specified profile file to standard output (default) in a human");
   UsageError("      readable form. The output is valid input for --create-profile-from");
@@ -111,6 +124,9 @@ NO_RETURN static void Usage(const char *fmt, ...) {
   UsageError("      accepts a file descriptor. Cannot be used together with");
   UsageError("      --reference-profile-file.");
   UsageError("");
+  UsageError("  --jobs=<number>: number of threads used to load and merge the profile files.");
+  UsageError("      Defaults to 1.");
+  UsageError("");
   UsageError("  --generate-test-profile=<filename>: generates a random profile file for testing.");
   UsageError("  --generate-test-profile-num-dex=<number>: number of dex files that should be");
   UsageError("      included in the generated profile. Defaults to 20.");
@@ -158,7 +174,11 @@ class ProfMan FINAL {
       reference_profile_file_fd_(kInvalidFd),
       dump_only_(false),
       dump_classes_and_methods_(false),
+      print_stats_(false),
+      print_diff_(false),
+      write_indexed_(false),
       dump_output_to_fd_(kInvalidFd),
+      jobs_(1),
       test_profile_num_dex_(kDefaultTestProfileNumDex),
       test_profile_method_ratio_(kDefaultTestProfileMethodRatio),
       test_profile_class_ratio_(kDefaultTestProfileClassRatio),
@@ -193,6 +213,12 @@ class ProfMan FINAL {
         dump_only_ = true;
       } else if (option == "--dump-classes-and-methods") {
         dump_classes_and_methods_ = true;
+      } else if (option == "--stats") {
+        print_stats_ = true;
+      } else if (option == "--diff") {
+        print_diff_ = true;
+      } else if (option == "--write-indexed") {
+        write_indexed_ = true;
       } else if (option.starts_with("--create-profile-from=")) {
         create_profile_from_file_ = option.substr(strlen("--create-profile-from=")).ToString();
       } else if (option.starts_with("--dump-output-to-fd=")) {
@@ -211,6 +237,11 @@ class ProfMan FINAL {
         ParseFdForCollection(option, "--apk-fd", &apks_fd_);
       } else if (option.starts_with("--apk=")) {
         apk_files_.push_back(option.substr(strlen("--apk=")).ToString());
+      } else if (option.starts_with("--jobs=")) {
+        ParseUintOption(option, "--jobs", &jobs_, Usage);
+        if (jobs_ == 0) {
+          Usage("--jobs must be at least 1");
+        }
       } else if (option.starts_with("--generate-test-profile=")) {
         test_profile_ = option.substr(strlen("--generate-test-profile=")).ToString();
       } else if (option.starts_with("--generate-test-profile-num-dex=")) {
@@ -261,15 +292,19 @@ class ProfMan FINAL {
       Usage("Options --profile-file-fd and --reference-profile-file-fd "
             "should only be used together");
     }
+    // Indexed profiles are mapped when loaded.
+    MemMap::Init();
     ProfileAssistant::ProcessingResult result;
     if (profile_files_.empty()) {
       // The file doesn't need to be flushed here (ProcessProfiles will do it)
       // so don't check the usage.
       File file(reference_profile_file_fd_, false);
-      result = ProfileAssistant::ProcessProfiles(profile_files_fd_, reference_profile_file_fd_);
+      result = ProfileAssistant::ProcessProfiles(profile_files_fd_,
+                                                 reference_profile_file_fd_,
+                                                 jobs_);
       CloseAllFds(profile_files_fd_, "profile_files_fd_");
     } else {
-      result = ProfileAssistant::ProcessProfiles(profile_files_, reference_profile_file_);
+      result = ProfileAssistant::ProcessProfiles(profile_files_, reference_profile_file_, jobs_);
     }
     return result;
   }
@@ -400,15 +435,7 @@ class ProfMan FINAL {
         return ret;
       }
     }
-    if (!FdIsValid(dump_output_to_fd_)) {
-      std::cout << dump;
-    } else {
-      unix_file::FdFile out_fd(dump_output_to_fd_, false /*check_usage*/);
-      if (!out_fd.WriteFully(dump.c_str(), dump.length())) {
-        return -1;
-      }
-    }
-    return 0;
+    return WriteOutput(dump);
   }
 
   bool ShouldOnlyDumpProfile() {
@@ -503,19 +530,231 @@ class ProfMan FINAL {
     for (const std::string& class_name : class_names) {
       dump += class_name + std::string("\n");
     }
+    return WriteOutput(dump);
+  }
+
+  bool ShouldOnlyDumpClassesAndMethods() {
+    return dump_classes_and_methods_;
+  }
+
+  // Write the output of the dump modes to standard output or to --dump-output-to-fd.
+  int WriteOutput(const std::string& output) {
     if (!FdIsValid(dump_output_to_fd_)) {
-      std::cout << dump;
+      std::cout << output;
     } else {
       unix_file::FdFile out_fd(dump_output_to_fd_, false /*check_usage*/);
-      if (!out_fd.WriteFully(dump.c_str(), dump.length())) {
+      if (!out_fd.WriteFully(output.c_str(), output.length())) {
         return -1;
       }
     }
     return 0;
   }
 
-  bool ShouldOnlyDumpClassesAndMethods() {
-    return dump_classes_and_methods_;
+  // Load the profile from `filename`, or from `fd` if the filename is empty.
+  // Like DumpOneProfile, the descriptor is closed after loading.
+  bool LoadProfile(const std::string& filename, int fd, ProfileCompilationInfo* info) {
+    if (!filename.empty()) {
+      fd = open(filename.c_str(), O_RDONLY);
+      if (fd < 0) {
+        PLOG(ERROR) << "Cannot open " << filename;
+        return false;
+      }
+    }
+    bool result = info->Load(fd);
+    if (!result) {
+      LOG(ERROR) << "Cannot load profile info from fd=" << fd;
+    }
+    if (close(fd) < 0) {
+      PLOG(WARNING) << "Failed to close descriptor";
+    }
+    return result;
+  }
+
+  static std::string GetProfileName(const std::string& filename, int fd) {
+    return filename.empty() ? android::base::StringPrintf("fd=%d", fd) : filename;
+  }
+
+  bool PrintOneProfileStats(const std::string& filename, int fd, std::string* output) {
+    ProfileCompilationInfo info;
+    if (!LoadProfile(filename, fd, &info)) {
+      return false;
+    }
+    std::ostringstream os;
+    os << "=== profile stats: " << GetProfileName(filename, fd) << " ===\n";
+    for (const ProfileCompilationInfo::DexFileStats& stats : info.GetDexFileStats()) {
+      os << stats.profile_key << " [checksum=" << std::hex << stats.checksum << std::dec << "]\n";
+      os << "\tmethods: " << stats.number_of_methods << "\n";
+      os << "\tclasses: " << stats.number_of_classes << "\n";
+      os << "\tinline caches:";
+      for (size_t i = 0; i < stats.inline_cache_histogram.size(); i++) {
+        if (stats.inline_cache_histogram[i] != 0) {
+          os << " types[" << i << "]=" << stats.inline_cache_histogram[i];
+        }
+      }
+      os << " megamorphic=" << stats.number_of_megamorphic_inline_caches
+         << " missing_types=" << stats.number_of_missing_types_inline_caches << "\n";
+    }
+    *output += os.str();
+    return true;
+  }
+
+  int PrintStats() {
+    // Validate that at least one profile file or reference was specified.
+    if (profile_files_.empty() && profile_files_fd_.empty() &&
+        reference_profile_file_.empty() && !FdIsValid(reference_profile_file_fd_)) {
+      Usage("No profile files or reference profile specified.");
+    }
+    // Indexed profiles are mapped when loaded.
+    MemMap::Init();
+    std::string output;
+    for (int profile_file_fd : profile_files_fd_) {
+      if (!PrintOneProfileStats("", profile_file_fd, &output)) {
+        return -1;
+      }
+    }
+    for (const std::string& profile_file : profile_files_) {
+      if (!PrintOneProfileStats(profile_file, kInvalidFd, &output)) {
+        return -1;
+      }
+    }
+    if (FdIsValid(reference_profile_file_fd_) || !reference_profile_file_.empty()) {
+      if (!PrintOneProfileStats(reference_profile_file_, reference_profile_file_fd_, &output)) {
+        return -1;
+      }
+    }
+    return WriteOutput(output);
+  }
+
+  bool ShouldOnlyPrintStats() {
+    return print_stats_;
+  }
+
+  // Merges the profile files and writes the result to the reference profile with SaveIndexed.
+  int WriteIndexedProfile() {
+    if (profile_files_.empty() && profile_files_fd_.empty()) {
+      Usage("No profile files specified.");
+    }
+    if (reference_profile_file_.empty() && !FdIsValid(reference_profile_file_fd_)) {
+      Usage("No reference profile file specified.");
+    }
+    // Indexed profiles are mapped when loaded.
+    MemMap::Init();
+    ProfileCompilationInfo info;
+    for (int profile_file_fd : profile_files_fd_) {
+      ProfileCompilationInfo profile;
+      if (!LoadProfile("", profile_file_fd, &profile) || !info.MergeWith(profile)) {
+        return -1;
+      }
+    }
+    for (const std::string& profile_file : profile_files_) {
+      ProfileCompilationInfo profile;
+      if (!LoadProfile(profile_file, kInvalidFd, &profile) || !info.MergeWith(profile)) {
+        return -1;
+      }
+    }
+    int fd = reference_profile_file_fd_;
+    if (!FdIsValid(fd)) {
+      fd = open(reference_profile_file_.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+      if (fd < 0) {
+        LOG(ERROR) << "Cannot open " << reference_profile_file_ << strerror(errno);
+        return -1;
+      }
+    } else if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0) {
+      PLOG(ERROR) << "Cannot truncate the reference profile";
+      return -1;
+    }
+    bool result = info.SaveIndexed(fd);
+    if (close(fd) < 0) {
+      PLOG(WARNING) << "Failed to close descriptor";
+    }
+    return result ? 0 : -1;
+  }
+
+  bool ShouldWriteIndexedProfile() {
+    return write_indexed_;
+  }
+
+  template <typename T, typename F>
+  static void PrintIndices(const char* name,
+                           const std::set<T>& indices,
+                           F get_index,
+                           std::ostream& os) {
+    if (indices.empty()) {
+      return;
+    }
+    os << "\t" << name << " (" << indices.size() << "): ";
+    for (const T& index : indices) {
+      os << get_index(index) << ",";
+    }
+    os << "\n";
+  }
+
+  int PrintDiff() {
+    if (profile_files_.size() + profile_files_fd_.size() != 1) {
+      Usage("--diff requires exactly one profile file.");
+    }
+    if (reference_profile_file_.empty() && !FdIsValid(reference_profile_file_fd_)) {
+      Usage("No reference profile file specified.");
+    }
+    // Indexed profiles are mapped when loaded.
+    MemMap::Init();
+    ProfileCompilationInfo reference_info;
+    if (!LoadProfile(reference_profile_file_, reference_profile_file_fd_, &reference_info)) {
+      return -1;
+    }
+    ProfileCompilationInfo info;
+    std::string profile_file = profile_files_.empty() ? "" : profile_files_[0];
+    int profile_file_fd = profile_files_fd_.empty() ? kInvalidFd : profile_files_fd_[0];
+    if (!LoadProfile(profile_file, profile_file_fd, &info)) {
+      return -1;
+    }
+
+    size_t added_methods = 0;
+    size_t removed_methods = 0;
+    size_t changed_methods = 0;
+    size_t added_classes = 0;
+    size_t removed_classes = 0;
+    size_t checksum_mismatches = 0;
+    auto method_index = [](uint16_t index) { return index; };
+    auto type_index = [](const dex::TypeIndex& index) { return index.index_; };
+    std::ostringstream os;
+    os << "=== profile diff: "
+       << GetProfileName(reference_profile_file_, reference_profile_file_fd_) << " -> "
+       << GetProfileName(profile_file, profile_file_fd) << " ===\n";
+    for (const ProfileCompilationInfo::DexFileDiff& diff : reference_info.GetDexFileDiffs(info)) {
+      if (diff.checksum_mismatch) {
+        os << diff.profile_key << "\n\tchecksum mismatch\n";
+        checksum_mismatches++;
+        continue;
+      }
+      if (diff.added_methods.empty() && diff.removed_methods.empty() &&
+          diff.changed_methods.empty() && diff.added_classes.empty() &&
+          diff.removed_classes.empty()) {
+        continue;
+      }
+      os << diff.profile_key << "\n";
+      PrintIndices("added methods", diff.added_methods, method_index, os);
+      PrintIndices("removed methods", diff.removed_methods, method_index, os);
+      PrintIndices("changed inline caches", diff.changed_methods, method_index, os);
+      PrintIndices("added classes", diff.added_classes, type_index, os);
+      PrintIndices("removed classes", diff.removed_classes, type_index, os);
+      added_methods += diff.added_methods.size();
+      removed_methods += diff.removed_methods.size();
+      changed_methods += diff.changed_methods.size();
+      added_classes += diff.added_classes.size();
+      removed_classes += diff.removed_classes.size();
+    }
+    os << "total: added_methods=" << added_methods
+       << " removed_methods=" << removed_methods
+       << " changed_methods=" << changed_methods
+       << " added_classes=" << added_classes
+       << " removed_classes=" << removed_classes
+       << " checksum_mismatches=" << checksum_mismatches << "\n";
+    return WriteOutput(os.str());
+  }
+
+  bool ShouldOnlyPrintDiff() {
+    return print_diff_;
   }
 
   // Read lines from the given file, dropping comments and empty lines. Post-process each line with
@@ -934,7 +1173,11 @@ class ProfMan FINAL {
   int reference_profile_file_fd_;
   bool dump_only_;
   bool dump_classes_and_methods_;
+  bool print_stats_;
+  bool print_diff_;
+  bool write_indexed_;
   int dump_output_to_fd_;
+  uint32_t jobs_;
   std::string test_profile_;
   std::string create_profile_from_file_;
   uint16_t test_profile_num_dex_;
@@ -960,6 +1203,15 @@ static int profman(int argc, char** argv) {
   if (profman.ShouldOnlyDumpClassesAndMethods()) {
     return profman.DumpClasses();
   }
+  if (profman.ShouldOnlyPrintStats()) {
+    return profman.PrintStats();
+  }
+  if (profman.ShouldOnlyPrintDiff()) {
+    return profman.PrintDiff();
+  }
+  if (profman.ShouldWriteIndexedProfile()) {
+    return profman.WriteIndexedProfile();
+  }
   if (profman.ShouldCreateProfile()) {
     return profman.CreateProfile();
   }
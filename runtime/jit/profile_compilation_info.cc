@@ -17,14 +17,18 @@
 #include "profile_compilation_info.h"
 
 #include "errno.h"
+#include <algorithm>
 #include <limits.h>
 #include <vector>
 #include <stdlib.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
 
 #include "base/arena_allocator.h"
+#include "base/bit_utils.h"
+#include "base/bit_vector.h"
 #include "base/dumpable.h"
 #include "base/mutex.h"
 #include "base/scoped_flock.h"
@@ -32,8 +36,10 @@
 #include "base/systrace.h"
 #include "base/unix_file/fd_file.h"
 #include "jit/profiling_info.h"
+#include "mem_map.h"
 #include "os.h"
 #include "safe_map.h"
+#include "thread-inl.h"
 #include "utils.h"
 
 namespace art {
@@ -42,6 +48,8 @@ const uint8_t ProfileCompilationInfo::kProfileMagic[] = { 'p', 'r', 'o', '\0' };
 // Last profile version: fix profman merges. Update profile version to force
 // regeneration of possibly faulty profiles.
 const uint8_t ProfileCompilationInfo::kProfileVersion[] = { '0', '0', '5', '\0' };
+// Indexed profile version: the layout described above SaveIndexed.
+const uint8_t ProfileCompilationInfo::kProfileIndexedVersion[] = { 'i', '0', '1', '\0' };
 
 static constexpr uint16_t kMaxDexFileKeyLength = PATH_MAX;
 
@@ -64,14 +72,18 @@ ProfileCompilationInfo::ProfileCompilationInfo(ArenaPool* custom_arena_pool)
     : default_arena_pool_(),
       arena_(custom_arena_pool),
       info_(arena_.Adapter(kArenaAllocProfile)),
-      profile_key_map_(std::less<const std::string>(), arena_.Adapter(kArenaAllocProfile)) {
+      profile_key_map_(std::less<const std::string>(), arena_.Adapter(kArenaAllocProfile)),
+      indexed_lock_("ProfileCompilationInfo indexed lock", kProfileIndexedLock),
+      indexed_decoded_(false) {
 }
 
 ProfileCompilationInfo::ProfileCompilationInfo()
     : default_arena_pool_(/*use_malloc*/true, /*low_4gb*/false, "ProfileCompilationInfo"),
       arena_(&default_arena_pool_),
       info_(arena_.Adapter(kArenaAllocProfile)),
-      profile_key_map_(std::less<const std::string>(), arena_.Adapter(kArenaAllocProfile)) {
+      profile_key_map_(std::less<const std::string>(), arena_.Adapter(kArenaAllocProfile)),
+      indexed_lock_("ProfileCompilationInfo indexed lock", kProfileIndexedLock),
+      indexed_decoded_(false) {
 }
 
 ProfileCompilationInfo::~ProfileCompilationInfo() {
@@ -152,10 +164,12 @@ bool ProfileCompilationInfo::Load(const std::string& filename, bool clear_if_inv
     LOG(WARNING) << "Couldn't lock the profile file " << filename << ": " << error;
     return false;
   }
+  return Load(flock.GetFile(), clear_if_invalid);
+}
 
-  int fd = flock.GetFile()->Fd();
-
-  ProfileLoadSatus status = LoadInternal(fd, &error);
+bool ProfileCompilationInfo::Load(File* file, bool clear_if_invalid) {
+  std::string error;
+  ProfileLoadSatus status = LoadInternal(file->Fd(), &error);
   if (status == kProfileLoadSuccess) {
     return true;
   }
@@ -163,16 +177,16 @@ bool ProfileCompilationInfo::Load(const std::string& filename, bool clear_if_inv
   if (clear_if_invalid &&
       ((status == kProfileLoadVersionMismatch) || (status == kProfileLoadBadData))) {
     LOG(WARNING) << "Clearing bad or obsolete profile data from file "
-                 << filename << ": " << error;
-    if (flock.GetFile()->ClearContent()) {
+                 << file->GetPath() << ": " << error;
+    if (file->ClearContent()) {
       return true;
     } else {
-      PLOG(WARNING) << "Could not clear profile file: " << filename;
+      PLOG(WARNING) << "Could not clear profile file: " << file->GetPath();
       return false;
     }
   }
 
-  LOG(WARNING) << "Could not load profile data from file " << filename << ": " << error;
+  LOG(WARNING) << "Could not load profile data from file " << file->GetPath() << ": " << error;
   return false;
 }
 
@@ -188,30 +202,77 @@ bool ProfileCompilationInfo::Save(const std::string& filename, uint64_t* bytes_w
     LOG(WARNING) << "Couldn't lock the profile file " << filename << ": " << error;
     return false;
   }
+  // This doesn't need locking because we are trying to lock the file for exclusive
+  // access and fail immediately if we can't.
+  return Save(flock.GetFile(), bytes_written);
+}
 
-  int fd = flock.GetFile()->Fd();
+bool ProfileCompilationInfo::Save(File* file, uint64_t* bytes_written) {
+  // The profile may be mapped from the file we are about to clear.
+  ReleaseIndexedData();
 
-  // We need to clear the data because we don't support appending to the profiles yet.
-  if (!flock.GetFile()->ClearContent()) {
-    PLOG(WARNING) << "Could not clear profile file: " << filename;
+  // Deltas are only appended by Append, a save rewrites the whole file.
+  if (!file->ClearContent()) {
+    PLOG(WARNING) << "Could not clear profile file: " << file->GetPath();
     return false;
   }
 
+  bool result = Save(file->Fd());
+  if (result) {
+    int64_t size = file->GetLength();
+    if (size != -1) {
+      VLOG(profiler)
+        << "Successfully saved profile info to " << file->GetPath() << " Size: "
+        << size;
+      if (bytes_written != nullptr) {
+        *bytes_written = static_cast<uint64_t>(size);
+      }
+    }
+  } else {
+    VLOG(profiler) << "Failed to save profile info to " << file->GetPath();
+  }
+  return result;
+}
+
+bool ProfileCompilationInfo::Append(const std::string& filename, uint64_t* bytes_written) {
+  ScopedTrace trace(__PRETTY_FUNCTION__);
+  ScopedFlock flock;
+  std::string error;
+  int flags = O_WRONLY | O_NOFOLLOW | O_CLOEXEC;
+  // As for Save, there's no need to fsync the profile data right away.
+  if (!flock.Init(filename.c_str(), flags, /*block*/false, /*flush_on_close*/false, &error)) {
+    LOG(WARNING) << "Couldn't lock the profile file " << filename << ": " << error;
+    return false;
+  }
   // This doesn't need locking because we are trying to lock the file for exclusive
   // access and fail immediately if we can't.
-  bool result = Save(fd);
+  return Append(flock.GetFile(), bytes_written);
+}
+
+bool ProfileCompilationInfo::Append(File* file, uint64_t* bytes_written) {
+  off_t start = lseek(file->Fd(), 0, SEEK_END);
+  if (start < 0) {
+    PLOG(WARNING) << "Could not seek to the end of profile file: " << file->GetPath();
+    return false;
+  }
+
+  bool result = Save(file->Fd());
   if (result) {
-    int64_t size = GetFileSizeBytes(filename);
+    int64_t size = file->GetLength();
     if (size != -1) {
       VLOG(profiler)
-        << "Successfully saved profile info to " << filename << " Size: "
+        << "Successfully appended profile info to " << file->GetPath() << " Size: "
         << size;
       if (bytes_written != nullptr) {
-        *bytes_written = static_cast<uint64_t>(size);
+        *bytes_written = static_cast<uint64_t>(size - start);
       }
     }
   } else {
-    VLOG(profiler) << "Failed to save profile info to " << filename;
+    // Drop the partial delta so that the file stays loadable.
+    if (file->SetLength(start) != 0) {
+      PLOG(WARNING) << "Could not truncate profile file: " << file->GetPath();
+    }
+    VLOG(profiler) << "Failed to append profile info to " << file->GetPath();
   }
   return result;
 }
@@ -269,6 +330,7 @@ static constexpr size_t kLineHeaderSize =
 bool ProfileCompilationInfo::Save(int fd) {
   ScopedTrace trace(__PRETTY_FUNCTION__);
   DCHECK_GE(fd, 0);
+  ReleaseIndexedData();
 
   // Cache at most 50KB before writing.
   static constexpr size_t kMaxSizeToKeepBeforeWriting = 50 * KB;
@@ -419,9 +481,170 @@ void ProfileCompilationInfo::GroupClassesByDex(
   }
 }
 
+struct ProfileCompilationInfo::IndexedHeader {
+  uint8_t magic[sizeof(kProfileMagic)];
+  uint8_t version[sizeof(kProfileIndexedVersion)];
+  uint32_t number_of_dex_files;
+  // The size of the whole profile, used to reject truncated files.
+  uint32_t file_size;
+};
+
+struct ProfileCompilationInfo::IndexedDexHeader {
+  uint32_t checksum;
+  uint32_t profile_key_offset;
+  uint32_t profile_key_size;
+  uint32_t number_of_methods;
+  uint32_t number_of_classes;
+  // Bit i of the method bitmap is set if the method with index i is in the profile.
+  uint32_t method_bitmap_offset;
+  uint32_t method_bitmap_bits;
+  // Bit i of the class bitmap is set if the type with index i is in the profile.
+  uint32_t class_bitmap_offset;
+  uint32_t class_bitmap_bits;
+  // Inline cache entries sorted by method index.
+  uint32_t inline_cache_table_offset;
+  uint32_t inline_cache_table_size;
+};
+
+struct ProfileCompilationInfo::IndexedInlineCacheEntry {
+  uint16_t method_index;
+  uint16_t padding;
+  // The inline cache of the method, encoded as in the regular format.
+  uint32_t offset;
+  uint32_t size;
+};
+
+static_assert(sizeof(ProfileCompilationInfo::kProfileIndexedVersion) ==
+                  sizeof(ProfileCompilationInfo::kProfileVersion),
+              "Profile versions must have the same size");
+
+// Method and type indices are 16 bits, which bounds the size of the bitmaps.
+static constexpr uint32_t kMaxIndexedBitmapBits = std::numeric_limits<uint16_t>::max() + 1u;
+static constexpr uint32_t kBitmapWordBits = BitSizeOf<uint32_t>();
+
+// Pad the buffer so that the next region starts at a 4-byte aligned offset.
+static void AlignBuffer(std::vector<uint8_t>* buffer) {
+  buffer->resize(RoundUp(buffer->size(), sizeof(uint32_t)), 0u);
+}
+
+// Add a bitmap with the bits of the sorted `indices` set. Returns the number of bits.
+static uint32_t AddBitmapToBuffer(std::vector<uint8_t>* buffer,
+                                  const std::vector<uint16_t>& indices) {
+  uint32_t num_bits = indices.empty() ? 0u : indices.back() + 1u;
+  std::vector<uint32_t> words(BitVector::BitsToWords(num_bits), 0u);
+  for (uint16_t index : indices) {
+    words[index / kBitmapWordBits] |= 1u << (index % kBitmapWordBits);
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(words.data());
+  buffer->insert(buffer->end(), bytes, bytes + words.size() * sizeof(uint32_t));
+  return num_bits;
+}
+
+// Call `visitor` with the index of every set bit of the bitmap, in increasing order.
+template <typename Visitor>
+static void VisitSetBits(const uint32_t* bitmap, uint32_t num_bits, const Visitor& visitor) {
+  for (uint32_t word = 0; word < BitVector::BitsToWords(num_bits); ++word) {
+    uint32_t value = bitmap[word];
+    while (value != 0u) {
+      visitor(word * kBitmapWordBits + static_cast<uint32_t>(CTZ(value)));
+      value &= value - 1u;
+    }
+  }
+}
+
+/**
+ * Indexed serialization format:
+ *    IndexedHeader (magic,kProfileIndexedVersion,number_of_dex_files,file_size)
+ *    IndexedDexHeader for each dex file, in the order of their profile index
+ *    data regions
+ * The regions of each dex file are:
+ *    profile_key,
+ *    method bitmap, class bitmap (one uint32_t word per 32 indices),
+ *    inline cache table (IndexedInlineCacheEntry for each method with inline caches),
+ *    inline cache data (the same encoding as AddInlineCacheToBuffer).
+ * Bitmaps and tables are 4-byte aligned so that the profile can be mapped and
+ * queried in place: method and class lookups are a bit test and inline caches
+ * are found by binary search and decoded only when requested.
+ **/
+bool ProfileCompilationInfo::SaveIndexed(int fd) {
+  ScopedTrace trace(__PRETTY_FUNCTION__);
+  DCHECK_GE(fd, 0);
+  ReleaseIndexedData();
+
+  std::vector<IndexedDexHeader> dex_headers(info_.size());
+  std::vector<uint8_t> buffer(sizeof(IndexedHeader) + info_.size() * sizeof(IndexedDexHeader));
+  for (const DexFileData* dex_data : info_) {
+    IndexedDexHeader& dex_header = dex_headers[dex_data->profile_index];
+    dex_header.checksum = dex_data->checksum;
+    dex_header.profile_key_offset = buffer.size();
+    dex_header.profile_key_size = dex_data->profile_key.size();
+    AddStringToBuffer(&buffer, dex_data->profile_key);
+    AlignBuffer(&buffer);
+
+    std::vector<uint16_t> method_indices;
+    std::vector<uint16_t> methods_with_inline_caches;
+    for (const auto& method_it : dex_data->method_map) {
+      method_indices.push_back(method_it.first);
+      if (!method_it.second.empty()) {
+        methods_with_inline_caches.push_back(method_it.first);
+      }
+    }
+    std::vector<uint16_t> class_indices;
+    for (const dex::TypeIndex& type_index : dex_data->class_set) {
+      class_indices.push_back(type_index.index_);
+    }
+
+    dex_header.number_of_methods = method_indices.size();
+    dex_header.number_of_classes = class_indices.size();
+    dex_header.method_bitmap_offset = buffer.size();
+    dex_header.method_bitmap_bits = AddBitmapToBuffer(&buffer, method_indices);
+    dex_header.class_bitmap_offset = buffer.size();
+    dex_header.class_bitmap_bits = AddBitmapToBuffer(&buffer, class_indices);
+
+    // Reserve the table and fill it in as the inline caches are encoded after it.
+    dex_header.inline_cache_table_offset = buffer.size();
+    dex_header.inline_cache_table_size = methods_with_inline_caches.size();
+    std::vector<IndexedInlineCacheEntry> entries(methods_with_inline_caches.size());
+    buffer.resize(buffer.size() + entries.size() * sizeof(IndexedInlineCacheEntry));
+    for (size_t i = 0; i < entries.size(); ++i) {
+      entries[i].method_index = methods_with_inline_caches[i];
+      entries[i].padding = 0u;
+      entries[i].offset = buffer.size();
+      AddInlineCacheToBuffer(&buffer, dex_data->method_map.find(entries[i].method_index)->second);
+      entries[i].size = buffer.size() - entries[i].offset;
+    }
+    if (!entries.empty()) {
+      memcpy(buffer.data() + dex_header.inline_cache_table_offset,
+             entries.data(),
+             entries.size() * sizeof(IndexedInlineCacheEntry));
+    }
+    AlignBuffer(&buffer);
+  }
+
+  if (buffer.size() > std::numeric_limits<uint32_t>::max()) {
+    LOG(WARNING) << "Indexed profile exceeds the maximum size";
+    return false;
+  }
+  IndexedHeader header;
+  memcpy(header.magic, kProfileMagic, sizeof(kProfileMagic));
+  memcpy(header.version, kProfileIndexedVersion, sizeof(kProfileIndexedVersion));
+  header.number_of_dex_files = info_.size();
+  header.file_size = buffer.size();
+  memcpy(buffer.data(), &header, sizeof(header));
+  if (!dex_headers.empty()) {
+    memcpy(buffer.data() + sizeof(header),
+           dex_headers.data(),
+           dex_headers.size() * sizeof(IndexedDexHeader));
+  }
+  return WriteBuffer(fd, buffer.data(), buffer.size());
+}
+
 ProfileCompilationInfo::DexFileData* ProfileCompilationInfo::GetOrAddDexFileData(
     const std::string& profile_key,
     uint32_t checksum) {
+  // Any addition modifies the profile, which can no longer be served from the mapping.
+  ReleaseIndexedData();
+
   const auto& profile_index_it = profile_key_map_.FindOrAdd(profile_key, profile_key_map_.size());
   if (profile_key_map_.size() > std::numeric_limits<uint8_t>::max()) {
     // Allow only 255 dex files to be profiled. This allows us to save bytes
@@ -866,6 +1089,60 @@ ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::LoadInternal(
   if (stat_buffer.st_size == 0) {
     return kProfileLoadSuccess;
   }
+
+  // Indexed profiles are mapped and queried in place instead of being decoded.
+  uint8_t magic_and_version[sizeof(kProfileMagic) + sizeof(kProfileIndexedVersion)];
+  if (TEMP_FAILURE_RETRY(pread(fd, magic_and_version, sizeof(magic_and_version), 0)) ==
+          static_cast<ssize_t>(sizeof(magic_and_version)) &&
+      memcmp(magic_and_version, kProfileMagic, sizeof(kProfileMagic)) == 0 &&
+      memcmp(magic_and_version + sizeof(kProfileMagic),
+             kProfileIndexedVersion,
+             sizeof(kProfileIndexedVersion)) == 0) {
+    return LoadIndexed(fd, stat_buffer.st_size, error);
+  }
+
+  ProfileLoadSatus status = ReadProfile(fd, error);
+  if (status != kProfileLoadSuccess) {
+    return status;
+  }
+
+  // The profile may be followed by deltas appended with Append. Each delta is a
+  // complete profile with its own dex file indexing, so it is read separately and merged.
+  while (true) {
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset < 0) {
+      *error = "Profile IO error: " + std::string(strerror(errno));
+      return kProfileLoadIOError;
+    }
+    if (offset >= stat_buffer.st_size) {
+      break;
+    }
+    ProfileCompilationInfo delta(arena_.GetArenaPool());
+    status = delta.ReadProfile(fd, error);
+    if (status != kProfileLoadSuccess) {
+      return status;
+    }
+    if (!MergeWith(delta)) {
+      *error = "Could not merge profile delta";
+      return kProfileLoadBadData;
+    }
+  }
+
+  // Check that we read everything and that profiles don't contain junk data.
+  int result = testEOF(fd);
+  if (result == 0) {
+    return kProfileLoadSuccess;
+  } else if (result < 0) {
+    return kProfileLoadIOError;
+  } else {
+    *error = "Unexpected content in the profile file";
+    return kProfileLoadBadData;
+  }
+}
+
+ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::ReadProfile(
+      int fd,
+      /*out*/std::string* error) {
   // Read profile header: magic + version + number_of_dex_files.
   uint8_t number_of_dex_files;
   ProfileLoadSatus status = ReadProfileHeader(fd, &number_of_dex_files, error);
@@ -888,20 +1165,213 @@ ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::LoadInternal(
       return status;
     }
   }
+  return kProfileLoadSuccess;
+}
 
-  // Check that we read everything and that profiles don't contain junk data.
-  int result = testEOF(fd);
-  if (result == 0) {
-    return kProfileLoadSuccess;
-  } else if (result < 0) {
+// Returns true if the region [offset, offset + size) is within a file of `file_size` bytes.
+static bool IsValidRegion(size_t file_size, uint32_t offset, size_t size) {
+  return offset <= file_size && size <= file_size - offset;
+}
+
+ProfileCompilationInfo::ProfileLoadSatus ProfileCompilationInfo::LoadIndexed(
+      int fd,
+      size_t file_size,
+      /*out*/std::string* error) {
+  if (file_size < sizeof(IndexedHeader)) {
+    *error = "Indexed profile is too small";
+    return kProfileLoadBadData;
+  }
+  std::string map_error;
+  std::unique_ptr<MemMap> map(MemMap::MapFile(file_size,
+                                              PROT_READ,
+                                              MAP_PRIVATE,
+                                              fd,
+                                              /*start*/0,
+                                              /*low_4gb*/false,
+                                              "indexed profile",
+                                              &map_error));
+  if (map == nullptr) {
+    *error = "Could not map indexed profile: " + map_error;
     return kProfileLoadIOError;
-  } else {
-    *error = "Unexpected content in the profile file";
+  }
+
+  const uint8_t* begin = map->Begin();
+  const IndexedHeader* header = reinterpret_cast<const IndexedHeader*>(begin);
+  if (header->file_size != file_size) {
+    *error = "Indexed profile size mismatch";
     return kProfileLoadBadData;
   }
+  if (header->number_of_dex_files > std::numeric_limits<uint8_t>::max() ||
+      !IsValidRegion(file_size,
+                     sizeof(IndexedHeader),
+                     header->number_of_dex_files * sizeof(IndexedDexHeader))) {
+    *error = "Invalid number of dex files in indexed profile";
+    return kProfileLoadBadData;
+  }
+
+  const IndexedDexHeader* dex_headers =
+      reinterpret_cast<const IndexedDexHeader*>(begin + sizeof(IndexedHeader));
+  for (uint32_t k = 0; k < header->number_of_dex_files; ++k) {
+    const IndexedDexHeader& dex_header = dex_headers[k];
+    if (dex_header.profile_key_size == 0 ||
+        dex_header.profile_key_size > kMaxDexFileKeyLength ||
+        !IsValidRegion(file_size, dex_header.profile_key_offset, dex_header.profile_key_size)) {
+      *error = "Invalid dex file key in indexed profile";
+      return kProfileLoadBadData;
+    }
+    if (dex_header.method_bitmap_bits > kMaxIndexedBitmapBits ||
+        dex_header.class_bitmap_bits > kMaxIndexedBitmapBits ||
+        !IsAligned<sizeof(uint32_t)>(dex_header.method_bitmap_offset) ||
+        !IsAligned<sizeof(uint32_t)>(dex_header.class_bitmap_offset) ||
+        !IsValidRegion(file_size,
+                       dex_header.method_bitmap_offset,
+                       BitVector::BitsToWords(dex_header.method_bitmap_bits) * sizeof(uint32_t)) ||
+        !IsValidRegion(file_size,
+                       dex_header.class_bitmap_offset,
+                       BitVector::BitsToWords(dex_header.class_bitmap_bits) * sizeof(uint32_t))) {
+      *error = "Invalid bitmap in indexed profile";
+      return kProfileLoadBadData;
+    }
+    if (dex_header.inline_cache_table_size > dex_header.method_bitmap_bits ||
+        !IsAligned<sizeof(uint32_t)>(dex_header.inline_cache_table_offset) ||
+        !IsValidRegion(file_size,
+                       dex_header.inline_cache_table_offset,
+                       dex_header.inline_cache_table_size * sizeof(IndexedInlineCacheEntry))) {
+      *error = "Invalid inline cache table in indexed profile";
+      return kProfileLoadBadData;
+    }
+    const uint32_t* method_bitmap =
+        reinterpret_cast<const uint32_t*>(begin + dex_header.method_bitmap_offset);
+    const IndexedInlineCacheEntry* entries =
+        reinterpret_cast<const IndexedInlineCacheEntry*>(begin +
+                                                         dex_header.inline_cache_table_offset);
+    for (uint32_t i = 0; i < dex_header.inline_cache_table_size; ++i) {
+      // Entries must be sorted for the binary search and refer to profiled methods.
+      if ((i != 0 && entries[i].method_index <= entries[i - 1].method_index) ||
+          entries[i].method_index >= dex_header.method_bitmap_bits ||
+          !BitVector::IsBitSet(method_bitmap, entries[i].method_index) ||
+          !IsValidRegion(file_size, entries[i].offset, entries[i].size)) {
+        *error = "Invalid inline cache entry in indexed profile";
+        return kProfileLoadBadData;
+      }
+    }
+
+    std::string profile_key(reinterpret_cast<const char*>(begin + dex_header.profile_key_offset),
+                            dex_header.profile_key_size);
+    DexFileData* data = GetOrAddDexFileData(profile_key, dex_header.checksum);
+    if (data == nullptr || data->profile_index != k) {
+      *error = "Duplicate dex file key in indexed profile: " + profile_key;
+      return kProfileLoadBadData;
+    }
+  }
+
+  indexed_map_ = std::move(map);
+  return kProfileLoadSuccess;
+}
+
+const ProfileCompilationInfo::IndexedDexHeader& ProfileCompilationInfo::GetIndexedDexHeader(
+    uint8_t profile_index) const {
+  DCHECK(IsIndexed());
+  DCHECK_LT(profile_index, info_.size());
+  const IndexedDexHeader* dex_headers =
+      reinterpret_cast<const IndexedDexHeader*>(indexed_map_->Begin() + sizeof(IndexedHeader));
+  return dex_headers[profile_index];
+}
+
+const ProfileCompilationInfo::InlineCacheMap* ProfileCompilationInfo::FindIndexedMethod(
+    const DexFileData& dex_data,
+    uint16_t dex_method_index) const {
+  const IndexedDexHeader& dex_header = GetIndexedDexHeader(dex_data.profile_index);
+  const uint8_t* begin = indexed_map_->Begin();
+  if (dex_method_index >= dex_header.method_bitmap_bits ||
+      !BitVector::IsBitSet(reinterpret_cast<const uint32_t*>(begin +
+                                                             dex_header.method_bitmap_offset),
+                           dex_method_index)) {
+    return nullptr;
+  }
+
+  // Decoding fills the arena backed maps of info_, which only caches what the
+  // mapping already holds. Serialize it so that compiler threads can query in parallel.
+  MutexLock mu(Thread::Current(), indexed_lock_);
+  DexFileData* data = info_[dex_data.profile_index];
+  auto method_it = data->method_map.find(dex_method_index);
+  if (method_it != data->method_map.end()) {
+    return &method_it->second;
+  }
+  InlineCacheMap* inline_cache = data->FindOrAddMethod(dex_method_index);
+  const IndexedInlineCacheEntry* entries_begin =
+      reinterpret_cast<const IndexedInlineCacheEntry*>(begin +
+                                                       dex_header.inline_cache_table_offset);
+  const IndexedInlineCacheEntry* entries_end = entries_begin + dex_header.inline_cache_table_size;
+  const IndexedInlineCacheEntry* entry = std::lower_bound(
+      entries_begin,
+      entries_end,
+      dex_method_index,
+      [](const IndexedInlineCacheEntry& lhs, uint16_t rhs) { return lhs.method_index < rhs; });
+  if (entry != entries_end && entry->method_index == dex_method_index) {
+    SafeBuffer buffer(entry->size);
+    memcpy(buffer.Get(), begin + entry->offset, entry->size);
+    std::string error;
+    if (!const_cast<ProfileCompilationInfo*>(this)->ReadInlineCache(
+            buffer, info_.size(), inline_cache, &error)) {
+      LOG(WARNING) << "Ignoring invalid inline cache in indexed profile: " << error;
+      inline_cache->clear();
+    }
+  }
+  return inline_cache;
+}
+
+void ProfileCompilationInfo::DecodeIndexedData() const {
+  if (!IsIndexed()) {
+    return;
+  }
+  MutexLock mu(Thread::Current(), indexed_lock_);
+  if (indexed_decoded_) {
+    return;
+  }
+  ScopedTrace trace(__PRETTY_FUNCTION__);
+  const uint8_t* begin = indexed_map_->Begin();
+  for (DexFileData* data : info_) {
+    const IndexedDexHeader& dex_header = GetIndexedDexHeader(data->profile_index);
+    VisitSetBits(reinterpret_cast<const uint32_t*>(begin + dex_header.method_bitmap_offset),
+                 dex_header.method_bitmap_bits,
+                 [data](uint32_t method_index) { data->FindOrAddMethod(method_index); });
+    VisitSetBits(reinterpret_cast<const uint32_t*>(begin + dex_header.class_bitmap_offset),
+                 dex_header.class_bitmap_bits,
+                 [data](uint32_t type_index) {
+                   data->class_set.insert(dex::TypeIndex(type_index));
+                 });
+    const IndexedInlineCacheEntry* entries =
+        reinterpret_cast<const IndexedInlineCacheEntry*>(begin +
+                                                         dex_header.inline_cache_table_offset);
+    for (uint32_t i = 0; i < dex_header.inline_cache_table_size; ++i) {
+      InlineCacheMap* inline_cache = data->FindOrAddMethod(entries[i].method_index);
+      if (!inline_cache->empty()) {
+        continue;  // Already decoded by FindIndexedMethod.
+      }
+      SafeBuffer buffer(entries[i].size);
+      memcpy(buffer.Get(), begin + entries[i].offset, entries[i].size);
+      std::string error;
+      if (!const_cast<ProfileCompilationInfo*>(this)->ReadInlineCache(
+              buffer, info_.size(), inline_cache, &error)) {
+        LOG(WARNING) << "Ignoring invalid inline cache in indexed profile: " << error;
+        inline_cache->clear();
+      }
+    }
+  }
+  indexed_decoded_ = true;
+}
+
+void ProfileCompilationInfo::ReleaseIndexedData() {
+  if (!IsIndexed()) {
+    return;
+  }
+  DecodeIndexedData();
+  indexed_map_.reset();
 }
 
 bool ProfileCompilationInfo::MergeWith(const ProfileCompilationInfo& other) {
+  other.DecodeIndexedData();
   // First verify that all checksums match. This will avoid adding garbage to
   // the current profile info.
   // Note that the number of elements should be very small, so this should not
@@ -969,6 +1439,191 @@ bool ProfileCompilationInfo::MergeWith(const ProfileCompilationInfo& other) {
   return true;
 }
 
+bool ProfileCompilationInfo::GetNewData(const ProfileCompilationInfo& other,
+                                        /*out*/ProfileCompilationInfo* delta) const {
+  DecodeIndexedData();
+  other.DecodeIndexedData();
+  for (const DexFileData* other_dex_data : other.info_) {
+    const std::string& profile_key = other_dex_data->profile_key;
+    const uint32_t checksum = other_dex_data->checksum;
+    const DexFileData* dex_data = FindDexData(profile_key);
+    if ((dex_data != nullptr) && (dex_data->checksum != checksum)) {
+      LOG(WARNING) << "Checksum mismatch for dex " << profile_key;
+      return false;
+    }
+
+    for (const dex::TypeIndex& type_index : other_dex_data->class_set) {
+      if ((dex_data == nullptr) ||
+          (dex_data->class_set.find(type_index) == dex_data->class_set.end())) {
+        if (!delta->AddClassIndex(profile_key, checksum, type_index)) {
+          return false;
+        }
+      }
+    }
+
+    for (const auto& other_method_it : other_dex_data->method_map) {
+      uint16_t method_index = other_method_it.first;
+      const InlineCacheMap* inline_cache = nullptr;
+      if (dex_data != nullptr) {
+        auto method_it = dex_data->method_map.find(method_index);
+        if (method_it != dex_data->method_map.end()) {
+          inline_cache = &method_it->second;
+        }
+      }
+      if ((inline_cache != nullptr) &&
+          !HasNewInlineCacheData(*inline_cache, other, other_method_it.second)) {
+        continue;
+      }
+      // Record the whole method. Merging is a union, so repeating the inline
+      // caches which are already saved is harmless.
+      std::unique_ptr<OfflineProfileMethodInfo> pmi =
+          other.GetMethod(profile_key, checksum, method_index);
+      DCHECK(pmi != nullptr);
+      if (!delta->AddMethod(profile_key, checksum, method_index, *pmi)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ProfileCompilationInfo::HasNewInlineCacheData(
+    const InlineCacheMap& inline_cache,
+    const ProfileCompilationInfo& other,
+    const InlineCacheMap& other_inline_cache) const {
+  for (const auto& other_ic_it : other_inline_cache) {
+    auto ic_it = inline_cache.find(other_ic_it.first);
+    if (ic_it == inline_cache.end()) {
+      return true;
+    }
+    const DexPcData& dex_pc_data = ic_it->second;
+    const DexPcData& other_dex_pc_data = other_ic_it.second;
+    // Missing types absorb everything, megamorphic absorbs everything but missing types.
+    if (dex_pc_data.is_missing_types) {
+      continue;
+    }
+    if (other_dex_pc_data.is_missing_types) {
+      return true;
+    }
+    if (dex_pc_data.is_megamorphic) {
+      continue;
+    }
+    if (other_dex_pc_data.is_megamorphic) {
+      return true;
+    }
+    // The profiles have different dex file indexing, match the classes by profile key.
+    for (const ClassReference& other_class_ref : other_dex_pc_data.classes) {
+      const DexFileData* class_dex_data =
+          FindDexData(other.info_[other_class_ref.dex_profile_index]->profile_key);
+      if ((class_dex_data == nullptr) ||
+          (dex_pc_data.classes.find(ClassReference(class_dex_data->profile_index,
+                                                   other_class_ref.type_index)) ==
+              dex_pc_data.classes.end())) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+std::vector<ProfileCompilationInfo::DexFileStats> ProfileCompilationInfo::GetDexFileStats() const {
+  DecodeIndexedData();
+  std::vector<DexFileStats> result;
+  for (const DexFileData* dex_data : info_) {
+    DexFileStats stats;
+    stats.profile_key = dex_data->profile_key;
+    stats.checksum = dex_data->checksum;
+    stats.number_of_methods = dex_data->method_map.size();
+    stats.number_of_classes = dex_data->class_set.size();
+    stats.number_of_megamorphic_inline_caches = 0;
+    stats.number_of_missing_types_inline_caches = 0;
+    for (const auto& method_it : dex_data->method_map) {
+      for (const auto& inline_cache_it : method_it.second) {
+        const DexPcData& dex_pc_data = inline_cache_it.second;
+        if (dex_pc_data.is_missing_types) {
+          stats.number_of_missing_types_inline_caches++;
+        } else if (dex_pc_data.is_megamorphic) {
+          stats.number_of_megamorphic_inline_caches++;
+        } else {
+          size_t number_of_types = dex_pc_data.classes.size();
+          if (stats.inline_cache_histogram.size() <= number_of_types) {
+            stats.inline_cache_histogram.resize(number_of_types + 1, 0u);
+          }
+          stats.inline_cache_histogram[number_of_types]++;
+        }
+      }
+    }
+    result.push_back(std::move(stats));
+  }
+  return result;
+}
+
+std::vector<ProfileCompilationInfo::DexFileDiff> ProfileCompilationInfo::GetDexFileDiffs(
+    const ProfileCompilationInfo& other) const {
+  DecodeIndexedData();
+  other.DecodeIndexedData();
+  std::vector<DexFileDiff> result;
+  // Visit the dex files of this profile first, then the ones only in `other`.
+  std::vector<const DexFileData*> dex_data_to_visit(info_.begin(), info_.end());
+  for (const DexFileData* other_dex_data : other.info_) {
+    if (FindDexData(other_dex_data->profile_key) == nullptr) {
+      dex_data_to_visit.push_back(other_dex_data);
+    }
+  }
+  for (const DexFileData* visited_dex_data : dex_data_to_visit) {
+    const std::string& profile_key = visited_dex_data->profile_key;
+    const DexFileData* dex_data = FindDexData(profile_key);
+    const DexFileData* other_dex_data = other.FindDexData(profile_key);
+    DexFileDiff diff;
+    diff.profile_key = profile_key;
+    diff.checksum_mismatch = (dex_data != nullptr) && (other_dex_data != nullptr) &&
+        (dex_data->checksum != other_dex_data->checksum);
+    if (diff.checksum_mismatch) {
+      result.push_back(std::move(diff));
+      continue;
+    }
+    if (other_dex_data != nullptr) {
+      for (const auto& other_method_it : other_dex_data->method_map) {
+        uint16_t method_index = other_method_it.first;
+        if (dex_data == nullptr) {
+          diff.added_methods.insert(method_index);
+          continue;
+        }
+        auto method_it = dex_data->method_map.find(method_index);
+        if (method_it == dex_data->method_map.end()) {
+          diff.added_methods.insert(method_index);
+        } else if (HasNewInlineCacheData(method_it->second, other, other_method_it.second) ||
+                   other.HasNewInlineCacheData(other_method_it.second, *this, method_it->second)) {
+          diff.changed_methods.insert(method_index);
+        }
+      }
+      for (const dex::TypeIndex& type_index : other_dex_data->class_set) {
+        if ((dex_data == nullptr) ||
+            (dex_data->class_set.find(type_index) == dex_data->class_set.end())) {
+          diff.added_classes.insert(type_index);
+        }
+      }
+    }
+    if (dex_data != nullptr) {
+      for (const auto& method_it : dex_data->method_map) {
+        if ((other_dex_data == nullptr) ||
+            (other_dex_data->method_map.find(method_it.first) ==
+                other_dex_data->method_map.end())) {
+          diff.removed_methods.insert(method_it.first);
+        }
+      }
+      for (const dex::TypeIndex& type_index : dex_data->class_set) {
+        if ((other_dex_data == nullptr) ||
+            (other_dex_data->class_set.find(type_index) == other_dex_data->class_set.end())) {
+          diff.removed_classes.insert(type_index);
+        }
+      }
+    }
+    result.push_back(std::move(diff));
+  }
+  return result;
+}
+
 static bool ChecksumMatch(uint32_t dex_file_checksum, uint32_t checksum) {
   return kDebugIgnoreChecksum || dex_file_checksum == checksum;
 }
@@ -978,6 +1633,19 @@ static bool ChecksumMatch(const DexFile& dex_file, uint32_t checksum) {
 }
 
 bool ProfileCompilationInfo::ContainsMethod(const MethodReference& method_ref) const {
+  if (IsIndexed()) {
+    // Test the bitmap directly, there is no need to decode the inline caches.
+    const DexFileData* dex_data =
+        FindDexData(GetProfileDexFileKey(method_ref.dex_file->GetLocation()));
+    if (dex_data == nullptr || !ChecksumMatch(*method_ref.dex_file, dex_data->checksum)) {
+      return false;
+    }
+    const IndexedDexHeader& dex_header = GetIndexedDexHeader(dex_data->profile_index);
+    return method_ref.dex_method_index < dex_header.method_bitmap_bits &&
+        BitVector::IsBitSet(reinterpret_cast<const uint32_t*>(
+                                indexed_map_->Begin() + dex_header.method_bitmap_offset),
+                            method_ref.dex_method_index);
+  }
   return FindMethod(method_ref.dex_file->GetLocation(),
                     method_ref.dex_file->GetLocationChecksum(),
                     method_ref.dex_method_index) != nullptr;
@@ -992,6 +1660,9 @@ ProfileCompilationInfo::FindMethod(const std::string& dex_location,
     if (!ChecksumMatch(dex_checksum, dex_data->checksum)) {
       return nullptr;
     }
+    if (IsIndexed()) {
+      return FindIndexedMethod(*dex_data, dex_method_index);
+    }
     const MethodMap& methods = dex_data->method_map;
     const auto method_it = methods.find(dex_method_index);
     return method_it == methods.end() ? nullptr : &(method_it->second);
@@ -1026,6 +1697,13 @@ bool ProfileCompilationInfo::ContainsClass(const DexFile& dex_file, dex::TypeInd
     if (!ChecksumMatch(dex_file, dex_data->checksum)) {
       return false;
     }
+    if (IsIndexed()) {
+      const IndexedDexHeader& dex_header = GetIndexedDexHeader(dex_data->profile_index);
+      return type_idx.index_ < dex_header.class_bitmap_bits &&
+          BitVector::IsBitSet(reinterpret_cast<const uint32_t*>(
+                                  indexed_map_->Begin() + dex_header.class_bitmap_offset),
+                              type_idx.index_);
+    }
     const ArenaSet<dex::TypeIndex>& classes = dex_data->class_set;
     return classes.find(type_idx) != classes.end();
   }
@@ -1035,7 +1713,9 @@ bool ProfileCompilationInfo::ContainsClass(const DexFile& dex_file, dex::TypeInd
 uint32_t ProfileCompilationInfo::GetNumberOfMethods() const {
   uint32_t total = 0;
   for (const DexFileData* dex_data : info_) {
-    total += dex_data->method_map.size();
+    total += IsIndexed()
+        ? GetIndexedDexHeader(dex_data->profile_index).number_of_methods
+        : dex_data->method_map.size();
   }
   return total;
 }
@@ -1043,7 +1723,9 @@ uint32_t ProfileCompilationInfo::GetNumberOfMethods() const {
 uint32_t ProfileCompilationInfo::GetNumberOfResolvedClasses() const {
   uint32_t total = 0;
   for (const DexFileData* dex_data : info_) {
-    total += dex_data->class_set.size();
+    total += IsIndexed()
+        ? GetIndexedDexHeader(dex_data->profile_index).number_of_classes
+        : dex_data->class_set.size();
   }
   return total;
 }
@@ -1068,6 +1750,7 @@ std::string ProfileCompilationInfo::DumpInfo(
 
 std::string ProfileCompilationInfo::DumpInfo(const std::vector<const DexFile*>* dex_files,
                                              bool print_full_dex_location) const {
+  DecodeIndexedData();
   std::ostringstream os;
   if (info_.empty()) {
     return "ProfileInfo: empty";
@@ -1141,6 +1824,19 @@ bool ProfileCompilationInfo::GetClassesAndMethods(const DexFile& dex_file,
   if (dex_data == nullptr || dex_data->checksum != dex_file.GetLocationChecksum()) {
     return false;
   }
+  if (IsIndexed()) {
+    const IndexedDexHeader& dex_header = GetIndexedDexHeader(dex_data->profile_index);
+    const uint8_t* begin = indexed_map_->Begin();
+    VisitSetBits(reinterpret_cast<const uint32_t*>(begin + dex_header.method_bitmap_offset),
+                 dex_header.method_bitmap_bits,
+                 [method_set](uint32_t method_index) { method_set->insert(method_index); });
+    VisitSetBits(reinterpret_cast<const uint32_t*>(begin + dex_header.class_bitmap_offset),
+                 dex_header.class_bitmap_bits,
+                 [class_set](uint32_t type_index) {
+                   class_set->insert(dex::TypeIndex(type_index));
+                 });
+    return true;
+  }
   for (const auto& it : dex_data->method_map) {
     method_set->insert(it.first);
   }
@@ -1153,6 +1849,8 @@ bool ProfileCompilationInfo::GetClassesAndMethods(const DexFile& dex_file,
 bool ProfileCompilationInfo::Equals(const ProfileCompilationInfo& other) {
   // No need to compare profile_key_map_. That's only a cache for fast search.
   // All the information is already in the info_ vector.
+  DecodeIndexedData();
+  other.DecodeIndexedData();
   if (info_.size() != other.info_.size()) {
     return false;
   }
@@ -1185,7 +1883,19 @@ std::set<DexCacheResolvedClasses> ProfileCompilationInfo::GetResolvedClasses(
         return std::set<DexCacheResolvedClasses>();
       }
       DexCacheResolvedClasses classes(dex_location, dex_location, dex_data->checksum);
-      classes.AddClasses(dex_data->class_set.begin(), dex_data->class_set.end());
+      if (IsIndexed()) {
+        const IndexedDexHeader& dex_header = GetIndexedDexHeader(dex_data->profile_index);
+        std::vector<dex::TypeIndex> class_indices;
+        VisitSetBits(reinterpret_cast<const uint32_t*>(
+                         indexed_map_->Begin() + dex_header.class_bitmap_offset),
+                     dex_header.class_bitmap_bits,
+                     [&class_indices](uint32_t type_index) {
+                       class_indices.push_back(dex::TypeIndex(type_index));
+                     });
+        classes.AddClasses(class_indices.begin(), class_indices.end());
+      } else {
+        classes.AddClasses(dex_data->class_set.begin(), dex_data->class_set.end());
+      }
       ret.insert(classes);
     }
   }
@@ -23,14 +23,18 @@
 #include "atomic.h"
 #include "base/arena_object.h"
 #include "base/arena_containers.h"
+#include "base/mutex.h"
 #include "dex_cache_resolved_classes.h"
 #include "dex_file.h"
 #include "dex_file_types.h"
 #include "method_reference.h"
+#include "os.h"
 #include "safe_map.h"
 
 namespace art {
 
+class MemMap;
+
 /**
  *  Convenient class to pass around profile information (including inline caches)
  *  without the need to hold GC-able objects.
@@ -80,6 +84,9 @@ class ProfileCompilationInfo {
  public:
   static const uint8_t kProfileMagic[];
   static const uint8_t kProfileVersion[];
+  // Version of the indexed format written by SaveIndexed. Indexed profiles are
+  // mapped by Load and queried in place instead of being decoded up front.
+  static const uint8_t kProfileIndexedVersion[];
 
   // Data structures for encoding the offline representation of inline caches.
   // This is exposed as public in order to make it available to dex2oat compilations
@@ -189,6 +196,34 @@ class ProfileCompilationInfo {
     std::vector<DexReference> dex_references;
   };
 
+  // Summary of the data recorded for a dex file (see GetDexFileStats).
+  struct DexFileStats {
+    std::string profile_key;
+    uint32_t checksum;
+    uint32_t number_of_methods;
+    uint32_t number_of_classes;
+    // The number of inline caches which recorded N receiver types is at index N.
+    std::vector<uint32_t> inline_cache_histogram;
+    uint32_t number_of_megamorphic_inline_caches;
+    uint32_t number_of_missing_types_inline_caches;
+  };
+
+  // The differences between the data two profiles record for a dex file
+  // (see GetDexFileDiffs). Added data is only in the other profile, removed
+  // data is only in this one.
+  struct DexFileDiff {
+    std::string profile_key;
+    // True if the profiles record different checksums for the dex file. The
+    // sets are left empty as the indices cannot be compared.
+    bool checksum_mismatch;
+    std::set<uint16_t> added_methods;
+    std::set<uint16_t> removed_methods;
+    // Methods in both profiles whose inline caches differ.
+    std::set<uint16_t> changed_methods;
+    std::set<dex::TypeIndex> added_classes;
+    std::set<dex::TypeIndex> removed_classes;
+  };
+
   // Public methods to create, extend or query the profile.
   ProfileCompilationInfo();
   explicit ProfileCompilationInfo(ArenaPool* arena_pool);
@@ -209,6 +244,9 @@ class ProfileCompilationInfo {
   // the file and returns true.
   bool Load(const std::string& filename, bool clear_if_invalid);
 
+  // As Load(filename, clear_if_invalid), for a file already locked by the caller.
+  bool Load(File* file, bool clear_if_invalid);
+
   // Merge the data from another ProfileCompilationInfo into the current object.
   bool MergeWith(const ProfileCompilationInfo& info);
 
@@ -218,6 +256,33 @@ class ProfileCompilationInfo {
   // Save the current profile into the given file. The file will be cleared before saving.
   bool Save(const std::string& filename, uint64_t* bytes_written);
 
+  // As Save(filename, bytes_written), for a file already locked by the caller.
+  bool Save(File* file, uint64_t* bytes_written);
+
+  // Append the profile data to the given file, after the data already saved there.
+  // Load merges all the profiles found in a file, so this records a delta without
+  // rewriting the existing data.
+  bool Append(const std::string& filename, uint64_t* bytes_written);
+
+  // As Append(filename, bytes_written), for a file already locked by the caller.
+  bool Append(File* file, uint64_t* bytes_written);
+
+  // Add to `delta` the methods, classes and inline caches of `other` which are not
+  // already in the current profile. Returns false if the dex checksums don't match.
+  bool GetNewData(const ProfileCompilationInfo& other,
+                  /*out*/ProfileCompilationInfo* delta) const;
+
+  // Return a summary of the data recorded for each dex file, in profile order.
+  std::vector<DexFileStats> GetDexFileStats() const;
+
+  // Return the differences from the current profile to `other` for each dex file
+  // recorded by either of them. Dex files are matched by profile key.
+  std::vector<DexFileDiff> GetDexFileDiffs(const ProfileCompilationInfo& other) const;
+
+  // Save the profile data to the given file descriptor using the indexed format
+  // (see kProfileIndexedVersion).
+  bool SaveIndexed(int fd);
+
   // Return the number of methods that were profiled.
   uint32_t GetNumberOfMethods() const;
 
@@ -285,6 +350,10 @@ class ProfileCompilationInfo {
   ArenaAllocator* GetArena() { return &arena_; }
 
  private:
+  struct IndexedHeader;
+  struct IndexedDexHeader;
+  struct IndexedInlineCacheEntry;
+
   enum ProfileLoadSatus {
     kProfileLoadWouldOverwiteData,
     kProfileLoadIOError,
@@ -374,6 +443,25 @@ class ProfileCompilationInfo {
   // Checks if the profile is empty.
   bool IsEmpty() const;
 
+  // Returns true if the profile data still lives in the mapping of an indexed profile.
+  bool IsIndexed() const { return indexed_map_ != nullptr; }
+
+  // Return the header of the dex file with the given profile index in the indexed mapping.
+  const IndexedDexHeader& GetIndexedDexHeader(uint8_t profile_index) const;
+
+  // Look up the method in the indexed mapping and decode its inline caches into the
+  // method map of `dex_data`. Returns null if the method is not in the profile.
+  const InlineCacheMap* FindIndexedMethod(const DexFileData& dex_data,
+                                          uint16_t dex_method_index) const;
+
+  // Decode all the methods and classes of the indexed mapping into the dex file data.
+  // The mapping stays valid so that concurrent in place queries keep working.
+  void DecodeIndexedData() const;
+
+  // Decode the indexed mapping and unmap it. Called before any modification of the
+  // profile data or of the file backing it.
+  void ReleaseIndexedData();
+
   // Parsing functionality.
 
   // The information present in the header of each profile line.
@@ -420,6 +508,12 @@ class ProfileCompilationInfo {
   // Entry point for profile loding functionality.
   ProfileLoadSatus LoadInternal(int fd, std::string* error);
 
+  // Read a single profile (header and lines) from the current position of the fd.
+  ProfileLoadSatus ReadProfile(int fd, /*out*/std::string* error);
+
+  // Map and validate an indexed profile of the given size.
+  ProfileLoadSatus LoadIndexed(int fd, size_t file_size, /*out*/std::string* error);
+
   // Read the profile header from the given fd and store the number of profile
   // lines into number_of_dex_files.
   ProfileLoadSatus ReadProfileHeader(int fd,
@@ -475,6 +569,12 @@ class ProfileCompilationInfo {
       const ClassSet& classes,
       /*out*/SafeMap<uint8_t, std::vector<dex::TypeIndex>>* dex_to_classes_map);
 
+  // Return true if `other_inline_cache` (from the `other` profile) holds types or
+  // flags which are not in `inline_cache`.
+  bool HasNewInlineCacheData(const InlineCacheMap& inline_cache,
+                             const ProfileCompilationInfo& other,
+                             const InlineCacheMap& other_inline_cache) const;
+
   // Find the data for the dex_pc in the inline cache. Adds an empty entry
   // if no previous data exists.
   DexPcData* FindOrAddDexPc(InlineCacheMap* inline_cache, uint32_t dex_pc);
@@ -496,6 +596,16 @@ class ProfileCompilationInfo {
   // This is used to speed up searches since it avoids iterating
   // over the info_ vector when searching by profile key.
   ArenaSafeMap<const std::string, uint8_t> profile_key_map_;
+
+  // The mapping of an indexed profile. Null if the profile was not loaded from an indexed
+  // file or if the data was released because the profile was modified.
+  std::unique_ptr<MemMap> indexed_map_;
+
+  // Guards the lazy decoding of the indexed mapping into info_.
+  mutable Mutex indexed_lock_;
+
+  // Whether DecodeIndexedData already decoded the whole mapping.
+  mutable bool indexed_decoded_ GUARDED_BY(indexed_lock_);
 };
 
 }  // namespace art
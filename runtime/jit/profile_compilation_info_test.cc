@@ -78,6 +78,13 @@ class ProfileCompilationInfoTest : public CommonRuntimeTest {
     return info->AddMethodIndex(dex_location, checksum, class_index);
   }
 
+  bool AddClassIndex(const std::string& dex_location,
+                     uint32_t checksum,
+                     uint16_t class_index,
+                     ProfileCompilationInfo* info) {
+    return info->AddClassIndex(dex_location, checksum, dex::TypeIndex(class_index));
+  }
+
   uint32_t GetFd(const ScratchFile& file) {
     return static_cast<uint32_t>(file.GetFd());
   }
@@ -537,6 +544,227 @@ TEST_F(ProfileCompilationInfoTest, SaveInlineCaches) {
   ASSERT_TRUE(*loaded_pmi2 == pmi);
 }
 
+TEST_F(ProfileCompilationInfoTest, SaveIndexed) {
+  ScratchFile profile;
+
+  ProfileCompilationInfo saved_info;
+  ProfileCompilationInfo::OfflineProfileMethodInfo pmi = GetOfflineProfileMethodInfo();
+  for (uint16_t i = 0; i < 10; i++) {
+    ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ i, &saved_info));
+    ASSERT_TRUE(AddMethod("dex_location4", /* checksum */ 4, /* method_idx */ 100 + i, pmi,
+                          &saved_info));
+    ASSERT_TRUE(AddClassIndex("dex_location1", /* checksum */ 1, /* class_idx */ 2 * i,
+                              &saved_info));
+  }
+  ASSERT_TRUE(saved_info.SaveIndexed(GetFd(profile)));
+  ASSERT_EQ(0, profile.GetFile()->Flush());
+
+  ProfileCompilationInfo loaded_info;
+  ASSERT_TRUE(profile.GetFile()->ResetOffset());
+  ASSERT_TRUE(loaded_info.Load(GetFd(profile)));
+
+  // Queries are answered from the mapped profile.
+  ASSERT_EQ(saved_info.GetNumberOfMethods(), loaded_info.GetNumberOfMethods());
+  ASSERT_EQ(saved_info.GetNumberOfResolvedClasses(), loaded_info.GetNumberOfResolvedClasses());
+  ASSERT_TRUE(loaded_info.GetMethod("dex_location1", /* checksum */ 1, /* method_idx */ 3)
+              != nullptr);
+  ASSERT_TRUE(loaded_info.GetMethod("dex_location1", /* checksum */ 1, /* method_idx */ 10)
+              == nullptr);
+  ASSERT_TRUE(loaded_info.GetMethod("dex_location1", /* checksum */ 2, /* method_idx */ 3)
+              == nullptr);
+  std::unique_ptr<ProfileCompilationInfo::OfflineProfileMethodInfo> loaded_pmi =
+      loaded_info.GetMethod("dex_location4", /* checksum */ 4, /* method_idx */ 103);
+  ASSERT_TRUE(loaded_pmi != nullptr);
+  ASSERT_TRUE(*loaded_pmi == pmi);
+
+  // Operations on the whole profile decode the mapping.
+  ASSERT_TRUE(loaded_info.Equals(saved_info));
+
+  // Modifications release the mapping.
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 11, &saved_info));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 11, &loaded_info));
+  ASSERT_TRUE(loaded_info.Equals(saved_info));
+  ASSERT_EQ(saved_info.GetNumberOfMethods(), loaded_info.GetNumberOfMethods());
+}
+
+TEST_F(ProfileCompilationInfoTest, IncompleteIndexed) {
+  ScratchFile profile;
+
+  ProfileCompilationInfo saved_info;
+  for (uint16_t i = 0; i < 10; i++) {
+    ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ i, &saved_info));
+  }
+  ASSERT_TRUE(saved_info.SaveIndexed(GetFd(profile)));
+  ASSERT_EQ(0, profile.GetFile()->Flush());
+  ASSERT_EQ(0, profile.GetFile()->SetLength(profile.GetFile()->GetLength() - 1));
+
+  // Check that we fail because the profile size does not match its header.
+  ProfileCompilationInfo loaded_info;
+  ASSERT_TRUE(profile.GetFile()->ResetOffset());
+  ASSERT_FALSE(loaded_info.Load(GetFd(profile)));
+}
+
+TEST_F(ProfileCompilationInfoTest, AppendDeltas) {
+  ScratchFile profile;
+
+  ProfileCompilationInfo saved_info;
+  ProfileCompilationInfo::OfflineProfileMethodInfo pmi = GetOfflineProfileMethodInfo();
+  for (uint16_t i = 0; i < 10; i++) {
+    ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ i, &saved_info));
+  }
+  ASSERT_TRUE(saved_info.Save(GetFd(profile)));
+  ASSERT_EQ(0, profile.GetFile()->Flush());
+
+  // Append two deltas, the second one with a dex file indexing different from the file.
+  ProfileCompilationInfo delta1;
+  ProfileCompilationInfo delta2;
+  for (uint16_t i = 10; i < 20; i++) {
+    ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ i, &delta1));
+    ASSERT_TRUE(AddMethod("dex_location4", /* checksum */ 4, /* method_idx */ i, pmi, &delta2));
+  }
+  ASSERT_TRUE(AddClassIndex("dex_location1", /* checksum */ 1, /* class_idx */ 1, &delta1));
+  ASSERT_TRUE(delta1.Append(profile.GetFilename(), nullptr));
+  ASSERT_TRUE(delta2.Append(profile.GetFilename(), nullptr));
+
+  // Loading the file merges the deltas.
+  ASSERT_TRUE(saved_info.MergeWith(delta1));
+  ASSERT_TRUE(saved_info.MergeWith(delta2));
+  ProfileCompilationInfo loaded_info;
+  ASSERT_TRUE(profile.GetFile()->ResetOffset());
+  ASSERT_TRUE(loaded_info.Load(GetFd(profile)));
+  ASSERT_TRUE(loaded_info.Equals(saved_info));
+  ASSERT_EQ(1u, loaded_info.GetNumberOfResolvedClasses());
+  std::unique_ptr<ProfileCompilationInfo::OfflineProfileMethodInfo> loaded_pmi =
+      loaded_info.GetMethod("dex_location4", /* checksum */ 4, /* method_idx */ 15);
+  ASSERT_TRUE(loaded_pmi != nullptr);
+  ASSERT_TRUE(*loaded_pmi == pmi);
+}
+
+TEST_F(ProfileCompilationInfoTest, GetNewData) {
+  ProfileCompilationInfo saved_info;
+  ProfileCompilationInfo::OfflineProfileMethodInfo pmi = GetOfflineProfileMethodInfo();
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 1, pmi, &saved_info));
+  ASSERT_TRUE(AddClassIndex("dex_location1", /* checksum */ 1, /* class_idx */ 1, &saved_info));
+
+  // Data which is already saved is not part of the delta.
+  ProfileCompilationInfo new_info;
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 1, pmi, &new_info));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 2, &new_info));
+  ASSERT_TRUE(AddClassIndex("dex_location1", /* checksum */ 1, /* class_idx */ 1, &new_info));
+  ASSERT_TRUE(AddClassIndex("dex_location1", /* checksum */ 1, /* class_idx */ 3, &new_info));
+  ProfileCompilationInfo delta;
+  ASSERT_TRUE(saved_info.GetNewData(new_info, &delta));
+  ASSERT_EQ(1u, delta.GetNumberOfMethods());
+  ASSERT_EQ(1u, delta.GetNumberOfResolvedClasses());
+  ASSERT_TRUE(delta.GetMethod("dex_location1", /* checksum */ 1, /* method_idx */ 2) != nullptr);
+
+  // A method with new inline cache data is part of the delta.
+  ProfileCompilationInfo::OfflineProfileMethodInfo pmi_new_type = GetOfflineProfileMethodInfo();
+  ProfileCompilationInfo::InlineCacheMap* ic_map =
+      const_cast<ProfileCompilationInfo::InlineCacheMap*>(pmi_new_type.inline_caches);
+  ic_map->find(0)->second.AddClass(1, dex::TypeIndex(5));
+  ProfileCompilationInfo new_info_new_type;
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 1, pmi_new_type,
+                        &new_info_new_type));
+  ProfileCompilationInfo delta_new_type;
+  ASSERT_TRUE(saved_info.GetNewData(new_info_new_type, &delta_new_type));
+  ASSERT_EQ(1u, delta_new_type.GetNumberOfMethods());
+
+  // Checksum mismatches are reported.
+  ProfileCompilationInfo new_info_mismatch;
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 2, /* method_idx */ 3,
+                        &new_info_mismatch));
+  ProfileCompilationInfo delta_mismatch;
+  ASSERT_FALSE(saved_info.GetNewData(new_info_mismatch, &delta_mismatch));
+}
+
+TEST_F(ProfileCompilationInfoTest, GetDexFileStats) {
+  ProfileCompilationInfo info;
+  ProfileCompilationInfo::OfflineProfileMethodInfo pmi = GetOfflineProfileMethodInfo();
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 1, pmi, &info));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 2, &info));
+  ASSERT_TRUE(AddClassIndex("dex_location1", /* checksum */ 1, /* class_idx */ 1, &info));
+
+  std::vector<ProfileCompilationInfo::DexFileStats> stats = info.GetDexFileStats();
+  // The inline caches reference the other dex files of the method info.
+  ASSERT_EQ(3u, stats.size());
+  ASSERT_EQ("dex_location1", stats[0].profile_key);
+  ASSERT_EQ(1u, stats[0].checksum);
+  ASSERT_EQ(2u, stats[0].number_of_methods);
+  ASSERT_EQ(1u, stats[0].number_of_classes);
+  ASSERT_EQ(4u, stats[0].inline_cache_histogram.size());
+  ASSERT_EQ(0u, stats[0].inline_cache_histogram[0]);
+  ASSERT_EQ(11u, stats[0].inline_cache_histogram[1]);
+  ASSERT_EQ(0u, stats[0].inline_cache_histogram[2]);
+  ASSERT_EQ(11u, stats[0].inline_cache_histogram[3]);
+  ASSERT_EQ(11u, stats[0].number_of_megamorphic_inline_caches);
+  ASSERT_EQ(11u, stats[0].number_of_missing_types_inline_caches);
+  for (size_t i = 1; i < stats.size(); i++) {
+    ASSERT_EQ(0u, stats[i].number_of_methods);
+    ASSERT_EQ(0u, stats[i].number_of_classes);
+  }
+}
+
+TEST_F(ProfileCompilationInfoTest, GetDexFileDiffs) {
+  ProfileCompilationInfo info1;
+  ProfileCompilationInfo::OfflineProfileMethodInfo pmi = GetOfflineProfileMethodInfo();
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 1, pmi, &info1));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 2, pmi, &info1));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 3, &info1));
+  ASSERT_TRUE(AddClassIndex("dex_location1", /* checksum */ 1, /* class_idx */ 1, &info1));
+  ASSERT_TRUE(AddClassIndex("dex_location5", /* checksum */ 5, /* class_idx */ 1, &info1));
+
+  ProfileCompilationInfo info2;
+  ProfileCompilationInfo::OfflineProfileMethodInfo pmi_new_type = GetOfflineProfileMethodInfo();
+  ProfileCompilationInfo::InlineCacheMap* ic_map =
+      const_cast<ProfileCompilationInfo::InlineCacheMap*>(pmi_new_type.inline_caches);
+  ic_map->find(0)->second.AddClass(1, dex::TypeIndex(5));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 1, pmi, &info2));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 2, pmi_new_type,
+                        &info2));
+  ASSERT_TRUE(AddMethod("dex_location1", /* checksum */ 1, /* method_idx */ 4, &info2));
+  ASSERT_TRUE(AddClassIndex("dex_location1", /* checksum */ 1, /* class_idx */ 2, &info2));
+  ASSERT_TRUE(AddClassIndex("dex_location5", /* checksum */ 6, /* class_idx */ 1, &info2));
+  ASSERT_TRUE(AddClassIndex("dex_location6", /* checksum */ 6, /* class_idx */ 3, &info2));
+
+  std::vector<ProfileCompilationInfo::DexFileDiff> diffs = info1.GetDexFileDiffs(info2);
+  ASSERT_EQ(5u, diffs.size());
+  const ProfileCompilationInfo::DexFileDiff& diff1 = diffs[0];
+  ASSERT_EQ("dex_location1", diff1.profile_key);
+  ASSERT_FALSE(diff1.checksum_mismatch);
+  ASSERT_EQ(std::set<uint16_t>({4}), diff1.added_methods);
+  ASSERT_EQ(std::set<uint16_t>({3}), diff1.removed_methods);
+  ASSERT_EQ(std::set<uint16_t>({2}), diff1.changed_methods);
+  ASSERT_EQ(std::set<dex::TypeIndex>({dex::TypeIndex(2)}), diff1.added_classes);
+  ASSERT_EQ(std::set<dex::TypeIndex>({dex::TypeIndex(1)}), diff1.removed_classes);
+
+  bool found_mismatch = false;
+  bool found_new_dex = false;
+  for (const ProfileCompilationInfo::DexFileDiff& diff : diffs) {
+    if (diff.profile_key == "dex_location5") {
+      found_mismatch = true;
+      ASSERT_TRUE(diff.checksum_mismatch);
+      ASSERT_TRUE(diff.removed_classes.empty());
+    } else if (diff.profile_key == "dex_location6") {
+      found_new_dex = true;
+      ASSERT_FALSE(diff.checksum_mismatch);
+      ASSERT_EQ(std::set<dex::TypeIndex>({dex::TypeIndex(3)}), diff.added_classes);
+    }
+  }
+  ASSERT_TRUE(found_mismatch);
+  ASSERT_TRUE(found_new_dex);
+
+  // A profile does not differ from itself.
+  for (const ProfileCompilationInfo::DexFileDiff& diff : info1.GetDexFileDiffs(info1)) {
+    ASSERT_FALSE(diff.checksum_mismatch);
+    ASSERT_TRUE(diff.added_methods.empty());
+    ASSERT_TRUE(diff.removed_methods.empty());
+    ASSERT_TRUE(diff.changed_methods.empty());
+    ASSERT_TRUE(diff.added_classes.empty());
+    ASSERT_TRUE(diff.removed_classes.empty());
+  }
+}
+
 TEST_F(ProfileCompilationInfoTest, MegamorphicInlineCaches) {
   ScratchFile profile;
 
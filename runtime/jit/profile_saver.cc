@@ -25,8 +25,10 @@
 
 #include "art_method-inl.h"
 #include "base/enums.h"
+#include "base/scoped_flock.h"
 #include "base/systrace.h"
 #include "base/time_utils.h"
+#include "base/unix_file/fd_file.h"
 #include "compiler_filter.h"
 #include "gc/collector_type.h"
 #include "gc/gc_cause.h"
@@ -54,6 +56,7 @@ ProfileSaver::ProfileSaver(const ProfileSaverOptions& options,
       total_number_of_code_cache_queries_(0),
       total_number_of_skipped_writes_(0),
       total_number_of_failed_writes_(0),
+      total_number_of_compactions_(0),
       total_ms_of_sleep_(0),
       total_ns_of_work_(0),
       max_number_of_profile_entries_cached_(0),
@@ -310,14 +313,33 @@ bool ProfileSaver::ProcessProfilingInfo(bool force_save, /*out*/uint16_t* number
       total_number_of_code_cache_queries_++;
     }
     {
-      ProfileCompilationInfo info(Runtime::Current()->GetArenaPool());
-      if (!info.Load(filename, /*clear_if_invalid*/ true)) {
-        LOG(WARNING) << "Could not forcefully load profile " << filename;
+      // Keep the file locked from the size check to the write. Otherwise someone could
+      // change it in between (e.g. clear it after compilation) and the delta would be
+      // appended to data which is not the one persisted in memory.
+      ScopedFlock flock;
+      std::string error;
+      int flags = O_RDWR | O_NOFOLLOW | O_CLOEXEC;
+      if (!flock.Init(filename.c_str(), flags, /*block*/false, /*flush_on_close*/false, &error)) {
+        LOG(WARNING) << "Couldn't lock the profile file " << filename << ": " << error;
         continue;
       }
-      uint64_t last_save_number_of_methods = info.GetNumberOfMethods();
-      uint64_t last_save_number_of_classes = info.GetNumberOfResolvedClasses();
+      File* file = flock.GetFile();
+
+      // Load the file only the first time or if someone else changed it. Otherwise
+      // the persisted data is already in memory.
+      PersistedProfile& persisted = persisted_profiles_.FindOrAdd(filename)->second;
+      if (persisted.info == nullptr || file->GetLength() != persisted.file_size) {
+        persisted.info.reset(new ProfileCompilationInfo(Runtime::Current()->GetArenaPool()));
+        if (!persisted.info->Load(file, /*clear_if_invalid*/ true)) {
+          LOG(WARNING) << "Could not forcefully load profile " << filename;
+          persisted.info.reset();
+          continue;
+        }
+        persisted.file_size = file->GetLength();
+        persisted.number_of_deltas = 0;
+      }
 
+      ProfileCompilationInfo info(Runtime::Current()->GetArenaPool());
       info.AddMethodsAndClasses(profile_methods,
                                 std::set<DexCacheResolvedClasses>());
       auto profile_cache_it = profile_cache_.find(filename);
@@ -325,11 +347,22 @@ bool ProfileSaver::ProcessProfilingInfo(bool force_save, /*out*/uint16_t* number
         info.MergeWith(*(profile_cache_it->second));
       }
 
-      int64_t delta_number_of_methods =
-          info.GetNumberOfMethods() - last_save_number_of_methods;
-      int64_t delta_number_of_classes =
-          info.GetNumberOfResolvedClasses() - last_save_number_of_classes;
+      // Only the data which is not yet in the file needs to be written.
+      ProfileCompilationInfo delta(Runtime::Current()->GetArenaPool());
+      if (!persisted.info->GetNewData(info, &delta)) {
+        LOG(WARNING) << "Could not compute the new profile data for " << filename;
+        total_number_of_skipped_writes_++;
+        continue;
+      }
+      int64_t delta_number_of_methods = delta.GetNumberOfMethods();
+      int64_t delta_number_of_classes = delta.GetNumberOfResolvedClasses();
 
+      if (delta_number_of_methods == 0 && delta_number_of_classes == 0) {
+        // Everything is already on disk, even a forced save has nothing to write.
+        VLOG(profiler) << "No new profile information for: " << filename;
+        total_number_of_skipped_writes_++;
+        continue;
+      }
       if (!force_save &&
           delta_number_of_methods < options_.GetMinMethodsToSave() &&
           delta_number_of_classes < options_.GetMinClassesToSave()) {
@@ -344,10 +377,25 @@ bool ProfileSaver::ProcessProfilingInfo(bool force_save, /*out*/uint16_t* number
             std::max(static_cast<uint16_t>(delta_number_of_methods),
                      *number_of_new_methods);
       }
-      uint64_t bytes_written;
-      // Force the save. In case the profile data is corrupted or the the profile
-      // has the wrong version this will "fix" the file to the correct format.
-      if (info.Save(filename, &bytes_written)) {
+      uint64_t bytes_written = 0;
+      bool saved;
+      persisted.info->MergeWith(delta);
+      if (persisted.number_of_deltas >= options_.GetMaxDeltasBeforeCompaction()) {
+        // Compact the file: rewrite it in full, which also drops the duplicated
+        // inline caches recorded by the deltas.
+        saved = persisted.info->Save(file, &bytes_written);
+        if (saved) {
+          persisted.number_of_deltas = 0;
+          total_number_of_compactions_++;
+        }
+      } else {
+        saved = delta.Append(file, &bytes_written);
+        if (saved) {
+          persisted.number_of_deltas++;
+        }
+      }
+      if (saved) {
+        persisted.file_size = file->GetLength();
         // We managed to save the profile. Clear the cache stored during startup.
         if (profile_cache_it != profile_cache_.end()) {
           ProfileCompilationInfo *cached_info = profile_cache_it->second;
@@ -359,15 +407,13 @@ bool ProfileSaver::ProcessProfilingInfo(bool force_save, /*out*/uint16_t* number
           total_bytes_written_ += bytes_written;
           profile_file_saved = true;
         } else {
-          // At this point we could still have avoided the write.
-          // We load and merge the data from the file lazily at its first ever
-          // save attempt. So, whatever we are trying to save could already be
-          // in the file.
           total_number_of_skipped_writes_++;
         }
       } else {
         LOG(WARNING) << "Could not save profiling info to " << filename;
         total_number_of_failed_writes_++;
+        // The persisted data now includes the delta, reload the file on the next save.
+        persisted.info.reset();
       }
     }
     // Trim the maps to madvise the pages used for profile info.
@@ -570,6 +616,7 @@ void ProfileSaver::DumpInfo(std::ostream& os) {
      << total_number_of_code_cache_queries_ << '\n'
      << "ProfileSaver total_number_of_skipped_writes=" << total_number_of_skipped_writes_ << '\n'
      << "ProfileSaver total_number_of_failed_writes=" << total_number_of_failed_writes_ << '\n'
+     << "ProfileSaver total_number_of_compactions=" << total_number_of_compactions_ << '\n'
      << "ProfileSaver total_ms_of_sleep=" << total_ms_of_sleep_ << '\n'
      << "ProfileSaver total_ms_of_work=" << NsToMs(total_ns_of_work_) << '\n'
      << "ProfileSaver max_number_profile_entries_cached="
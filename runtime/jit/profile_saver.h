@@ -75,6 +75,20 @@ class ProfileSaver {
   // The run loop for the saver.
   void Run() REQUIRES(!Locks::profiler_lock_, !wait_lock_);
 
+  // The profile data which is known to be in a profile file. Saves only append the
+  // data missing from it to the file (see ProcessProfilingInfo).
+  struct PersistedProfile {
+    PersistedProfile() : file_size(-1), number_of_deltas(0) {}
+
+    // The content of the file, or null if it needs to be (re)loaded.
+    std::unique_ptr<ProfileCompilationInfo> info;
+    // The size of the file after our last write. A different size means that the
+    // file was changed by someone else (e.g. cleared after compilation).
+    int64_t file_size;
+    // The number of deltas appended since the file was last written in full.
+    uint32_t number_of_deltas;
+  };
+
   // Processes the existing profiling info from the jit code cache and returns
   // true if it needed to be saved to disk.
   // If number_of_new_methods is not null, after the call it will contain the number of new methods
@@ -134,6 +148,10 @@ class ProfileSaver {
   // to just a few hundreds entries in the ProfileCompilationInfo objects.
   SafeMap<std::string, ProfileCompilationInfo*> profile_cache_;
 
+  // The data persisted in each tracked profile file. Only accessed by the saver thread
+  // (and by ForceProcessProfiles in tests).
+  SafeMap<std::string, PersistedProfile> persisted_profiles_;
+
   // Save period condition support.
   Mutex wait_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   ConditionVariable period_condition_ GUARDED_BY(wait_lock_);
@@ -143,6 +161,7 @@ class ProfileSaver {
   uint64_t total_number_of_code_cache_queries_;
   uint64_t total_number_of_skipped_writes_;
   uint64_t total_number_of_failed_writes_;
+  uint64_t total_number_of_compactions_;
   uint64_t total_ms_of_sleep_;
   uint64_t total_ns_of_work_;
   // TODO(calin): replace with an actual size.
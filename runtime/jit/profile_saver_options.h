@@ -28,6 +28,8 @@ struct ProfileSaverOptions {
   static constexpr uint32_t kMinClassesToSave = 10;
   static constexpr uint32_t kMinNotificationBeforeWake = 10;
   static constexpr uint32_t kMaxNotificationBeforeWake = 50;
+  // Number of deltas appended to a profile file before it is rewritten in full.
+  static constexpr uint32_t kMaxDeltasBeforeCompaction = 10;
 
   ProfileSaverOptions() :
     enabled_(false),
@@ -38,6 +40,7 @@ struct ProfileSaverOptions {
     min_classes_to_save_(kMinClassesToSave),
     min_notification_before_wake_(kMinNotificationBeforeWake),
     max_notification_before_wake_(kMaxNotificationBeforeWake),
+    max_deltas_before_compaction_(kMaxDeltasBeforeCompaction),
     profile_path_("") {}
 
   ProfileSaverOptions(
@@ -49,6 +52,7 @@ struct ProfileSaverOptions {
       uint32_t min_classes_to_save,
       uint32_t min_notification_before_wake,
       uint32_t max_notification_before_wake,
+      uint32_t max_deltas_before_compaction,
       const std::string& profile_path):
     enabled_(enabled),
     min_save_period_ms_(min_save_period_ms),
@@ -58,6 +62,7 @@ struct ProfileSaverOptions {
     min_classes_to_save_(min_classes_to_save),
     min_notification_before_wake_(min_notification_before_wake),
     max_notification_before_wake_(max_notification_before_wake),
+    max_deltas_before_compaction_(max_deltas_before_compaction),
     profile_path_(profile_path) {}
 
   bool IsEnabled() const {
@@ -88,6 +93,9 @@ struct ProfileSaverOptions {
   uint32_t GetMaxNotificationBeforeWake() const {
     return max_notification_before_wake_;
   }
+  uint32_t GetMaxDeltasBeforeCompaction() const {
+    return max_deltas_before_compaction_;
+  }
   std::string GetProfilePath() const {
     return profile_path_;
   }
@@ -100,7 +108,8 @@ struct ProfileSaverOptions {
         << ", min_methods_to_save_" << pso.min_methods_to_save_
         << ", min_classes_to_save_" << pso.min_classes_to_save_
         << ", min_notification_before_wake_" << pso.min_notification_before_wake_
-        << ", max_notification_before_wake_" << pso.max_notification_before_wake_;
+        << ", max_notification_before_wake_" << pso.max_notification_before_wake_
+        << ", max_deltas_before_compaction_" << pso.max_deltas_before_compaction_;
     return os;
   }
 
@@ -112,6 +121,7 @@ struct ProfileSaverOptions {
   uint32_t min_classes_to_save_;
   uint32_t min_notification_before_wake_;
   uint32_t max_notification_before_wake_;
+  uint32_t max_deltas_before_compaction_;
   std::string profile_path_;
 };
 
@@ -68,10 +68,17 @@ std::ostream& operator << (std::ostream& stream, const OatFileAssistant::OatStat
 OatFileAssistant::OatFileAssistant(const char* dex_location,
                                    const InstructionSet isa,
                                    bool load_executable)
+    : OatFileAssistant(dex_location, isa, load_executable, /*image_info*/ nullptr) {}
+
+OatFileAssistant::OatFileAssistant(const char* dex_location,
+                                   const InstructionSet isa,
+                                   bool load_executable,
+                                   const ImageInfo* image_info)
     : isa_(isa),
       load_executable_(load_executable),
       odex_(this, /*is_oat_location*/ false),
-      oat_(this, /*is_oat_location*/ true) {
+      oat_(this, /*is_oat_location*/ true),
+      image_info_(image_info) {
   CHECK(dex_location != nullptr) << "OatFileAssistant: null dex location";
 
   // Try to get the realpath for the dex location.
@@ -862,15 +869,16 @@ OatFileAssistant::ImageInfo::GetRuntimeImageInfo(InstructionSet isa, std::string
 }
 
 const OatFileAssistant::ImageInfo* OatFileAssistant::GetImageInfo() {
-  if (!image_info_load_attempted_) {
+  if (image_info_ == nullptr && !image_info_load_attempted_) {
     image_info_load_attempted_ = true;
     std::string error_msg;
     cached_image_info_ = ImageInfo::GetRuntimeImageInfo(isa_, &error_msg);
     if (cached_image_info_ == nullptr) {
       LOG(WARNING) << "Unable to get runtime image info: " << error_msg;
     }
+    image_info_ = cached_image_info_.get();
   }
-  return cached_image_info_.get();
+  return image_info_;
 }
 
 OatFileAssistant::OatFileInfo& OatFileAssistant::GetBestInfo() {
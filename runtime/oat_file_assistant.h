@@ -101,6 +101,19 @@ class OatFileAssistant {
     kOatUpToDate,
   };
 
+  // The boot image information the oat files are checked against.
+  struct ImageInfo {
+    uint32_t oat_checksum = 0;
+    uintptr_t oat_data_begin = 0;
+    int32_t patch_delta = 0;
+    std::string location;
+
+    // Reads the header of the runtime's boot image for the given isa.
+    // Returns null and sets error_msg if the header could not be read.
+    static std::unique_ptr<ImageInfo> GetRuntimeImageInfo(InstructionSet isa,
+                                                          std::string* error_msg);
+  };
+
   // Constructs an OatFileAssistant object to assist the oat file
   // corresponding to the given dex location with the target instruction set.
   //
@@ -122,6 +135,15 @@ class OatFileAssistant {
                    const InstructionSet isa,
                    bool load_executable);
 
+  // As above, but checks the oat files against the given image_info instead of
+  // reading the boot image header for isa. This lets callers which create many
+  // OatFileAssistant objects read the header once per isa.
+  // The image_info must outlive the OatFileAssistant object.
+  OatFileAssistant(const char* dex_location,
+                   const InstructionSet isa,
+                   bool load_executable,
+                   const ImageInfo* image_info);
+
   ~OatFileAssistant();
 
   // Returns true if the dex location refers to an element of the boot class
@@ -265,16 +287,6 @@ class OatFileAssistant {
                                        std::string* error_msg);
 
  private:
-  struct ImageInfo {
-    uint32_t oat_checksum = 0;
-    uintptr_t oat_data_begin = 0;
-    int32_t patch_delta = 0;
-    std::string location;
-
-    static std::unique_ptr<ImageInfo> GetRuntimeImageInfo(InstructionSet isa,
-                                                          std::string* error_msg);
-  };
-
   class OatFileInfo {
    public:
     // Initially the info is for no file in particular. It will treat the
@@ -449,6 +461,10 @@ class OatFileAssistant {
   bool image_info_load_attempted_ = false;
   std::unique_ptr<ImageInfo> cached_image_info_;
 
+  // The image info passed to the constructor or cached_image_info_, once loaded.
+  // Not owned.
+  const ImageInfo* image_info_ = nullptr;
+
   friend class OatFileAssistantTest;
 
   DISALLOW_COPY_AND_ASSIGN(OatFileAssistant);
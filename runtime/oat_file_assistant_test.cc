@@ -605,6 +605,43 @@ TEST_F(OatFileAssistantTest, OatImageOutOfDate) {
   EXPECT_TRUE(oat_file_assistant.HasOriginalDexFiles());
 }
 
+// Case: We have a DEX file and an OAT file, checked against the given image info
+// rather than the boot image header.
+// Expect: The OAT file is up to date with the image info of the runtime and out of
+// date with the image info of another boot image.
+TEST_F(OatFileAssistantTest, OatGivenImageInfo) {
+  if (IsExecutedAsRoot()) {
+    // We cannot simulate non writable locations when executed as root: b/38000545.
+    LOG(ERROR) << "Test skipped because it's running as root";
+    return;
+  }
+
+  std::string dex_location = GetScratchDir() + "/OatGivenImageInfo.jar";
+  Copy(GetDexSrc1(), dex_location);
+  GenerateOatForTest(dex_location.c_str(), CompilerFilter::kSpeed);
+
+  ScopedNonWritable scoped_non_writable(dex_location);
+  ASSERT_TRUE(scoped_non_writable.IsSuccessful());
+
+  std::string error_msg;
+  std::unique_ptr<OatFileAssistant::ImageInfo> image_info =
+      OatFileAssistant::ImageInfo::GetRuntimeImageInfo(kRuntimeISA, &error_msg);
+  ASSERT_TRUE(image_info != nullptr) << error_msg;
+
+  OatFileAssistant oat_file_assistant(dex_location.c_str(), kRuntimeISA, false, image_info.get());
+  EXPECT_EQ(OatFileAssistant::kNoDexOptNeeded,
+      oat_file_assistant.GetDexOptNeeded(CompilerFilter::kSpeed));
+  EXPECT_EQ(OatFileAssistant::kOatUpToDate, oat_file_assistant.OatFileStatus());
+
+  OatFileAssistant::ImageInfo other_image_info = *image_info;
+  other_image_info.oat_checksum++;
+  OatFileAssistant other_oat_file_assistant(
+      dex_location.c_str(), kRuntimeISA, false, &other_image_info);
+  EXPECT_EQ(OatFileAssistant::kDex2OatForBootImage,
+      other_oat_file_assistant.GetDexOptNeeded(CompilerFilter::kSpeed));
+  EXPECT_EQ(OatFileAssistant::kOatBootImageOutOfDate, other_oat_file_assistant.OatFileStatus());
+}
+
 // Case: We have a DEX file and a verify-at-runtime OAT file out of date with
 // respect to the boot image.
 // It shouldn't matter that the OAT file is out of date, because it is
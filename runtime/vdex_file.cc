@@ -168,61 +168,89 @@ bool VdexFile::OpenAllDexFiles(std::vector<std::unique_ptr<const DexFile>>* dex_
   return true;
 }
 
+// Calls `visitor` for each code item of `dex_file` with the quickening data recorded for it,
+// which starts at `quickening_info_ptr`. Returns a pointer past the data of `dex_file`.
+template <typename Visitor>
+static const uint8_t* VisitQuickeningInfo(const DexFile& dex_file,
+                                          const uint8_t* quickening_info_ptr,
+                                          const Visitor& visitor) {
+  for (uint32_t i = 0; i < dex_file.NumClassDefs(); ++i) {
+    const DexFile::ClassDef& class_def = dex_file.GetClassDef(i);
+    const uint8_t* class_data = dex_file.GetClassData(class_def);
+    if (class_data == nullptr) {
+      continue;
+    }
+    ClassDataItemIterator it(dex_file, class_data);
+    // Skip fields
+    while (it.HasNextStaticField()) {
+      it.Next();
+    }
+    while (it.HasNextInstanceField()) {
+      it.Next();
+    }
+
+    // Direct and virtual methods.
+    while (it.HasNext()) {
+      const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
+      if (code_item != nullptr) {
+        uint32_t quickening_size = *reinterpret_cast<const uint32_t*>(quickening_info_ptr);
+        quickening_info_ptr += sizeof(uint32_t);
+        visitor(*code_item, ArrayRef<const uint8_t>(quickening_info_ptr, quickening_size));
+        quickening_info_ptr += quickening_size;
+      }
+      it.Next();
+    }
+  }
+  return quickening_info_ptr;
+}
+
+ArrayRef<const uint8_t> VdexFile::GetQuickeningInfoOf(
+    const DexFile& dex_file,
+    const ArrayRef<const uint8_t>& quickening_info) {
+  if (quickening_info.size() == 0) {
+    return quickening_info;
+  }
+  const uint8_t* end = VisitQuickeningInfo(
+      dex_file,
+      quickening_info.data(),
+      [](const DexFile::CodeItem& code_item ATTRIBUTE_UNUSED,
+         const ArrayRef<const uint8_t>& data ATTRIBUTE_UNUSED) {});
+  CHECK_LE(end, quickening_info.data() + quickening_info.size());
+  return quickening_info.SubArray(0u, end - quickening_info.data());
+}
+
+size_t VdexFile::UnquickenDexFile(const DexFile& dex_file,
+                                  const ArrayRef<const uint8_t>& quickening_info,
+                                  bool decompile_return_instruction) {
+  if (quickening_info.size() == 0) {
+    // If there is no quickening info, we bail early, as the code below expects at
+    // least the size of quickening data for each method that has a code item.
+    return 0u;
+  }
+  const uint8_t* end = VisitQuickeningInfo(
+      dex_file,
+      quickening_info.data(),
+      [decompile_return_instruction](const DexFile::CodeItem& code_item,
+                                     const ArrayRef<const uint8_t>& data) {
+        optimizer::ArtDecompileDEX(code_item, data, decompile_return_instruction);
+      });
+  CHECK_LE(end, quickening_info.data() + quickening_info.size());
+  return end - quickening_info.data();
+}
+
 void VdexFile::Unquicken(const std::vector<const DexFile*>& dex_files,
                          const ArrayRef<const uint8_t>& quickening_info,
                          bool decompile_return_instruction) {
   if (quickening_info.size() == 0) {
-    // If there is no quickening info, we bail early, as the code below expects at
-    // least the size of quickening data for each method that has a code item.
     return;
   }
-  const uint8_t* quickening_info_ptr = quickening_info.data();
-  const uint8_t* const quickening_info_end = quickening_info.data() + quickening_info.size();
+  size_t offset = 0u;
   for (const DexFile* dex_file : dex_files) {
-    for (uint32_t i = 0; i < dex_file->NumClassDefs(); ++i) {
-      const DexFile::ClassDef& class_def = dex_file->GetClassDef(i);
-      const uint8_t* class_data = dex_file->GetClassData(class_def);
-      if (class_data == nullptr) {
-        continue;
-      }
-      ClassDataItemIterator it(*dex_file, class_data);
-      // Skip fields
-      while (it.HasNextStaticField()) {
-        it.Next();
-      }
-      while (it.HasNextInstanceField()) {
-        it.Next();
-      }
-
-      while (it.HasNextDirectMethod()) {
-        const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
-        if (code_item != nullptr) {
-          uint32_t quickening_size = *reinterpret_cast<const uint32_t*>(quickening_info_ptr);
-          quickening_info_ptr += sizeof(uint32_t);
-          optimizer::ArtDecompileDEX(*code_item,
-                                     ArrayRef<const uint8_t>(quickening_info_ptr, quickening_size),
-                                     decompile_return_instruction);
-          quickening_info_ptr += quickening_size;
-        }
-        it.Next();
-      }
-
-      while (it.HasNextVirtualMethod()) {
-        const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
-        if (code_item != nullptr) {
-          uint32_t quickening_size = *reinterpret_cast<const uint32_t*>(quickening_info_ptr);
-          quickening_info_ptr += sizeof(uint32_t);
-          optimizer::ArtDecompileDEX(*code_item,
-                                     ArrayRef<const uint8_t>(quickening_info_ptr, quickening_size),
-                                     decompile_return_instruction);
-          quickening_info_ptr += quickening_size;
-        }
-        it.Next();
-      }
-      DCHECK(!it.HasNext());
-    }
+    offset += UnquickenDexFile(*dex_file,
+                               quickening_info.SubArray(offset),
+                               decompile_return_instruction);
   }
-  if (quickening_info_ptr != quickening_info_end) {
+  if (offset != quickening_info.size()) {
     LOG(FATAL) << "Failed to use all quickening info";
   }
 }
@@ -142,6 +142,19 @@ class VdexFile {
                         const ArrayRef<const uint8_t>& quickening_info,
                         bool decompile_return_instruction);
 
+  // In-place unquicken `dex_file` based on `quickening_info`, which must start with the
+  // quickening info of `dex_file`. The quickening info of a vdex file is laid out in dex file
+  // order. Returns the number of bytes of `quickening_info` used by `dex_file`.
+  static size_t UnquickenDexFile(const DexFile& dex_file,
+                                 const ArrayRef<const uint8_t>& quickening_info,
+                                 bool decompile_return_instruction);
+
+  // Returns the part of `quickening_info` used by `dex_file`, without unquickening it.
+  // `quickening_info` must start with the quickening info of `dex_file`.
+  static ArrayRef<const uint8_t> GetQuickeningInfoOf(
+      const DexFile& dex_file,
+      const ArrayRef<const uint8_t>& quickening_info);
+
  private:
   explicit VdexFile(MemMap* mmap) : mmap_(mmap) {}
 
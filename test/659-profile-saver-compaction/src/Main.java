@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.io.File;
+import java.io.IOException;
+import java.lang.reflect.Method;
+import java.nio.file.Files;
+
+public class Main {
+  // The default of -Xps-max-deltas-before-compaction.
+  private static final int MAX_DELTAS_BEFORE_COMPACTION = 10;
+
+  // The magic and version which start every profile, and so every delta, in a profile file.
+  private static final byte[] PROFILE_HEADER = { 'p', 'r', 'o', 0, '0', '0', '5', 0 };
+
+  public static void main(String[] args) throws Exception {
+    System.loadLibrary(args[0]);
+
+    File file = null;
+    try {
+      file = createTempFile();
+      String codePath = System.getenv("DEX_LOCATION") + "/659-profile-saver-compaction.jar";
+      VMRuntime.registerAppInfo(file.getPath(),
+                                new String[] {codePath});
+
+      // Each save has exactly one new method, so it writes one delta. The save after
+      // MAX_DELTAS_BEFORE_COMPACTION deltas rewrites the file as a single profile.
+      int[] methodIdxs = new int[MAX_DELTAS_BEFORE_COMPACTION + 2];
+      for (int save = 0; save < methodIdxs.length; save++) {
+        methodIdxs[save] = $noinline$testProfile(save);
+        ensureProfileProcessing();
+
+        int expectedProfiles = (save < MAX_DELTAS_BEFORE_COMPACTION)
+            ? save + 1
+            : save + 1 - MAX_DELTAS_BEFORE_COMPACTION;
+        int profiles = countProfiles(file);
+        if (profiles != expectedProfiles) {
+          throw new RuntimeException("After save " + save + " the profile file holds " +
+              profiles + " profiles instead of " + expectedProfiles);
+        }
+        // Appending and compacting must not lose any data.
+        for (int i = 0; i <= save; i++) {
+          if (!presentInProfile(file.getPath(), methodIdxs[i])) {
+            throw new RuntimeException("After save " + save + " method with index " +
+                methodIdxs[i] + " not in the profile");
+          }
+        }
+      }
+    } finally {
+      if (file != null) {
+        file.delete();
+      }
+    }
+  }
+
+  // Returns the number of profiles (the base profile and the deltas) in the file.
+  private static int countProfiles(File file) throws IOException {
+    byte[] bytes = Files.readAllBytes(file.toPath());
+    int count = 0;
+    for (int i = 0; i + PROFILE_HEADER.length <= bytes.length; i++) {
+      int j = 0;
+      while (j < PROFILE_HEADER.length && bytes[i + j] == PROFILE_HEADER[j]) {
+        j++;
+      }
+      if (j == PROFILE_HEADER.length) {
+        count++;
+        i += PROFILE_HEADER.length - 1;
+      }
+    }
+    return count;
+  }
+
+  // Makes sure that one more method has a profile info and returns its dex method index.
+  public static int $noinline$testProfile(int n) {
+    switch (n) {
+      case 0: return $noinline$method0();
+      case 1: return $noinline$method1();
+      case 2: return $noinline$method2();
+      case 3: return $noinline$method3();
+      case 4: return $noinline$method4();
+      case 5: return $noinline$method5();
+      case 6: return $noinline$method6();
+      case 7: return $noinline$method7();
+      case 8: return $noinline$method8();
+      case 9: return $noinline$method9();
+      case 10: return $noinline$method10();
+      case 11: return $noinline$method11();
+      default: throw new Error("No method " + n);
+    }
+  }
+
+  public static int $noinline$method0() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method0");
+  }
+
+  public static int $noinline$method1() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method1");
+  }
+
+  public static int $noinline$method2() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method2");
+  }
+
+  public static int $noinline$method3() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method3");
+  }
+
+  public static int $noinline$method4() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method4");
+  }
+
+  public static int $noinline$method5() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method5");
+  }
+
+  public static int $noinline$method6() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method6");
+  }
+
+  public static int $noinline$method7() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method7");
+  }
+
+  public static int $noinline$method8() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method8");
+  }
+
+  public static int $noinline$method9() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method9");
+  }
+
+  public static int $noinline$method10() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method10");
+  }
+
+  public static int $noinline$method11() {
+    if (doThrow) throw new Error();
+    return ensureProfilingInfo("$noinline$method11");
+  }
+
+  // Return the dex method index.
+  public static native int ensureProfilingInfo(String methodName);
+  // Ensures the profile saver does its usual processing.
+  public static native void ensureProfileProcessing();
+  // Checks if the profiles saver knows about the method.
+  public static native boolean presentInProfile(String profile, int methodIdx);
+
+  public static boolean doThrow = false;
+  private static final String TEMP_FILE_NAME_PREFIX = "dummy";
+  private static final String TEMP_FILE_NAME_SUFFIX = "-file";
+
+  private static File createTempFile() throws Exception {
+    try {
+      return File.createTempFile(TEMP_FILE_NAME_PREFIX, TEMP_FILE_NAME_SUFFIX);
+    } catch (IOException e) {
+      System.setProperty("java.io.tmpdir", "/data/local/tmp");
+      try {
+        return File.createTempFile(TEMP_FILE_NAME_PREFIX, TEMP_FILE_NAME_SUFFIX);
+      } catch (IOException e2) {
+        System.setProperty("java.io.tmpdir", "/sdcard");
+        return File.createTempFile(TEMP_FILE_NAME_PREFIX, TEMP_FILE_NAME_SUFFIX);
+      }
+    }
+  }
+
+  private static class VMRuntime {
+    private static final Method registerAppInfoMethod;
+    static {
+      try {
+        Class<? extends Object> c = Class.forName("dalvik.system.VMRuntime");
+        registerAppInfoMethod = c.getDeclaredMethod("registerAppInfo",
+            String.class, String[].class);
+      } catch (Exception e) {
+        throw new RuntimeException(e);
+      }
+    }
+
+    public static void registerAppInfo(String profile, String[] codePaths)
+        throws Exception {
+      registerAppInfoMethod.invoke(null, profile, codePaths);
+    }
+  }
+}